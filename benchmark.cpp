@@ -0,0 +1,348 @@
+#include "benchmark.hpp"
+#include "transform.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+	/// <summary>
+	/// Uniform float in [0, 1) derived directly from generator bits, since std distributions differ between standard libraries
+	/// </summary>
+	float uniformFloat(std::mt19937& rng) { return static_cast<float>(rng() >> 8) * (1.0f / 16777216.0f); }
+
+	std::string escapeJson(const std::string& text) {
+		std::ostringstream escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') escaped << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20) escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+			else escaped << c;
+		}
+		return escaped.str();
+	}
+
+	void writeSummary(std::ostream& output, const FrameTimeSummary& summary) {
+		output << "{\"samples\": " << summary.sample_count
+			<< ", \"mean\": " << summary.mean
+			<< ", \"p50\": " << summary.p50
+			<< ", \"p99\": " << summary.p99
+			<< ", \"max\": " << summary.max << "}";
+	}
+}
+
+Benchmark::Benchmark(const AppSettings& settings, uint32_t seed) : settings{ settings }, seed{ seed } {
+	if (this->settings.frame_limit == 0) this->settings.frame_limit = DEFAULT_FRAMES;
+}
+
+const std::vector<BenchmarkSceneConfig>&
+Benchmark::defaultScenes() {
+	static const std::vector<BenchmarkSceneConfig> scenes = {
+		{ "tris_1_draws_1", 1, 1 },
+		{ "tris_1k_draws_1", 1000, 1 },
+		{ "tris_100k_draws_1", 100000, 1 },
+		{ "tris_1m_draws_1", 1000000, 1 },
+		{ "tris_1k_draws_1k", 1000, 1000 },
+		{ "tris_100k_draws_100", 100000, 100 },
+		{ "tris_100k_draws_10k", 100000, 10000 },
+		{ "tris_100k_draws_100k", 100000, 100000 },
+		{ "tris_1m_draws_100k", 1000000, 100000 },
+		{ "copies_10k_tris_100k_draws_10k", 100000, 10000 },
+		{ "copies_10k_tris_100k_instanced", 100000, 10000, true },
+		{ "copies_100k_tris_1m_instanced", 1000000, 100000, true },
+		{ "overdraw_layers_32", 64, 32, false, true }
+	};
+	return scenes;
+}
+
+BenchmarkScene
+Benchmark::generateScene(const BenchmarkSceneConfig& config, uint32_t seed) {
+	BenchmarkScene scene;
+	std::mt19937 rng(seed);
+	// Shrink triangles as their number grows so that total covered area (and thus fragment load) stays roughly constant
+	float triangle_size = std::clamp(2.0f / std::sqrt(static_cast<float>(config.triangle_count)), 0.002f, 0.5f);
+
+	// Appends a cluster of triangles around a centre, as the triangles of a mesh would be
+	auto generateMesh = [&](uint32_t triangle_count, glm::vec2 centre, glm::vec3 colour) {
+		DrawRange range{};
+		range.first_index = static_cast<uint32_t>(scene.indices.size());
+		range.index_count = triangle_count * 3;
+		for (uint32_t triangle = 0; triangle < triangle_count; triangle++) {
+			glm::vec2 origin = centre + glm::vec2{ uniformFloat(rng) - 0.5f, uniformFloat(rng) - 0.5f } * 0.4f;
+			float angle = uniformFloat(rng) * 6.2831853f;
+			glm::vec2 right = glm::vec2{ std::cos(angle), std::sin(angle) } * triangle_size;
+			glm::vec2 down = glm::vec2{ -right.y, right.x };
+
+			// Rotating (0,0), (1,0), (1,1) keeps the clockwise winding expected by the pipeline's culling
+			uint32_t base = static_cast<uint32_t>(scene.vertices.size());
+			scene.vertices.push_back({ origin, colour });
+			scene.vertices.push_back({ origin + right, colour });
+			scene.vertices.push_back({ origin + right + down, colour });
+			scene.indices.insert(scene.indices.end(), { base, base + 1, base + 2 });
+		}
+		return range;
+	};
+	auto randomCentre = [&]() { return glm::vec2{ uniformFloat(rng) * 1.6f - 0.8f, uniformFloat(rng) * 1.6f - 0.8f }; };
+	auto randomColour = [&]() { return glm::vec3{ uniformFloat(rng), uniformFloat(rng), uniformFloat(rng) }; };
+
+	if (config.layered) {
+		// Drawn farthest first (never sorted by state), so every layer passes the depth test and is shaded unless a pre-pass
+		// resolved depth beforehand
+		scene.instances.resize(config.draw_count);
+		for (uint32_t draw = 0; draw < config.draw_count; draw++) {
+			glm::vec3 colour = randomColour();
+			uint32_t base = static_cast<uint32_t>(scene.vertices.size());
+			scene.vertices.push_back({ { -1.0f, -1.0f }, colour });
+			scene.vertices.push_back({ { 1.0f, -1.0f }, colour });
+			scene.vertices.push_back({ { 1.0f, 1.0f }, colour });
+			scene.vertices.push_back({ { -1.0f, 1.0f }, colour });
+			DrawRange range{ static_cast<uint32_t>(scene.indices.size()), 6 };
+			scene.indices.insert(scene.indices.end(), { base, base + 1, base + 2, base + 2, base + 3, base });
+
+			scene.instances[draw].transform[3] = glm::vec4{ 0.0f, 0.0f, 1.0f - (draw + 1.0f) / (config.draw_count + 1.0f), 1.0f };
+			scene.objects.push_back({ 0, range, draw, 1 });
+			scene.objects.back().bounds = CullingUtils::computeBoundingSphere(scene.vertices, scene.indices, range);
+		}
+		return scene;
+	}
+
+	uint32_t triangles_per_draw = config.triangle_count / config.draw_count;
+	if (config.instanced) {
+		// One shared mesh, each copy placed and tinted through its instance data
+		DrawRange range = generateMesh(triangles_per_draw, { 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+		scene.instances.reserve(config.draw_count);
+		for (uint32_t copy = 0; copy < config.draw_count; copy++) {
+			InstanceData instance{};
+			glm::vec2 offset = randomCentre();
+			instance.transform[3] = glm::vec4{ offset, 0.0f, 1.0f };
+			instance.color = glm::vec4{ randomColour(), 1.0f };
+			scene.instances.push_back(instance);
+		}
+		scene.objects.push_back({ 0, range, 0, config.draw_count });
+		scene.objects.back().bounds = CullingUtils::computeBoundingSphere(scene.vertices, scene.indices, range);
+		return scene;
+	}
+
+	scene.vertices.reserve(static_cast<size_t>(config.triangle_count) * 3);
+	scene.indices.reserve(static_cast<size_t>(config.triangle_count) * 3);
+	scene.objects.reserve(config.draw_count);
+	uint32_t remainder = config.triangle_count % config.draw_count;
+	for (uint32_t draw = 0; draw < config.draw_count; draw++) {
+		glm::vec2 centre = randomCentre();
+		glm::vec3 colour = randomColour();
+		DrawRange range = generateMesh(triangles_per_draw + (draw < remainder ? 1 : 0), centre, colour);
+		scene.objects.push_back({ 0, range, draw, 1 }); // Each object has its own (identity) instance
+		scene.objects.back().bounds = CullingUtils::computeBoundingSphere(scene.vertices, scene.indices, range);
+	}
+	scene.instances.resize(config.draw_count);
+	return scene;
+}
+
+void
+Benchmark::run(std::ostream& output, const std::string& scene_filter) {
+	output << std::fixed << std::setprecision(4);
+	output << "{\n  \"seed\": " << seed
+		<< ",\n  \"frames\": " << settings.frame_limit
+		<< ",\n  \"warmup_frames\": " << WARMUP_FRAMES
+		<< ",\n  \"width\": " << settings.width
+		<< ",\n  \"height\": " << settings.height
+		<< ",\n  \"headless\": " << (settings.headless ? "true" : "false")
+		<< ",\n  \"indirect_draws\": " << (settings.indirect_draws ? "true" : "false")
+		<< ",\n  \"gpu_culling\": " << (settings.gpu_culling ? "true" : "false")
+		<< ",\n  \"cpu_culling\": " << (settings.cpu_culling ? "true" : "false")
+		<< ",\n  \"depth_prepass\": " << (settings.depth_prepass ? "true" : "false")
+		<< ",\n  \"msaa_samples\": " << settings.msaa_samples
+		<< ",\n  \"frame_budget_ms\": " << settings.frame_budget_ms
+		<< ",\n  \"scenes\": [";
+
+	bool first_scene = true;
+	for (const BenchmarkSceneConfig& config : defaultScenes()) {
+		if (!scene_filter.empty() && config.name.find(scene_filter) == std::string::npos) continue;
+		std::cerr << "Running benchmark scene " << config.name << std::endl;
+
+		AppSettings scene_settings = settings;
+		scene_settings.frame_limit = settings.frame_limit + WARMUP_FRAMES;
+		scene_settings.sort_draws = settings.sort_draws && !config.layered;
+		CoreApp app(scene_settings);
+
+		// Upload the generated scene as a single model
+		BenchmarkScene scene = generateScene(config, seed);
+		uint64_t scene_bytes = scene.vertices.size() * sizeof(Vertex) + scene.indices.size() * sizeof(uint32_t) + scene.instances.size() * sizeof(InstanceData);
+		std::vector<std::unique_ptr<Model>> models;
+		models.push_back(std::make_unique<Model>(app.getDevice(), scene.vertices, scene.indices));
+		app.setScene(std::move(models), std::move(scene.objects), scene.instances);
+		scene = {}; // Host copy is no longer needed and would inflate measured memory
+
+		app.run();
+		HostMemoryUsage host_memory = ProfilingUtils::queryHostMemoryUsage();
+		MemorySnapshot device_memory = app.getDevice().getMemoryTracker().snapshot();
+
+		// Drop warmup frames from the statistics
+		const FrameTimings& timings = app.getFrameTimings();
+		auto measured = [](const std::vector<double>& samples) {
+			size_t skip = std::min<size_t>(WARMUP_FRAMES, samples.size());
+			return std::vector<double>(samples.begin() + skip, samples.end());
+		};
+
+		output << (first_scene ? "\n" : ",\n");
+		first_scene = false;
+		output << "    {\n      \"name\": \"" << escapeJson(config.name) << "\""
+			<< ",\n      \"device\": \"" << escapeJson(app.getDevice().physical_device_properties.deviceName) << "\""
+			<< ",\n      \"triangles\": " << config.triangle_count
+			<< ",\n      \"objects\": " << config.draw_count
+			<< ",\n      \"instanced\": " << (config.instanced ? "true" : "false")
+			<< ",\n      \"sorted_draws\": " << (scene_settings.sort_draws ? "true" : "false")
+			<< ",\n      \"samples\": " << app.getSampleCount()
+			<< ",\n      \"cpu_frame_ms\": ";
+		writeSummary(output, ProfilingUtils::summarise(measured(timings.cpu_ms)));
+		output << ",\n      \"gpu_frame_ms\": ";
+		if (timings.gpu_ms.empty()) output << "null";
+		else writeSummary(output, ProfilingUtils::summarise(measured(timings.gpu_ms)));
+		output << ",\n      \"fragment_invocations\": ";
+		if (timings.fragment_invocations.empty()) output << "null";
+		else writeSummary(output, ProfilingUtils::summarise(measured(std::vector<double>(timings.fragment_invocations.begin(), timings.fragment_invocations.end()))));
+		output << ",\n      \"render_scale\": ";
+		writeSummary(output, ProfilingUtils::summarise(measured(timings.render_scale)));
+		output << ",\n      \"binds_issued\": ";
+		writeSummary(output, ProfilingUtils::summarise(measured(std::vector<double>(timings.binds_issued.begin(), timings.binds_issued.end()))));
+		output << ",\n      \"binds_skipped\": ";
+		writeSummary(output, ProfilingUtils::summarise(measured(std::vector<double>(timings.binds_skipped.begin(), timings.binds_skipped.end()))));
+		output << ",\n      \"resolution_changes\": " << (app.getResolutionController() ? app.getResolutionController()->getChanges().size() : 0);
+		output << ",\n      \"memory\": {\"scene_buffer_bytes\": " << scene_bytes
+			<< ", \"attachment_bytes\": " << app.getRenderGraph().getTransientMemorySize()
+			<< ", \"lazy_attachment_bytes\": " << app.getRenderGraph().getLazyMemorySize()
+			<< ", \"device_allocated_bytes\": " << device_memory.allocatedBytes()
+			<< ", \"device_local_bytes\": " << device_memory.deviceLocalBytes()
+			<< ", \"device_budget_queried\": " << (device_memory.budget_queried ? "true" : "false")
+			<< ", \"host_current_bytes\": " << host_memory.current_bytes
+			<< ", \"host_peak_bytes\": " << host_memory.peak_bytes
+			<< ", \"categories\": {";
+		for (size_t i = 0; i < device_memory.categories.size(); i++) {
+			const CategoryUsage& usage = device_memory.categories[i];
+			output << (i == 0 ? "" : ", ") << "\"" << MemoryTracker::categoryName(static_cast<MemoryCategory>(i))
+				<< "\": {\"bytes\": " << usage.bytes << ", \"peak_bytes\": " << usage.peak_bytes << "}";
+		}
+		output << "}}"
+			<< "\n    }";
+	}
+	output << "\n  ]\n}" << std::endl;
+}
+
+void
+Benchmark::runCulling(std::ostream& output) {
+	// Spheres scattered around a camera looking down +z, so that a fraction of them is inside the frustum
+	std::mt19937 rng(seed);
+	BoundingSphereArray spheres;
+	spheres.resize(CULLING_OBJECT_COUNT);
+	for (uint32_t i = 0; i < CULLING_OBJECT_COUNT; i++) {
+		glm::vec3 centre{ uniformFloat(rng) * 200.0f - 100.0f, uniformFloat(rng) * 200.0f - 100.0f, uniformFloat(rng) * 200.0f - 100.0f };
+		spheres.set(i, { centre, 0.05f + uniformFloat(rng) * 2.0f });
+	}
+	glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3{ 0.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	Frustum frustum = Frustum::fromMatrix(projection * view);
+
+	std::vector<uint32_t> expected;
+	CullingUtils::cullSpheres(frustum, spheres, expected, SimdLevel::Scalar);
+
+	output << std::fixed << std::setprecision(4);
+	output << "{\n  \"seed\": " << seed
+		<< ",\n  \"objects\": " << CULLING_OBJECT_COUNT
+		<< ",\n  \"iterations\": " << CULLING_ITERATIONS
+		<< ",\n  \"visible\": " << expected.size()
+		<< ",\n  \"dispatched\": \"" << CullingUtils::simdLevelName(CullingUtils::bestSimdLevel()) << "\""
+		<< ",\n  \"paths\": [";
+
+	bool first_path = true;
+	auto measurePath = [&](const std::string& name, const std::function<void(std::vector<uint32_t>&)>& cull) {
+		std::vector<uint32_t> visible;
+		std::vector<double> pass_ms;
+		bool matches = true;
+		for (uint32_t iteration = 0; iteration < CULLING_ITERATIONS; iteration++) {
+			auto start = std::chrono::steady_clock::now();
+			cull(visible);
+			pass_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			matches = matches && visible == expected;
+		}
+
+		FrameTimeSummary summary = ProfilingUtils::summarise(pass_ms);
+		output << (first_path ? "\n" : ",\n");
+		first_path = false;
+		output << "    {\"name\": \"" << name << "\""
+			<< ", \"matches_scalar\": " << (matches ? "true" : "false")
+			<< ", \"ns_per_object\": " << summary.p50 * 1e6 / CULLING_OBJECT_COUNT
+			<< ", \"pass_ms\": ";
+		writeSummary(output, summary);
+		output << "}";
+	};
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2, SimdLevel::Neon }) {
+		if (!CullingUtils::isSimdLevelSupported(level)) continue;
+		measurePath(CullingUtils::simdLevelName(level), [&](std::vector<uint32_t>& visible) { CullingUtils::cullSpheres(frustum, spheres, visible, level); });
+	}
+
+	// Widest instruction set split across every thread
+	JobSystem jobs(settings.worker_threads, settings.pin_threads);
+	measurePath(std::string(CullingUtils::simdLevelName(CullingUtils::bestSimdLevel())) + " x" + std::to_string(jobs.getThreadCount()) + " threads",
+		[&](std::vector<uint32_t>& visible) { CullingUtils::cullSpheres(frustum, spheres, visible, jobs); });
+	output << "\n  ]\n}" << std::endl;
+}
+
+void
+Benchmark::runTransforms(std::ostream& output) {
+	// Random forest: a hundred roots, every other node parented to a random earlier node
+	std::mt19937 rng(seed);
+	constexpr uint32_t root_count = 100;
+	JobSystem jobs(settings.worker_threads, settings.pin_threads);
+	TransformHierarchy hierarchy(&jobs);
+	for (uint32_t node = 0; node < TRANSFORM_NODE_COUNT; node++) {
+		glm::mat4 local{ 1.0f };
+		local[3] = glm::vec4{ uniformFloat(rng) - 0.5f, uniformFloat(rng) - 0.5f, 0.0f, 1.0f };
+		hierarchy.addNode(local, node < root_count ? TransformHierarchy::NO_PARENT : rng() % node);
+	}
+	std::vector<uint32_t> updated_nodes;
+	hierarchy.update(updated_nodes);
+
+	output << std::fixed << std::setprecision(4);
+	output << "{\n  \"seed\": " << seed
+		<< ",\n  \"nodes\": " << TRANSFORM_NODE_COUNT
+		<< ",\n  \"depth\": " << hierarchy.getDepthCount()
+		<< ",\n  \"frames\": " << TRANSFORM_FRAMES
+		<< ",\n  \"threads\": " << jobs.getThreadCount()
+		<< ",\n  \"runs\": [";
+
+	// Animating roots dirties their whole subtree, so the last run is a full recomputation
+	const std::vector<std::pair<std::string, uint32_t>> runs = { { "animate_10_nodes", 10 }, { "animate_1000_nodes", 1000 }, { "animate_all_roots", 0 } };
+	for (size_t run = 0; run < runs.size(); run++) {
+		std::vector<double> update_ms;
+		uint64_t recomputed = 0;
+		for (uint32_t frame = 0; frame < TRANSFORM_FRAMES; frame++) {
+			uint32_t animated = runs[run].second == 0 ? root_count : runs[run].second;
+			for (uint32_t i = 0; i < animated; i++) {
+				uint32_t node = runs[run].second == 0 ? i : rng() % TRANSFORM_NODE_COUNT;
+				glm::mat4 local = hierarchy.getLocal(node);
+				local[3].x += 0.001f;
+				hierarchy.setLocal(node, local);
+			}
+			auto start = std::chrono::steady_clock::now();
+			hierarchy.update(updated_nodes);
+			update_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			recomputed += updated_nodes.size();
+		}
+
+		output << (run == 0 ? "\n" : ",\n");
+		output << "    {\"name\": \"" << runs[run].first << "\""
+			<< ", \"mean_recomputed_nodes\": " << static_cast<double>(recomputed) / TRANSFORM_FRAMES
+			<< ", \"update_ms\": ";
+		writeSummary(output, ProfilingUtils::summarise(update_ms));
+		output << "}";
+	}
+	output << "\n  ]\n}" << std::endl;
+}
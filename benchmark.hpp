@@ -0,0 +1,102 @@
+#pragma once
+
+#include "core_app.hpp"
+#include "model.hpp"
+#include "scene.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Size parameters of a procedurally generated benchmark scene
+/// </summary>
+struct BenchmarkSceneConfig {
+	std::string name;
+	uint32_t triangle_count;
+	/// <summary>
+	/// Number of objects; each is a separate draw unless the scene is instanced
+	/// </summary>
+	uint32_t draw_count;
+	/// <summary>
+	/// Objects are copies of one mesh drawn by a single instanced draw instead of distinct meshes drawn one by one
+	/// </summary>
+	bool instanced = false;
+	/// <summary>
+	/// Objects are full screen quads stacked back to front, each nearer than the last, instead of random triangles
+	/// (triangle_count is ignored). Measures overdraw, which a depth pre-pass removes. Never sorted by state, as sorting front
+	/// to back would remove the overdraw too
+	/// </summary>
+	bool layered = false;
+};
+
+/// <summary>
+/// Geometry of a generated benchmark scene as a single model, with the objects and instances drawing it
+/// </summary>
+struct BenchmarkScene {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<SceneObject> objects;
+	std::vector<InstanceData> instances;
+};
+
+/// <summary>
+/// Runs a fixed number of frames over a set of deterministic scenes and reports frame time and memory statistics as JSON
+/// </summary>
+class Benchmark {
+public:
+	/// <summary>
+	/// Frames drawn (and excluded from statistics) before measurement starts, to let caches and drivers settle
+	/// </summary>
+	static constexpr uint32_t WARMUP_FRAMES = 10;
+	static constexpr uint32_t DEFAULT_FRAMES = 200;
+	static constexpr uint32_t CULLING_OBJECT_COUNT = 1000000;
+	static constexpr uint32_t CULLING_ITERATIONS = 50;
+	static constexpr uint32_t TRANSFORM_NODE_COUNT = 100000;
+	static constexpr uint32_t TRANSFORM_FRAMES = 100;
+
+	/// <summary>
+	/// Creates a Benchmark object
+	/// </summary>
+	/// <param name="settings">Application settings each scene is run with (frame_limit selects the measured frame count)</param>
+	/// <param name="seed">Seed for scene generation, identical seeds produce identical scenes on every platform</param>
+	Benchmark(const AppSettings& settings, uint32_t seed);
+
+	/// <summary>
+	/// Run every scene and write the results as a single JSON document
+	/// </summary>
+	/// <param name="output">Stream to write JSON results to</param>
+	/// <param name="scene_filter">Only scenes whose name contains this string are run (empty runs all)</param>
+	void run(std::ostream& output, const std::string& scene_filter = "");
+	/// <summary>
+	/// Time CPU frustum culling of CULLING_OBJECT_COUNT random spheres with every supported instruction set and write the
+	/// results as JSON, noting whether each path's visible list exactly matches the scalar one (--self-test checks the
+	/// paths against each other, allowing for rounding on spheres touching a plane)
+	/// </summary>
+	/// <param name="output">Stream to write JSON results to</param>
+	void runCulling(std::ostream& output);
+	/// <summary>
+	/// Time transform hierarchy updates of TRANSFORM_NODE_COUNT nodes when animating an increasing fraction of them
+	/// (from a few nodes to every root), and write the results as JSON
+	/// </summary>
+	/// <param name="output">Stream to write JSON results to</param>
+	void runTransforms(std::ostream& output);
+
+	/// <summary>
+	/// Scenes scaling from a single triangle to 1,000,000 triangles and from a single draw to 100,000 draws, plus a layered
+	/// overdraw scene
+	/// </summary>
+	static const std::vector<BenchmarkSceneConfig>& defaultScenes();
+	/// <summary>
+	/// Procedurally generate a scene of small randomly placed triangles
+	/// </summary>
+	/// <param name="config">Number of triangles and draws to generate</param>
+	/// <param name="seed">Seed of the random generator</param>
+	/// <returns>Generated geometry, with triangles distributed as evenly as possible over the objects</returns>
+	static BenchmarkScene generateScene(const BenchmarkSceneConfig& config, uint32_t seed);
+
+private:
+	AppSettings settings;
+	uint32_t seed;
+};
@@ -0,0 +1,47 @@
+#include "buffer.hpp"
+
+#include <string>
+
+UniformRingBuffer::UniformRingBuffer(LogicalDevice& device, uint32_t frame_count, VkDeviceSize frame_capacity, VkBufferUsageFlags usage)
+	: device{ device }, frame_count{ frame_count } {
+	// Every allocation may be used as a dynamic offset of either descriptor type
+	const VkPhysicalDeviceLimits& limits = device.physical_device_properties.limits;
+	alignment = std::max<VkDeviceSize>({ limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, 16 });
+	region_size = (frame_capacity + alignment - 1) / alignment * alignment;
+
+	device.createBuffer(
+		region_size * frame_count,
+		usage,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // Rewritten by the host every frame
+		MemoryCategory::Uniform,
+		buffer,
+		memory);
+	void* data;
+	if (vkMapMemory(device.getDevice(), memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to map uniform ring buffer memory");
+	}
+	mapped = static_cast<char*>(data);
+}
+
+UniformRingBuffer::~UniformRingBuffer() {
+	vkUnmapMemory(device.getDevice(), memory);
+	vkDestroyBuffer(device.getDevice(), buffer, nullptr);
+	device.freeMemory(memory);
+}
+
+void
+UniformRingBuffer::beginFrame(uint32_t frame) {
+	assert(frame < frame_count && "Frame index out of range");
+	current_frame = frame;
+	cursor = 0;
+}
+
+VkDeviceSize
+UniformRingBuffer::allocate(VkDeviceSize size) {
+	VkDeviceSize offset = cursor;
+	if (offset + size > region_size) {
+		throw std::runtime_error("Uniform ring buffer frame region exhausted (" + std::to_string(region_size) + " bytes)");
+	}
+	cursor = (offset + size + alignment - 1) / alignment * alignment;
+	return offset;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+/// <summary>
+/// Array of elements mirrored into one persistently mapped, host-visible buffer per frame in flight.
+/// Elements are written on the host through set() and only the entries changed since a frame's copy was last
+/// flushed are written to it, so a frame whose fence has signalled can be updated without waiting on the others.
+/// Growing works the same way: each frame's buffer is replaced by a larger one when that frame is next flushed
+/// </summary>
+/// <typeparam name="T">Element type, copied into GPU memory verbatim</typeparam>
+template <typename T>
+class PerFrameBuffer {
+public:
+	static constexpr uint32_t MAX_FRAMES = 8; // Bound by the width of the per-element dirty mask
+
+	/// <summary>
+	/// Creates a PerFrameBuffer object
+	/// </summary>
+	/// <param name="device">Device to allocate buffers on</param>
+	/// <param name="frame_count">Number of frames that can be in flight (one buffer copy is kept per frame)</param>
+	/// <param name="usage">Flags specifying what the buffers will be used for</param>
+	/// <param name="capacity">Number of elements to initially allocate space for</param>
+	PerFrameBuffer(LogicalDevice& device, uint32_t frame_count, VkBufferUsageFlags usage, uint32_t capacity = 1)
+		: device{ device }, usage{ usage }, frames(frame_count) {
+		assert(frame_count > 0 && frame_count <= MAX_FRAMES && "Unsupported number of frames in flight");
+		this->capacity = capacity > 0 ? capacity : 1;
+		for (FrameCopy& copy : frames) allocate(copy);
+	}
+	~PerFrameBuffer() {
+		for (FrameCopy& copy : frames) release(copy);
+	}
+
+	PerFrameBuffer(const PerFrameBuffer&) = delete;
+	PerFrameBuffer& operator=(const PerFrameBuffer&) = delete;
+
+	uint32_t size() { return static_cast<uint32_t>(elements.size()); }
+	const T& get(uint32_t index) { return elements[index]; }
+	VkBuffer getBuffer(uint32_t frame) { return frames[frame].buffer; }
+
+	/// <summary>
+	/// Change the number of elements. Growing beyond the current capacity replaces each frame's buffer when that frame is
+	/// next flushed, so buffers in use by the GPU are left untouched
+	/// </summary>
+	/// <param name="count">New number of elements, new elements are value-initialised and marked dirty</param>
+	void resize(uint32_t count) {
+		uint32_t old_count = size();
+		elements.resize(count);
+		dirty_mask.resize(count, 0);
+		if (count > capacity) capacity = std::max(count, capacity * 2); // Geometric, so repeated appends rarely reallocate
+		for (uint32_t i = old_count; i < count; i++) markDirty(i);
+	}
+
+	/// <summary>
+	/// Update an element on the host, it is written to each frame's buffer the next time that frame is flushed
+	/// </summary>
+	void set(uint32_t index, const T& value) {
+		elements[index] = value;
+		markDirty(index);
+	}
+
+	/// <summary>
+	/// Copy all elements changed since the last flush of this frame into its mapped buffer.
+	/// The frame's previous use of the buffer must have completed on the GPU
+	/// </summary>
+	/// <param name="frame">Index of the frame in flight about to be recorded</param>
+	void flush(uint32_t frame) {
+		FrameCopy& copy = frames[frame];
+		if (copy.capacity < capacity) {
+			// The frame's previous use has completed, so its buffer can be replaced, and the fresh one holds nothing yet
+			release(copy);
+			allocate(copy);
+			copy.dirty_indices.resize(elements.size());
+			for (uint32_t index = 0; index < elements.size(); index++) {
+				copy.dirty_indices[index] = index;
+				dirty_mask[index] |= static_cast<uint8_t>(1u << frame);
+			}
+		}
+		for (uint32_t index : copy.dirty_indices) {
+			if (index >= elements.size()) continue; // Element was removed by shrinking since it was marked
+			std::memcpy(copy.mapped + static_cast<size_t>(index) * sizeof(T), &elements[index], sizeof(T));
+			dirty_mask[index] &= static_cast<uint8_t>(~(1u << frame));
+		}
+		copy.dirty_indices.clear();
+	}
+
+private:
+	struct FrameCopy {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		char* mapped = nullptr;
+		uint32_t capacity = 0; // Elements the buffer holds, below the array's capacity until the frame is next flushed
+		std::vector<uint32_t> dirty_indices; // Elements this frame's copy is missing, each listed at most once
+	};
+
+	LogicalDevice& device;
+	VkBufferUsageFlags usage;
+	uint32_t capacity = 0; // Elements every frame's buffer will hold once flushed
+	std::vector<FrameCopy> frames;
+	std::vector<T> elements;
+	std::vector<uint8_t> dirty_mask; // Bit f is set while frame f's copy of the element is stale
+
+	void markDirty(uint32_t index) {
+		for (uint32_t frame = 0; frame < frames.size(); frame++) {
+			if (!(dirty_mask[index] & (1u << frame))) frames[frame].dirty_indices.push_back(index);
+		}
+		dirty_mask[index] = static_cast<uint8_t>((1u << frames.size()) - 1);
+	}
+
+	void allocate(FrameCopy& copy) {
+		VkDeviceSize buffer_size = sizeof(T) * static_cast<VkDeviceSize>(capacity);
+		device.createBuffer(
+			buffer_size,
+			usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // Written directly by the host every frame, coherency removes the need for explicit flushes
+			MemoryTracker::bufferCategory(usage),
+			copy.buffer,
+			copy.memory);
+		void* data;
+		if (vkMapMemory(device.getDevice(), copy.memory, 0, buffer_size, 0, &data) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to map per-frame buffer memory");
+		}
+		copy.mapped = static_cast<char*>(data);
+		copy.capacity = capacity;
+	}
+
+	void release(FrameCopy& copy) {
+		if (copy.buffer == VK_NULL_HANDLE) return;
+		vkUnmapMemory(device.getDevice(), copy.memory);
+		vkDestroyBuffer(device.getDevice(), copy.buffer, nullptr);
+		device.freeMemory(copy.memory);
+		copy.buffer = VK_NULL_HANDLE;
+		copy.memory = VK_NULL_HANDLE;
+		copy.mapped = nullptr;
+		copy.capacity = 0;
+	}
+};
+
+/// <summary>
+/// Persistently mapped buffer split into one region per frame in flight, from which uniform/storage data is sub-allocated
+/// linearly while recording. A region is bound once per frame through a dynamic descriptor (its base is the dynamic offset),
+/// so writing data costs a pointer bump and a copy, with no allocations or descriptor updates
+/// </summary>
+class UniformRingBuffer {
+public:
+	/// <summary>
+	/// Creates a UniformRingBuffer object
+	/// </summary>
+	/// <param name="device">Device to allocate the buffer on, whose limits determine allocation alignment</param>
+	/// <param name="frame_count">Number of frames that can be in flight (one region is kept per frame)</param>
+	/// <param name="frame_capacity">Bytes available to each frame</param>
+	/// <param name="usage">Flags specifying what the buffer will be used for</param>
+	UniformRingBuffer(
+		LogicalDevice& device,
+		uint32_t frame_count,
+		VkDeviceSize frame_capacity,
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	~UniformRingBuffer();
+
+	UniformRingBuffer(const UniformRingBuffer&) = delete;
+	UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+	/// <summary>
+	/// Start writing to the given frame's region, discarding its previous contents. The frame's previous use must have completed
+	/// </summary>
+	void beginFrame(uint32_t frame);
+	/// <summary>
+	/// Reserve space in the current frame's region
+	/// </summary>
+	/// <param name="size">Number of bytes to reserve</param>
+	/// <returns>Offset of the reservation from the start of the region, aligned for use as a dynamic offset</returns>
+	VkDeviceSize allocate(VkDeviceSize size);
+	/// <summary>
+	/// Copy a value into the current frame's region
+	/// </summary>
+	/// <returns>Offset of the value from the start of the region</returns>
+	template <typename T>
+	VkDeviceSize write(const T& value) {
+		VkDeviceSize offset = allocate(sizeof(T));
+		std::memcpy(mapped + region_size * current_frame + offset, &value, sizeof(T));
+		return offset;
+	}
+
+	VkBuffer getBuffer() { return buffer; }
+	/// <summary>
+	/// Byte offset of a frame's region in the buffer, to be added to the offsets returned by allocate()
+	/// </summary>
+	uint32_t getFrameOffset(uint32_t frame) { return static_cast<uint32_t>(region_size * frame); }
+	VkDeviceSize getFrameCapacity() { return region_size; }
+	/// <summary>
+	/// Bytes allocated from the current frame's region so far
+	/// </summary>
+	VkDeviceSize getUsedSize() { return cursor; }
+
+private:
+	LogicalDevice& device;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	char* mapped = nullptr;
+	VkDeviceSize alignment;
+	VkDeviceSize region_size;
+	uint32_t frame_count;
+	uint32_t current_frame = 0;
+	VkDeviceSize cursor = 0;
+};
@@ -1,33 +1,402 @@
 #include "core_app.hpp"
+#include "image.hpp"
+#include "ktx.hpp"
+#include "lod.hpp"
+#include "mapped_file.hpp"
+#include "obj.hpp"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <stdexcept>
 #include <cstdlib>
 #include <vector>
 #include <set>
+#include <tuple>
+
+CoreApp::CoreApp(const AppSettings& settings)
+	: settings{ settings },
+	window{ settings.headless ? nullptr : std::make_unique<Window>(static_cast<int>(settings.width), static_cast<int>(settings.height), "Vulkan Tutorial") },
+	jobs{ settings.worker_threads, settings.pin_threads },
+	vulkan_device{ window.get(), settings.device } {
+	bool wants_indirect = settings.indirect_draws || settings.gpu_culling;
+	use_indirect_draws = wants_indirect && indirect_draws.isSupported();
+	if (wants_indirect && !use_indirect_draws) std::cerr << "Indirect draws with a first instance are unsupported, drawing directly" << std::endl;
+	if (use_indirect_draws && settings.gpu_culling) {
+		gpu_culler = std::make_unique<GpuCuller>(vulkan_device, SwapChain::MAX_FRAMES_IN_FLIGHT, "shaders/cull.spv", settings.validate_culling);
+	}
+	use_cpu_culling = settings.cpu_culling && !use_indirect_draws;
+
+	// Sample counts are powers of two, so the highest usable one is the largest power of two within both limits
+	uint32_t max_samples = std::min<uint32_t>(std::max(settings.msaa_samples, 1u), vulkan_device.getMaxUsableSampleCount());
+	while (max_samples & (max_samples - 1)) max_samples &= max_samples - 1;
+	sample_count = static_cast<VkSampleCountFlagBits>(max_samples);
+	if (sample_count < settings.msaa_samples) std::cerr << "Multisampling limited to " << sample_count << " samples" << std::endl;
+	if (settings.frame_budget_ms > 0.0) resolution_controller = std::make_unique<ResolutionController>(settings.frame_budget_ms, settings.min_render_scale);
+
+	if (BindlessDescriptors::isSupported(vulkan_device)) {
+		bindless = std::make_unique<BindlessDescriptors>(vulkan_device, SwapChain::MAX_FRAMES_IN_FLIGHT);
+		texture_streamer = std::make_unique<TextureStreamer>(vulkan_device, *bindless, SwapChain::MAX_FRAMES_IN_FLIGHT, settings.texture_budget);
+	}
+	mesh_streamer = std::make_unique<MeshStreamer>(vulkan_device, jobs, SwapChain::MAX_FRAMES_IN_FLIGHT);
+	if (settings.capture_interval > 0) std::filesystem::create_directories(settings.capture_directory);
 
-CoreApp::CoreApp() {
 	loadModels();
+	createFrameDescriptorSet();
 	createPipelineLayout();
 	recreateSwapChain();
 	createCommandBuffers();
+	if (resolution_controller && !gpu_timer->isSupported()) std::cerr << "GPU timestamps are unsupported, dynamic resolution stays at full resolution" << std::endl;
 }
 
 CoreApp::~CoreApp() {
+	// Background writes report into a member counter, so they must end before it does even if run() was left by an exception
+	try { jobs.wait(capture_writes); }
+	catch (const std::exception&) {}
 	vkDestroyPipelineLayout(vulkan_device.getDevice(), pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(vulkan_device.getDevice(), frame_set_layout, nullptr);
 }
 
 void
 CoreApp::run() {
-	while (!window.shouldClose()) {
-		glfwPollEvents();
+	for (uint32_t frame = 0; settings.frame_limit == 0 || frame < settings.frame_limit; frame++) {
+		if (window) {
+			if (window->shouldClose()) break;
+			glfwPollEvents();
+		}
+
+		auto frame_start = std::chrono::steady_clock::now();
 		drawFrame();
+		frame_timings.cpu_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+
+		if (settings.memory_report_interval > 0 && (frame + 1) % settings.memory_report_interval == 0) {
+			std::cerr << "Frame " << frame + 1 << ": ";
+			MemoryTracker::print(std::cerr, vulkan_device.getMemoryTracker().snapshot());
+		}
 	}
 
 	vkDeviceWaitIdle(vulkan_device.getDevice()); // Wait until all ongoing commands have ended before terminating
+	if (gpu_culler) gpu_culler->validatePendingFrames();
+
+	// Gather timings of the frames still in flight when the loop ended
+	for (uint32_t slot = 0; slot < command_buffers.size(); slot++) {
+		if (auto gpu_ms = gpu_timer->collect(slot)) frame_timings.gpu_ms.push_back(*gpu_ms);
+		if (auto invocations = fragment_counter->collect(slot)) frame_timings.fragment_invocations.push_back(*invocations);
+	}
+	collectCaptures();
+	jobs.wait(capture_writes);
+}
+
+void
+CoreApp::setScene(std::vector<std::unique_ptr<Model>> new_models, std::vector<SceneObject> objects, const std::vector<InstanceData>& instance_data) {
+	vkDeviceWaitIdle(vulkan_device.getDevice()); // Old buffers may still be referenced by frames in flight
+	models = std::move(new_models);
+	scene_objects = std::move(objects);
+
+	// Every instance referenced by an object must exist, missing data defaults to an untransformed, untinted instance
+	uint32_t instance_count = static_cast<uint32_t>(instance_data.size());
+	for (const SceneObject& object : scene_objects) instance_count = std::max(instance_count, object.first_instance + object.instance_count);
+	instances.resize(instance_count);
+	for (uint32_t i = 0; i < instance_count; i++) instances.set(i, i < instance_data.size() ? instance_data[i] : InstanceData{});
+
+	// Remember which object each instance belongs to, so that moving an instance only updates that object's culling sphere
+	instance_owners.assign(instance_count, NO_OWNER);
+	for (uint32_t object = 0; object < scene_objects.size(); object++) {
+		for (uint32_t i = scene_objects[object].first_instance; i < scene_objects[object].first_instance + scene_objects[object].instance_count; i++) {
+			instance_owners[i] = instance_owners[i] == NO_OWNER ? object : SHARED_OWNER;
+		}
+	}
+	moved_instances.clear();
+	all_bounds_dirty = false;
+	object_lods.assign(scene_objects.size(), 0);
+
+	if (use_indirect_draws) updateIndirectCommands();
+	if (use_cpu_culling) object_bounds.resize(static_cast<uint32_t>(scene_objects.size()));
+	if (gpu_culler || use_cpu_culling) {
+		for (uint32_t object = 0; object < scene_objects.size(); object++) updateCullingBounds(object);
+	}
+}
+
+uint32_t
+CoreApp::addModel(std::unique_ptr<Model> model, std::vector<SceneObject> objects, const std::vector<InstanceData>& instance_data) {
+	if (gpu_culler) vkDeviceWaitIdle(vulkan_device.getDevice()); // Its output buffers may be reallocated
+	uint32_t model_index = static_cast<uint32_t>(models.size());
+	models.push_back(std::move(model));
+
+	// Instances are appended, so those of frames in flight keep their place and the per-frame buffers grow as each frame is
+	// next flushed
+	uint32_t first_instance = instances.size();
+	uint32_t instance_count = static_cast<uint32_t>(instance_data.size());
+	for (const SceneObject& object : objects) instance_count = std::max(instance_count, object.first_instance + object.instance_count);
+	instances.resize(first_instance + instance_count);
+	for (uint32_t i = 0; i < instance_count; i++) instances.set(first_instance + i, i < instance_data.size() ? instance_data[i] : InstanceData{});
+	instance_owners.resize(first_instance + instance_count, NO_OWNER);
+
+	uint32_t first_object = static_cast<uint32_t>(scene_objects.size());
+	for (SceneObject& object : objects) {
+		object.model = model_index;
+		object.first_instance += first_instance;
+		uint32_t object_index = static_cast<uint32_t>(scene_objects.size());
+		for (uint32_t i = object.first_instance; i < object.first_instance + object.instance_count; i++) {
+			instance_owners[i] = instance_owners[i] == NO_OWNER ? object_index : SHARED_OWNER;
+		}
+		scene_objects.push_back(object);
+	}
+	object_lods.resize(scene_objects.size(), 0);
+
+	// Indirect commands are regrouped, which moves the culling data of existing objects too
+	if (use_indirect_draws) updateIndirectCommands();
+	if (use_cpu_culling) object_bounds.resize(static_cast<uint32_t>(scene_objects.size()));
+	if (gpu_culler) {
+		for (uint32_t object = 0; object < scene_objects.size(); object++) updateCullingBounds(object);
+	}
+	else if (use_cpu_culling) {
+		for (uint32_t object = first_object; object < scene_objects.size(); object++) updateCullingBounds(object);
+	}
+	return model_index;
+}
+
+void
+CoreApp::setInstance(uint32_t index, const InstanceData& data) {
+	instances.set(index, data);
+	if (gpu_culler || use_cpu_culling) moved_instances.push_back(index);
+}
+
+void
+CoreApp::attachInstance(uint32_t node, uint32_t instance) {
+	if (node >= node_instances.size()) node_instances.resize(node + 1, NO_OWNER);
+	node_instances[node] = instance;
+
+	// Apply the node's current transform even if it does not change again
+	updateTransforms();
+	InstanceData data = instances.get(instance);
+	data.transform = transforms.getWorld(node);
+	setInstance(instance, data);
+}
+
+uint32_t
+CoreApp::addTexture(std::unique_ptr<TextureSource> source) {
+	if (!texture_streamer) throw std::runtime_error("Textures require descriptor indexing");
+	return texture_streamer->addTexture(std::move(source));
+}
+
+std::vector<std::unique_ptr<Model>>
+CoreApp::importModels(const std::vector<MeshData>& meshes, const ModelImportSettings& import_settings) {
+	// Simplification and meshlet building dominate, uploads share the graphics queue so they stay on this thread
+	std::vector<ProcessedMesh> processed(meshes.size());
+	jobs.parallelFor(meshes.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t mesh = begin; mesh < end; mesh++) processed[mesh] = Model::process(meshes[mesh].vertices, meshes[mesh].indices, import_settings);
+	});
+
+	std::vector<std::unique_ptr<Model>> imported;
+	imported.reserve(meshes.size());
+	for (size_t mesh = 0; mesh < meshes.size(); mesh++) imported.push_back(std::make_unique<Model>(vulkan_device, meshes[mesh].vertices, std::move(processed[mesh])));
+	return imported;
+}
+
+void
+CoreApp::updateTransforms() {
+	transforms.update(updated_nodes);
+	for (uint32_t node : updated_nodes) {
+		if (node >= node_instances.size() || node_instances[node] == NO_OWNER) continue;
+		InstanceData data = instances.get(node_instances[node]);
+		data.transform = transforms.getWorld(node);
+		setInstance(node_instances[node], data);
+	}
+}
+
+void
+CoreApp::updateIndirectCommands() {
+	// Group objects by model, texture and tint (keeping their relative order) so that each batch draws from a single set of
+	// buffers with a single set of push constants
+	auto tintKey = [](const glm::vec4& tint) { return std::make_tuple(tint.r, tint.g, tint.b, tint.a); };
+	std::vector<uint32_t> order(scene_objects.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		if (scene_objects[a].model != scene_objects[b].model) return scene_objects[a].model < scene_objects[b].model;
+		if (scene_objects[a].texture != scene_objects[b].texture) return scene_objects[a].texture < scene_objects[b].texture;
+		return tintKey(scene_objects[a].tint) < tintKey(scene_objects[b].tint);
+	});
+
+	indirect_batches.clear();
+	object_commands.resize(order.size());
+	std::vector<uint32_t> object_batches(order.size());
+	uint32_t command_count = 0;
+	for (uint32_t object_index : order) {
+		const SceneObject& object = scene_objects[object_index];
+		if (indirect_batches.empty() || indirect_batches.back().model != object.model || indirect_batches.back().tint != object.tint || indirect_batches.back().texture != object.texture) {
+			indirect_batches.push_back({ object.model, command_count, 0, object.tint, object.texture });
+		}
+		object_commands[object_index] = command_count;
+		object_batches[object_index] = static_cast<uint32_t>(indirect_batches.size()) - 1;
+		indirect_batches.back().command_count += objectCommandCount(object_index);
+		command_count += objectCommandCount(object_index);
+	}
+
+	indirect_draws.resize(command_count, static_cast<uint32_t>(indirect_batches.size()));
+	for (uint32_t object_index : order) {
+		const SceneObject& object = scene_objects[object_index];
+		uint32_t command = object_commands[object_index];
+		if (usesMeshlets(object_index)) {
+			// A single instance per command, so that every meshlet of every instance is culled on its own
+			for (uint32_t instance = object.first_instance; instance < object.first_instance + object.instance_count; instance++) {
+				for (const Meshlet& meshlet : models[object.model]->getMeshlets()) {
+					indirect_draws.setCommand(command++, { meshlet.range.index_count, 1, meshlet.range.first_index, meshlet.range.vertex_offset, instance });
+				}
+			}
+			continue;
+		}
+
+		VkDrawIndexedIndirectCommand draw{};
+		DrawRange range = objectRange(object_index);
+		draw.indexCount = range.index_count;
+		draw.instanceCount = object.instance_count;
+		draw.firstIndex = range.first_index;
+		draw.vertexOffset = range.vertex_offset;
+		draw.firstInstance = object.first_instance;
+		indirect_draws.setCommand(command, draw);
+	}
+	for (uint32_t batch = 0; batch < indirect_batches.size(); batch++) indirect_draws.setBatchDrawCount(batch, indirect_batches[batch].command_count);
+
+	if (!gpu_culler) return;
+	gpu_culler->resize(command_count, static_cast<uint32_t>(indirect_batches.size()));
+	for (uint32_t object_index : order) {
+		CullObject cull_object{};
+		cull_object.sphere = scene_objects[object_index].bounds;
+		cull_object.batch = object_batches[object_index];
+		cull_object.batch_first_command = indirect_batches[object_batches[object_index]].first_command;
+		for (uint32_t i = 0; i < objectCommandCount(object_index); i++) gpu_culler->setObject(object_commands[object_index] + i, cull_object);
+	}
+}
+
+void
+CoreApp::updateCullingBounds(uint32_t object) {
+	const SceneObject& scene_object = scene_objects[object];
+	if (usesMeshlets(object)) {
+		// Place the bounds and normal cone of every meshlet with the transform of the instance its command draws
+		uint32_t command = object_commands[object];
+		for (uint32_t i = scene_object.first_instance; i < scene_object.first_instance + scene_object.instance_count; i++) {
+			const glm::mat4& transform = instances.get(i).transform;
+			for (const Meshlet& meshlet : models[scene_object.model]->getMeshlets()) {
+				CullObject cull_object = gpu_culler->getObject(command);
+				cull_object.sphere = CullingUtils::transformSphere(transform, meshlet.sphere);
+				cull_object.cone = CullingUtils::transformCone(transform, meshlet.cone);
+				gpu_culler->setObject(command++, cull_object);
+			}
+		}
+		return;
+	}
+
+	glm::vec4 sphere = scene_object.bounds;
+	if (scene_object.instance_count > 0) {
+		// Union of the bounds placed by every instance the command draws
+		sphere = CullingUtils::transformSphere(instances.get(scene_object.first_instance).transform, scene_object.bounds);
+		for (uint32_t i = scene_object.first_instance + 1; i < scene_object.first_instance + scene_object.instance_count; i++) {
+			sphere = CullingUtils::mergeSpheres(sphere, CullingUtils::transformSphere(instances.get(i).transform, scene_object.bounds));
+		}
+	}
+
+	if (!gpu_culler) {
+		object_bounds.set(object, sphere);
+		return;
+	}
+	CullObject cull_object = gpu_culler->getObject(object_commands[object]);
+	cull_object.sphere = sphere;
+	gpu_culler->setObject(object_commands[object], cull_object);
+}
+
+void
+CoreApp::updateMovedBounds() {
+	for (uint32_t instance : moved_instances) {
+		if (instance >= instance_owners.size() || instance_owners[instance] == NO_OWNER) continue;
+		if (instance_owners[instance] == SHARED_OWNER) { all_bounds_dirty = true; break; }
+		updateCullingBounds(instance_owners[instance]);
+	}
+	moved_instances.clear();
+
+	if (all_bounds_dirty) {
+		// Without the GPU culler every object only writes its own sphere, so objects can be split across jobs
+		if (gpu_culler) {
+			for (uint32_t object = 0; object < scene_objects.size(); object++) updateCullingBounds(object);
+		}
+		else {
+			jobs.parallelFor(scene_objects.size(), JobSystem::DEFAULT_GRAIN, [this](size_t begin, size_t end) {
+				for (size_t object = begin; object < end; object++) updateCullingBounds(static_cast<uint32_t>(object));
+			});
+		}
+		all_bounds_dirty = false;
+	}
+}
+
+float
+CoreApp::pixelsPerUnit(const SceneObject& object) {
+	// Pixels covered per world unit at w = 1, taken from the length of the projection's x and y rows
+	float screen_scale = 0.5f * std::max(
+		glm::length(glm::vec3(view_projection[0][0], view_projection[1][0], view_projection[2][0])) * render_extent.width,
+		glm::length(glm::vec3(view_projection[0][1], view_projection[1][1], view_projection[2][1])) * render_extent.height);
+
+	if (object.bounds.w >= CullingUtils::UNBOUNDED_RADIUS || object.bounds.w <= 0.0f) return std::numeric_limits<float>::infinity();
+	glm::vec4 sphere = object.bounds;
+	if (object.instance_count > 0) sphere = CullingUtils::transformSphere(instances.get(object.first_instance).transform, object.bounds);
+	float w = (view_projection * glm::vec4(glm::vec3(sphere), 1.0f)).w;
+	if (w <= sphere.w) return std::numeric_limits<float>::infinity(); // Reaching the camera, so possibly filling the screen
+	return screen_scale / w * (sphere.w / object.bounds.w); // The instance's scale turns model units into world units
+}
+
+void
+CoreApp::requestTextureLevels() {
+	for (const SceneObject& object : scene_objects) {
+		if (object.texture == TextureStreamer::NO_TEXTURE) continue;
+		float screen_pixels = 2.0f * object.bounds.w * pixelsPerUnit(object); // Diameter on screen
+		texture_streamer->requestLevel(object.texture, std::isinf(screen_pixels) ? 0 : texture_streamer->levelForScreenSize(object.texture, screen_pixels));
+	}
+}
+
+void
+CoreApp::selectLods() {
+	for (uint32_t object = 0; object < scene_objects.size(); object++) {
+		const SceneObject& scene_object = scene_objects[object];
+		if (!scene_object.use_lods || models[scene_object.model]->getLods().size() < 2 || usesMeshlets(object)) continue;
+		uint32_t lod = LodUtils::selectLod(models[scene_object.model]->getLods(), object_lods[object], pixelsPerUnit(scene_object), settings.lod_error_pixels);
+		if (lod == object_lods[object]) continue;
+		object_lods[object] = lod;
+
+		if (!use_indirect_draws) continue;
+		DrawRange range = objectRange(object);
+		VkDrawIndexedIndirectCommand draw = indirect_draws.getCommand(object_commands[object]);
+		draw.indexCount = range.index_count;
+		draw.firstIndex = range.first_index;
+		draw.vertexOffset = range.vertex_offset;
+		indirect_draws.setCommand(object_commands[object], draw);
+	}
+}
+
+DrawRange
+CoreApp::objectRange(uint32_t object) {
+	const SceneObject& scene_object = scene_objects[object];
+	if (!scene_object.use_lods) return scene_object.range;
+	const std::vector<LodLevel>& lods = models[scene_object.model]->getLods();
+	return lods.empty() ? scene_object.range : lods[std::min(object_lods[object], static_cast<uint32_t>(lods.size()) - 1)].range;
+}
+
+bool
+CoreApp::usesMeshlets(uint32_t object) {
+	const SceneObject& scene_object = scene_objects[object];
+	return gpu_culler && scene_object.use_meshlets && !models[scene_object.model]->getMeshlets().empty();
+}
+
+uint32_t
+CoreApp::objectCommandCount(uint32_t object) {
+	return usesMeshlets(object) ? scene_objects[object].instance_count * static_cast<uint32_t>(models[scene_objects[object].model]->getMeshlets().size()) : 1;
 }
 
 void
@@ -41,10 +410,25 @@ CoreApp::drawFrame() {
 		throw std::runtime_error("Failed to acquire swapchain image");
 	}
 
+	// The image's previous submission is known to have finished once it has been acquired, so its timing can be read
+	if (auto gpu_ms = gpu_timer->collect(image_index)) {
+		frame_timings.gpu_ms.push_back(*gpu_ms);
+		if (resolution_controller) resolution_controller->update(*gpu_ms);
+	}
+	if (auto invocations = fragment_counter->collect(image_index)) frame_timings.fragment_invocations.push_back(*invocations);
+	if (frame_readback) {
+		if (auto captured = frame_readback->collect(image_index)) deliverCapture(std::move(*captured));
+	}
+
+	if (bindless) bindless->beginFrame(); // The acquired frame's previous submission has completed, so have all older ones
+	mesh_streamer->update(); // Uploads are submitted ahead of the frame, which may draw any model already published
+	addStreamedMesh();
+	updateTransforms();
 	recordCommandBuffer(image_index);
 	result = device_swap_chain->submitCommandBuffers(&command_buffers[image_index], &image_index);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized()) { // Swapchain no longer compatible or swapchain suboptimal (we recreate here because we've already presented the image, as opposed to the previous check where we are yet to presesnt) or window resize flag was raised
-		window.resetWindowResizedFlag();
+	bool window_resized = window && window->wasWindowResized();
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window_resized) { // Swapchain no longer compatible or swapchain suboptimal (we recreate here because we've already presented the image, as opposed to the previous check where we are yet to presesnt) or window resize flag was raised
+		if (window) window->resetWindowResizedFlag();
 		recreateSwapChain();
 		return;
 	} else if (result != VK_SUCCESS) {
@@ -52,27 +436,134 @@ CoreApp::drawFrame() {
 	}
 }
 
+ImportedMesh
+CoreApp::importMesh(const std::string& path) {
+	using clock = std::chrono::steady_clock;
+	auto milliseconds = [](clock::time_point start, clock::time_point end) { return std::chrono::duration<double, std::milli>(end - start).count(); };
+
+	clock::time_point start = clock::now();
+	MappedFile source(path);
+	std::optional<MeshCache> cache;
+	uint64_t key = 0;
+	ImportedMesh imported;
+	if (!settings.mesh_cache_directory.empty()) {
+		cache.emplace(settings.mesh_cache_directory, settings.mesh_cache_size);
+		key = MeshCache::computeKey(source.data(), source.size(), ObjUtils::IMPORTER_VERSION, settings.mesh_import_settings);
+		if (cache->load(key, imported)) {
+			std::cout << "Mesh " << path << " imported warm (from cache) in " << milliseconds(start, clock::now()) << " ms" << std::endl;
+			return imported;
+		}
+	}
+
+	MeshData data = ObjUtils::parse(source.data(), source.size());
+	if (data.indices.empty()) throw std::runtime_error("Mesh " + path + " has no faces");
+	clock::time_point parsed = clock::now();
+	imported.mesh = Model::process(data.vertices, data.indices, settings.mesh_import_settings);
+	imported.vertices = std::move(data.vertices);
+	clock::time_point processed = clock::now();
+	if (cache) cache->store(key, imported);
+	clock::time_point stored = clock::now();
+
+	std::cout << "Mesh " << path << " imported cold in " << milliseconds(start, stored) << " ms (parse " << milliseconds(start, parsed)
+		<< " ms, process " << milliseconds(parsed, processed) << " ms";
+	if (cache) std::cout << ", cache write " << milliseconds(processed, stored) << " ms";
+	std::cout << ")" << std::endl;
+	return imported;
+}
+
 void
 CoreApp::loadModels() {
 	// Pre-set vertices for testing
 	std::vector<Vertex> vertices = {
-		{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-		{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-		{{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
-		{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}
+		{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
+		{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+		{{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+		{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}
 	};
 	std::vector<uint32_t> indices = {0, 1, 2, 2, 3, 0};
-	scene = std::make_unique<Model>(vulkan_device, vertices, indices);
+	if (!settings.mesh_path.empty()) {
+		// Rendering starts with an empty scene, the mesh is added by addStreamedMesh once its upload has completed
+		setScene({}, {});
+		streamed_mesh = mesh_streamer->loadProcessed([this]() {
+			ImportedMesh imported = importMesh(settings.mesh_path);
+			streamed_mesh_bounds = CullingUtils::computeBoundingSphere(imported.vertices, imported.mesh.indices, imported.mesh.lods[0].range);
+			return imported;
+		});
+		return;
+	}
+
+	std::vector<std::unique_ptr<Model>> quad_models = importModels({ { vertices, indices } }, {});
+	SceneObject quad{ 0, quad_models[0]->fullRange() }; // A single untransformed instance
+	quad.bounds = CullingUtils::computeBoundingSphere(vertices, indices, quad.range);
+	if (!settings.texture_path.empty()) quad.texture = addTexture(std::make_unique<Ktx2TextureSource>(settings.texture_path));
+	else if (settings.texture_demo && texture_streamer) quad.texture = texture_streamer->addTexture(RgbaTextureSource::checkerboard(2048, 128));
+	setScene(std::move(quad_models), { quad });
+}
+
+void
+CoreApp::addStreamedMesh() {
+	if (streamed_mesh == MeshStreamer::NO_MESH) return;
+	MeshState state = mesh_streamer->getState(streamed_mesh);
+	if (state == MeshState::Failed) throw std::runtime_error("Failed to load mesh " + settings.mesh_path + ": " + mesh_streamer->getError(streamed_mesh));
+	if (state != MeshState::Ready) return;
+
+	std::unique_ptr<Model> model = mesh_streamer->take(streamed_mesh);
+	streamed_mesh = MeshStreamer::NO_MESH;
+	SceneObject mesh{ 0, model->fullRange() };
+	mesh.bounds = streamed_mesh_bounds;
+	mesh.use_lods = true;
+	mesh.use_meshlets = true;
+	addModel(std::move(model), { mesh });
+	std::cout << "Mesh " << settings.mesh_path << " added to the scene after " << frames_drawn << " frames" << std::endl;
+}
+
+void
+CoreApp::createFrameDescriptorSet() {
+	VkDescriptorSetLayoutBinding frame_binding{};
+	frame_binding.binding = 0;
+	frame_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; // Offset supplied at bind time, so the set never needs rewriting
+	frame_binding.descriptorCount = 1;
+	frame_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = 1;
+	layout_info.pBindings = &frame_binding;
+	if (vkCreateDescriptorSetLayout(vulkan_device.getDevice(), &layout_info, nullptr, &frame_set_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create frame descriptor set layout");
+	}
+
+	frame_descriptor_set = descriptor_allocator.allocate(frame_set_layout);
+
+	VkDescriptorBufferInfo buffer_info{ frame_data.getBuffer(), 0, sizeof(FrameUniforms) };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = frame_descriptor_set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write.pBufferInfo = &buffer_info;
+	vkUpdateDescriptorSets(vulkan_device.getDevice(), 1, &write, 0, nullptr);
 }
 
 void
 CoreApp::createPipelineLayout() {
+	// Per-draw parameters small enough to be recorded into the command buffer directly
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(DrawPushConstants);
+
+	// Set 0 holds per-frame data, set 1 (when available) every bindless resource
+	std::vector<VkDescriptorSetLayout> set_layouts = { frame_set_layout };
+	if (bindless) set_layouts.push_back(bindless->getLayout());
+
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 0;
-	pipelineLayoutInfo.pSetLayouts = nullptr;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+	pipelineLayoutInfo.pSetLayouts = set_layouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &push_constant_range;
 
 	if (vkCreatePipelineLayout(vulkan_device.getDevice(), &pipelineLayoutInfo, nullptr, &pipeline_layout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline layout");
@@ -82,16 +573,84 @@ CoreApp::createPipelineLayout() {
 void
 CoreApp::createPipeline() {
 	PipelineConfigInfo pipeline_config{};
+	PipelineConfigInfo depth_pipeline_config{}; // Configs point into themselves, so each is filled in place rather than copied
 	GraphicsPipeline::defaultPipelineConfigInfo(pipeline_config, device_swap_chain->getWidth(), device_swap_chain->getHeight());
-	pipeline_config.render_pass = device_swap_chain->getRenderPass();
-	pipeline_config.pipeline_layout = pipeline_layout;
+	GraphicsPipeline::defaultPipelineConfigInfo(depth_pipeline_config, device_swap_chain->getWidth(), device_swap_chain->getHeight());
+	pipeline_config.render_pass = depth_pipeline_config.render_pass = render_graph->getRenderPass(scene_pass);
+	pipeline_config.pipeline_layout = depth_pipeline_config.pipeline_layout = pipeline_layout;
+	pipeline_config.multisample_info.rasterizationSamples = depth_pipeline_config.multisample_info.rasterizationSamples = sample_count;
+	pipeline_config.dynamic_states = depth_pipeline_config.dynamic_states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR }; // Resolution may change every frame
+
+	depth_pipeline = nullptr;
+	if (settings.depth_prepass) {
+		GraphicsPipeline::depthPrepassConfigInfo(depth_pipeline_config, pipeline_config);
+		depth_pipeline = std::make_unique<GraphicsPipeline>(vulkan_device, "shaders/vert.spv", "", depth_pipeline_config);
+	}
 	pipeline = std::make_unique<GraphicsPipeline>(
 		vulkan_device,
 		"shaders/vert.spv",
-		"shaders/frag.spv",
+		bindless ? "shaders/textured.spv" : "shaders/frag.spv", // Texturing samples from the bindless set
 		pipeline_config);
 }
 
+void
+CoreApp::createRenderGraph() {
+	render_graph = std::make_unique<RenderGraph>(vulkan_device);
+	VkExtent2D extent = device_swap_chain->getSwapChainExtent();
+	backbuffer_image = render_graph->importImage(
+		"backbuffer",
+		{ device_swap_chain->getSwapChainImageFormat(), extent },
+		VK_IMAGE_LAYOUT_UNDEFINED, // We don't care about previous image data
+		vulkan_device.isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR); // Presented, or copied out when there is nothing to present to
+	uint32_t depth_image = render_graph->createImage("depth", { device_swap_chain->getDepthFormat(), extent, sample_count }); // Never leaves the frame, so the graph owns it
+	render_extent = extent;
+
+	// Dynamic resolution draws into part of an intermediate image, which is then blitted over the backbuffer with filtering
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(vulkan_device.getPhysicalDevice(), device_swap_chain->getSwapChainImageFormat(), &format_properties);
+	VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	bool can_upscale = (format_properties.optimalTilingFeatures & blit_features) == blit_features && (device_swap_chain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	if (resolution_controller && !can_upscale) std::cerr << "Swapchain images cannot be blitted to, rendering at full resolution" << std::endl;
+	upscale_source_image = RenderGraph::NO_IMAGE;
+	if (resolution_controller && can_upscale) upscale_source_image = render_graph->createImage("scene colour", { device_swap_chain->getSwapChainImageFormat(), extent });
+	uint32_t scene_target = upscale_source_image != RenderGraph::NO_IMAGE ? upscale_source_image : backbuffer_image;
+
+	VkClearValue clear_colour{};
+	clear_colour.color = { 0.0f, 0.0f, 0.0f, 1.0f }; // When clearing previous pixels, set their values to completely black with no transparency
+	VkClearValue clear_depth{};
+	clear_depth.depthStencil = { 1.0f, 0 }; // Everything is nearer than the far plane
+	scene_pass = render_graph->addPass("scene", [this](VkCommandBuffer command_buffer) { recordScene(command_buffer); });
+	render_graph->clearImage(scene_pass, depth_image, ImageUsage::DepthAttachment, clear_depth);
+	if (sample_count == VK_SAMPLE_COUNT_1_BIT) {
+		render_graph->clearImage(scene_pass, scene_target, ImageUsage::ColorAttachment, clear_colour);
+	} else {
+		// Samples are resolved within the pass, so only the resolved image is ever written to memory
+		uint32_t colour_image = render_graph->createImage("multisampled colour", { device_swap_chain->getSwapChainImageFormat(), extent, sample_count });
+		render_graph->clearImage(scene_pass, colour_image, ImageUsage::ColorAttachment, clear_colour);
+		render_graph->resolveImage(scene_pass, colour_image, scene_target);
+	}
+
+	if (upscale_source_image != RenderGraph::NO_IMAGE) {
+		uint32_t upscale_pass = render_graph->addPass("upscale", [this](VkCommandBuffer command_buffer) { recordUpscale(command_buffer); });
+		render_graph->readImage(upscale_pass, upscale_source_image, ImageUsage::TransferSrc);
+		render_graph->writeImage(upscale_pass, backbuffer_image, ImageUsage::TransferDst);
+	}
+
+	// Captures copy the backbuffer out once everything else has been drawn into it
+	VkFormat format = device_swap_chain->getSwapChainImageFormat();
+	bool can_capture = (device_swap_chain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && FrameReadback::isFormatSupported(format);
+	if (settings.capture_interval > 0 && !can_capture) std::cerr << "Swapchain images cannot be copied out, frames are not captured" << std::endl;
+	frame_readback = nullptr;
+	if (settings.capture_interval > 0 && can_capture) {
+		frame_readback = std::make_unique<FrameReadback>(vulkan_device, static_cast<uint32_t>(device_swap_chain->imageCount()), extent, format);
+		uint32_t readback_pass = render_graph->addPass("readback", [this](VkCommandBuffer command_buffer) {
+			if (capture_recording) frame_readback->record(command_buffer, recording_image, render_graph->getImage(backbuffer_image), recording_frame);
+		});
+		render_graph->readImage(readback_pass, backbuffer_image, ImageUsage::TransferSrc);
+	}
+	render_graph->compile();
+}
+
 void
 CoreApp::createCommandBuffers() {
 	command_buffers.resize(device_swap_chain->imageCount()); // One command buffer per framebuffer (and we use one framebuffer per image)
@@ -104,6 +663,9 @@ CoreApp::createCommandBuffers() {
 	if (vkAllocateCommandBuffers(vulkan_device.getDevice(), &alloc_info, command_buffers.data()) != VK_SUCCESS) {
 		throw std::runtime_error("Failed allocate command buffers");
 	}
+
+	gpu_timer = std::make_unique<GpuTimer>(vulkan_device, static_cast<uint32_t>(command_buffers.size()));
+	fragment_counter = std::make_unique<FragmentCounter>(vulkan_device, static_cast<uint32_t>(command_buffers.size()));
 }
 
 void
@@ -114,6 +676,8 @@ CoreApp::freeCommandBuffers() {
 		static_cast<uint32_t>(command_buffers.size()),
 		command_buffers.data());
 	command_buffers.clear();
+	gpu_timer = nullptr; // Pending timings of freed command buffers are discarded
+	fragment_counter = nullptr;
 }
 
 void
@@ -123,41 +687,175 @@ CoreApp::recordCommandBuffer(int image_index) {
 	if (vkBeginCommandBuffer(command_buffers[image_index], &begin_info) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to begin recording command buffer");
 	}
+	gpu_timer->begin(command_buffers[image_index], image_index);
 
-	VkRenderPassBeginInfo render_pass_begin_info{};
-	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	render_pass_begin_info.renderPass = device_swap_chain->getRenderPass();
-	render_pass_begin_info.framebuffer = device_swap_chain->getFramebuffer(image_index);
-	render_pass_begin_info.renderArea.offset = { 0, 0 };
-	render_pass_begin_info.renderArea.extent = device_swap_chain->getSwapChainExtent();
-	VkClearValue clear_color = { 0.0f, 0.0f, 0.0f, 1.0f }; // When clearing previous pixels, set their values to completely black with no transparency
-	render_pass_begin_info.clearValueCount = 1;
-	render_pass_begin_info.pClearValues = &clear_color;
-	vkCmdBeginRenderPass(command_buffers[image_index], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE); // Finalise render pass begin command
+	// Draw only the part of the render targets matching the current resolution scale
+	VkExtent2D extent = device_swap_chain->getSwapChainExtent();
+	float scale = upscale_source_image != RenderGraph::NO_IMAGE ? resolution_controller->getScale() : 1.0f;
+	render_extent = { std::max(1u, static_cast<uint32_t>(extent.width * scale + 0.5f)), std::max(1u, static_cast<uint32_t>(extent.height * scale + 0.5f)) };
+	render_graph->setRenderArea(scene_pass, render_extent);
+	frame_timings.render_scale.push_back(scale);
 
-	// Connect pipeline and scene/vertices to the buffer
-	pipeline->bind(command_buffers[image_index]);
-	scene->bind(command_buffers[image_index]);
+	// Culling writes the commands drawn inside the render pass, so it must be recorded before the pass begins
+	uint32_t frame = static_cast<uint32_t>(device_swap_chain->getCurrentFrame());
+	selectLods();
+	if (use_indirect_draws) indirect_draws.flush(frame);
+	if (gpu_culler || use_cpu_culling) updateMovedBounds();
+	if (gpu_culler) gpu_culler->record(command_buffers[image_index], frame, indirect_draws, Frustum::fromMatrix(view_projection));
+	if (use_cpu_culling) CullingUtils::cullSpheres(Frustum::fromMatrix(view_projection), object_bounds, visible_objects, jobs);
 
-	// Add command to draw the scene's vertices
-	scene->draw(command_buffers[image_index]);
+	// Texture uploads and residency changes are transfers, also recorded before the pass
+	if (texture_streamer) {
+		requestTextureLevels();
+		texture_streamer->update(command_buffers[image_index]);
+	}
 
-	vkCmdEndRenderPass(command_buffers[image_index]);
+	render_graph->setImportedImage(backbuffer_image, device_swap_chain->getImage(image_index), device_swap_chain->getImageView(image_index));
+	recording_image = static_cast<uint32_t>(image_index);
+	recording_frame = frames_drawn; // Counted up as the scene is recorded
+	capture_recording = frame_readback && (frames_drawn + 1) % settings.capture_interval == 0;
+	fragment_counter->begin(command_buffers[image_index], image_index);
+	render_graph->execute(command_buffers[image_index]);
+	fragment_counter->end(command_buffers[image_index], image_index);
+	gpu_timer->end(command_buffers[image_index], image_index);
 
 	if (vkEndCommandBuffer(command_buffers[image_index]) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to record command buffer");
 	}
 }
 
+void
+CoreApp::recordScene(VkCommandBuffer command_buffer) {
+	uint32_t frame = static_cast<uint32_t>(device_swap_chain->getCurrentFrame());
+
+	// Viewport and scissor are dynamic, covering the part of the render targets drawn into this frame
+	VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(render_extent.width), static_cast<float>(render_extent.height), 0.0f, 1.0f };
+	VkRect2D scissor{ { 0, 0 }, render_extent };
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+	// Per-frame data is written once and bound once, draws only differ in their push constants
+	frame_data.beginFrame(frame);
+	FrameUniforms frame_uniforms{};
+	frame_uniforms.view_projection = view_projection;
+	frame_uniforms.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time).count();
+	frame_uniforms.frame_index = frames_drawn++;
+	uint32_t frame_uniforms_offset = frame_data.getFrameOffset(frame) + static_cast<uint32_t>(frame_data.write(frame_uniforms));
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &frame_descriptor_set, 1, &frame_uniforms_offset);
+	if (bindless) bindless->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1);
+
+	// Every state change goes through these, which skip (and count) those matching what is already bound. Both pipelines
+	// share the layout, so push constants and vertex buffers stay bound across pipeline changes
+	BindCounts binds;
+	GraphicsPipeline* bound_pipeline = nullptr;
+	uint32_t bound_model = UINT32_MAX;
+	std::optional<DrawPushConstants> pushed_constants;
+	auto bindPipeline = [&](GraphicsPipeline* next_pipeline) {
+		if (next_pipeline == bound_pipeline) { binds.skipped++; return; }
+		next_pipeline->bind(command_buffer);
+		bound_pipeline = next_pipeline;
+		binds.issued++;
+	};
+	auto bindModel = [&](uint32_t model) {
+		if (model == bound_model) { binds.skipped++; return; }
+		models[model]->bind(command_buffer);
+		bound_model = model;
+		binds.issued++;
+	};
+	auto pushDrawConstants = [&](const glm::vec4& tint, uint32_t texture) {
+		DrawPushConstants constants{ tint };
+		if (texture != TextureStreamer::NO_TEXTURE) constants.texture = texture_streamer->getDescriptorIndex(texture); // Slots change with residency
+		if (pushed_constants && pushed_constants->tint == constants.tint && pushed_constants->texture == constants.texture) { binds.skipped++; return; }
+		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawPushConstants), &constants);
+		pushed_constants = constants;
+		binds.issued++;
+	};
+
+	// Upload instance changes to this frame's copy of the instance buffer and bind it to the per-instance binding
+	instances.flush(frame);
+	VkBuffer instance_buffers[] = { instances.getBuffer(frame) };
+	VkDeviceSize instance_offsets[] = { 0 };
+	vkCmdBindVertexBuffers(command_buffer, 1, 1, instance_buffers, instance_offsets);
+
+	// The depth pre-pass draws everything before the colour pass does
+	GraphicsPipeline* pass_pipelines[] = { depth_pipeline.get(), pipeline.get() };
+	if (use_indirect_draws) {
+		// Submission cost depends on the number of models, not on the number of objects
+		for (GraphicsPipeline* pass_pipeline : pass_pipelines) {
+			if (!pass_pipeline) continue;
+			bindPipeline(pass_pipeline);
+			for (uint32_t batch = 0; batch < indirect_batches.size(); batch++) {
+				const IndirectBatch& indirect_batch = indirect_batches[batch];
+				bindModel(indirect_batch.model);
+				pushDrawConstants(indirect_batch.tint, indirect_batch.texture);
+				if (gpu_culler) gpu_culler->draw(command_buffer, frame, batch, indirect_batch.first_command, indirect_batch.command_count);
+				else indirect_draws.draw(command_buffer, frame, batch, indirect_batch.first_command, indirect_batch.command_count);
+			}
+		}
+	} else {
+		// Queue a draw per pass of every (visible) object, keyed so that sorting groups draws sharing state. Unless sorting by
+		// state, only the pass is keyed, and the stable sort keeps the scene's order within it
+		render_queue.clear();
+		auto queueObject = [&](uint32_t object_index) {
+			const SceneObject& object = scene_objects[object_index];
+			if (object.instance_count == 0) return;
+			glm::vec4 centre = view_projection * (instances.get(object.first_instance).transform * glm::vec4(glm::vec3(object.bounds), 1.0f));
+			float depth = centre.w > 0.0f ? centre.z / centre.w : 0.0f;
+			uint32_t material = object.texture + 1; // Textures are bound through push constants, so they are what materials differ in
+			for (uint32_t pass = 0; pass < std::size(pass_pipelines); pass++) {
+				if (!pass_pipelines[pass]) continue;
+				render_queue.push(settings.sort_draws ? RenderQueue::makeKey(pass, material, object.model, depth) : RenderQueue::makeKey(pass, 0, 0, 0.0f), object_index);
+			}
+		};
+		if (use_cpu_culling) {
+			for (uint32_t object : visible_objects) queueObject(object);
+		} else {
+			for (uint32_t object = 0; object < scene_objects.size(); object++) queueObject(object);
+		}
+		render_queue.sort();
+
+		for (const RenderQueue::Entry& entry : render_queue.getEntries()) {
+			const SceneObject& object = scene_objects[entry.item];
+			bindPipeline(pass_pipelines[RenderQueue::getPipeline(entry.key)]);
+			bindModel(object.model);
+			pushDrawConstants(object.tint, object.texture);
+			models[object.model]->drawRange(command_buffer, objectRange(entry.item), object.instance_count, object.first_instance);
+		}
+	}
+	frame_timings.binds_issued.push_back(binds.issued);
+	frame_timings.binds_skipped.push_back(binds.skipped);
+}
+
+void
+CoreApp::recordUpscale(VkCommandBuffer command_buffer) {
+	VkExtent2D extent = device_swap_chain->getSwapChainExtent();
+	VkImageBlit blit{};
+	blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.srcOffsets[1] = { static_cast<int32_t>(render_extent.width), static_cast<int32_t>(render_extent.height), 1 };
+	blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.dstOffsets[1] = { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 };
+	vkCmdBlitImage(
+		command_buffer,
+		render_graph->getImage(upscale_source_image), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // Layouts the graph transitions to for these usages
+		render_graph->getImage(backbuffer_image), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &blit,
+		VK_FILTER_LINEAR);
+}
+
 void
 CoreApp::recreateSwapChain() {
-	// Wait until window is in a drawable state
-	VkExtent2D extent = window.getExtent();
-	while (extent.width == 0 || extent.height == 0) {
-		extent = window.getExtent();
-		glfwWaitEvents();
+	// Wait until window is in a drawable state (offscreen images are always drawable)
+	VkExtent2D extent = { settings.width, settings.height };
+	if (window) {
+		extent = window->getExtent();
+		while (extent.width == 0 || extent.height == 0) {
+			extent = window->getExtent();
+			glfwWaitEvents();
+		}
 	}
 	vkDeviceWaitIdle(vulkan_device.getDevice());
+	collectCaptures(); // Pending copies are lost with the readback buffers, which are sized to the old swapchain
+	render_graph = nullptr; // Its framebuffers reference the old swapchain's image views
 
 	if (device_swap_chain == nullptr) { device_swap_chain = std::make_unique<SwapChain>(vulkan_device, extent); }
 	else {
@@ -168,9 +866,40 @@ CoreApp::recreateSwapChain() {
 		}
 	}
 
+	createRenderGraph();
 	createPipeline();
 }
 
+void
+CoreApp::deliverCapture(CapturedFrame captured) {
+	if (capture_callback) {
+		capture_callback(std::move(captured));
+		return;
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "frame_%06llu", static_cast<unsigned long long>(captured.frame));
+	std::string path = (std::filesystem::path(settings.capture_directory) / name).string();
+	auto write = [path, raw = settings.capture_raw, image = std::move(captured.image)]() {
+		ImageUtils::writePng(path + ".png", image);
+		if (raw) ImageUtils::writeRaw(path + ".rgba", image);
+	};
+	// Writing is left to the workers, so the main thread only pays for the copy out of the readback buffer
+	if (jobs.getThreadCount() > 1) jobs.runInBackground(std::move(write), capture_writes);
+	else write();
+}
+
+void
+CoreApp::collectCaptures() {
+	if (!frame_readback) return;
+	std::vector<CapturedFrame> captures;
+	for (uint32_t slot = 0; slot < device_swap_chain->imageCount(); slot++) {
+		if (auto captured = frame_readback->collect(slot)) captures.push_back(std::move(*captured));
+	}
+	std::sort(captures.begin(), captures.end(), [](const CapturedFrame& a, const CapturedFrame& b) { return a.frame < b.frame; });
+	for (CapturedFrame& captured : captures) deliverCapture(std::move(captured));
+}
+
 void
 CoreApp::printSupportedExtensions() {
 	uint32_t extension_count = 0;
@@ -1,19 +1,151 @@
 #pragma once
 
+#include "buffer.hpp"
+#include "descriptors.hpp"
 #include "device.hpp"
+#include "gpu_culling.hpp"
+#include "indirect.hpp"
+#include "job_system.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_streamer.hpp"
 #include "model.hpp"
 #include "pipeline.hpp"
+#include "profiling.hpp"
+#include "readback.hpp"
+#include "render_graph.hpp"
+#include "render_queue.hpp"
+#include "resolution.hpp"
+#include "scene.hpp"
 #include "swapchain.hpp"
+#include "texture.hpp"
+#include "transform.hpp"
 #include "window.hpp"
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <string>
+
+/// <summary>
+/// Startup options selecting how and where the application renders
+/// </summary>
+struct AppSettings {
+	/// <summary>
+	/// Render to a ring of offscreen images instead of a window (no GLFW, surface or swapchain)
+	/// </summary>
+	bool headless = false;
+	/// <summary>
+	/// Number of frames to draw before run() returns (0 means until the window is closed)
+	/// </summary>
+	uint32_t frame_limit = 0;
+	/// <summary>
+	/// Submit the scene from a buffer of indirect draw commands instead of one draw call per object (ignored if unsupported)
+	/// </summary>
+	bool indirect_draws = false;
+	/// <summary>
+	/// Frustum cull the indirect draw commands in a compute pass before drawing (implies indirect_draws)
+	/// </summary>
+	bool gpu_culling = false;
+	/// <summary>
+	/// Check every frame's GPU culling output against the CPU reference, throwing on mismatch (slow, for testing)
+	/// </summary>
+	bool validate_culling = false;
+	/// <summary>
+	/// Frustum cull scene objects on the CPU and only record draws for visible ones (direct draws only)
+	/// </summary>
+	bool cpu_culling = false;
+	/// <summary>
+	/// Bytes of device memory streamed textures may occupy together
+	/// </summary>
+	VkDeviceSize texture_budget = 256ull * 1024 * 1024;
+	/// <summary>
+	/// Put a streamed checkerboard texture on the default quad
+	/// </summary>
+	bool texture_demo = false;
+	/// <summary>
+	/// KTX2 texture to put on the default quad instead of the checkerboard (empty for none)
+	/// </summary>
+	std::string texture_path;
+	/// <summary>
+	/// Wavefront OBJ mesh to draw instead of the default quad (empty for none), streamed in while the first frames render
+	/// </summary>
+	std::string mesh_path;
+	/// <summary>
+	/// Processing applied to the mesh at mesh_path
+	/// </summary>
+	ModelImportSettings mesh_import_settings{ 4, true };
+	/// <summary>
+	/// Directory keeping processed meshes between runs, so unchanged meshes skip importing (empty disables the cache)
+	/// </summary>
+	std::string mesh_cache_directory;
+	/// <summary>
+	/// Bytes the mesh cache may occupy on disk before its least recently used entries are deleted
+	/// </summary>
+	uint64_t mesh_cache_size = 512ull * 1024 * 1024;
+	/// <summary>
+	/// Largest deviation from the full resolution mesh, in pixels, that level of detail selection lets objects show
+	/// </summary>
+	float lod_error_pixels = 1.0f;
+	/// <summary>
+	/// Draw the scene into the depth buffer first, then shade only the nearest fragment of each pixel with an equal depth test
+	/// </summary>
+	bool depth_prepass = false;
+	/// <summary>
+	/// Sort direct draws by pipeline, material, mesh and then front to back, instead of recording them in scene order (each
+	/// pass after the previous one). Sorting reorders coplanar draws of differing state and hides overdraw, so it is left to
+	/// scenes that rely on neither
+	/// </summary>
+	bool sort_draws = false;
+	/// <summary>
+	/// Samples per pixel of the scene's colour and depth attachments, resolved into the swapchain image as the render pass
+	/// ends (rounded down to a power of two the device supports, 1 disables multisampling)
+	/// </summary>
+	uint32_t msaa_samples = 1;
+	/// <summary>
+	/// GPU time each frame should take, in milliseconds. When set, the scene is rendered at a resolution adjusted to meet
+	/// it and upscaled into the swapchain image (0 renders at the swapchain's resolution)
+	/// </summary>
+	double frame_budget_ms = 0.0;
+	/// <summary>
+	/// Lowest fraction of the swapchain's resolution, per axis, dynamic resolution may render at
+	/// </summary>
+	float min_render_scale = 0.5f;
+	/// <summary>
+	/// Print a breakdown of device memory usage every this many frames (0 disables the report)
+	/// </summary>
+	uint32_t memory_report_interval = 0;
+	/// <summary>
+	/// Copy the rendered image back to the CPU every this many frames (0 disables captures). Copies are read frames later,
+	/// so capturing does not stall rendering
+	/// </summary>
+	uint32_t capture_interval = 0;
+	/// <summary>
+	/// Directory captured frames are written to as frame_NNNNNN.png, unless a capture callback replaces writing them
+	/// </summary>
+	std::string capture_directory = ".";
+	/// <summary>
+	/// Also write captured frames as headerless RGBA files (frame_NNNNNN.rgba), e.g. for encoding into video
+	/// </summary>
+	bool capture_raw = false;
+	/// <summary>
+	/// Name (or part of it) or UUID of the GPU to render with, overriding the scored choice (empty picks by score)
+	/// </summary>
+	std::string device;
+	/// <summary>
+	/// Threads running jobs besides the main thread (0 uses one per remaining hardware thread)
+	/// </summary>
+	uint32_t worker_threads = 0;
+	/// <summary>
+	/// Pin the main thread and each job worker to its own core
+	/// </summary>
+	bool pin_threads = false;
+	uint32_t width = 640;
+	uint32_t height = 480;
+};
 
 class CoreApp {
 public:
-	static constexpr int WIDTH = 640;
-	static constexpr int HEIGHT = 480;
-
-	CoreApp();
+	CoreApp(const AppSettings& settings = {});
 	~CoreApp();
 
 	/// <summary>
@@ -26,14 +158,160 @@ public:
 	/// </summary>
 	void printSupportedExtensions();
 
+	/// <summary>
+	/// Replace the scene drawn every frame
+	/// </summary>
+	/// <param name="new_models">Models providing vertex and index buffers</param>
+	/// <param name="objects">Objects to draw, each referencing one of new_models by index</param>
+	/// <param name="instance_data">Per-instance data referenced by the objects (identity transforms and white if empty)</param>
+	void setScene(std::vector<std::unique_ptr<Model>> new_models, std::vector<SceneObject> objects, const std::vector<InstanceData>& instance_data = {});
+	/// <summary>
+	/// Add a model and objects drawing it to the scene while frames are in flight, e.g. once the mesh streamer has published
+	/// it. Nothing already drawn is released, so only GPU culling (whose output buffers are reallocated) waits for the device
+	/// </summary>
+	/// <param name="model">Model providing vertex and index buffers</param>
+	/// <param name="objects">Objects to draw, all drawing the model (their model index is replaced)</param>
+	/// <param name="instance_data">Per-instance data referenced by the objects, indexed from 0 and appended after the scene's
+	/// instances (identity transforms and white if empty)</param>
+	/// <returns>Index of the model, which the objects now reference</returns>
+	uint32_t addModel(std::unique_ptr<Model> model, std::vector<SceneObject> objects, const std::vector<InstanceData>& instance_data = {});
+	/// <summary>
+	/// Update the data of a single instance, taking effect from the next recorded frame
+	/// </summary>
+	/// <param name="index">Index of the instance in the instance buffer</param>
+	/// <param name="data">New instance data</param>
+	void setInstance(uint32_t index, const InstanceData& data);
+	/// <summary>
+	/// Set the matrix transforming world space to clip space, whose frustum objects are culled against
+	/// </summary>
+	void setViewProjection(const glm::mat4& matrix) { view_projection = matrix; }
+	/// <summary>
+	/// Transform hierarchy whose world transforms drive the instances attached to its nodes, updated before every frame
+	/// </summary>
+	TransformHierarchy& getTransforms() { return transforms; }
+	/// <summary>
+	/// Make an instance follow the world transform of a node. Each instance should follow at most one node
+	/// </summary>
+	/// <param name="node">Node of the transform hierarchy</param>
+	/// <param name="instance">Index of the instance in the instance buffer</param>
+	void attachInstance(uint32_t node, uint32_t instance);
+
+	LogicalDevice& getDevice() { return vulkan_device; }
+	/// <summary>
+	/// Scheduler engine work is split across, which the caller may also use from the main thread
+	/// </summary>
+	JobSystem& getJobs() { return jobs; }
+	/// <summary>
+	/// Create models from meshes, building their levels of detail and meshlets in parallel and then uploading them in order
+	/// </summary>
+	/// <param name="meshes">Meshes to create models of</param>
+	/// <param name="import_settings">Processing applied to every mesh</param>
+	/// <returns>One model per mesh, in the same order</returns>
+	std::vector<std::unique_ptr<Model>> importModels(const std::vector<MeshData>& meshes, const ModelImportSettings& import_settings);
+	/// <summary>
+	/// Loader of meshes added while rendering continues, updated once per frame. Ready models can be drawn from the
+	/// streamer directly or taken out of it and passed to addModel
+	/// </summary>
+	MeshStreamer& getMeshStreamer() { return *mesh_streamer; }
+	/// <summary>
+	/// Timings of all frames drawn so far
+	/// </summary>
+	const FrameTimings& getFrameTimings() { return frame_timings; }
+	/// <summary>
+	/// Global set of buffers and images indexed from shaders (set 1 of the graphics pipeline), null without descriptor indexing
+	/// </summary>
+	BindlessDescriptors* getBindless() { return bindless.get(); }
+	/// <summary>
+	/// Streamer of the textures scene objects reference, null without descriptor indexing
+	/// </summary>
+	TextureStreamer* getTextureStreamer() { return texture_streamer.get(); }
+	/// <summary>
+	/// Add a texture for scene objects to reference, uploading its coarsest levels immediately and streaming the rest on demand
+	/// </summary>
+	/// <returns>Identifier to store in SceneObject::texture</returns>
+	uint32_t addTexture(std::unique_ptr<TextureSource> source);
+	/// <summary>
+	/// Number of frames whose GPU culling output was checked against the CPU reference
+	/// </summary>
+	uint32_t getValidatedCullingFrames() { return gpu_culler ? gpu_culler->getValidatedFrameCount() : 0; }
+	/// <summary>
+	/// Samples per pixel the scene is rendered with
+	/// </summary>
+	VkSampleCountFlagBits getSampleCount() { return sample_count; }
+	/// <summary>
+	/// Render graph of the current swapchain
+	/// </summary>
+	RenderGraph& getRenderGraph() { return *render_graph; }
+	/// <summary>
+	/// Controller choosing the render resolution from GPU frame times, null without a frame budget
+	/// </summary>
+	ResolutionController* getResolutionController() { return resolution_controller.get(); }
+	/// <summary>
+	/// Receive captured frames instead of having them written to the capture directory. Called on the main thread
+	/// </summary>
+	void setCaptureCallback(std::function<void(CapturedFrame)> callback) { capture_callback = std::move(callback); }
+
 private:
-	Window window{ WIDTH, HEIGHT, "Vulkan Tutorial" };
-	LogicalDevice vulkan_device{ window };
+	static constexpr VkDeviceSize FRAME_DATA_CAPACITY = 64 * 1024; // Bytes of uniform/storage data each frame may write
+	static constexpr uint32_t NO_OWNER = UINT32_MAX;
+	static constexpr uint32_t SHARED_OWNER = UINT32_MAX - 1;
+
+	AppSettings settings;
+	std::unique_ptr<Window> window; // Null when headless
+	JobSystem jobs;
+	LogicalDevice vulkan_device;
+	PerFrameBuffer<InstanceData> instances{ vulkan_device, SwapChain::MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT };
+	IndirectDrawBuffer indirect_draws{ vulkan_device, SwapChain::MAX_FRAMES_IN_FLIGHT };
+	std::vector<IndirectBatch> indirect_batches;
+	bool use_indirect_draws = false;
+	std::unique_ptr<GpuCuller> gpu_culler; // Null unless culling on the GPU
+	std::vector<uint32_t> object_commands; // First indirect command drawing each scene object
+	bool use_cpu_culling = false;
+	BoundingSphereArray object_bounds; // World space culling sphere of each scene object when culling on the CPU
+	std::vector<uint32_t> visible_objects; // Scene objects passing the CPU frustum test this frame, in scene order
+	std::vector<uint32_t> instance_owners; // Scene object using each instance (NO_OWNER or SHARED_OWNER otherwise)
+	std::vector<uint32_t> moved_instances; // Instances changed since culling bounds were last updated
+	bool all_bounds_dirty = false;
+	glm::mat4 view_projection{ 1.0f };
+	TransformHierarchy transforms{ &jobs };
+	std::vector<uint32_t> node_instances; // Instance following each node (NO_OWNER if none)
+	std::vector<uint32_t> updated_nodes;  // Scratch list of nodes recomputed by the last transform update
+	std::vector<uint32_t> object_lods;    // Level of detail drawn for each scene object
 	std::unique_ptr<SwapChain> device_swap_chain;
+	std::unique_ptr<RenderGraph> render_graph; // Rebuilt with the swapchain, whose image views its framebuffers reference
+	uint32_t backbuffer_image; // Swapchain image being rendered to, imported into the render graph every frame
+	uint32_t scene_pass;
+	VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT;
+	std::unique_ptr<ResolutionController> resolution_controller; // Null without a frame budget
+	uint32_t upscale_source_image = RenderGraph::NO_IMAGE; // Image the scene is rendered into at reduced resolution, NO_IMAGE when rendering into the backbuffer
+	VkExtent2D render_extent{}; // Part of the render targets drawn into this frame
 	std::unique_ptr<GraphicsPipeline> pipeline;
+	std::unique_ptr<GraphicsPipeline> depth_pipeline; // Null without a depth pre-pass
+	UniformRingBuffer frame_data{ vulkan_device, SwapChain::MAX_FRAMES_IN_FLIGHT, FRAME_DATA_CAPACITY };
+	DescriptorAllocator descriptor_allocator{ vulkan_device };
+	std::unique_ptr<BindlessDescriptors> bindless; // Null without descriptor indexing
+	std::unique_ptr<TextureStreamer> texture_streamer; // Null without bindless descriptors
+	glm::vec4 streamed_mesh_bounds{ 0.0f }; // Written by the loader of the streamed mesh, so it outlives the streamer
+	std::unique_ptr<MeshStreamer> mesh_streamer;
+	MeshStreamer::MeshHandle streamed_mesh = MeshStreamer::NO_MESH; // Mesh given with --mesh, added to the scene once ready
+	VkDescriptorSetLayout frame_set_layout;
+	VkDescriptorSet frame_descriptor_set; // Single set over the whole ring, each frame selects its region with a dynamic offset
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	uint32_t frames_drawn = 0;
 	VkPipelineLayout pipeline_layout;
 	std::vector<VkCommandBuffer> command_buffers;
-	std::unique_ptr<Model> scene;
+	std::unique_ptr<GpuTimer> gpu_timer; // One timing slot per command buffer
+	std::unique_ptr<FragmentCounter> fragment_counter; // One counting slot per command buffer
+	std::unique_ptr<FrameReadback> frame_readback; // One capture slot per command buffer, null unless capturing
+	std::function<void(CapturedFrame)> capture_callback; // Empty writes captures to the capture directory
+	JobCounter capture_writes; // Captures being written to disk in the background
+	uint32_t recording_image = 0; // Command buffer being recorded
+	uint32_t recording_frame = 0; // Index of the frame being recorded
+	bool capture_recording = false; // Whether the frame being recorded is captured
+	std::vector<std::unique_ptr<Model>> models;
+	std::vector<SceneObject> scene_objects;
+	RenderQueue render_queue; // Direct draws of the frame being recorded
+	FrameTimings frame_timings;
 
 	/// <summary>
 	/// Draws a single frame
@@ -41,10 +319,84 @@ private:
 	void drawFrame();
 
 	void loadModels();
+	/// <summary>
+	/// Add the streamed mesh to the scene once the streamer has published it
+	/// </summary>
+	void addStreamedMesh();
+	/// <summary>
+	/// Import the OBJ mesh at the given path and process it, or read the result from the mesh cache if it holds it,
+	/// reporting how long either took. Safe to call from a background thread
+	/// </summary>
+	ImportedMesh importMesh(const std::string& path);
+	/// <summary>
+	/// Rebuild the indirect draw commands from the scene objects, grouping them into one batch per model
+	/// </summary>
+	void updateIndirectCommands();
+	/// <summary>
+	/// Recompute the world space culling sphere of an object from its bounds and instance transforms
+	/// </summary>
+	void updateCullingBounds(uint32_t object);
+	/// <summary>
+	/// Bring the culling spheres of objects whose instances moved up to date
+	/// </summary>
+	void updateMovedBounds();
+	/// <summary>
+	/// Recompute dirty world transforms and copy them into the instances attached to their nodes
+	/// </summary>
+	void updateTransforms();
+	/// <summary>
+	/// Screen pixels covered by one model space unit of an object at its distance from the camera (infinite if the object
+	/// is unbounded or reaches the camera)
+	/// </summary>
+	float pixelsPerUnit(const SceneObject& object);
+	/// <summary>
+	/// Request the mip level of each textured object's texture matching the object's projected size on screen
+	/// </summary>
+	void requestTextureLevels();
+	/// <summary>
+	/// Update the level of detail of every object using them from its projected size, rewriting changed indirect commands
+	/// </summary>
+	void selectLods();
+	/// <summary>
+	/// Index range currently drawn for an object
+	/// </summary>
+	DrawRange objectRange(uint32_t object);
+	/// <summary>
+	/// Whether an object is drawn as one indirect command per meshlet of each of its instances
+	/// </summary>
+	bool usesMeshlets(uint32_t object);
+	/// <summary>
+	/// Number of consecutive indirect commands drawing an object
+	/// </summary>
+	uint32_t objectCommandCount(uint32_t object);
+	/// <summary>
+	/// Create the descriptor set giving shaders access to the per-frame data of the uniform ring buffer
+	/// </summary>
+	void createFrameDescriptorSet();
 	void createPipelineLayout();
 	void createPipeline();
+	/// <summary>
+	/// Build and compile the render graph drawing the scene into the swapchain images
+	/// </summary>
+	void createRenderGraph();
 	void createCommandBuffers();
 	void freeCommandBuffers();
 	void recordCommandBuffer(int image_index);
+	/// <summary>
+	/// Record the scene's draws, inside the render pass of the scene pass
+	/// </summary>
+	void recordScene(VkCommandBuffer command_buffer);
+	/// <summary>
+	/// Record the blit stretching the part of the scene image drawn this frame over the backbuffer
+	/// </summary>
+	void recordUpscale(VkCommandBuffer command_buffer);
 	void recreateSwapChain();
+	/// <summary>
+	/// Hand a captured frame to the capture callback, or write it to the capture directory on a background thread
+	/// </summary>
+	void deliverCapture(CapturedFrame captured);
+	/// <summary>
+	/// Deliver the captures of every command buffer in frame order (all submissions must have completed)
+	/// </summary>
+	void collectCaptures();
 };
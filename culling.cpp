@@ -0,0 +1,393 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CULLING_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CULLING_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit instructions beyond the baseline inside functions targeting them, MSVC always allows the intrinsics
+#if defined(__GNUC__) || defined(__clang__)
+#define CULLING_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CULLING_TARGET(isa)
+#endif
+
+namespace {
+	/// <summary>
+	/// Write the indices of the set bits of a lane mask to out, returning how many were written.
+	/// Branchless: every lane is written and the cursor only advances past visible ones, so out must have room for all lanes
+	/// </summary>
+	inline uint32_t appendVisible(uint32_t mask, uint32_t first_index, uint32_t lanes, uint32_t* out) {
+		uint32_t written = 0;
+		for (uint32_t lane = 0; lane < lanes; lane++) {
+			out[written] = first_index + lane;
+			written += (mask >> lane) & 1u;
+		}
+		return written;
+	}
+
+	uint32_t cullScalar(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t begin, uint32_t end, uint32_t* out) {
+		const float* xs = spheres.centreX();
+		const float* ys = spheres.centreY();
+		const float* zs = spheres.centreZ();
+		const float* rs = spheres.radii();
+		uint32_t written = 0;
+		for (uint32_t i = begin; i < end; i++) {
+			bool visible = true;
+			for (const glm::vec4& plane : frustum.planes) {
+				float distance = plane.x * xs[i] + plane.y * ys[i] + plane.z * zs[i] + plane.w;
+				visible &= distance + rs[i] >= 0.0f;
+			}
+			out[written] = i;
+			written += visible ? 1 : 0;
+		}
+		return written;
+	}
+
+#if defined(CULLING_X86)
+	/// <summary>
+	/// Visibility mask of the 4 spheres starting at index i
+	/// </summary>
+	inline int testSse(const __m128 planes[6][4], const BoundingSphereArray& spheres, uint32_t i) {
+		__m128 x = _mm_load_ps(spheres.centreX() + i);
+		__m128 y = _mm_load_ps(spheres.centreY() + i);
+		__m128 z = _mm_load_ps(spheres.centreZ() + i);
+		__m128 r = _mm_load_ps(spheres.radii() + i);
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)), _mm_mul_ps(planes[p][2], z)), planes[p][3]);
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+		}
+		return _mm_movemask_ps(visible);
+	}
+
+	uint32_t cullSse(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t begin, uint32_t end, uint32_t* out) {
+		__m128 planes[6][4];
+		for (int p = 0; p < 6; p++) {
+			for (int c = 0; c < 4; c++) planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+		}
+		uint32_t written = 0;
+		for (uint32_t i = begin; i < end; i += 8) {
+			uint32_t mask = static_cast<uint32_t>(testSse(planes, spheres, i)) | (static_cast<uint32_t>(testSse(planes, spheres, i + 4)) << 4);
+			written += appendVisible(mask, i, 8, out + written);
+		}
+		return written;
+	}
+
+	CULLING_TARGET("avx2") inline int testAvx2(const __m256 planes[6][4], const BoundingSphereArray& spheres, uint32_t i) {
+		__m256 x = _mm256_load_ps(spheres.centreX() + i);
+		__m256 y = _mm256_load_ps(spheres.centreY() + i);
+		__m256 z = _mm256_load_ps(spheres.centreZ() + i);
+		__m256 r = _mm256_load_ps(spheres.radii() + i);
+		__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			// Separate multiplies and adds (no FMA) so that rounding matches the scalar path exactly
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)), _mm256_mul_ps(planes[p][2], z)), planes[p][3]);
+			visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		return _mm256_movemask_ps(visible);
+	}
+
+	CULLING_TARGET("avx2") uint32_t cullAvx2(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t begin, uint32_t end, uint32_t* out) {
+		__m256 planes[6][4];
+		for (int p = 0; p < 6; p++) {
+			for (int c = 0; c < 4; c++) planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+		}
+		uint32_t written = 0;
+		for (uint32_t i = begin; i < end; i += 16) {
+			uint32_t mask = static_cast<uint32_t>(testAvx2(planes, spheres, i)) | (static_cast<uint32_t>(testAvx2(planes, spheres, i + 8)) << 8);
+			written += appendVisible(mask, i, 16, out + written);
+		}
+		return written;
+	}
+
+	bool cpuSupportsAvx2() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		bool os_saves_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6; // OSXSAVE, AVX and YMM state enabled
+		__cpuidex(info, 7, 0);
+		return os_saves_avx && (info[1] & (1 << 5));
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+#if defined(CULLING_NEON)
+	inline uint32_t testNeon(const float32x4_t planes[6][4], const BoundingSphereArray& spheres, uint32_t i) {
+		float32x4_t x = vld1q_f32(spheres.centreX() + i);
+		float32x4_t y = vld1q_f32(spheres.centreY() + i);
+		float32x4_t z = vld1q_f32(spheres.centreZ() + i);
+		float32x4_t r = vld1q_f32(spheres.radii() + i);
+		uint32x4_t visible = vdupq_n_u32(0xFFFFFFFFu);
+		for (int p = 0; p < 6; p++) {
+			float32x4_t distance = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(planes[p][0], x), vmulq_f32(planes[p][1], y)), vmulq_f32(planes[p][2], z)), planes[p][3]);
+			visible = vandq_u32(visible, vcgeq_f32(vaddq_f32(distance, r), vdupq_n_f32(0.0f)));
+		}
+		// No movemask on NEON, weight each lane by its bit and sum them
+		const uint32_t lane_bits[4] = { 1, 2, 4, 8 };
+		return vaddvq_u32(vandq_u32(visible, vld1q_u32(lane_bits)));
+	}
+
+	uint32_t cullNeon(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t begin, uint32_t end, uint32_t* out) {
+		float32x4_t planes[6][4];
+		for (int p = 0; p < 6; p++) {
+			for (int c = 0; c < 4; c++) planes[p][c] = vdupq_n_f32(frustum.planes[p][c]);
+		}
+		uint32_t written = 0;
+		for (uint32_t i = begin; i < end; i += 8) {
+			uint32_t mask = testNeon(planes, spheres, i) | (testNeon(planes, spheres, i + 4) << 4);
+			written += appendVisible(mask, i, 8, out + written);
+		}
+		return written;
+	}
+#endif
+
+	/// <summary>
+	/// Cull the spheres [begin, end), both multiples of BLOCK_SIZE, writing the visible indices to out
+	/// </summary>
+	uint32_t cullRange(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t begin, uint32_t end, uint32_t* out, SimdLevel level) {
+		switch (level) {
+#if defined(CULLING_X86)
+		case SimdLevel::Sse: return cullSse(frustum, spheres, begin, end, out);
+		case SimdLevel::Avx2: return cullAvx2(frustum, spheres, begin, end, out);
+#endif
+#if defined(CULLING_NEON)
+		case SimdLevel::Neon: return cullNeon(frustum, spheres, begin, end, out);
+#endif
+		default: return cullScalar(frustum, spheres, begin, end, out);
+		}
+	}
+}
+
+Frustum
+Frustum::fromMatrix(const glm::mat4& view_projection) {
+	// Rows of the matrix (glm is column-major), see Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+	auto row = [&view_projection](int r) { return glm::vec4{ view_projection[0][r], view_projection[1][r], view_projection[2][r], view_projection[3][r] }; };
+
+	Frustum frustum{};
+	frustum.planes[0] = row(3) + row(0); // Left, -w <= x
+	frustum.planes[1] = row(3) - row(0); // Right, x <= w
+	frustum.planes[2] = row(3) + row(1); // Bottom, -w <= y
+	frustum.planes[3] = row(3) - row(1); // Top, y <= w
+	frustum.planes[4] = row(2);          // Near, 0 <= z (Vulkan depth range)
+	frustum.planes[5] = row(3) - row(2); // Far, z <= w
+
+	// Normalise so that plane equations yield true distances, which sphere radii can be compared against
+	for (glm::vec4& plane : frustum.planes) {
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) plane /= length;
+	}
+
+	// The camera is the point mapped to x = y = w = 0: orthogonal to rows 0, 1 and 3, i.e. their 4D cross product.
+	// Dotting it with row 2 expands the determinant of the matrix along that row
+	glm::vec4 a = row(0), b = row(1), c = row(3);
+	auto minor = [&](int i, int j, int k) { return a[i] * (b[j] * c[k] - b[k] * c[j]) - a[j] * (b[i] * c[k] - b[k] * c[i]) + a[k] * (b[i] * c[j] - b[j] * c[i]); };
+	glm::vec4 camera{ minor(1, 2, 3), -minor(0, 2, 3), minor(0, 1, 3), -minor(0, 1, 2) };
+	glm::vec4 depth_row = row(2);
+	float determinant = depth_row.x * camera.x + depth_row.y * camera.y + depth_row.z * camera.z + depth_row.w * camera.w;
+	frustum.orientation = determinant >= 0.0f ? 1.0f : -1.0f;
+	float camera_length = glm::length(glm::vec3(camera));
+	if (std::abs(camera.w) > 1e-6f * camera_length) {
+		frustum.camera = camera / camera.w;
+	} else if (camera_length > 0.0f) {
+		// At infinity, depth increases along the view direction
+		frustum.camera = glm::vec4(glm::vec3(camera) * (-frustum.orientation / camera_length), 0.0f);
+	}
+	return frustum;
+}
+
+float
+CullingUtils::visibilityMargin(const Frustum& frustum, const glm::vec4& sphere) {
+	if (sphere.w == UNBOUNDED_RADIUS) return UNBOUNDED_RADIUS;
+
+	float margin = UNBOUNDED_RADIUS;
+	for (const glm::vec4& plane : frustum.planes) {
+		float distance = plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w;
+		margin = std::min(margin, distance + sphere.w);
+	}
+	return margin;
+}
+
+void
+CullingUtils::cullSpheresReference(const Frustum& frustum, const std::vector<glm::vec4>& spheres, std::vector<uint32_t>& visible) {
+	visible.clear();
+	for (uint32_t i = 0; i < spheres.size(); i++) {
+		if (isSphereVisible(frustum, spheres[i])) visible.push_back(i);
+	}
+}
+
+void
+BoundingSphereArray::resize(uint32_t new_count) {
+	uint32_t padded = (new_count + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+	x.resize(padded, 0.0f);
+	y.resize(padded, 0.0f);
+	z.resize(padded, 0.0f);
+	radius.resize(padded, 0.0f);
+	// Padding spheres have a radius no distance can make up for, so they are always culled
+	for (uint32_t i = new_count; i < padded; i++) set(i, { 0.0f, 0.0f, 0.0f, std::numeric_limits<float>::lowest() });
+	for (uint32_t i = count; i < new_count; i++) set(i, { 0.0f, 0.0f, 0.0f, 0.0f });
+	count = new_count;
+}
+
+void
+BoundingSphereArray::set(uint32_t index, const glm::vec4& sphere) {
+	x[index] = sphere.x;
+	y[index] = sphere.y;
+	z[index] = sphere.z;
+	radius[index] = sphere.w;
+}
+
+void
+CullingUtils::cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, std::vector<uint32_t>& visible) {
+	static const SimdLevel level = bestSimdLevel();
+	cullSpheres(frustum, spheres, visible, level);
+}
+
+void
+CullingUtils::cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, std::vector<uint32_t>& visible, SimdLevel level) {
+	if (!isSimdLevelSupported(level)) throw std::runtime_error(std::string("Culling instruction set unsupported: ") + simdLevelName(level));
+
+	// Every padded entry may be written before the cursor skips it, the list is trimmed to the visible count afterwards
+	visible.resize(spheres.paddedSize());
+	visible.resize(cullRange(frustum, spheres, 0, spheres.paddedSize(), visible.data(), level));
+}
+
+void
+CullingUtils::cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, std::vector<uint32_t>& visible, JobSystem& jobs) {
+	static const SimdLevel level = bestSimdLevel();
+	visible.resize(spheres.paddedSize());
+
+	// Each range writes its visible indices over its own stretch of the list, which are then moved down to be contiguous
+	size_t block_count = spheres.paddedSize() / BoundingSphereArray::BLOCK_SIZE;
+	size_t grain = PARALLEL_GRAIN / BoundingSphereArray::BLOCK_SIZE;
+	size_t range_count = jobs.rangeCount(block_count, grain);
+	std::vector<uint32_t> range_visible(range_count);
+	jobs.parallelForRanges(block_count, grain, [&](size_t range, size_t begin_block, size_t end_block) {
+		uint32_t begin = static_cast<uint32_t>(begin_block) * BoundingSphereArray::BLOCK_SIZE;
+		uint32_t end = static_cast<uint32_t>(end_block) * BoundingSphereArray::BLOCK_SIZE;
+		range_visible[range] = cullRange(frustum, spheres, begin, end, visible.data() + begin, level);
+	});
+
+	uint32_t written = 0;
+	for (size_t range = 0; range < range_count; range++) {
+		uint32_t begin = static_cast<uint32_t>(range * block_count / range_count) * BoundingSphereArray::BLOCK_SIZE;
+		if (written != begin) std::copy(visible.begin() + begin, visible.begin() + begin + range_visible[range], visible.begin() + written); // Only ever moves entries down
+		written += range_visible[range];
+	}
+	visible.resize(written);
+}
+
+SimdLevel
+CullingUtils::bestSimdLevel() {
+#if defined(CULLING_X86)
+	static const bool avx2 = cpuSupportsAvx2();
+	return avx2 ? SimdLevel::Avx2 : SimdLevel::Sse; // SSE2 is part of the x86-64 baseline and MSVC's default for x86
+#elif defined(CULLING_NEON)
+	return SimdLevel::Neon; // Mandatory on AArch64
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+bool
+CullingUtils::isSimdLevelSupported(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::Scalar: return true;
+#if defined(CULLING_X86)
+	case SimdLevel::Sse: return true;
+	case SimdLevel::Avx2: return bestSimdLevel() == SimdLevel::Avx2;
+#endif
+#if defined(CULLING_NEON)
+	case SimdLevel::Neon: return true;
+#endif
+	default: return false;
+	}
+}
+
+const char*
+CullingUtils::simdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::Sse: return "sse";
+	case SimdLevel::Avx2: return "avx2";
+	case SimdLevel::Neon: return "neon";
+	default: return "scalar";
+	}
+}
+
+glm::vec4
+CullingUtils::computeBoundingSphere(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const DrawRange& range) {
+	if (range.index_count == 0) return { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	glm::vec2 minimum{ std::numeric_limits<float>::max() };
+	glm::vec2 maximum{ std::numeric_limits<float>::lowest() };
+	for (uint32_t i = range.first_index; i < range.first_index + range.index_count; i++) {
+		const glm::vec2& position = vertices[indices[i] + range.vertex_offset].pos;
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
+
+	glm::vec2 centre = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t i = range.first_index; i < range.first_index + range.index_count; i++) {
+		radius = std::max(radius, glm::length(vertices[indices[i] + range.vertex_offset].pos - centre));
+	}
+	return { centre, 0.0f, radius };
+}
+
+glm::vec4
+CullingUtils::transformSphere(const glm::mat4& transform, const glm::vec4& sphere) {
+	if (sphere.w == UNBOUNDED_RADIUS) return sphere;
+
+	glm::vec3 centre = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+	float scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+	return { centre, sphere.w * scale };
+}
+
+float
+CullingUtils::coneMargin(const Frustum& frustum, const glm::vec4& sphere, const glm::vec4& cone) {
+	// Same test as cull.comp: the direction from the camera to the sphere must lie within the cone's backfacing range
+	glm::vec3 direction = glm::vec3(sphere) * frustum.camera.w - glm::vec3(frustum.camera);
+	return cone.w * glm::length(direction) + sphere.w * frustum.camera.w - frustum.orientation * glm::dot(direction, glm::vec3(cone));
+}
+
+glm::vec4
+CullingUtils::transformCone(const glm::mat4& transform, const glm::vec4& cone) {
+	if (cone.w >= 1.0f) return cone;
+
+	glm::vec3 axis = glm::vec3(transform * glm::vec4(glm::vec3(cone), 0.0f));
+	float length = glm::length(axis);
+	if (length == 0.0f) return { 0.0f, 0.0f, 0.0f, 1.0f };
+	// Mirroring transforms swap the front and back faces of the cluster
+	float determinant = glm::dot(glm::cross(glm::vec3(transform[0]), glm::vec3(transform[1])), glm::vec3(transform[2]));
+	return { axis * ((determinant < 0.0f ? -1.0f : 1.0f) / length), cone.w };
+}
+
+glm::vec4
+CullingUtils::mergeSpheres(const glm::vec4& a, const glm::vec4& b) {
+	if (a.w == UNBOUNDED_RADIUS || b.w == UNBOUNDED_RADIUS) return { 0.0f, 0.0f, 0.0f, UNBOUNDED_RADIUS };
+
+	glm::vec3 offset = glm::vec3(b) - glm::vec3(a);
+	float distance = glm::length(offset);
+	if (distance + b.w <= a.w) return a; // b is contained in a
+	if (distance + a.w <= b.w) return b; // a is contained in b
+
+	float radius = (distance + a.w + b.w) * 0.5f;
+	glm::vec3 centre = glm::vec3(a) + offset * ((radius - a.w) / distance);
+	return { centre, radius };
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "model.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <vector>
+
+/// <summary>
+/// Six planes bounding the visible volume, each stored as (normal, distance) with the normal pointing inwards
+/// </summary>
+struct Frustum {
+	std::array<glm::vec4, 6> planes;
+	/// <summary>
+	/// Camera for backface tests: world space position with w = 1, or for projections without a centre (orthographic)
+	/// the negated view direction with w = 0
+	/// </summary>
+	glm::vec4 camera{ 0.0f };
+	/// <summary>
+	/// -1 when the matrix mirrors space (negative determinant), which swaps the triangles seen as front facing
+	/// </summary>
+	float orientation = 1.0f;
+
+	/// <summary>
+	/// Extract the frustum planes of a view-projection matrix (Vulkan clip space, depth in [0, 1])
+	/// </summary>
+	/// <param name="view_projection">Matrix transforming world space to clip space</param>
+	/// <returns>Frustum with normalised planes (left, right, bottom, top, near, far) and the camera they converge to</returns>
+	static Frustum fromMatrix(const glm::mat4& view_projection);
+};
+
+/// <summary>
+/// Instruction sets the batched culling routines can be run with
+/// </summary>
+enum class SimdLevel {
+	Scalar,
+	Sse,  // SSE2, 2 x 4 spheres per iteration
+	Avx2, // 2 x 8 spheres per iteration
+	Neon  // AArch64 NEON, 2 x 4 spheres per iteration
+};
+
+/// <summary>
+/// Minimal allocator returning memory aligned for aligned SIMD loads
+/// </summary>
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+	using value_type = T;
+	template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+	template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{ Alignment })); }
+	void deallocate(T* pointer, size_t) { ::operator delete(pointer, std::align_val_t{ Alignment }); }
+
+	template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+/// <summary>
+/// Bounding spheres stored as structure of arrays (centre x, y, z and radius in separate aligned arrays), so that several
+/// spheres can be loaded into one SIMD register per component. Arrays are padded to a multiple of BLOCK_SIZE with spheres
+/// that are never visible, which lets the culling loops run over whole blocks without a scalar tail
+/// </summary>
+class BoundingSphereArray {
+public:
+	static constexpr uint32_t BLOCK_SIZE = 16; // Spheres tested per iteration by the widest path
+	static constexpr size_t ALIGNMENT = 64;    // Cache line, covers the alignment of every SIMD register width
+
+	uint32_t size() const { return count; }
+	/// <summary>
+	/// Number of entries including padding, always a multiple of BLOCK_SIZE
+	/// </summary>
+	uint32_t paddedSize() const { return static_cast<uint32_t>(x.size()); }
+
+	/// <summary>
+	/// Change the number of spheres, new spheres are zero-sized at the origin
+	/// </summary>
+	void resize(uint32_t new_count);
+	void set(uint32_t index, const glm::vec4& sphere);
+	glm::vec4 get(uint32_t index) const { return { x[index], y[index], z[index], radius[index] }; }
+
+	const float* centreX() const { return x.data(); }
+	const float* centreY() const { return y.data(); }
+	const float* centreZ() const { return z.data(); }
+	const float* radii() const { return radius.data(); }
+
+private:
+	using AlignedFloats = std::vector<float, AlignedAllocator<float, ALIGNMENT>>;
+	AlignedFloats x, y, z, radius;
+	uint32_t count = 0;
+};
+
+/// <summary>
+/// Utility class containing static methods for visibility testing of bounding spheres.
+/// Spheres are stored as glm::vec4 with the centre in xyz and the radius in w
+/// </summary>
+class CullingUtils {
+public:
+	/// <summary>
+	/// Radius of spheres that are visible from everywhere (used for objects without known bounds)
+	/// </summary>
+	static constexpr float UNBOUNDED_RADIUS = std::numeric_limits<float>::max();
+	/// <summary>
+	/// Fewest spheres worth culling in a job of their own
+	/// </summary>
+	static constexpr uint32_t PARALLEL_GRAIN = 16384;
+
+	/// <summary>
+	/// Smallest signed distance of the sphere's surface to the inside of any frustum plane.
+	/// The sphere is visible when it is non-negative
+	/// </summary>
+	static float visibilityMargin(const Frustum& frustum, const glm::vec4& sphere);
+	/// <summary>
+	/// Reference (scalar) frustum test of a single sphere
+	/// </summary>
+	static bool isSphereVisible(const Frustum& frustum, const glm::vec4& sphere) { return visibilityMargin(frustum, sphere) >= 0.0f; }
+	/// <summary>
+	/// Reference (scalar) frustum culling of a list of spheres
+	/// </summary>
+	/// <param name="frustum">Frustum to test against</param>
+	/// <param name="spheres">Spheres to test</param>
+	/// <param name="visible">Filled with the indices of the visible spheres, in increasing order</param>
+	static void cullSpheresReference(const Frustum& frustum, const std::vector<glm::vec4>& spheres, std::vector<uint32_t>& visible);
+	/// <summary>
+	/// Frustum culling of a structure of arrays of spheres with the widest instruction set supported by the CPU
+	/// </summary>
+	/// <param name="frustum">Frustum to test against</param>
+	/// <param name="spheres">Spheres to test</param>
+	/// <param name="visible">Filled with the indices of the visible spheres, in increasing order</param>
+	static void cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, std::vector<uint32_t>& visible);
+	/// <summary>
+	/// Frustum culling with a specific instruction set, which must be supported. Each plane test performs the same float
+	/// operations in the same order at every level, so results only differ from SimdLevel::Scalar when the compiler
+	/// contracts the scalar path into fused multiply-adds, and then only for spheres touching a plane
+	/// </summary>
+	static void cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, std::vector<uint32_t>& visible, SimdLevel level);
+	/// <summary>
+	/// Frustum culling split across the jobs of a scheduler, with the same result as the single threaded version
+	/// </summary>
+	static void cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, std::vector<uint32_t>& visible, JobSystem& jobs);
+	/// <summary>
+	/// Widest instruction set supported by the CPU and compiler, detected on first use
+	/// </summary>
+	static SimdLevel bestSimdLevel();
+	static bool isSimdLevelSupported(SimdLevel level);
+	static const char* simdLevelName(SimdLevel level);
+
+	/// <summary>
+	/// Bounding sphere of the vertices referenced by an index range (centred on their bounding box)
+	/// </summary>
+	static glm::vec4 computeBoundingSphere(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const DrawRange& range);
+	/// <summary>
+	/// Conservative bounding sphere of a sphere after an affine transform (radius scaled by the largest axis scale)
+	/// </summary>
+	static glm::vec4 transformSphere(const glm::mat4& transform, const glm::vec4& sphere);
+	/// <summary>
+	/// Sphere enclosing both given spheres
+	/// </summary>
+	static glm::vec4 mergeSpheres(const glm::vec4& a, const glm::vec4& b);
+	/// <summary>
+	/// How far a cluster is from facing entirely away from the frustum's camera, negative when every triangle within
+	/// its normal cone is backfacing (see Meshlet::cone). Clusters without a cone (cutoff of 1 or more) are never backfacing
+	/// </summary>
+	/// <param name="frustum">Frustum whose camera the cluster is seen from</param>
+	/// <param name="sphere">World space bounding sphere of the cluster</param>
+	/// <param name="cone">World space normal cone of the cluster</param>
+	static float coneMargin(const Frustum& frustum, const glm::vec4& sphere, const glm::vec4& cone);
+	static bool isConeBackfacing(const Frustum& frustum, const glm::vec4& sphere, const glm::vec4& cone) { return coneMargin(frustum, sphere, cone) < 0.0f; }
+	/// <summary>
+	/// Normal cone after an affine transform (exact for rotations and uniform scales, which keep the spread unchanged)
+	/// </summary>
+	static glm::vec4 transformCone(const glm::mat4& transform, const glm::vec4& cone);
+};
@@ -0,0 +1,238 @@
+#include "descriptors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+DescriptorAllocator::DescriptorAllocator(LogicalDevice& device, std::vector<PoolSizeRatio> ratios)
+	: device{ device }, ratios{ std::move(ratios) } {
+	if (this->ratios.empty()) {
+		this->ratios = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+		};
+	}
+}
+
+DescriptorAllocator::~DescriptorAllocator() {
+	for (VkDescriptorPool pool : used_pools) vkDestroyDescriptorPool(device.getDevice(), pool, nullptr);
+	for (VkDescriptorPool pool : free_pools) vkDestroyDescriptorPool(device.getDevice(), pool, nullptr);
+}
+
+VkDescriptorSet
+DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const void* next) {
+	if (current_pool == VK_NULL_HANDLE) current_pool = grabPool();
+
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.pNext = next;
+	alloc_info.descriptorPool = current_pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &layout;
+
+	VkDescriptorSet set;
+	VkResult result = vkAllocateDescriptorSets(device.getDevice(), &alloc_info, &set);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) { // Current pool is full, move on to a fresh one
+		current_pool = grabPool();
+		alloc_info.descriptorPool = current_pool;
+		result = vkAllocateDescriptorSets(device.getDevice(), &alloc_info, &set);
+	}
+	if (result != VK_SUCCESS) throw std::runtime_error("Failed to allocate descriptor set");
+	return set;
+}
+
+void
+DescriptorAllocator::resetPools() {
+	for (VkDescriptorPool pool : used_pools) {
+		vkResetDescriptorPool(device.getDevice(), pool, 0);
+		free_pools.push_back(pool);
+	}
+	used_pools.clear();
+	current_pool = VK_NULL_HANDLE;
+}
+
+VkDescriptorPool
+DescriptorAllocator::grabPool() {
+	VkDescriptorPool pool;
+	if (!free_pools.empty()) {
+		pool = free_pools.back();
+		free_pools.pop_back();
+	} else {
+		std::vector<VkDescriptorPoolSize> pool_sizes;
+		for (const PoolSizeRatio& ratio : ratios) {
+			pool_sizes.push_back({ ratio.type, std::max(1u, static_cast<uint32_t>(ratio.ratio * sets_per_pool)) });
+		}
+		VkDescriptorPoolCreateInfo pool_info{};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.maxSets = sets_per_pool;
+		pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+		pool_info.pPoolSizes = pool_sizes.data();
+		if (vkCreateDescriptorPool(device.getDevice(), &pool_info, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create descriptor pool");
+		}
+		sets_per_pool = std::min(sets_per_pool * 2, MAX_SETS_PER_POOL); // Needing many pools suggests needing bigger ones
+	}
+	used_pools.push_back(pool);
+	return pool;
+}
+
+uint32_t
+BindlessDescriptors::SlotAllocator::acquire() {
+	if (!free_slots.empty()) {
+		uint32_t slot = free_slots.back();
+		free_slots.pop_back();
+		return slot;
+	}
+	if (next_unused >= capacity) throw std::runtime_error("Bindless descriptor array is full");
+	return next_unused++;
+}
+
+void
+BindlessDescriptors::SlotAllocator::recycle(uint64_t completed_frame) {
+	auto recyclable = [completed_frame](const std::pair<uint32_t, uint64_t>& retired) { return retired.second <= completed_frame; };
+	for (const auto& retired : retired_slots) {
+		if (recyclable(retired)) free_slots.push_back(retired.first);
+	}
+	retired_slots.erase(std::remove_if(retired_slots.begin(), retired_slots.end(), recyclable), retired_slots.end());
+}
+
+BindlessDescriptors::BindlessDescriptors(LogicalDevice& device, uint32_t frame_count) : device{ device }, frame_count{ frame_count } {
+	if (!isSupported(device)) throw std::runtime_error("Bindless descriptors require descriptor indexing");
+
+	// Array sizes are capped by the device's update-after-bind limits
+	VkPhysicalDeviceVulkan12Properties properties_12{};
+	properties_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &properties_12;
+	vkGetPhysicalDeviceProperties2(device.getPhysicalDevice(), &properties);
+	buffer_slots.capacity = std::min({
+		MAX_STORAGE_BUFFERS,
+		properties_12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		properties_12.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+	image_slots.capacity = std::min({
+		MAX_IMAGES,
+		properties_12.maxDescriptorSetUpdateAfterBindSampledImages,
+		properties_12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		properties_12.maxDescriptorSetUpdateAfterBindSamplers,
+		properties_12.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[STORAGE_BUFFER_BINDING].binding = STORAGE_BUFFER_BINDING;
+	bindings[STORAGE_BUFFER_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[STORAGE_BUFFER_BINDING].descriptorCount = buffer_slots.capacity;
+	bindings[STORAGE_BUFFER_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[IMAGE_BINDING].binding = IMAGE_BINDING;
+	bindings[IMAGE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[IMAGE_BINDING].descriptorCount = image_slots.capacity;
+	bindings[IMAGE_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+
+	// Unused slots may hold nothing, and slots may be written while the set is bound in pending command buffers
+	constexpr VkDescriptorBindingFlags array_flags =
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	std::array<VkDescriptorBindingFlags, 2> binding_flags = { array_flags, array_flags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+	binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	binding_flags_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+	binding_flags_info.pBindingFlags = binding_flags.data();
+
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.pNext = &binding_flags_info;
+	layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+	layout_info.pBindings = bindings.data();
+	if (vkCreateDescriptorSetLayout(device.getDevice(), &layout_info, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create bindless descriptor set layout");
+	}
+
+	// Update-after-bind sets need a pool created for them, so this set does not come from a DescriptorAllocator
+	std::array<VkDescriptorPoolSize, 2> pool_sizes = { {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_slots.capacity },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_slots.capacity } } };
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+	pool_info.pPoolSizes = pool_sizes.data();
+	if (vkCreateDescriptorPool(device.getDevice(), &pool_info, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create bindless descriptor pool");
+	}
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfo variable_count_info{};
+	variable_count_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	variable_count_info.descriptorSetCount = 1;
+	variable_count_info.pDescriptorCounts = &image_slots.capacity;
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.pNext = &variable_count_info;
+	alloc_info.descriptorPool = pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &layout;
+	if (vkAllocateDescriptorSets(device.getDevice(), &alloc_info, &set) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate bindless descriptor set");
+	}
+}
+
+BindlessDescriptors::~BindlessDescriptors() {
+	vkDestroyDescriptorPool(device.getDevice(), pool, nullptr);
+	vkDestroyDescriptorSetLayout(device.getDevice(), layout, nullptr);
+}
+
+uint32_t
+BindlessDescriptors::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	uint32_t index = buffer_slots.acquire();
+	VkDescriptorBufferInfo buffer_info{ buffer, offset, range };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = STORAGE_BUFFER_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &buffer_info;
+	vkUpdateDescriptorSets(device.getDevice(), 1, &write, 0, nullptr);
+	return index;
+}
+
+uint32_t
+BindlessDescriptors::addImage(VkImageView view, VkSampler sampler, VkImageLayout image_layout) {
+	uint32_t index = image_slots.acquire();
+	updateImage(index, view, sampler, image_layout);
+	return index;
+}
+
+void
+BindlessDescriptors::updateImage(uint32_t index, VkImageView view, VkSampler sampler, VkImageLayout image_layout) {
+	VkDescriptorImageInfo image_info{ sampler, view, image_layout };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = IMAGE_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(device.getDevice(), 1, &write, 0, nullptr);
+}
+
+void
+BindlessDescriptors::beginFrame() {
+	frame_counter++;
+	if (frame_counter < frame_count) return;
+	// Frames up to frame_counter - frame_count have completed, their releases can no longer be observed by the GPU
+	buffer_slots.recycle(frame_counter - frame_count);
+	image_slots.recycle(frame_counter - frame_count);
+}
+
+void
+BindlessDescriptors::bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout pipeline_layout, uint32_t set_index) {
+	vkCmdBindDescriptorSets(command_buffer, bind_point, pipeline_layout, set_index, 1, &set, 0, nullptr);
+}
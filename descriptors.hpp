@@ -0,0 +1,142 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Allocates descriptor sets of any layout from a growing list of descriptor pools. When a pool runs out a new (larger) one is
+/// created, so callers never size pools themselves. Sets are freed all at once by resetting the pools
+/// </summary>
+class DescriptorAllocator {
+public:
+	/// <summary>
+	/// Descriptors of a type reserved per set in each pool
+	/// </summary>
+	struct PoolSizeRatio {
+		VkDescriptorType type;
+		float ratio;
+	};
+
+	static constexpr uint32_t INITIAL_SETS_PER_POOL = 64;
+	static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+	/// <summary>
+	/// Creates a DescriptorAllocator object
+	/// </summary>
+	/// <param name="device">Device to create pools on</param>
+	/// <param name="ratios">Descriptors reserved per set for each type (empty uses a mix suited to common layouts)</param>
+	DescriptorAllocator(LogicalDevice& device, std::vector<PoolSizeRatio> ratios = {});
+	~DescriptorAllocator();
+
+	DescriptorAllocator(const DescriptorAllocator&) = delete;
+	DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+	/// <summary>
+	/// Allocate a set, creating a new pool if the current one is exhausted
+	/// </summary>
+	/// <param name="layout">Layout of the set</param>
+	/// <param name="next">Extension structures of the allocation (e.g. variable descriptor counts)</param>
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout, const void* next = nullptr);
+	/// <summary>
+	/// Free every set allocated so far, keeping the pools for reuse. No set may be in use by the GPU
+	/// </summary>
+	void resetPools();
+
+private:
+	LogicalDevice& device;
+	std::vector<PoolSizeRatio> ratios;
+	uint32_t sets_per_pool = INITIAL_SETS_PER_POOL;
+	VkDescriptorPool current_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorPool> used_pools; // Pools sets were allocated from (including the current one)
+	std::vector<VkDescriptorPool> free_pools; // Reset pools ready for reuse
+
+	VkDescriptorPool grabPool();
+};
+
+/// <summary>
+/// Global descriptor set holding large arrays of storage buffers and sampled images, bound once and indexed from shaders.
+/// Built on Vulkan 1.2 descriptor indexing: the arrays are partially bound and updated after bind, so resources can be
+/// added and removed while frames using the set are in flight. Freed slots are only reused once those frames have completed
+/// </summary>
+class BindlessDescriptors {
+public:
+	static constexpr uint32_t STORAGE_BUFFER_BINDING = 0;
+	static constexpr uint32_t IMAGE_BINDING = 1; // Combined image samplers, last binding as its size is variable
+	static constexpr uint32_t MAX_STORAGE_BUFFERS = 16384;
+	static constexpr uint32_t MAX_IMAGES = 16384;
+
+	/// <summary>
+	/// Whether the device has the descriptor indexing features this set requires
+	/// </summary>
+	static bool isSupported(LogicalDevice& device) { return device.getEnabledFeatures().descriptor_indexing; }
+
+	/// <summary>
+	/// Creates a BindlessDescriptors object. The device must support it (see isSupported)
+	/// </summary>
+	/// <param name="device">Device to create the set on, whose limits cap the array sizes</param>
+	/// <param name="frame_count">Number of frames that can be in flight, i.e. frames a freed slot stays reserved for</param>
+	BindlessDescriptors(LogicalDevice& device, uint32_t frame_count);
+	~BindlessDescriptors();
+
+	BindlessDescriptors(const BindlessDescriptors&) = delete;
+	BindlessDescriptors& operator=(const BindlessDescriptors&) = delete;
+
+	/// <summary>
+	/// Add a storage buffer to the set
+	/// </summary>
+	/// <returns>Index of the buffer in the shader's storage buffer array</returns>
+	uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	/// <summary>
+	/// Add an image to the set
+	/// </summary>
+	/// <returns>Index of the image in the shader's image array</returns>
+	uint32_t addImage(VkImageView view, VkSampler sampler, VkImageLayout image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	/// <summary>
+	/// Point an existing image slot at a different view, e.g. once more of its mip levels are resident.
+	/// The previous view must stay alive until the frames in flight have completed
+	/// </summary>
+	void updateImage(uint32_t index, VkImageView view, VkSampler sampler, VkImageLayout image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void removeBuffer(uint32_t index) { buffer_slots.release(index, frame_counter); }
+	void removeImage(uint32_t index) { image_slots.release(index, frame_counter); }
+
+	/// <summary>
+	/// Mark the start of a new frame, making slots freed frame_count frames ago available again
+	/// </summary>
+	void beginFrame();
+	/// <summary>
+	/// Bind the set, which only needs to happen once per command buffer and pipeline layout
+	/// </summary>
+	void bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout pipeline_layout, uint32_t set_index);
+
+	VkDescriptorSetLayout getLayout() { return layout; }
+	VkDescriptorSet getSet() { return set; }
+	uint32_t getBufferCapacity() { return buffer_slots.capacity; }
+	uint32_t getImageCapacity() { return image_slots.capacity; }
+
+private:
+	/// <summary>
+	/// Free list of array slots whose release is deferred until frames that may still read them have completed
+	/// </summary>
+	struct SlotAllocator {
+		uint32_t capacity = 0;
+		uint32_t next_unused = 0;
+		std::vector<uint32_t> free_slots;
+		std::vector<std::pair<uint32_t, uint64_t>> retired_slots; // Slot and the frame it was released in
+
+		uint32_t acquire();
+		void release(uint32_t slot, uint64_t frame) { retired_slots.push_back({ slot, frame }); }
+		void recycle(uint64_t completed_frame);
+	};
+
+	LogicalDevice& device;
+	uint32_t frame_count;
+	uint64_t frame_counter = 0;
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	SlotAllocator buffer_slots;
+	SlotAllocator image_slots;
+};
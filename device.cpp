@@ -2,22 +2,35 @@
 #include "device.hpp"
 
 #include <algorithm>
+#include <cstdlib>
+#include <iostream>
 #include <set>
+#include <string>
 #include <stdexcept>
 
-LogicalDevice::LogicalDevice(Window& window) : window{ window } {
+LogicalDevice::LogicalDevice(Window* window, const std::string& device_override) : window{ window }, device_override{ device_override } {
+	if (!isHeadless()) device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
 	createInstance();
 	setupDebugMessenger();
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	memory_tracker.init(physical_device, enabled_features.memory_budget);
 	createCommandPool();
+	queryTextureFormats();
 }
 
 LogicalDevice::~LogicalDevice() {
+	// Everything allocated should have been freed by the objects owning it by now
+	size_t leaked = memory_tracker.getLiveAllocationCount();
+	if (leaked > 0) {
+		std::cerr << "Warning: " << leaked << " device memory allocations were never freed" << std::endl;
+		MemoryTracker::print(std::cerr, memory_tracker.snapshot());
+	}
 	vkDestroyCommandPool(device_, command_pool, nullptr);
 	vkDestroyDevice(device_, nullptr);
-	vkDestroySurfaceKHR(instance, surface_, nullptr);
+	if (surface_ != VK_NULL_HANDLE) vkDestroySurfaceKHR(instance, surface_, nullptr);
 	if (enable_validation_layers) DebugUtils::destroyDebugUtilsMessengerEXT(instance, debug_messenger, nullptr);
 	vkDestroyInstance(instance, nullptr);
 }
@@ -79,7 +92,10 @@ LogicalDevice::setupDebugMessenger() {
 }
 
 void
-LogicalDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+LogicalDevice::createSurface() {
+	if (isHeadless()) return; // Offscreen rendering has nothing to present to
+	window->createWindowSurface(instance, &surface_);
+}
 
 void
 LogicalDevice::pickPhysicalDevice() {
@@ -91,7 +107,10 @@ LogicalDevice::pickPhysicalDevice() {
 	vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
 
 	physical_device = findSuitableDevice(devices.data(), devices.size());
-	if (physical_device == VK_NULL_HANDLE) throw std::runtime_error("Failed to find a suitable GPU");
+	if (physical_device == VK_NULL_HANDLE) {
+		throw std::runtime_error(device_override.empty() ? "Failed to find a suitable GPU" : "Failed to find a suitable GPU matching \"" + device_override + "\"");
+	}
+	vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
 }
 
 void 
@@ -101,7 +120,8 @@ LogicalDevice::createLogicalDevice() {
 
 	// Create one queue per queue family type
 	std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-	std::set<uint32_t> unique_family_indices = { indices.graphics_family.value(), indices.present_family.value() };
+	std::set<uint32_t> unique_family_indices = { indices.graphics_family.value() };
+	if (indices.present_family.has_value()) unique_family_indices.insert(indices.present_family.value());
 	for (uint32_t family_index : unique_family_indices) {
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -111,17 +131,70 @@ LogicalDevice::createLogicalDevice() {
 		queue_create_infos.push_back(queueCreateInfo);
 	}
 
-	// No particular device features are needed
-	VkPhysicalDeviceFeatures device_features{};
+	// Query optional features, Vulkan 1.2 features can only be chained if the device itself supports 1.2
+	bool vulkan_1_2 = physical_device_properties.apiVersion >= VK_API_VERSION_1_2;
+	VkPhysicalDeviceVulkan12Features supported_12_features{};
+	supported_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supported_features{};
+	supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supported_features.pNext = vulkan_1_2 ? &supported_12_features : nullptr;
+	vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+
+	// Enable only the optional features that are supported, the renderer falls back when one is missing
+	enabled_features.multi_draw_indirect = supported_features.features.multiDrawIndirect;
+	enabled_features.draw_indirect_first_instance = supported_features.features.drawIndirectFirstInstance;
+	enabled_features.draw_indirect_count = vulkan_1_2 && supported_12_features.drawIndirectCount;
+	enabled_features.descriptor_indexing = vulkan_1_2 &&
+		supported_12_features.runtimeDescriptorArray &&
+		supported_12_features.descriptorBindingPartiallyBound &&
+		supported_12_features.descriptorBindingVariableDescriptorCount &&
+		supported_12_features.descriptorBindingStorageBufferUpdateAfterBind &&
+		supported_12_features.descriptorBindingSampledImageUpdateAfterBind &&
+		supported_12_features.descriptorBindingUpdateUnusedWhilePending &&
+		supported_12_features.shaderStorageBufferArrayNonUniformIndexing &&
+		supported_12_features.shaderSampledImageArrayNonUniformIndexing;
+	enabled_features.texture_compression_bc = supported_features.features.textureCompressionBC;
+	enabled_features.texture_compression_astc_ldr = supported_features.features.textureCompressionASTC_LDR;
+	enabled_features.pipeline_statistics_query = supported_features.features.pipelineStatisticsQuery;
+
+	// Querying the budget needs vkGetPhysicalDeviceMemoryProperties2, core since 1.1
+	std::vector<const char*> extensions = device_extensions;
+	enabled_features.memory_budget = physical_device_properties.apiVersion >= VK_API_VERSION_1_1 &&
+		supportsDeviceExtension(physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (enabled_features.memory_budget) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+	VkPhysicalDeviceVulkan12Features device_12_features{};
+	device_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	device_12_features.drawIndirectCount = enabled_features.draw_indirect_count;
+	if (enabled_features.descriptor_indexing) {
+		device_12_features.descriptorIndexing = supported_12_features.descriptorIndexing;
+		device_12_features.runtimeDescriptorArray = VK_TRUE;
+		device_12_features.descriptorBindingPartiallyBound = VK_TRUE;
+		device_12_features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		device_12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		device_12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		device_12_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		device_12_features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+		device_12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	}
+	VkPhysicalDeviceFeatures2 device_features{};
+	device_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	device_features.pNext = vulkan_1_2 ? &device_12_features : nullptr;
+	device_features.features.multiDrawIndirect = enabled_features.multi_draw_indirect;
+	device_features.features.drawIndirectFirstInstance = enabled_features.draw_indirect_first_instance;
+	device_features.features.textureCompressionBC = enabled_features.texture_compression_bc;
+	device_features.features.textureCompressionASTC_LDR = enabled_features.texture_compression_astc_ldr;
+	device_features.features.pipelineStatisticsQuery = enabled_features.pipeline_statistics_query;
 
 	// Specify properties for logical device creation
 	VkDeviceCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	create_info.pNext = &device_features; // Features are passed through the pNext chain so 1.2 features can be included
 	create_info.pQueueCreateInfos = queue_create_infos.data();
 	create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
-	create_info.pEnabledFeatures = &device_features;
-	create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-	create_info.ppEnabledExtensionNames = device_extensions.data();
+	create_info.pEnabledFeatures = nullptr;
+	create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	create_info.ppEnabledExtensionNames = extensions.data();
 	if (enable_validation_layers) {
 		create_info.enabledLayerCount = static_cast<uint32_t>(validation_layers.size());
 		create_info.ppEnabledLayerNames = validation_layers.data();
@@ -134,7 +207,7 @@ LogicalDevice::createLogicalDevice() {
 
 	// Populate handles for the graphics and present queues
 	vkGetDeviceQueue(device_, indices.graphics_family.value(), 0, &graphics_queue_);
-	vkGetDeviceQueue(device_, indices.present_family.value(), 0, &present_queue_);
+	if (indices.present_family.has_value()) vkGetDeviceQueue(device_, indices.present_family.value(), 0, &present_queue_);
 }
 
 void
@@ -151,6 +224,29 @@ LogicalDevice::createCommandPool() {
 	}
 }
 
+void
+LogicalDevice::queryTextureFormats() {
+	std::vector<VkFormat> candidates = { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB };
+	// Compressed formats are only usable with their feature enabled, even if format properties report support
+	if (enabled_features.texture_compression_bc) {
+		for (int format = VK_FORMAT_BC1_RGB_UNORM_BLOCK; format <= VK_FORMAT_BC7_SRGB_BLOCK; format++) candidates.push_back(static_cast<VkFormat>(format));
+	}
+	if (enabled_features.texture_compression_astc_ldr) {
+		for (int format = VK_FORMAT_ASTC_4x4_UNORM_BLOCK; format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK; format++) candidates.push_back(static_cast<VkFormat>(format));
+	}
+
+	constexpr VkFormatFeatureFlags required_features =
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+		VK_FORMAT_FEATURE_TRANSFER_SRC_BIT |
+		VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	for (VkFormat format : candidates) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+		if ((properties.optimalTilingFeatures & required_features) == required_features) texture_formats.push_back(format);
+	}
+}
+
 bool
 LogicalDevice::checkValidationLayerSupport() {
 	uint32_t layer_count;
@@ -175,11 +271,14 @@ LogicalDevice::checkValidationLayerSupport() {
 
 std::vector<const char*>
 LogicalDevice::getRequiredExtensions() {
-	// Extensions required by GLFW
-	uint32_t glfw_extension_count = 0;
-	const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+	std::vector<const char*> extensions;
 
-	std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+	// Extensions required by GLFW (GLFW is never initialised when headless, so there are none)
+	if (!isHeadless()) {
+		uint32_t glfw_extension_count = 0;
+		const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+		extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+	}
 
 	// Validation layers debug utils extension
 	if (enable_validation_layers) { extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); }
@@ -189,10 +288,34 @@ LogicalDevice::getRequiredExtensions() {
 
 VkPhysicalDevice
 LogicalDevice::findSuitableDevice(VkPhysicalDevice* devices, size_t device_count) {
+	std::vector<DeviceCandidate> candidates(device_count);
 	for (uint32_t counter = 0; counter < device_count; counter++) {
-		if (LogicalDevice::isDeviceSuitable(devices[counter], surface_)) return devices[counter];
+		DeviceCandidate& candidate = candidates[counter];
+		vkGetPhysicalDeviceProperties(devices[counter], &candidate.properties);
+		vkGetPhysicalDeviceMemoryProperties(devices[counter], &candidate.memory_properties);
+		vkGetPhysicalDeviceFeatures(devices[counter], &candidate.features);
+		candidate.has_uuid = candidate.properties.apiVersion >= VK_API_VERSION_1_1;
+		if (candidate.has_uuid) {
+			VkPhysicalDeviceIDProperties id_properties{};
+			id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+			VkPhysicalDeviceProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &id_properties;
+			vkGetPhysicalDeviceProperties2(devices[counter], &properties);
+			std::copy(std::begin(id_properties.deviceUUID), std::end(id_properties.deviceUUID), candidate.uuid);
+		}
+		candidate.suitable = LogicalDevice::isDeviceSuitable(devices[counter], surface_);
 	}
-	return VK_NULL_HANDLE;
+
+	// An explicit override takes precedence over the environment
+	if (device_override.empty()) {
+		const char* variable = std::getenv(DeviceSelectionUtils::OVERRIDE_VARIABLE);
+		if (variable != nullptr) device_override = variable;
+	}
+
+	std::cerr << "Physical devices:\n";
+	std::optional<size_t> chosen = DeviceSelectionUtils::choose(candidates, device_override, std::cerr);
+	return chosen ? devices[*chosen] : VK_NULL_HANDLE;
 }
 
 QueueFamilyIndices
@@ -207,13 +330,15 @@ LogicalDevice::findQueueFamilies(VkPhysicalDevice device) {
 	// Find first queue families supporting needed functions
 	uint32_t i = 0;
 	for (auto& queue_family : queue_families) {
-		if (indices.isComplete()) break;
+		if (indices.isComplete(!isHeadless())) break;
 
 		if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphics_family = i;
 
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-		if (presentSupport) indices.present_family = i;
+		if (!isHeadless()) {
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			if (presentSupport) indices.present_family = i;
+		}
 
 		i++;
 	}
@@ -255,14 +380,14 @@ LogicalDevice::isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR& surface)
 	// Required device extensions exist
 	bool extensions_supported = LogicalDevice::checkDeviceExtensionSupport(device);
 
-	// At least a single image format and a single presentation mode exist
-	bool swap_chain_adequate = false;
-	if (extensions_supported) {
+	// At least a single image format and a single presentation mode exist (offscreen images need no surface support)
+	bool swap_chain_adequate = isHeadless();
+	if (extensions_supported && !isHeadless()) {
 		SwapChainSupportDetails swap_chain_support = LogicalDevice::querySwapChainSupport(device);
 		swap_chain_adequate = !swap_chain_support.formats.empty() && !swap_chain_support.present_modes.empty();
 	}
 
-	return indices.isComplete() && extensions_supported && swap_chain_adequate;
+	return indices.isComplete(!isHeadless()) && extensions_supported && swap_chain_adequate;
 }
 
 bool
@@ -279,6 +404,15 @@ LogicalDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	return required_extensions.empty();
 }
 
+bool
+LogicalDevice::supportsDeviceExtension(VkPhysicalDevice device, const char* extension) {
+	uint32_t extension_count;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
+	return std::any_of(extensions.begin(), extensions.end(), [extension](const VkExtensionProperties& properties) { return strcmp(properties.extensionName, extension) == 0; });
+}
+
 uint32_t
 LogicalDevice::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) {
 	VkPhysicalDeviceMemoryProperties mem_properties;
@@ -294,11 +428,70 @@ LogicalDevice::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags proper
 	throw std::runtime_error("Failed to find suitable memory type");
 }
 
+bool
+LogicalDevice::hasMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+	VkPhysicalDeviceMemoryProperties mem_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+
+	for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+		if (type_filter & (1 << i) &&
+			(mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return true;
+		}
+	}
+	return false;
+}
+
+VkSampleCountFlagBits
+LogicalDevice::getMaxUsableSampleCount() {
+	VkSampleCountFlags counts = physical_device_properties.limits.framebufferColorSampleCounts & physical_device_properties.limits.framebufferDepthSampleCounts;
+	for (VkSampleCountFlagBits count : { VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT, VK_SAMPLE_COUNT_16_BIT, VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT }) {
+		if (counts & count) return count;
+	}
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
+VkFormat
+LogicalDevice::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+	for (VkFormat format : candidates) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+		VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+		if ((supported & features) == features) return format;
+	}
+
+	throw std::runtime_error("Failed to find supported format");
+}
+
+VkDeviceMemory
+LogicalDevice::allocateMemory(VkDeviceSize size, uint32_t memory_type, MemoryCategory category) {
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = memory_type;
+	VkDeviceMemory memory;
+	VkResult result = vkAllocateMemory(device_, &alloc_info, nullptr, &memory);
+	if (result != VK_SUCCESS) {
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) MemoryTracker::print(std::cerr, memory_tracker.snapshot());
+		throw std::runtime_error(std::string("Failed to allocate ") + std::to_string(size) + " bytes of " + MemoryTracker::categoryName(category) + " memory on Vulkan device");
+	}
+	memory_tracker.recordAllocation(memory, size, memory_type, category);
+	return memory;
+}
+
+void
+LogicalDevice::freeMemory(VkDeviceMemory memory) {
+	if (memory == VK_NULL_HANDLE) return;
+	memory_tracker.recordFree(memory);
+	vkFreeMemory(device_, memory, nullptr);
+}
+
 void
 LogicalDevice::createBuffer(
 	VkDeviceSize size,
 	VkBufferUsageFlags usage,
 	VkMemoryPropertyFlags properties,
+	MemoryCategory category,
 	VkBuffer& buffer,
 	VkDeviceMemory& buffer_memory) {
 	// Create the logical buffer itself
@@ -316,17 +509,34 @@ LogicalDevice::createBuffer(
 	vkGetBufferMemoryRequirements(device_, buffer, &mem_requirements);
 
 	// Allocate the underlying memory utilised by the buffer
-	VkMemoryAllocateInfo mem_alloc_info{};
-	mem_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	mem_alloc_info.allocationSize = mem_requirements.size;
-	mem_alloc_info.memoryTypeIndex = findMemoryType(mem_requirements.memoryTypeBits, properties);
-	if (vkAllocateMemory(device_, &mem_alloc_info, nullptr, &buffer_memory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate memory on Vulkan device");
-	}
+	buffer_memory = allocateMemory(mem_requirements.size, findMemoryType(mem_requirements.memoryTypeBits, properties), category);
 
 	vkBindBufferMemory(device_, buffer, buffer_memory, 0); // Connect buffer to underlying memory
 }
 
+void
+LogicalDevice::createImageWithInfo(
+	const VkImageCreateInfo& image_info,
+	VkMemoryPropertyFlags properties,
+	MemoryCategory category,
+	VkImage& image,
+	VkDeviceMemory& image_memory) {
+	if (vkCreateImage(device_, &image_info, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create image on Vulkan device");
+	}
+
+	// Acquire requirements of underlying memory needed by image
+	VkMemoryRequirements mem_requirements;
+	vkGetImageMemoryRequirements(device_, image, &mem_requirements);
+
+	// Allocate the underlying memory utilised by the image
+	image_memory = allocateMemory(mem_requirements.size, findMemoryType(mem_requirements.memoryTypeBits, properties), category);
+
+	if (vkBindImageMemory(device_, image, image_memory, 0) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to bind image memory");
+	}
+}
+
 VkCommandBuffer
 LogicalDevice::beginSingleTimeCommands() {
 	VkCommandBufferAllocateInfo alloc_info{};
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "device_selection.hpp"
+#include "memory_tracker.hpp"
 #include "window.hpp"
 
+#include <algorithm>
 #include <optional>
+#include <string>
 #include <vector>
 
 /// <summary>
@@ -15,8 +19,9 @@ struct QueueFamilyIndices {
 	/// <summary>
 	/// Determines whether all needed families are present
 	/// </summary>
+	/// <param name="needs_present">Whether a present family is required (false when rendering headless)</param>
 	/// <returns>Indication if an index exists for each member family</returns>
-	bool isComplete() { return graphics_family.has_value() && present_family.has_value(); }
+	bool isComplete(bool needs_present = true) { return graphics_family.has_value() && (present_family.has_value() || !needs_present); }
 };
 
 /// <summary>
@@ -28,6 +33,44 @@ struct SwapChainSupportDetails {
 	std::vector<VkPresentModeKHR> present_modes;
 };
 
+/// <summary>
+/// Optional device features, each enabled on the logical device when the physical device supports it
+/// </summary>
+struct EnabledFeatures {
+	/// <summary>
+	/// More than one draw per vkCmdDraw*Indirect call
+	/// </summary>
+	bool multi_draw_indirect = false;
+	/// <summary>
+	/// Non-zero firstInstance in indirect draw commands
+	/// </summary>
+	bool draw_indirect_first_instance = false;
+	/// <summary>
+	/// vkCmdDraw*IndirectCount, taking the draw count from a buffer (Vulkan 1.2)
+	/// </summary>
+	bool draw_indirect_count = false;
+	/// <summary>
+	/// Runtime-sized, partially bound, update-after-bind descriptor arrays indexed non-uniformly (Vulkan 1.2 descriptor indexing)
+	/// </summary>
+	bool descriptor_indexing = false;
+	/// <summary>
+	/// Sampling BC1-BC7 block compressed images
+	/// </summary>
+	bool texture_compression_bc = false;
+	/// <summary>
+	/// Sampling ASTC LDR block compressed images
+	/// </summary>
+	bool texture_compression_astc_ldr = false;
+	/// <summary>
+	/// Pipeline statistics queries, used to count fragment shader invocations
+	/// </summary>
+	bool pipeline_statistics_query = false;
+	/// <summary>
+	/// Per-heap budgets and usage reported by the driver (VK_EXT_memory_budget)
+	/// </summary>
+	bool memory_budget = false;
+};
+
 /// <summary>
 /// Class for managing device resources and functionality
 /// </summary>
@@ -35,14 +78,30 @@ class LogicalDevice {
 public:
 	VkPhysicalDeviceProperties physical_device_properties;
 
-	LogicalDevice(Window& window);
+	/// <summary>
+	/// Creates the Vulkan instance and logical device
+	/// </summary>
+	/// <param name="window">Window to present to, or nullptr to run headless (no surface, no swapchain extension and no GLFW)</param>
+	/// <param name="device_override">Name or UUID of the physical device to use, taking precedence over the
+	/// VULKAN_TUTORIAL_DEVICE environment variable (empty picks the highest scoring device)</param>
+	LogicalDevice(Window* window, const std::string& device_override = "");
 	~LogicalDevice();
 
+	bool isHeadless() { return window == nullptr; }
+
 	VkDevice getDevice() { return device_; }
+	VkPhysicalDevice getPhysicalDevice() { return physical_device; }
 	VkSurfaceKHR getSurface() { return surface_; }
 	VkQueue getGraphicsQueue() { return graphics_queue_; }
 	VkQueue getPresentQueue() { return present_queue_; }
 	VkCommandPool getCommandPool() { return command_pool; }
+	const EnabledFeatures& getEnabledFeatures() { return enabled_features; }
+	MemoryTracker& getMemoryTracker() { return memory_tracker; }
+	/// <summary>
+	/// Whether textures of the given format can be uploaded, copied between and sampled, as found during device setup.
+	/// Only RGBA8 and the BCn and ASTC LDR formats are considered
+	/// </summary>
+	bool supportsTextureFormat(VkFormat format) { return std::find(texture_formats.begin(), texture_formats.end(), format) != texture_formats.end(); }
 
 	// Device properties
 	/// <summary>
@@ -52,9 +111,40 @@ public:
 	/// <param name="properties">Bitmask filter that specifies properties that the memory type must have</param>
 	/// <returns>Index of the memory type within the physical device memory type array</returns>
 	uint32_t findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties);
+	/// <summary>
+	/// Whether any of the filtered memory types has the given properties (e.g. lazily allocated memory, absent on most desktop GPUs)
+	/// </summary>
+	bool hasMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties);
+	/// <summary>
+	/// Highest sample count colour and depth attachments both support
+	/// </summary>
+	VkSampleCountFlagBits getMaxUsableSampleCount();
+	/// <summary>
+	/// Find the first of the given formats supporting the given features with the given tiling
+	/// </summary>
+	/// <param name="candidates">Formats to check, in order of preference</param>
+	/// <param name="tiling">Tiling the images of this format will use</param>
+	/// <param name="features">Features the format must support with that tiling</param>
+	/// <returns>The first supported candidate</returns>
+	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physical_device); }
 	SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physical_device); }
 
+	// Memory functionality
+	/// <summary>
+	/// Allocate device memory, accounting for it in the memory tracker.
+	/// All device memory should be allocated and freed through this and <c>freeMemory</c>
+	/// </summary>
+	/// <param name="size">Number of bytes to allocate</param>
+	/// <param name="memory_type">Index of the memory type to allocate from</param>
+	/// <param name="category">What the memory will hold</param>
+	/// <returns>The allocated memory</returns>
+	VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memory_type, MemoryCategory category);
+	/// <summary>
+	/// Free memory allocated by <c>allocateMemory</c>, ignoring null handles
+	/// </summary>
+	void freeMemory(VkDeviceMemory memory);
+
 	// Buffer functionality
 	/// <summary>
 	/// Creates a buffer on this device.
@@ -62,15 +152,31 @@ public:
 	/// <param name="size">Size of the buffer in byes</param>
 	/// <param name="usage">Flags specifying what the buffer will be used for</param>
 	/// <param name="properties">Bit mask of properties that the underlying memory of the buffer should have</param>
+	/// <param name="category">What the buffer will hold, for memory tracking</param>
 	/// <param name="buffer">Buffer object to allocate to</param>
 	/// <param name="buffer_memory">Buffer memory object to allocate to</param>
 	void createBuffer(
 		VkDeviceSize size,
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
+		MemoryCategory category,
 		VkBuffer& buffer,
 		VkDeviceMemory& buffer_memory);
 	/// <summary>
+	/// Creates an image on this device and binds freshly allocated memory to it
+	/// </summary>
+	/// <param name="image_info">Fully populated image creation info</param>
+	/// <param name="properties">Bit mask of properties that the underlying memory of the image should have</param>
+	/// <param name="category">What the image will hold, for memory tracking</param>
+	/// <param name="image">Image object to allocate to</param>
+	/// <param name="image_memory">Image memory object to allocate to</param>
+	void createImageWithInfo(
+		const VkImageCreateInfo& image_info,
+		VkMemoryPropertyFlags properties,
+		MemoryCategory category,
+		VkImage& image,
+		VkDeviceMemory& image_memory);
+	/// <summary>
 	/// Allocate and fill begin info for a command buffer intended to be executed only once
 	/// </summary>
 	/// <returns>An allocated command buffer with suitable single usage begin info</returns>
@@ -96,20 +202,24 @@ private:
 #else
 	const bool enable_validation_layers = true;
 #endif
-	const std::vector<const char*> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	std::vector<const char*> device_extensions; // Swapchain extension is added when a window is present
 	const std::vector<const char*> validation_layers = { "VK_LAYER_KHRONOS_validation" };
 
 	VkInstance instance;
 	VkDebugUtilsMessengerEXT debug_messenger;
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
-	Window& window;
+	Window* window;
+	std::string device_override;
 
 	VkDevice device_;
-	VkSurfaceKHR surface_;
+	VkSurfaceKHR surface_ = VK_NULL_HANDLE;
 	VkQueue graphics_queue_;
-	VkQueue present_queue_;
+	VkQueue present_queue_ = VK_NULL_HANDLE;
 
 	VkCommandPool command_pool;
+	EnabledFeatures enabled_features;
+	std::vector<VkFormat> texture_formats;
+	MemoryTracker memory_tracker;
 
 	void createInstance();
 	void setupDebugMessenger();
@@ -117,6 +227,10 @@ private:
 	void pickPhysicalDevice();
 	void createLogicalDevice();
 	void createCommandPool();
+	/// <summary>
+	/// Find the candidate texture formats whose images support transfers and sampling on this device
+	/// </summary>
+	void queryTextureFormats();
 
 	/// <summary>
 	/// Verify that all required validation layers (as specified in <c>validation_layers</c> are present
@@ -125,17 +239,16 @@ private:
 	bool checkValidationLayerSupport();
 	/// <summary>
 	/// Acquires a list of needed extensions based on <c>device_extensions</c>,
-	/// the extensions needed by GLFW and (if enabled) the extensions needed for debug validation layers
+	/// the extensions needed by GLFW (skipped when headless) and (if enabled) the extensions needed for debug validation layers
 	/// </summary>
 	/// <returns>String vector containing names of needed extensions</returns>
 	std::vector<const char*> getRequiredExtensions();
 	/// <summary>
-	/// Fetches a suitable device according to certain requirements.
-	/// See <c>isDeviceSuitable</c>
+	/// Fetches the highest scoring device of those satisfying certain requirements, or the one named by the override.
+	/// See <c>isDeviceSuitable</c> and <c>DeviceSelectionUtils::score</c>
 	/// </summary>
 	/// <param name="devices">Array of available devices to select from</param>
 	/// <param name="device_count">Number of devices in the given array</param>
-	/// <param name="surface">Surface to be rendered to</param>
 	/// <returns>Handle for a device that satisfies the established requirements</returns>
 	VkPhysicalDevice findSuitableDevice(VkPhysicalDevice* devices, size_t device_count);
 	/// <summary>
@@ -159,6 +272,7 @@ private:
 	///		The device extensions contained in <c>device_extensions</c> exist -
 	///		At least a single image format and presentation format exist
 	/// )
+	/// When headless only the graphics queue family is required
 	/// </summary>
 	/// <param name="device">Device to evaluate suitability of</param>
 	/// <param name="surface">Surface to be rendered to use for fetching properties</param>
@@ -170,4 +284,8 @@ private:
 	/// <param name="device">Device to check extension support for</param>
 	/// <returns>Indication if device supports these extensions</returns>
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	/// <summary>
+	/// Check that the given device supports a single (optional) extension
+	/// </summary>
+	bool supportsDeviceExtension(VkPhysicalDevice device, const char* extension);
 };
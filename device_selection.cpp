@@ -0,0 +1,97 @@
+#include "device_selection.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+
+uint64_t
+DeviceSelectionUtils::score(const DeviceCandidate& candidate) {
+	// Each type outweighs anything the remaining criteria can add up to
+	constexpr uint64_t TYPE_WEIGHT = 1ull << 32;
+	uint64_t type_rank;
+	switch (candidate.properties.deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: type_rank = 4; break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: type_rank = 3; break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: type_rank = 2; break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: type_rank = 0; break;
+	default: type_rank = 1; break;
+	}
+	uint64_t result = type_rank * TYPE_WEIGHT;
+
+	// Device local memory in MiB, capped at 1 TiB so it cannot overflow into the type
+	result += std::min<uint64_t>(deviceLocalMemory(candidate.memory_properties) >> 20, 1ull << 20) << 10;
+
+	// Optional features the renderer falls back without, and limits bounding texture and attachment sizes
+	const VkPhysicalDeviceFeatures& features = candidate.features;
+	uint64_t feature_count = 0;
+	feature_count += features.multiDrawIndirect;
+	feature_count += features.drawIndirectFirstInstance;
+	feature_count += features.textureCompressionBC || features.textureCompressionASTC_LDR;
+	feature_count += features.pipelineStatisticsQuery;
+	feature_count += candidate.properties.apiVersion >= VK_API_VERSION_1_2; // Indirect count and descriptor indexing
+	result += feature_count << 5;
+	result += std::min<uint64_t>(candidate.properties.limits.maxImageDimension2D >> 10, 31);
+	return result;
+}
+
+VkDeviceSize
+DeviceSelectionUtils::deviceLocalMemory(const VkPhysicalDeviceMemoryProperties& memory_properties) {
+	VkDeviceSize largest = 0;
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+		if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) largest = std::max(largest, memory_properties.memoryHeaps[i].size);
+	}
+	return largest;
+}
+
+std::string
+DeviceSelectionUtils::formatUuid(const uint8_t uuid[VK_UUID_SIZE]) {
+	std::ostringstream result;
+	result << std::hex << std::setfill('0');
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+		if (i == 4 || i == 6 || i == 8 || i == 10) result << '-';
+		result << std::setw(2) << static_cast<uint32_t>(uuid[i]);
+	}
+	return result.str();
+}
+
+bool
+DeviceSelectionUtils::matchesOverride(const DeviceCandidate& candidate, const std::string& device_override) {
+	auto lowered = [](std::string text, bool strip_dashes) {
+		if (strip_dashes) text.erase(std::remove(text.begin(), text.end(), '-'), text.end());
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return text;
+	};
+
+	if (candidate.has_uuid && lowered(device_override, true) == lowered(formatUuid(candidate.uuid), true)) return true;
+	return lowered(candidate.properties.deviceName, false).find(lowered(device_override, false)) != std::string::npos;
+}
+
+std::optional<size_t>
+DeviceSelectionUtils::choose(const std::vector<DeviceCandidate>& candidates, const std::string& device_override, std::ostream& log) {
+	std::optional<size_t> chosen;
+	uint64_t chosen_score = 0;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		const DeviceCandidate& candidate = candidates[i];
+		uint64_t candidate_score = score(candidate);
+		bool matches = device_override.empty() || matchesOverride(candidate, device_override);
+
+		log << "  [" << i << "] " << candidate.properties.deviceName;
+		if (candidate.has_uuid) log << " (" << formatUuid(candidate.uuid) << ")";
+		if (!candidate.suitable) log << ": unsuitable\n";
+		else if (!matches) log << ": does not match override\n";
+		else log << ": score " << candidate_score << "\n";
+
+		// Ties keep the device enumerated first
+		if (candidate.suitable && matches && (!chosen || candidate_score > chosen_score)) {
+			chosen = i;
+			chosen_score = candidate_score;
+		}
+	}
+
+	if (chosen) {
+		log << "Using " << candidates[*chosen].properties.deviceName
+			<< (device_override.empty() ? " (highest score)" : " (matches override \"" + device_override + "\")") << std::endl;
+	}
+	return chosen;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "window.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// What is known about a physical device when choosing which one to render with.
+/// Plain data so that selection can be exercised without a Vulkan instance
+/// </summary>
+struct DeviceCandidate {
+	VkPhysicalDeviceProperties properties;
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkPhysicalDeviceFeatures features;
+	uint8_t uuid[VK_UUID_SIZE];
+	bool has_uuid = false; // Device UUIDs need Vulkan 1.1
+	/// <summary>
+	/// Whether the device meets the renderer's hard requirements (queues, extensions, presentation)
+	/// </summary>
+	bool suitable = false;
+};
+
+/// <summary>
+/// Ranks physical devices, preferring discrete GPUs over integrated ones over virtual GPUs over software rasterisers,
+/// then more device local memory, higher limits and more of the optional features the renderer makes use of
+/// </summary>
+class DeviceSelectionUtils {
+public:
+	/// <summary>
+	/// Environment variable naming the device to use, by (part of its) name or by UUID
+	/// </summary>
+	static constexpr const char* OVERRIDE_VARIABLE = "VULKAN_TUTORIAL_DEVICE";
+
+	/// <summary>
+	/// Preference for the given device, higher is better. Device type dominates, so that e.g. an integrated GPU
+	/// reporting its shared system memory as device local is never preferred over a discrete one
+	/// </summary>
+	static uint64_t score(const DeviceCandidate& candidate);
+	/// <summary>
+	/// Size of the largest device local heap
+	/// </summary>
+	static VkDeviceSize deviceLocalMemory(const VkPhysicalDeviceMemoryProperties& memory_properties);
+	/// <summary>
+	/// Format a UUID as 32 lowercase hexadecimal digits in the canonical 8-4-4-4-12 grouping
+	/// </summary>
+	static std::string formatUuid(const uint8_t uuid[VK_UUID_SIZE]);
+	/// <summary>
+	/// Whether the device is the one named by an override, either by UUID (dashes optional, case insensitive)
+	/// or by a case insensitive substring of its name
+	/// </summary>
+	static bool matchesOverride(const DeviceCandidate& candidate, const std::string& device_override);
+	/// <summary>
+	/// Pick the device to render with, logging every candidate's score and the decision
+	/// </summary>
+	/// <param name="candidates">Devices in enumeration order, which breaks ties</param>
+	/// <param name="device_override">Name or UUID of the device to use regardless of score (empty to pick by score)</param>
+	/// <param name="log">Stream the decision is written to</param>
+	/// <returns>Index of the chosen candidate, empty if no suitable candidate (matching the override) exists</returns>
+	static std::optional<size_t> choose(const std::vector<DeviceCandidate>& candidates, const std::string& device_override, std::ostream& log);
+};
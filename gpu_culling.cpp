@@ -0,0 +1,360 @@
+#include "gpu_culling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace {
+	constexpr uint32_t STORAGE_BINDING_COUNT = 4; // Objects, input commands, output commands, draw counts
+	constexpr float VALIDATION_EPSILON = 1e-4f; // Relative distance to a plane within which GPU and CPU may disagree
+
+	using CommandKey = std::tuple<uint32_t, uint32_t, uint32_t, int32_t, uint32_t>;
+	CommandKey commandKey(const VkDrawIndexedIndirectCommand& command) {
+		return { command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance };
+	}
+}
+
+GpuCuller::GpuCuller(LogicalDevice& device, uint32_t frame_count, const std::string& comp_file_path, bool validate)
+	: device{ device },
+	compact{ device.getEnabledFeatures().draw_indirect_count },
+	validate{ validate },
+	objects{ device, frame_count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+	outputs(frame_count) {
+	createDescriptorSetLayout();
+	createPipelineLayout();
+	createDescriptorSets();
+	pipeline = std::make_unique<ComputePipeline>(device, comp_file_path, pipeline_layout);
+	createOutputBuffers();
+}
+
+GpuCuller::~GpuCuller() {
+	destroyOutputBuffers();
+	pipeline = nullptr;
+	vkDestroyPipelineLayout(device.getDevice(), pipeline_layout, nullptr);
+	vkDestroyDescriptorPool(device.getDevice(), descriptor_pool, nullptr); // Also frees the sets allocated from it
+	vkDestroyDescriptorSetLayout(device.getDevice(), descriptor_set_layout, nullptr);
+}
+
+void
+GpuCuller::resize(uint32_t command_count, uint32_t new_batch_count) {
+	validatePendingFrames(); // Read back buffers are about to be destroyed
+	objects.resize(command_count);
+	if (command_count > command_capacity || new_batch_count > batch_count) {
+		destroyOutputBuffers();
+		command_capacity = std::max(command_count, command_capacity);
+		batch_count = std::max(new_batch_count, batch_count);
+		createOutputBuffers();
+	}
+}
+
+void
+GpuCuller::setObject(uint32_t command, const CullObject& object) {
+	const CullObject& current = objects.get(command);
+	if (current.sphere == object.sphere && current.cone == object.cone && current.batch == object.batch && current.batch_first_command == object.batch_first_command) return;
+	objects.set(command, object);
+}
+
+void
+GpuCuller::record(VkCommandBuffer command_buffer, uint32_t frame, IndirectDrawBuffer& input_commands, const Frustum& frustum) {
+	FrameOutput& output = outputs[frame];
+	if (output.pending_validation) validateFrame(frame); // The frame's previous submission has completed
+
+	uint32_t object_count = objects.size();
+	objects.flush(frame);
+	updateDescriptorSet(frame, input_commands.getCommandsBuffer(frame));
+
+	// Counters are accumulated with atomics, so they start from zero every frame
+	vkCmdFillBuffer(command_buffer, output.counts, 0, VK_WHOLE_SIZE, 0);
+	VkMemoryBarrier clear_barrier{};
+	clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clear_barrier, 0, nullptr, 0, nullptr);
+
+	if (object_count > 0) {
+		CullParameters parameters{};
+		for (size_t i = 0; i < frustum.planes.size(); i++) parameters.frustum_planes[i] = frustum.planes[i];
+		parameters.camera = frustum.camera;
+		parameters.orientation = frustum.orientation;
+		parameters.object_count = object_count;
+		parameters.compact = compact ? 1 : 0;
+
+		pipeline->bind(command_buffer);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &output.descriptor_set, 0, nullptr);
+		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParameters), &parameters);
+		vkCmdDispatch(command_buffer, (object_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+	}
+
+	// Culled commands and counts are consumed by the indirect draws of the same command buffer (and copied out when validating)
+	VkMemoryBarrier cull_barrier{};
+	cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | (validate ? VK_ACCESS_TRANSFER_READ_BIT : 0);
+	VkPipelineStageFlags cull_destination = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | (validate ? VK_PIPELINE_STAGE_TRANSFER_BIT : 0);
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, cull_destination, 0, 1, &cull_barrier, 0, nullptr, 0, nullptr);
+
+	if (!validate) return;
+
+	VkDeviceSize commands_size = static_cast<VkDeviceSize>(std::max(command_capacity, 1u)) * sizeof(VkDrawIndexedIndirectCommand);
+	VkBufferCopy commands_copy{ 0, 0, commands_size };
+	VkBufferCopy counts_copy{ 0, commands_size, static_cast<VkDeviceSize>(std::max(batch_count, 1u)) * sizeof(uint32_t) };
+	vkCmdCopyBuffer(command_buffer, output.commands, output.readback, 1, &commands_copy);
+	vkCmdCopyBuffer(command_buffer, output.counts, output.readback, 1, &counts_copy);
+	VkMemoryBarrier readback_barrier{};
+	readback_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	readback_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	readback_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readback_barrier, 0, nullptr, 0, nullptr);
+
+	// Keep the inputs of this frame, the host copies may change before its results can be read
+	output.pending_validation = true;
+	output.validation_frustum = frustum;
+	output.validation_objects.resize(object_count);
+	output.validation_input.resize(object_count);
+	for (uint32_t i = 0; i < object_count; i++) {
+		output.validation_objects[i] = objects.get(i);
+		output.validation_input[i] = input_commands.getCommand(i);
+	}
+}
+
+void
+GpuCuller::draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t batch, uint32_t first_command, uint32_t max_draw_count) {
+	IndirectDrawBuffer::recordDraws(
+		device,
+		command_buffer,
+		outputs[frame].commands,
+		static_cast<VkDeviceSize>(first_command) * sizeof(VkDrawIndexedIndirectCommand),
+		outputs[frame].counts,
+		static_cast<VkDeviceSize>(batch) * sizeof(uint32_t),
+		max_draw_count);
+}
+
+void
+GpuCuller::validatePendingFrames() {
+	for (uint32_t frame = 0; frame < outputs.size(); frame++) {
+		if (outputs[frame].pending_validation) validateFrame(frame);
+	}
+}
+
+void
+GpuCuller::createDescriptorSetLayout() {
+	std::array<VkDescriptorSetLayoutBinding, STORAGE_BINDING_COUNT> bindings{};
+	for (uint32_t i = 0; i < STORAGE_BINDING_COUNT; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+	layout_info.pBindings = bindings.data();
+	if (vkCreateDescriptorSetLayout(device.getDevice(), &layout_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling descriptor set layout");
+	}
+}
+
+void
+GpuCuller::createPipelineLayout() {
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(CullParameters);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+	if (vkCreatePipelineLayout(device.getDevice(), &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling pipeline layout");
+	}
+}
+
+void
+GpuCuller::createDescriptorSets() {
+	uint32_t frame_count = static_cast<uint32_t>(outputs.size());
+	VkDescriptorPoolSize pool_size{};
+	pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_size.descriptorCount = STORAGE_BINDING_COUNT * frame_count;
+
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.maxSets = frame_count;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	if (vkCreateDescriptorPool(device.getDevice(), &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling descriptor pool");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(frame_count, descriptor_set_layout);
+	std::vector<VkDescriptorSet> sets(frame_count);
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = descriptor_pool;
+	alloc_info.descriptorSetCount = frame_count;
+	alloc_info.pSetLayouts = layouts.data();
+	if (vkAllocateDescriptorSets(device.getDevice(), &alloc_info, sets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate culling descriptor sets");
+	}
+	for (uint32_t frame = 0; frame < frame_count; frame++) outputs[frame].descriptor_set = sets[frame];
+}
+
+void
+GpuCuller::createOutputBuffers() {
+	VkDeviceSize commands_size = static_cast<VkDeviceSize>(std::max(command_capacity, 1u)) * sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize counts_size = static_cast<VkDeviceSize>(std::max(batch_count, 1u)) * sizeof(uint32_t);
+	VkBufferUsageFlags readback_usage = validate ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT : 0;
+
+	for (FrameOutput& output : outputs) {
+		// Only ever written and read by the GPU, so it can live in the fastest memory
+		device.createBuffer(
+			commands_size,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | readback_usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			MemoryCategory::Indirect,
+			output.commands,
+			output.commands_memory);
+		device.createBuffer(
+			counts_size,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | readback_usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			MemoryCategory::Indirect,
+			output.counts,
+			output.counts_memory);
+		if (validate) {
+			device.createBuffer(
+				commands_size + counts_size,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				MemoryCategory::Readback,
+				output.readback,
+				output.readback_memory);
+		}
+		output.bound_objects = VK_NULL_HANDLE; // Descriptor set must be pointed at the new buffers
+		output.bound_input = VK_NULL_HANDLE;
+	}
+}
+
+void
+GpuCuller::destroyOutputBuffers() {
+	for (FrameOutput& output : outputs) {
+		vkDestroyBuffer(device.getDevice(), output.commands, nullptr);
+		device.freeMemory(output.commands_memory);
+		vkDestroyBuffer(device.getDevice(), output.counts, nullptr);
+		device.freeMemory(output.counts_memory);
+		vkDestroyBuffer(device.getDevice(), output.readback, nullptr);
+		device.freeMemory(output.readback_memory);
+		output.commands = output.counts = output.readback = VK_NULL_HANDLE;
+		output.commands_memory = output.counts_memory = output.readback_memory = VK_NULL_HANDLE;
+		output.pending_validation = false;
+	}
+}
+
+void
+GpuCuller::updateDescriptorSet(uint32_t frame, VkBuffer input_commands) {
+	FrameOutput& output = outputs[frame];
+	VkBuffer objects_buffer = objects.getBuffer(frame);
+	if (output.bound_objects == objects_buffer && output.bound_input == input_commands) return;
+
+	std::array<VkDescriptorBufferInfo, STORAGE_BINDING_COUNT> buffer_infos{};
+	buffer_infos[0] = { objects_buffer, 0, VK_WHOLE_SIZE };
+	buffer_infos[1] = { input_commands, 0, VK_WHOLE_SIZE };
+	buffer_infos[2] = { output.commands, 0, VK_WHOLE_SIZE };
+	buffer_infos[3] = { output.counts, 0, VK_WHOLE_SIZE };
+
+	std::array<VkWriteDescriptorSet, STORAGE_BINDING_COUNT> writes{};
+	for (uint32_t i = 0; i < STORAGE_BINDING_COUNT; i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = output.descriptor_set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &buffer_infos[i];
+	}
+	vkUpdateDescriptorSets(device.getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	output.bound_objects = objects_buffer;
+	output.bound_input = input_commands;
+}
+
+void
+GpuCuller::validateFrame(uint32_t frame) {
+	FrameOutput& output = outputs[frame];
+	output.pending_validation = false;
+
+	VkDeviceSize commands_size = static_cast<VkDeviceSize>(std::max(command_capacity, 1u)) * sizeof(VkDrawIndexedIndirectCommand);
+	void* data;
+	if (vkMapMemory(device.getDevice(), output.readback_memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to map culling readback memory");
+	}
+	const auto* gpu_commands = static_cast<const VkDrawIndexedIndirectCommand*>(data);
+	const auto* gpu_counts = reinterpret_cast<const uint32_t*>(static_cast<const char*>(data) + commands_size);
+
+	// Classify every command with the CPU reference, commands too close to a plane may go either way due to float precision
+	const std::vector<CullObject>& cull_objects = output.validation_objects;
+	const std::vector<VkDrawIndexedIndirectCommand>& input = output.validation_input;
+	std::vector<bool> visible(cull_objects.size());
+	std::vector<bool> ambiguous(cull_objects.size());
+	for (size_t i = 0; i < cull_objects.size(); i++) {
+		const glm::vec4& sphere = cull_objects[i].sphere;
+		float margin = CullingUtils::visibilityMargin(output.validation_frustum, sphere);
+		float cone_margin = CullingUtils::coneMargin(output.validation_frustum, sphere, cull_objects[i].cone);
+		float tolerance = VALIDATION_EPSILON * std::max(1.0f, glm::length(glm::vec3(sphere)) + std::abs(sphere.w));
+		visible[i] = margin >= 0.0f && cone_margin >= 0.0f;
+		ambiguous[i] = (std::abs(margin) <= tolerance && cone_margin >= -tolerance) || (std::abs(cone_margin) <= tolerance && margin >= -tolerance);
+	}
+
+	std::string error;
+	if (compact) {
+		// Visible commands are packed in arbitrary order, so compare the contents of each batch as multisets
+		std::vector<std::multiset<CommandKey>> required(batch_count), allowed(batch_count);
+		std::vector<uint32_t> batch_first(batch_count, 0), batch_size(batch_count, 0);
+		for (size_t i = 0; i < cull_objects.size(); i++) {
+			uint32_t batch = cull_objects[i].batch;
+			batch_first[batch] = cull_objects[i].batch_first_command;
+			batch_size[batch]++;
+			if (ambiguous[i]) allowed[batch].insert(commandKey(input[i]));
+			else if (visible[i]) required[batch].insert(commandKey(input[i]));
+		}
+		for (uint32_t batch = 0; batch < batch_count && error.empty(); batch++) {
+			if (gpu_counts[batch] > batch_size[batch]) {
+				error = "batch " + std::to_string(batch) + " draws " + std::to_string(gpu_counts[batch]) + " of " + std::to_string(batch_size[batch]) + " commands";
+				break;
+			}
+			for (uint32_t slot = 0; slot < gpu_counts[batch]; slot++) {
+				CommandKey key = commandKey(gpu_commands[batch_first[batch] + slot]);
+				auto match = required[batch].find(key);
+				if (match != required[batch].end()) { required[batch].erase(match); continue; }
+				match = allowed[batch].find(key);
+				if (match != allowed[batch].end()) { allowed[batch].erase(match); continue; }
+				error = "batch " + std::to_string(batch) + " draws a culled or duplicated command";
+				break;
+			}
+			if (error.empty() && !required[batch].empty()) {
+				error = "batch " + std::to_string(batch) + " is missing " + std::to_string(required[batch].size()) + " visible commands";
+			}
+		}
+	} else {
+		// Commands keep their slot, culled ones have no instances
+		for (size_t i = 0; i < cull_objects.size() && error.empty(); i++) {
+			VkDrawIndexedIndirectCommand expected = input[i];
+			if (!visible[i]) expected.instanceCount = 0;
+			bool matches = commandKey(gpu_commands[i]) == commandKey(expected);
+			if (!matches && ambiguous[i]) {
+				expected.instanceCount = visible[i] ? 0 : input[i].instanceCount;
+				matches = commandKey(gpu_commands[i]) == commandKey(expected);
+			}
+			if (!matches) error = "command " + std::to_string(i) + " was " + (visible[i] ? "culled" : "kept") + " but should not have been";
+		}
+	}
+
+	vkUnmapMemory(device.getDevice(), output.readback_memory);
+	if (!error.empty()) throw std::runtime_error("GPU culling disagrees with the CPU reference: " + error);
+	validated_frames++;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "culling.hpp"
+#include "device.hpp"
+#include "indirect.hpp"
+#include "pipeline.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Per-command culling input, laid out to match the CullObject struct of cull.comp (std430)
+/// </summary>
+struct CullObject {
+	/// <summary>
+	/// World space bounding sphere, centre in xyz and radius in w
+	/// </summary>
+	glm::vec4 sphere;
+	/// <summary>
+	/// World space normal cone of the command's triangles (see Meshlet::cone), the default never culls
+	/// </summary>
+	glm::vec4 cone{ 0.0f, 0.0f, 0.0f, 1.0f };
+	/// <summary>
+	/// Batch whose draw count is incremented when the object is visible
+	/// </summary>
+	uint32_t batch;
+	/// <summary>
+	/// Index of the first command of that batch, visible commands are compacted from there on
+	/// </summary>
+	uint32_t batch_first_command;
+	uint32_t padding[2];
+};
+
+/// <summary>
+/// Compute pass testing the bounding sphere of every indirect draw command against the view frustum, and its normal cone
+/// (if any) against the camera to drop clusters that only show back faces.
+/// Visible commands are compacted per batch into an output command buffer with an atomic counter, to be drawn with
+/// vkCmdDrawIndexedIndirectCount. Without drawIndirectCount commands are not compacted, culled ones get an instance count of 0
+/// </summary>
+class GpuCuller {
+public:
+	static constexpr uint32_t WORKGROUP_SIZE = 64; // Must match local_size_x in cull.comp
+
+	/// <summary>
+	/// Creates a GpuCuller object
+	/// </summary>
+	/// <param name="device">Device to create the pipeline and buffers on</param>
+	/// <param name="frame_count">Number of frames that can be in flight</param>
+	/// <param name="comp_file_path">Path to the SPIR-V culling compute shader</param>
+	/// <param name="validate">Read results back and compare them against the CPU reference (slow, for testing)</param>
+	GpuCuller(LogicalDevice& device, uint32_t frame_count, const std::string& comp_file_path, bool validate = false);
+	~GpuCuller();
+
+	/// <summary>
+	/// Change the number of commands and batches. Reallocates buffers, so no frame using them may be in flight
+	/// </summary>
+	void resize(uint32_t command_count, uint32_t new_batch_count);
+	/// <summary>
+	/// Set the culling input of a command, only changed entries are uploaded
+	/// </summary>
+	void setObject(uint32_t command, const CullObject& object);
+	const CullObject& getObject(uint32_t command) { return objects.get(command); }
+
+	/// <summary>
+	/// Record the culling dispatch. Must be recorded outside of a render pass, before the draws consuming its output
+	/// </summary>
+	/// <param name="command_buffer">Command buffer to record to</param>
+	/// <param name="frame">Frame being recorded, whose previous submission must have completed</param>
+	/// <param name="input_commands">All (unculled) draw commands in the same order as the culling objects, already flushed for this frame</param>
+	/// <param name="frustum">Frustum to test against</param>
+	void record(VkCommandBuffer command_buffer, uint32_t frame, IndirectDrawBuffer& input_commands, const Frustum& frustum);
+	/// <summary>
+	/// Record the draws of a batch from the culled output
+	/// </summary>
+	void draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t batch, uint32_t first_command, uint32_t max_draw_count);
+
+	/// <summary>
+	/// Whether visible commands are compacted (drawIndirectCount is available)
+	/// </summary>
+	bool isCompacting() { return compact; }
+	/// <summary>
+	/// Number of frames whose GPU output was checked against the CPU reference
+	/// </summary>
+	uint32_t getValidatedFrameCount() { return validated_frames; }
+	/// <summary>
+	/// Validate the output of all frames not checked yet. The device must be idle
+	/// </summary>
+	void validatePendingFrames();
+
+private:
+	/// <summary>
+	/// Push constants of cull.comp
+	/// </summary>
+	struct CullParameters {
+		glm::vec4 frustum_planes[6];
+		glm::vec4 camera;
+		uint32_t object_count;
+		uint32_t compact;
+		float orientation;
+	};
+
+	/// <summary>
+	/// Per-frame output of the culling pass
+	/// </summary>
+	struct FrameOutput {
+		VkBuffer commands = VK_NULL_HANDLE;
+		VkDeviceMemory commands_memory = VK_NULL_HANDLE;
+		VkBuffer counts = VK_NULL_HANDLE;
+		VkDeviceMemory counts_memory = VK_NULL_HANDLE;
+		VkBuffer readback = VK_NULL_HANDLE; // Only used when validating
+		VkDeviceMemory readback_memory = VK_NULL_HANDLE;
+		VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+		VkBuffer bound_objects = VK_NULL_HANDLE; // Buffers the descriptor set currently points at
+		VkBuffer bound_input = VK_NULL_HANDLE;
+		bool pending_validation = false;
+		Frustum validation_frustum{};
+		std::vector<CullObject> validation_objects;
+		std::vector<VkDrawIndexedIndirectCommand> validation_input;
+	};
+
+	LogicalDevice& device;
+	bool compact;
+	bool validate;
+	uint32_t validated_frames = 0;
+	uint32_t command_capacity = 0;
+	uint32_t batch_count = 0;
+
+	VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	std::unique_ptr<ComputePipeline> pipeline;
+	PerFrameBuffer<CullObject> objects;
+	std::vector<FrameOutput> outputs;
+
+	void createDescriptorSetLayout();
+	void createPipelineLayout();
+	void createDescriptorSets();
+	void createOutputBuffers();
+	void destroyOutputBuffers();
+	/// <summary>
+	/// Point the frame's descriptor set at the current buffers if any of them were reallocated
+	/// </summary>
+	void updateDescriptorSet(uint32_t frame, VkBuffer input_commands);
+	/// <summary>
+	/// Compare the frame's read back output against the CPU reference, throwing if they disagree
+	/// </summary>
+	void validateFrame(uint32_t frame);
+};
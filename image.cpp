@@ -0,0 +1,412 @@
+#include "image.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+	constexpr uint8_t PNG_SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	constexpr size_t STORED_BLOCK_SIZE = 65535; // Largest deflate block stored without compression
+	constexpr double MAX_YIQ_DELTA = 35215.0; // Weighted YIQ difference of black and white
+
+	uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+		static const std::array<uint32_t, 256> table = []() {
+			std::array<uint32_t, 256> result{};
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t value = i;
+				for (int bit = 0; bit < 8; bit++) value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+				result[i] = value;
+			}
+			return result;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t adler32(const uint8_t* data, size_t size) {
+		uint32_t a = 1, b = 0;
+		for (size_t i = 0; i < size; i++) {
+			a = (a + data[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	void appendBigEndian(std::vector<uint8_t>& output, uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8) output.push_back(static_cast<uint8_t>(value >> shift));
+	}
+
+	uint32_t readBigEndian(const uint8_t* data) {
+		return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+	}
+
+	void writeChunk(std::vector<uint8_t>& output, const char type[4], const std::vector<uint8_t>& data) {
+		appendBigEndian(output, static_cast<uint32_t>(data.size()));
+		size_t type_offset = output.size();
+		output.insert(output.end(), type, type + 4);
+		output.insert(output.end(), data.begin(), data.end());
+		appendBigEndian(output, crc32(0, output.data() + type_offset, output.size() - type_offset));
+	}
+
+	/// <summary>
+	/// Reads a deflate stream least significant bit first
+	/// </summary>
+	class BitReader {
+	public:
+		BitReader(const uint8_t* data, size_t size) : data{ data }, size{ size } {}
+
+		uint32_t bits(uint32_t count) {
+			uint32_t value = bit_buffer;
+			while (bit_count < count) {
+				value |= static_cast<uint32_t>(nextByte()) << bit_count;
+				bit_count += 8;
+			}
+			bit_buffer = value >> count;
+			bit_count -= count;
+			return value & ((1u << count) - 1);
+		}
+
+		/// <summary>
+		/// Drop the bits left in the current byte, as stored blocks start on a byte boundary
+		/// </summary>
+		void alignToByte() {
+			bit_buffer = 0;
+			bit_count = 0;
+		}
+
+		uint8_t nextByte() {
+			if (position >= size) throw std::runtime_error("Truncated deflate stream");
+			return data[position++];
+		}
+
+	private:
+		const uint8_t* data;
+		size_t size;
+		size_t position = 0;
+		uint32_t bit_buffer = 0;
+		uint32_t bit_count = 0;
+	};
+
+	/// <summary>
+	/// Canonical Huffman code: number of codes of each length, and symbols ordered by code
+	/// </summary>
+	struct Huffman {
+		uint16_t count[16];
+		uint16_t symbol[288];
+	};
+
+	void buildHuffman(Huffman& huffman, const uint16_t* lengths, uint32_t symbol_count) {
+		std::fill(std::begin(huffman.count), std::end(huffman.count), static_cast<uint16_t>(0));
+		for (uint32_t symbol = 0; symbol < symbol_count; symbol++) huffman.count[lengths[symbol]]++;
+		uint16_t offsets[16] = {};
+		for (uint32_t length = 1; length < 15; length++) offsets[length + 1] = offsets[length] + huffman.count[length];
+		for (uint32_t symbol = 0; symbol < symbol_count; symbol++) {
+			if (lengths[symbol] != 0) huffman.symbol[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+		}
+	}
+
+	uint32_t decodeSymbol(BitReader& reader, const Huffman& huffman) {
+		// Codes of each length follow those of the previous length, so the code is located by counting through lengths
+		int32_t code = 0, first = 0, index = 0;
+		for (uint32_t length = 1; length < 16; length++) {
+			code |= static_cast<int32_t>(reader.bits(1));
+			int32_t count = huffman.count[length];
+			if (code - count < first) return huffman.symbol[index + (code - first)];
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+		throw std::runtime_error("Invalid Huffman code in deflate stream");
+	}
+
+	void inflateCodes(BitReader& reader, std::vector<uint8_t>& output, size_t max_size, const Huffman& lengths, const Huffman& distances) {
+		static constexpr uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr uint16_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static constexpr uint16_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		while (true) {
+			uint32_t symbol = decodeSymbol(reader, lengths);
+			if (symbol < 256) {
+				if (output.size() >= max_size) throw std::runtime_error("Deflate stream is longer than expected");
+				output.push_back(static_cast<uint8_t>(symbol));
+			}
+			else if (symbol == 256) return;
+			else {
+				symbol -= 257;
+				if (symbol >= 29) throw std::runtime_error("Invalid length in deflate stream");
+				uint32_t length = LENGTH_BASE[symbol] + reader.bits(LENGTH_EXTRA[symbol]);
+				uint32_t distance_symbol = decodeSymbol(reader, distances);
+				if (distance_symbol >= 30) throw std::runtime_error("Invalid distance in deflate stream");
+				size_t distance = DISTANCE_BASE[distance_symbol] + reader.bits(DISTANCE_EXTRA[distance_symbol]);
+				if (distance > output.size()) throw std::runtime_error("Distance too far back in deflate stream");
+				if (length > max_size - output.size()) throw std::runtime_error("Deflate stream is longer than expected");
+				for (uint32_t i = 0; i < length; i++) output.push_back(output[output.size() - distance]); // Copies may overlap what they produce
+			}
+		}
+	}
+
+	/// <summary>
+	/// Decompress a raw deflate stream, throwing rather than producing more than max_size bytes, so a stream cannot
+	/// allocate more than its container allows however well it compresses
+	/// </summary>
+	std::vector<uint8_t> inflate(const uint8_t* data, size_t size, size_t max_size) {
+		BitReader reader(data, size);
+		std::vector<uint8_t> output;
+		bool last_block;
+		do {
+			last_block = reader.bits(1) != 0;
+			uint32_t type = reader.bits(2);
+			if (type == 0) {
+				reader.alignToByte();
+				uint32_t length = reader.nextByte();
+				length |= static_cast<uint32_t>(reader.nextByte()) << 8;
+				uint32_t inverted_length = reader.nextByte();
+				inverted_length |= static_cast<uint32_t>(reader.nextByte()) << 8;
+				if (length != (~inverted_length & 0xFFFF)) throw std::runtime_error("Corrupt stored block in deflate stream");
+				if (length > max_size - output.size()) throw std::runtime_error("Deflate stream is longer than expected");
+				for (uint32_t i = 0; i < length; i++) output.push_back(reader.nextByte());
+			}
+			else if (type == 1) {
+				// Fixed codes defined by the format
+				uint16_t code_lengths[288 + 30];
+				std::fill(code_lengths, code_lengths + 144, static_cast<uint16_t>(8));
+				std::fill(code_lengths + 144, code_lengths + 256, static_cast<uint16_t>(9));
+				std::fill(code_lengths + 256, code_lengths + 280, static_cast<uint16_t>(7));
+				std::fill(code_lengths + 280, code_lengths + 288, static_cast<uint16_t>(8));
+				std::fill(code_lengths + 288, code_lengths + 318, static_cast<uint16_t>(5));
+				Huffman lengths, distances;
+				buildHuffman(lengths, code_lengths, 288);
+				buildHuffman(distances, code_lengths + 288, 30);
+				inflateCodes(reader, output, max_size, lengths, distances);
+			}
+			else if (type == 2) {
+				// Codes described at the start of the block, themselves Huffman coded
+				static constexpr uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+				uint32_t length_count = reader.bits(5) + 257;
+				uint32_t distance_count = reader.bits(5) + 1;
+				uint32_t code_length_count = reader.bits(4) + 4;
+				if (length_count > 286 || distance_count > 30) throw std::runtime_error("Invalid code counts in deflate stream");
+
+				uint16_t code_lengths[288 + 30] = {};
+				for (uint32_t i = 0; i < code_length_count; i++) code_lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint16_t>(reader.bits(3));
+				Huffman code_length_code;
+				buildHuffman(code_length_code, code_lengths, 19);
+
+				std::fill(std::begin(code_lengths), std::end(code_lengths), static_cast<uint16_t>(0));
+				for (uint32_t i = 0; i < length_count + distance_count;) {
+					uint32_t symbol = decodeSymbol(reader, code_length_code);
+					if (symbol < 16) {
+						code_lengths[i++] = static_cast<uint16_t>(symbol);
+						continue;
+					}
+					uint16_t repeated = 0;
+					uint32_t repeat;
+					if (symbol == 16) {
+						if (i == 0) throw std::runtime_error("Repeat without a previous length in deflate stream");
+						repeated = code_lengths[i - 1];
+						repeat = 3 + reader.bits(2);
+					}
+					else if (symbol == 17) repeat = 3 + reader.bits(3);
+					else repeat = 11 + reader.bits(7);
+					if (i + repeat > length_count + distance_count) throw std::runtime_error("Too many code lengths in deflate stream");
+					while (repeat-- > 0) code_lengths[i++] = repeated;
+				}
+
+				// Lengths and distances are described as one sequence, but the distance code starts at index length_count
+				uint16_t distance_lengths[30] = {};
+				std::copy(code_lengths + length_count, code_lengths + length_count + distance_count, distance_lengths);
+				Huffman lengths, distances;
+				buildHuffman(lengths, code_lengths, length_count);
+				buildHuffman(distances, distance_lengths, 30);
+				inflateCodes(reader, output, max_size, lengths, distances);
+			}
+			else throw std::runtime_error("Invalid block type in deflate stream");
+		} while (!last_block);
+		return output;
+	}
+
+	uint8_t paethPredictor(int32_t a, int32_t b, int32_t c) {
+		int32_t p = a + b - c;
+		int32_t pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+		return static_cast<uint8_t>(pb <= pc ? b : c);
+	}
+
+	void toYiq(const uint8_t* pixel, double& y, double& i, double& q) {
+		double r = pixel[0], g = pixel[1], b = pixel[2];
+		y = r * 0.29889531 + g * 0.58662247 + b * 0.11448223;
+		i = r * 0.59597799 - g * 0.27417610 - b * 0.32180189;
+		q = r * 0.21147017 - g * 0.52261711 + b * 0.31114694;
+	}
+}
+
+void
+ImageUtils::writePng(const std::string& path, const RgbaImage& image) {
+	if (image.width == 0 || image.height == 0) throw std::runtime_error("Cannot write an empty image to " + path);
+
+	// Every row starts with its filter type, none here
+	size_t row_size = static_cast<size_t>(image.width) * 4;
+	std::vector<uint8_t> filtered((row_size + 1) * image.height);
+	for (uint32_t y = 0; y < image.height; y++) {
+		filtered[y * (row_size + 1)] = 0;
+		memcpy(&filtered[y * (row_size + 1) + 1], &image.pixels[y * row_size], row_size);
+	}
+
+	// zlib stream of stored deflate blocks
+	std::vector<uint8_t> compressed = { 0x78, 0x01 };
+	compressed.reserve(filtered.size() + filtered.size() / STORED_BLOCK_SIZE * 5 + 16);
+	for (size_t offset = 0; offset < filtered.size(); offset += STORED_BLOCK_SIZE) {
+		size_t length = std::min(STORED_BLOCK_SIZE, filtered.size() - offset);
+		compressed.push_back(offset + length == filtered.size() ? 1 : 0);
+		compressed.push_back(static_cast<uint8_t>(length));
+		compressed.push_back(static_cast<uint8_t>(length >> 8));
+		compressed.push_back(static_cast<uint8_t>(~length));
+		compressed.push_back(static_cast<uint8_t>(~length >> 8));
+		compressed.insert(compressed.end(), filtered.begin() + offset, filtered.begin() + offset + length);
+	}
+	appendBigEndian(compressed, adler32(filtered.data(), filtered.size()));
+
+	std::vector<uint8_t> header;
+	appendBigEndian(header, image.width);
+	appendBigEndian(header, image.height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bits per channel RGBA, deflate, adaptive filtering, not interlaced
+
+	std::vector<uint8_t> file(std::begin(PNG_SIGNATURE), std::end(PNG_SIGNATURE));
+	writeChunk(file, "IHDR", header);
+	writeChunk(file, "IDAT", compressed);
+	writeChunk(file, "IEND", {});
+
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+	if (!output) throw std::runtime_error("Failed to write image " + path);
+}
+
+void
+ImageUtils::writeRaw(const std::string& path, const RgbaImage& image) {
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+	if (!output) throw std::runtime_error("Failed to write image " + path);
+}
+
+RgbaImage
+ImageUtils::readPng(const std::string& path) {
+	std::ifstream input(path, std::ios::binary);
+	if (!input.is_open()) throw std::runtime_error("Failed to open image " + path);
+	std::vector<uint8_t> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+	if (file.size() < sizeof(PNG_SIGNATURE) || memcmp(file.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0) throw std::runtime_error(path + " is not a PNG file");
+
+	RgbaImage image;
+	uint32_t channels = 0;
+	std::vector<uint8_t> compressed;
+	for (size_t offset = sizeof(PNG_SIGNATURE); offset + 12 <= file.size();) {
+		uint32_t length = readBigEndian(&file[offset]);
+		if (offset + 12 + static_cast<size_t>(length) > file.size()) throw std::runtime_error(path + " is truncated");
+		const uint8_t* type = &file[offset + 4];
+		const uint8_t* data = &file[offset + 8];
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+			image.width = readBigEndian(data);
+			image.height = readBigEndian(data + 4);
+			uint8_t bit_depth = data[8], colour_type = data[9], interlace = data[12];
+			if (bit_depth != 8 || (colour_type != 2 && colour_type != 6) || interlace != 0) {
+				throw std::runtime_error(path + " is not a non-interlaced 8-bit RGB or RGBA PNG");
+			}
+			channels = colour_type == 6 ? 4 : 3;
+		}
+		else if (memcmp(type, "IDAT", 4) == 0) compressed.insert(compressed.end(), data, data + length);
+		else if (memcmp(type, "IEND", 4) == 0) break;
+		offset += 12 + static_cast<size_t>(length);
+	}
+	if (channels == 0 || image.width == 0 || image.height == 0) throw std::runtime_error(path + " has no image header");
+	if (compressed.size() < 2 || (compressed[0] & 0x0F) != 8 || (compressed[1] & 0x20)) throw std::runtime_error(path + " uses an unsupported zlib stream");
+
+	// Rows (with their filter byte) and decoded pixels take at most height * (width * 4 + 1) bytes, which must not wrap
+	// before anything is sized from it
+	constexpr size_t SIZE_LIMIT = std::numeric_limits<size_t>::max();
+	if (image.width > (SIZE_LIMIT - 1) / 4 || image.height > SIZE_LIMIT / (static_cast<size_t>(image.width) * 4 + 1)) {
+		throw std::runtime_error(path + " is too large to decode");
+	}
+	size_t row_size = static_cast<size_t>(image.width) * channels;
+	size_t filtered_size = (row_size + 1) * image.height;
+	std::vector<uint8_t> filtered = inflate(compressed.data() + 2, compressed.size() - 2, filtered_size);
+	if (filtered.size() < filtered_size) throw std::runtime_error(path + " has too little image data");
+
+	// Undo each row's filter in place, every predictor referring to already reconstructed bytes
+	image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+	std::vector<uint8_t> previous_row(row_size, 0);
+	for (uint32_t y = 0; y < image.height; y++) {
+		uint8_t filter = filtered[y * (row_size + 1)];
+		uint8_t* row = &filtered[y * (row_size + 1) + 1];
+		for (size_t x = 0; x < row_size; x++) {
+			int32_t a = x >= channels ? row[x - channels] : 0;
+			int32_t b = previous_row[x];
+			int32_t c = x >= channels ? previous_row[x - channels] : 0;
+			switch (filter) {
+			case 0: break;
+			case 1: row[x] = static_cast<uint8_t>(row[x] + a); break;
+			case 2: row[x] = static_cast<uint8_t>(row[x] + b); break;
+			case 3: row[x] = static_cast<uint8_t>(row[x] + (a + b) / 2); break;
+			case 4: row[x] = static_cast<uint8_t>(row[x] + paethPredictor(a, b, c)); break;
+			default: throw std::runtime_error(path + " uses an invalid row filter");
+			}
+		}
+		memcpy(previous_row.data(), row, row_size);
+
+		for (uint32_t x = 0; x < image.width; x++) {
+			uint8_t* pixel = &image.pixels[(static_cast<size_t>(y) * image.width + x) * 4];
+			memcpy(pixel, &row[x * channels], channels);
+			if (channels == 3) pixel[3] = 255;
+		}
+	}
+	return image;
+}
+
+ImageComparison
+ImageUtils::compare(const RgbaImage& expected, const RgbaImage& actual, double threshold, RgbaImage* diff) {
+	if (expected.width != actual.width || expected.height != actual.height) {
+		throw std::runtime_error("Cannot compare a " + std::to_string(actual.width) + "x" + std::to_string(actual.height) + " image against a "
+			+ std::to_string(expected.width) + "x" + std::to_string(expected.height) + " one");
+	}
+
+	ImageComparison result;
+	size_t pixel_count = static_cast<size_t>(expected.width) * expected.height;
+	if (diff) {
+		diff->width = expected.width;
+		diff->height = expected.height;
+		diff->pixels.resize(pixel_count * 4);
+	}
+	double total_delta = 0.0;
+	for (size_t i = 0; i < pixel_count; i++) {
+		double y1, i1, q1, y2, i2, q2;
+		toYiq(&expected.pixels[i * 4], y1, i1, q1);
+		toYiq(&actual.pixels[i * 4], y2, i2, q2);
+		double dy = y1 - y2, di = i1 - i2, dq = q1 - q2;
+		double delta = std::sqrt((0.5053 * dy * dy + 0.299 * di * di + 0.1957 * dq * dq) / MAX_YIQ_DELTA);
+		bool differs = delta > threshold;
+		result.differing_pixels += differs;
+		result.max_delta = std::max(result.max_delta, delta);
+		total_delta += delta;
+
+		if (diff) {
+			uint8_t* pixel = &diff->pixels[i * 4];
+			if (differs) {
+				pixel[0] = 255;
+				pixel[1] = pixel[2] = 0;
+			}
+			else pixel[0] = pixel[1] = pixel[2] = static_cast<uint8_t>(255.0 - 0.1 * (255.0 - y1)); // Faded luma keeps the context visible
+			pixel[3] = 255;
+		}
+	}
+	if (pixel_count > 0) {
+		result.differing_fraction = static_cast<double>(result.differing_pixels) / pixel_count;
+		result.mean_delta = total_delta / pixel_count;
+	}
+	return result;
+}
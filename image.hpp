@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// 8-bit RGBA image in memory, rows stored top to bottom without padding
+/// </summary>
+struct RgbaImage {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+/// <summary>
+/// Outcome of comparing two images pixel by pixel
+/// </summary>
+struct ImageComparison {
+	/// <summary>
+	/// Pixels whose perceptual difference exceeds the threshold
+	/// </summary>
+	uint64_t differing_pixels = 0;
+	double differing_fraction = 0.0;
+	/// <summary>
+	/// Largest and average perceptual difference, from 0 (identical) to about 1 (black against white)
+	/// </summary>
+	double max_delta = 0.0;
+	double mean_delta = 0.0;
+};
+
+/// <summary>
+/// Utility class containing static methods for reading, writing and comparing images
+/// </summary>
+class ImageUtils {
+public:
+	/// <summary>
+	/// Perceptual difference above which two pixels count as different unless told otherwise, small enough to catch a
+	/// visibly wrong shade while ignoring rounding and dithering noise
+	/// </summary>
+	static constexpr double DEFAULT_THRESHOLD = 0.1;
+
+	/// <summary>
+	/// Write an image as an RGBA PNG. Pixel data is stored uncompressed, trading file size for the speed of writing captures
+	/// </summary>
+	static void writePng(const std::string& path, const RgbaImage& image);
+	/// <summary>
+	/// Write an image's pixels as they are, without any header (e.g. for ffmpeg's rawvideo demuxer with pix_fmt rgba)
+	/// </summary>
+	static void writeRaw(const std::string& path, const RgbaImage& image);
+	/// <summary>
+	/// Read a non-interlaced 8-bit RGB or RGBA PNG, throwing on anything else
+	/// </summary>
+	static RgbaImage readPng(const std::string& path);
+
+	/// <summary>
+	/// Compare two images of the same size by the difference of their pixels in the YIQ colour space, weighted the way
+	/// the eye weighs brightness against hue. Alpha is ignored
+	/// </summary>
+	/// <param name="expected">Reference image</param>
+	/// <param name="actual">Image compared against the reference</param>
+	/// <param name="threshold">Perceptual difference (0 to 1) above which a pixel counts as different</param>
+	/// <param name="diff">If not null, receives a faded copy of the reference with the differing pixels in red</param>
+	static ImageComparison compare(const RgbaImage& expected, const RgbaImage& actual, double threshold = DEFAULT_THRESHOLD, RgbaImage* diff = nullptr);
+};
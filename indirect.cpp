@@ -0,0 +1,82 @@
+#include "indirect.hpp"
+
+#include <algorithm>
+
+IndirectDrawBuffer::IndirectDrawBuffer(LogicalDevice& device, uint32_t frame_count)
+	: device{ device },
+	commands{ device, frame_count, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+	draw_counts{ device, frame_count, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT } {}
+
+bool
+IndirectDrawBuffer::isSupported() { return device.getEnabledFeatures().draw_indirect_first_instance; }
+
+void
+IndirectDrawBuffer::resize(uint32_t command_count, uint32_t batch_count) {
+	commands.resize(command_count);
+	draw_counts.resize(batch_count);
+}
+
+void
+IndirectDrawBuffer::setCommand(uint32_t index, const VkDrawIndexedIndirectCommand& command) {
+	const VkDrawIndexedIndirectCommand& current = commands.get(index);
+	if (current.indexCount == command.indexCount &&
+		current.instanceCount == command.instanceCount &&
+		current.firstIndex == command.firstIndex &&
+		current.vertexOffset == command.vertexOffset &&
+		current.firstInstance == command.firstInstance) return; // Unchanged commands cost nothing to keep
+	commands.set(index, command);
+	pending_changes++;
+}
+
+void
+IndirectDrawBuffer::setBatchDrawCount(uint32_t batch, uint32_t draw_count) {
+	if (draw_counts.get(batch) != draw_count) draw_counts.set(batch, draw_count);
+}
+
+void
+IndirectDrawBuffer::flush(uint32_t frame) {
+	last_flush_size = pending_changes;
+	pending_changes = 0;
+	commands.flush(frame);
+	draw_counts.flush(frame);
+}
+
+void
+IndirectDrawBuffer::draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t batch, uint32_t first_command, uint32_t max_draw_count) {
+	recordDraws(
+		device,
+		command_buffer,
+		commands.getBuffer(frame),
+		static_cast<VkDeviceSize>(first_command) * sizeof(VkDrawIndexedIndirectCommand),
+		draw_counts.getBuffer(frame),
+		static_cast<VkDeviceSize>(batch) * sizeof(uint32_t),
+		max_draw_count);
+}
+
+void
+IndirectDrawBuffer::recordDraws(
+	LogicalDevice& device,
+	VkCommandBuffer command_buffer,
+	VkBuffer commands_buffer,
+	VkDeviceSize offset,
+	VkBuffer count_buffer,
+	VkDeviceSize count_offset,
+	uint32_t max_draw_count) {
+	const EnabledFeatures& features = device.getEnabledFeatures();
+	constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	// Count read from GPU memory, so the number of draws can change without touching the recorded commands
+	if (features.draw_indirect_count) {
+		vkCmdDrawIndexedIndirectCount(command_buffer, commands_buffer, offset, count_buffer, count_offset, max_draw_count, stride);
+		return;
+	}
+
+	// Without multiDrawIndirect every indirect call is limited to a single draw
+	uint32_t draws_per_call = features.multi_draw_indirect
+		? std::max(device.physical_device_properties.limits.maxDrawIndirectCount, 1u)
+		: 1u;
+	for (uint32_t drawn = 0; drawn < max_draw_count; drawn += draws_per_call) {
+		uint32_t count = std::min(draws_per_call, max_draw_count - drawn);
+		vkCmdDrawIndexedIndirect(command_buffer, commands_buffer, offset + static_cast<VkDeviceSize>(drawn) * stride, count, stride);
+	}
+}
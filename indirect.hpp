@@ -0,0 +1,103 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/// <summary>
+/// Range of consecutive indirect draw commands that all draw from the same model with the same push constants
+/// </summary>
+struct IndirectBatch {
+	uint32_t model;
+	uint32_t first_command;
+	uint32_t command_count;
+	glm::vec4 tint{ 1.0f };
+	uint32_t texture = UINT32_MAX; // TextureStreamer identifier of the texture shared by the batch (NO_TEXTURE if none)
+};
+
+/// <summary>
+/// Indirect draw commands of a scene, kept in GPU-visible memory across frames so that submitting them costs a handful of
+/// commands regardless of how many draws they contain. Commands are grouped into batches that share vertex and index buffers
+/// </summary>
+class IndirectDrawBuffer {
+public:
+	/// <summary>
+	/// Creates an IndirectDrawBuffer object
+	/// </summary>
+	/// <param name="device">Device to allocate buffers on and whose enabled features select the submission path</param>
+	/// <param name="frame_count">Number of frames that can be in flight</param>
+	IndirectDrawBuffer(LogicalDevice& device, uint32_t frame_count);
+
+	/// <summary>
+	/// Whether the device can draw with non-zero firstInstance from indirect commands. Without it instance data cannot be
+	/// selected per command and this buffer must not be used
+	/// </summary>
+	bool isSupported();
+
+	/// <summary>
+	/// Change the number of commands and batches. Larger buffers replace each frame's as that frame is flushed
+	/// </summary>
+	void resize(uint32_t command_count, uint32_t batch_count);
+	/// <summary>
+	/// Set a command, it is only written to GPU memory if it differs from the command already stored
+	/// </summary>
+	void setCommand(uint32_t index, const VkDrawIndexedIndirectCommand& command);
+	/// <summary>
+	/// Set the number of commands drawn by a batch when the device supports taking draw counts from a buffer
+	/// </summary>
+	void setBatchDrawCount(uint32_t batch, uint32_t draw_count);
+	/// <summary>
+	/// Write changed commands and counts to the given frame's buffers. The frame's previous use must have completed
+	/// </summary>
+	void flush(uint32_t frame);
+	/// <summary>
+	/// Record the draws of a batch with as few commands as the device allows
+	/// (one vkCmdDrawIndexedIndirectCount, one vkCmdDrawIndexedIndirect per maxDrawIndirectCount draws, or one per draw)
+	/// </summary>
+	/// <param name="command_buffer">Command buffer to record to, with the batch's vertex and index buffers bound</param>
+	/// <param name="frame">Frame being recorded</param>
+	/// <param name="batch">Index of the batch, used to locate its draw count</param>
+	/// <param name="first_command">Index of the batch's first command</param>
+	/// <param name="max_draw_count">Number of commands in the batch (upper bound when counts are read from the buffer)</param>
+	void draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t batch, uint32_t first_command, uint32_t max_draw_count);
+
+	/// <summary>
+	/// Number of commands written to GPU memory by the last flush, for monitoring update cost
+	/// </summary>
+	uint32_t getLastFlushSize() { return last_flush_size; }
+	/// <summary>
+	/// Buffer holding the given frame's commands, which may also be read as a storage buffer (e.g. as input to GPU culling)
+	/// </summary>
+	VkBuffer getCommandsBuffer(uint32_t frame) { return commands.getBuffer(frame); }
+	const VkDrawIndexedIndirectCommand& getCommand(uint32_t index) { return commands.get(index); }
+	uint32_t getCommandCount() { return commands.size(); }
+
+	/// <summary>
+	/// Record indexed indirect draws with as few commands as the device allows
+	/// </summary>
+	/// <param name="device">Device whose enabled features and limits select the submission path</param>
+	/// <param name="command_buffer">Command buffer to record to</param>
+	/// <param name="commands_buffer">Buffer holding tightly packed VkDrawIndexedIndirectCommands</param>
+	/// <param name="offset">Byte offset of the first command</param>
+	/// <param name="count_buffer">Buffer holding the draw count, only read when drawIndirectCount is enabled (may be VK_NULL_HANDLE otherwise)</param>
+	/// <param name="count_offset">Byte offset of the draw count</param>
+	/// <param name="max_draw_count">Number of commands (upper bound of the draw count)</param>
+	static void recordDraws(
+		LogicalDevice& device,
+		VkCommandBuffer command_buffer,
+		VkBuffer commands_buffer,
+		VkDeviceSize offset,
+		VkBuffer count_buffer,
+		VkDeviceSize count_offset,
+		uint32_t max_draw_count);
+
+private:
+	LogicalDevice& device;
+	PerFrameBuffer<VkDrawIndexedIndirectCommand> commands;
+	PerFrameBuffer<uint32_t> draw_counts; // One count per batch, consumed by vkCmdDrawIndexedIndirectCount
+	uint32_t pending_changes = 0;
+	uint32_t last_flush_size = 0;
+};
@@ -0,0 +1,241 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+	// Deque of the calling thread, valid while current_system is the system it belongs to
+	thread_local JobSystem* current_system = nullptr;
+	thread_local uint32_t current_queue = 0;
+}
+
+bool
+JobCounter::isDone() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending == 0;
+}
+
+JobSystem::JobSystem(uint32_t worker_count, bool pin_threads) {
+	uint32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+	if (worker_count == 0) worker_count = hardware_threads - 1;
+
+	queues.resize(static_cast<size_t>(worker_count) + 1);
+	for (std::unique_ptr<WorkerQueue>& queue : queues) queue = std::make_unique<WorkerQueue>();
+	current_system = this;
+	current_queue = 0;
+	pinned = pin_threads && pinCurrentThread(0);
+
+	workers.reserve(worker_count);
+	for (uint32_t worker = 1; worker <= worker_count; worker++) {
+		workers.emplace_back([this, worker, hardware_threads]() {
+			if (pinned) pinCurrentThread(worker % hardware_threads);
+			workerLoop(worker);
+		});
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) worker.join();
+	if (current_system == this) current_system = nullptr;
+}
+
+void
+JobSystem::run(std::function<void()> job, JobCounter& counter) {
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		counter.pending++;
+	}
+	schedule({ std::move(job), &counter });
+}
+
+void
+JobSystem::runAfter(JobCounter& dependency, std::function<void()> job, JobCounter& counter) {
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		counter.pending++;
+	}
+	{
+		// Queued by whichever job brings the dependency to zero, unless that already happened
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.pending > 0) {
+			dependency.continuations.push_back({ std::move(job), &counter });
+			return;
+		}
+	}
+	schedule({ std::move(job), &counter });
+}
+
+void
+JobSystem::runInBackground(std::function<void()> job, JobCounter& counter) {
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		counter.pending++;
+	}
+	queued_jobs++; // Counted before it can be taken, so taking it never drops the count below zero
+	{
+		std::lock_guard<std::mutex> lock(background_mutex);
+		background_jobs.push_back({ std::move(job), &counter });
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+void
+JobSystem::wait(JobCounter& counter) {
+	uint32_t queue = currentQueue();
+	while (!counter.isDone()) {
+		if (!runOne(queue)) std::this_thread::yield(); // The remaining jobs are running on other threads
+	}
+
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		std::swap(error, counter.error);
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+size_t
+JobSystem::rangeCount(size_t count, size_t grain) const {
+	if (count == 0) return 0;
+	size_t by_grain = (count + std::max<size_t>(grain, 1) - 1) / std::max<size_t>(grain, 1);
+	return std::min(by_grain, static_cast<size_t>(getThreadCount()) * CHUNKS_PER_THREAD);
+}
+
+void
+JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+	parallelForRanges(count, grain, [&body](size_t, size_t begin, size_t end) { body(begin, end); });
+}
+
+void
+JobSystem::parallelForRanges(size_t count, size_t grain, const std::function<void(size_t range, size_t begin, size_t end)>& body) {
+	size_t ranges = rangeCount(count, grain);
+	if (ranges == 0) return;
+	if (ranges == 1 || getThreadCount() == 1) {
+		for (size_t range = 0; range < ranges; range++) body(range, range * count / ranges, (range + 1) * count / ranges);
+		return;
+	}
+
+	JobCounter counter;
+	for (size_t range = 1; range < ranges; range++) {
+		run([&body, range, count, ranges]() { body(range, range * count / ranges, (range + 1) * count / ranges); }, counter);
+	}
+
+	// The body is referenced by the queued jobs, so they must finish even if the calling thread's range throws
+	std::exception_ptr error;
+	try { body(0, 0, count / ranges); }
+	catch (...) { error = std::current_exception(); }
+	wait(counter);
+	if (error) std::rethrow_exception(error);
+}
+
+void
+JobSystem::schedule(Job job) {
+	uint32_t queue = current_system == this ? current_queue : next_queue++ % getThreadCount();
+	queued_jobs++; // Counted before it can be stolen, so running it never drops the count below zero
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		queues[queue]->jobs.push_back(std::move(job));
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex); // Orders the count before a sleeping worker's check of it
+	}
+	wake.notify_one();
+}
+
+bool
+JobSystem::runOne(uint32_t queue) {
+	Job job;
+	bool found = false;
+	for (uint32_t offset = 0; offset < getThreadCount() && !found; offset++) {
+		WorkerQueue& victim = *queues[(queue + offset) % getThreadCount()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.jobs.empty()) continue;
+		// Newest job from the own deque, oldest (and likely largest remaining) from someone else's
+		if (offset == 0) {
+			job = std::move(victim.jobs.back());
+			victim.jobs.pop_back();
+		}
+		else {
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+		}
+		queued_jobs--;
+		found = true;
+	}
+	if (!found && queue != 0) {
+		std::lock_guard<std::mutex> lock(background_mutex);
+		if (!background_jobs.empty()) {
+			job = std::move(background_jobs.front());
+			background_jobs.pop_front();
+			queued_jobs--;
+			found = true;
+		}
+	}
+	if (!found) return false;
+
+	std::exception_ptr error;
+	try { job.function(); }
+	catch (...) { error = std::current_exception(); }
+	finish(job.counter, error);
+	return true;
+}
+
+void
+JobSystem::finish(JobCounter* counter, std::exception_ptr error) {
+	std::vector<JobCounter::Continuation> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (error && !counter->error) counter->error = error;
+		if (--counter->pending == 0) std::swap(ready, counter->continuations);
+	}
+	for (JobCounter::Continuation& continuation : ready) schedule({ std::move(continuation.function), continuation.counter });
+}
+
+void
+JobSystem::workerLoop(uint32_t queue) {
+	current_system = this;
+	current_queue = queue;
+	while (true) {
+		if (runOne(queue)) continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this]() { return stopping || queued_jobs > 0; });
+		if (stopping && queued_jobs == 0) return;
+	}
+}
+
+uint32_t
+JobSystem::currentQueue() const {
+	return current_system == this ? current_queue : 0;
+}
+
+bool
+JobSystem::pinCurrentThread(uint32_t core) {
+#if defined(_WIN32)
+	if (core >= sizeof(DWORD_PTR) * 8) return false;
+	return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
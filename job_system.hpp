@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+/// <summary>
+/// Counts the unfinished jobs of a group. Waiting on it runs other jobs in the meantime, and jobs scheduled to run after it
+/// are queued once it drops to zero. Must outlive every job counted by or depending on it
+/// </summary>
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool isDone();
+
+private:
+	friend class JobSystem;
+
+	struct Continuation {
+		std::function<void()> function;
+		JobCounter* counter;
+	};
+
+	std::mutex mutex; // Also taken by the finishing job, so a waiter never frees the counter while it is still being touched
+	uint32_t pending = 0;
+	std::vector<Continuation> continuations;
+	std::exception_ptr error; // First exception thrown by a counted job, rethrown by wait()
+};
+
+/// <summary>
+/// Work-stealing scheduler. Each thread owns a deque it pushes to and pops from at the back (running the most recently
+/// spawned, cache-warm work first) while idle threads steal the oldest jobs from the front of the others' deques.
+/// The thread creating the system takes part as thread 0 whenever it waits, so nothing is lost by waiting on a job.
+/// Jobs should be coarse (tens of microseconds or more), as the deques are guarded by (uncontended) locks
+/// </summary>
+class JobSystem {
+public:
+	/// <summary>
+	/// Smallest number of items given to a job by parallelFor unless a grain is specified
+	/// </summary>
+	static constexpr size_t DEFAULT_GRAIN = 256;
+	/// <summary>
+	/// Jobs parallelFor creates per thread at most, so threads finishing early have work left to steal
+	/// </summary>
+	static constexpr uint32_t CHUNKS_PER_THREAD = 4;
+
+	/// <param name="worker_count">Threads to start besides the calling one (0 uses one per remaining hardware thread)</param>
+	/// <param name="pin_threads">Pin the calling thread to the first core and each worker to the following ones, keeping
+	/// the OS from migrating them between cores (ignored where unsupported)</param>
+	JobSystem(uint32_t worker_count = 0, bool pin_threads = false);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	/// <summary>
+	/// Threads running jobs, including the one that created the system
+	/// </summary>
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+	bool isPinned() const { return pinned; }
+
+	/// <summary>
+	/// Queue a job, counted by the given counter until it finishes
+	/// </summary>
+	void run(std::function<void()> job, JobCounter& counter);
+	/// <summary>
+	/// Queue a job once every job counted by the dependency has finished (immediately if none are pending)
+	/// </summary>
+	/// <param name="dependency">Counter that must reach zero first</param>
+	/// <param name="job">Job to run</param>
+	/// <param name="counter">Counter counting the job from now until it finishes</param>
+	void runAfter(JobCounter& dependency, std::function<void()> job, JobCounter& counter);
+	/// <summary>
+	/// Queue a long running job (e.g. loading an asset) that only worker threads pick up, once they have nothing else to
+	/// do, so the creating thread never ends up running it while it waits on short jobs of its own. Never runs when the
+	/// system has no workers
+	/// </summary>
+	void runInBackground(std::function<void()> job, JobCounter& counter);
+	/// <summary>
+	/// Run queued jobs until every job counted by the counter has finished, rethrowing the first exception one threw
+	/// </summary>
+	void wait(JobCounter& counter);
+	/// <summary>
+	/// Split [0, count) into contiguous ranges of at least grain items, run the body on every range in parallel and wait
+	/// for all of them. Ranges are processed in no particular order, so each must only write what it alone owns
+	/// </summary>
+	/// <param name="count">Number of items</param>
+	/// <param name="grain">Fewest items worth a job of their own</param>
+	/// <param name="body">Function processing the items [begin, end)</param>
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+	/// <summary>
+	/// Number of contiguous ranges parallelFor splits count items into, so callers can prepare per-range outputs.
+	/// Range i covers [i * count / ranges, (i + 1) * count / ranges)
+	/// </summary>
+	size_t rangeCount(size_t count, size_t grain) const;
+	/// <summary>
+	/// Like parallelFor, but the body also receives the index of its range (see rangeCount), for deterministic merging
+	/// of per-range results
+	/// </summary>
+	void parallelForRanges(size_t count, size_t grain, const std::function<void(size_t range, size_t begin, size_t end)>& body);
+
+private:
+	struct Job {
+		std::function<void()> function;
+		JobCounter* counter;
+	};
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues; // One per thread, index 0 belonging to the creating thread
+	std::vector<std::thread> workers;
+	std::mutex background_mutex;
+	std::deque<Job> background_jobs; // Taken oldest first by idle workers only
+	std::atomic<uint32_t> queued_jobs{ 0 }; // Upper bound on the jobs in any deque, raised before a job is pushed
+	std::atomic<uint32_t> next_queue{ 0 }; // Round robin target for jobs scheduled by threads outside the system
+	std::atomic<bool> stopping{ false };
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool pinned = false;
+
+	void schedule(Job job);
+	/// <summary>
+	/// Run a single job from the thread's own deque, or stolen from another, or (workers only) a background job,
+	/// returning whether one was found
+	/// </summary>
+	bool runOne(uint32_t queue);
+	void finish(JobCounter* counter, std::exception_ptr error);
+	void workerLoop(uint32_t queue);
+	/// <summary>
+	/// Deque owned by the calling thread, or the creating thread's for threads outside the system
+	/// </summary>
+	uint32_t currentQueue() const;
+	static bool pinCurrentThread(uint32_t core);
+};
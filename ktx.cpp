@@ -0,0 +1,124 @@
+#include "ktx.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	// Fixed-size part of a KTX2 file: identifier, header and index (see the KTX 2.0 specification, section 3)
+	constexpr unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// The 64-bit fields follow an odd number of 32-bit ones, so natural alignment would pad the struct past the file layout
+#pragma pack(push, 4)
+	struct Ktx2Header {
+		uint32_t vk_format;
+		uint32_t type_size;
+		uint32_t pixel_width;
+		uint32_t pixel_height;
+		uint32_t pixel_depth;
+		uint32_t layer_count;
+		uint32_t face_count;
+		uint32_t level_count;
+		uint32_t supercompression_scheme;
+		uint32_t dfd_byte_offset;
+		uint32_t dfd_byte_length;
+		uint32_t kvd_byte_offset;
+		uint32_t kvd_byte_length;
+		uint64_t sgd_byte_offset;
+		uint64_t sgd_byte_length;
+	};
+#pragma pack(pop)
+	static_assert(sizeof(Ktx2Header) == 68, "KTX2 header must match the file layout");
+
+	struct Ktx2LevelIndex {
+		uint64_t byte_offset;
+		uint64_t byte_length;
+		uint64_t uncompressed_byte_length;
+	};
+
+	/// <summary>
+	/// Texels per block and bytes per block of the formats textures may be uploaded in (see
+	/// LogicalDevice::queryTextureFormats), uncompressed formats being 1x1 blocks
+	/// </summary>
+	struct FormatBlock {
+		uint32_t width;
+		uint32_t height;
+		uint32_t bytes;
+	};
+
+	bool getFormatBlock(VkFormat format, FormatBlock& block) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB: block = { 1, 1, 4 }; return true;
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK: case VK_FORMAT_BC1_RGB_SRGB_BLOCK: case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK: case VK_FORMAT_BC4_SNORM_BLOCK: block = { 4, 4, 8 }; return true;
+		case VK_FORMAT_BC2_UNORM_BLOCK: case VK_FORMAT_BC2_SRGB_BLOCK: case VK_FORMAT_BC3_UNORM_BLOCK: case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK: case VK_FORMAT_BC5_SNORM_BLOCK: case VK_FORMAT_BC6H_UFLOAT_BLOCK: case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK: case VK_FORMAT_BC7_SRGB_BLOCK: block = { 4, 4, 16 }; return true;
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK: case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: block = { 4, 4, 16 }; return true;
+		case VK_FORMAT_ASTC_5x4_UNORM_BLOCK: case VK_FORMAT_ASTC_5x4_SRGB_BLOCK: block = { 5, 4, 16 }; return true;
+		case VK_FORMAT_ASTC_5x5_UNORM_BLOCK: case VK_FORMAT_ASTC_5x5_SRGB_BLOCK: block = { 5, 5, 16 }; return true;
+		case VK_FORMAT_ASTC_6x5_UNORM_BLOCK: case VK_FORMAT_ASTC_6x5_SRGB_BLOCK: block = { 6, 5, 16 }; return true;
+		case VK_FORMAT_ASTC_6x6_UNORM_BLOCK: case VK_FORMAT_ASTC_6x6_SRGB_BLOCK: block = { 6, 6, 16 }; return true;
+		case VK_FORMAT_ASTC_8x5_UNORM_BLOCK: case VK_FORMAT_ASTC_8x5_SRGB_BLOCK: block = { 8, 5, 16 }; return true;
+		case VK_FORMAT_ASTC_8x6_UNORM_BLOCK: case VK_FORMAT_ASTC_8x6_SRGB_BLOCK: block = { 8, 6, 16 }; return true;
+		case VK_FORMAT_ASTC_8x8_UNORM_BLOCK: case VK_FORMAT_ASTC_8x8_SRGB_BLOCK: block = { 8, 8, 16 }; return true;
+		case VK_FORMAT_ASTC_10x5_UNORM_BLOCK: case VK_FORMAT_ASTC_10x5_SRGB_BLOCK: block = { 10, 5, 16 }; return true;
+		case VK_FORMAT_ASTC_10x6_UNORM_BLOCK: case VK_FORMAT_ASTC_10x6_SRGB_BLOCK: block = { 10, 6, 16 }; return true;
+		case VK_FORMAT_ASTC_10x8_UNORM_BLOCK: case VK_FORMAT_ASTC_10x8_SRGB_BLOCK: block = { 10, 8, 16 }; return true;
+		case VK_FORMAT_ASTC_10x10_UNORM_BLOCK: case VK_FORMAT_ASTC_10x10_SRGB_BLOCK: block = { 10, 10, 16 }; return true;
+		case VK_FORMAT_ASTC_12x10_UNORM_BLOCK: case VK_FORMAT_ASTC_12x10_SRGB_BLOCK: block = { 12, 10, 16 }; return true;
+		case VK_FORMAT_ASTC_12x12_UNORM_BLOCK: case VK_FORMAT_ASTC_12x12_SRGB_BLOCK: block = { 12, 12, 16 }; return true;
+		default: return false;
+		}
+	}
+}
+
+Ktx2TextureSource::Ktx2TextureSource(const std::string& path) : file{ path } {
+	// Only the header and level index are parsed, level data is left untouched until it is streamed
+	if (file.size() < sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header) || std::memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		throw std::runtime_error("Not a KTX2 file: " + path);
+	}
+	Ktx2Header header;
+	std::memcpy(&header, file.data() + sizeof(KTX2_IDENTIFIER), sizeof(header));
+
+	if (header.vk_format == VK_FORMAT_UNDEFINED) throw std::runtime_error("KTX2 file needs transcoding (Basis Universal), which is unsupported: " + path);
+	if (header.supercompression_scheme != 0) throw std::runtime_error("Supercompressed KTX2 files are unsupported: " + path);
+	if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1) {
+		throw std::runtime_error("Only single 2D KTX2 textures are supported: " + path);
+	}
+	format = static_cast<VkFormat>(header.vk_format);
+	extent = { header.pixel_width, header.pixel_height };
+	FormatBlock block;
+	if (!getFormatBlock(format, block)) throw std::runtime_error("KTX2 format " + std::to_string(header.vk_format) + " is unsupported: " + path);
+
+	uint32_t level_count = std::max(header.level_count, 1u); // 0 asks the loader to generate mips, only the base level is stored
+	if (level_count > 32 || (std::max(extent.width, extent.height) >> (level_count - 1)) == 0) throw std::runtime_error("KTX2 file has more levels than its extent allows: " + path);
+	size_t index_offset = sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header);
+	if (file.size() < index_offset + level_count * sizeof(Ktx2LevelIndex)) throw std::runtime_error("Truncated KTX2 level index: " + path);
+	for (uint32_t level = 0; level < level_count; level++) {
+		Ktx2LevelIndex index;
+		std::memcpy(&index, file.data() + index_offset + level * sizeof(Ktx2LevelIndex), sizeof(index));
+		// Written so that neither side can overflow, whatever the offset and length claim
+		if (index.byte_offset > file.size() || index.byte_length > file.size() - index.byte_offset) throw std::runtime_error("KTX2 level data lies outside of the file: " + path);
+
+		// Uploads copy exactly the blocks covering the level, so a level of any other size would be read past or misread
+		VkExtent2D level_extent = getMipExtent(level);
+		uint64_t expected_size = static_cast<uint64_t>((level_extent.width + block.width - 1) / block.width) * ((level_extent.height + block.height - 1) / block.height) * block.bytes;
+		if (index.byte_length != expected_size) {
+			throw std::runtime_error("KTX2 level " + std::to_string(level) + " holds " + std::to_string(index.byte_length) + " bytes instead of " + std::to_string(expected_size) + ": " + path);
+		}
+		levels.push_back({ static_cast<size_t>(index.byte_offset), index.byte_length });
+	}
+}
+
+VkExtent2D
+Ktx2TextureSource::getMipExtent(uint32_t level) const {
+	return { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+}
+
+void
+Ktx2TextureSource::readMip(uint32_t level, void* destination) const {
+	// Levels are stored in the layout buffer to image copies expect (tightly packed blocks), so no conversion is needed
+	std::memcpy(destination, file.data() + levels[level].offset, static_cast<size_t>(levels[level].size));
+}
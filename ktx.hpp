@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "texture.hpp"
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// 2D texture read from a KTX2 container. The file is memory-mapped and each mip level is copied from the mapping as stored,
+/// so block compressed formats (BCn, ASTC) stay compressed all the way to the GPU. Supercompressed (Basis, zstd) files,
+/// arrays, cube maps and 3D textures are rejected
+/// </summary>
+class Ktx2TextureSource : public TextureSource {
+public:
+	/// <summary>
+	/// Map and validate the KTX2 file at the given path, throwing if it cannot be read or uses an unsupported feature
+	/// </summary>
+	Ktx2TextureSource(const std::string& path);
+
+	VkFormat getFormat() const override { return format; }
+	uint32_t getMipCount() const override { return static_cast<uint32_t>(levels.size()); }
+	VkExtent2D getMipExtent(uint32_t level) const override;
+	VkDeviceSize getMipSize(uint32_t level) const override { return levels[level].size; }
+	void readMip(uint32_t level, void* destination) const override;
+
+private:
+	struct Level {
+		size_t offset;
+		VkDeviceSize size;
+	};
+
+	MappedFile file;
+	VkFormat format;
+	VkExtent2D extent;
+	std::vector<Level> levels;
+};
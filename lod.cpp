@@ -0,0 +1,241 @@
+#include "lod.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+	/// <summary>
+	/// Symmetric 4x4 matrix summing squared distances to a set of planes (upper triangle stored)
+	/// </summary>
+	struct Quadric {
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+		static Quadric fromPlane(const glm::dvec3& normal, double distance) {
+			return {
+				normal.x * normal.x, normal.x * normal.y, normal.x * normal.z, normal.x * distance,
+				normal.y * normal.y, normal.y * normal.z, normal.y * distance,
+				normal.z * normal.z, normal.z * distance,
+				distance * distance };
+		}
+
+		Quadric& operator+=(const Quadric& other) {
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad; b2 += other.b2;
+			bc += other.bc; bd += other.bd; c2 += other.c2; cd += other.cd; d2 += other.d2;
+			return *this;
+		}
+
+		double error(const glm::dvec3& p) const {
+			double result =
+				a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x +
+				b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y +
+				c2 * p.z * p.z + 2 * cd * p.z +
+				d2;
+			return std::max(result, 0.0); // Rounding may take it slightly below zero
+		}
+	};
+
+	/// <summary>
+	/// Candidate collapse of vertex from into vertex to, valid while neither vertex changed since it was queued
+	/// </summary>
+	struct Collapse {
+		double cost;
+		double length_squared; // Breaks ties (e.g. on flat areas) in favour of short edges, which keeps triangles evenly sized
+		uint32_t from;
+		uint32_t to;
+		uint32_t from_version;
+		uint32_t to_version;
+
+		bool operator>(const Collapse& other) const { return cost != other.cost ? cost > other.cost : length_squared > other.length_squared; }
+	};
+
+	uint64_t edgeKey(uint32_t a, uint32_t b) { return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b); }
+
+	glm::dvec3 position(const Vertex& vertex) { return { vertex.pos.x, vertex.pos.y, 0.0 }; } // Model space is the z = 0 plane
+}
+
+std::vector<uint32_t>
+LodUtils::simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const DrawRange& range, uint32_t target_index_count, float& error) {
+	error = 0.0f;
+
+	// Work on the vertices the range uses, renumbered densely
+	std::unordered_map<uint32_t, uint32_t> local_ids;
+	std::vector<uint32_t> original_ids;
+	std::vector<std::array<uint32_t, 3>> triangles(range.index_count / 3);
+	for (uint32_t i = 0; i < triangles.size() * 3; i++) {
+		uint32_t index = indices[range.first_index + i];
+		auto [entry, inserted] = local_ids.try_emplace(index, static_cast<uint32_t>(original_ids.size()));
+		if (inserted) original_ids.push_back(index);
+		triangles[i / 3][i % 3] = entry->second;
+	}
+	uint32_t vertex_count = static_cast<uint32_t>(original_ids.size());
+	std::vector<glm::dvec3> positions(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; v++) positions[v] = position(vertices[original_ids[v] + range.vertex_offset]);
+
+	// Vertices sharing a position with another vertex lie on an attribute seam, removing them would tear the seam open
+	std::vector<bool> locked(vertex_count, false);
+	std::unordered_map<uint64_t, uint32_t> position_owners;
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		const glm::vec2& pos = vertices[original_ids[v] + range.vertex_offset].pos;
+		uint64_t key;
+		std::memcpy(&key, &pos, sizeof(key));
+		auto [owner, inserted] = position_owners.try_emplace(key, v);
+		if (!inserted) locked[v] = locked[owner->second] = true;
+	}
+
+	// Each vertex starts with the planes of its triangles, border edges add a plane perpendicular to their triangle so
+	// the outline of the mesh is kept as well
+	std::vector<Quadric> quadrics(vertex_count);
+	std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+	std::unordered_map<uint64_t, uint32_t> edge_uses;
+	std::vector<bool> removed(triangles.size(), false);
+	uint32_t live_triangles = 0;
+	for (uint32_t t = 0; t < triangles.size(); t++) {
+		const auto& triangle = triangles[t];
+		if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) { removed[t] = true; continue; }
+		live_triangles++;
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			vertex_triangles[triangle[corner]].push_back(t);
+			edge_uses[edgeKey(triangle[corner], triangle[(corner + 1) % 3])]++;
+		}
+	}
+	for (uint32_t t = 0; t < triangles.size(); t++) {
+		if (removed[t]) continue;
+		const auto& triangle = triangles[t];
+		glm::dvec3 normal = glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+		double length = glm::length(normal);
+		if (length == 0.0) continue;
+		normal /= length;
+		Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, positions[triangle[0]]));
+		for (uint32_t corner = 0; corner < 3; corner++) quadrics[triangle[corner]] += plane;
+
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint32_t a = triangle[corner], b = triangle[(corner + 1) % 3];
+			if (edge_uses[edgeKey(a, b)] != 1) continue;
+			glm::dvec3 border_normal = glm::cross(positions[b] - positions[a], normal);
+			double border_length = glm::length(border_normal);
+			if (border_length == 0.0) continue;
+			border_normal /= border_length;
+			Quadric border = Quadric::fromPlane(border_normal, -glm::dot(border_normal, positions[a]));
+			quadrics[a] += border;
+			quadrics[b] += border;
+		}
+	}
+
+	std::vector<uint32_t> versions(vertex_count, 0);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+	auto queueCollapse = [&](uint32_t from, uint32_t to) {
+		if (locked[from]) return;
+		Quadric combined = quadrics[from];
+		combined += quadrics[to];
+		glm::dvec3 edge = positions[to] - positions[from];
+		queue.push({ combined.error(positions[to]), glm::dot(edge, edge), from, to, versions[from], versions[to] });
+	};
+	for (uint32_t t = 0; t < triangles.size(); t++) {
+		if (removed[t]) continue;
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			queueCollapse(triangles[t][corner], triangles[t][(corner + 1) % 3]);
+			queueCollapse(triangles[t][(corner + 1) % 3], triangles[t][corner]);
+		}
+	}
+
+	double max_cost = 0.0;
+	while (live_triangles * 3 > target_index_count && !queue.empty()) {
+		Collapse collapse = queue.top();
+		queue.pop();
+		if (collapse.from_version != versions[collapse.from] || collapse.to_version != versions[collapse.to]) continue; // Stale
+
+		// Reject collapses that would flip a triangle around the moved vertex
+		bool flips = false;
+		bool adjacent = false;
+		for (uint32_t t : vertex_triangles[collapse.from]) {
+			if (removed[t]) continue;
+			const auto& triangle = triangles[t];
+			if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) { adjacent = true; continue; }
+			glm::dvec3 moved[3];
+			for (uint32_t corner = 0; corner < 3; corner++) moved[corner] = triangle[corner] == collapse.from ? positions[collapse.to] : positions[triangle[corner]];
+			glm::dvec3 before = glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+			glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, after) <= 0.0) { flips = true; break; }
+		}
+		if (flips || !adjacent) continue;
+
+		quadrics[collapse.to] += quadrics[collapse.from];
+		for (uint32_t t : vertex_triangles[collapse.from]) {
+			if (removed[t]) continue;
+			auto& triangle = triangles[t];
+			if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+				removed[t] = true;
+				live_triangles--;
+				continue;
+			}
+			for (uint32_t& corner : triangle) {
+				if (corner == collapse.from) corner = collapse.to;
+			}
+			vertex_triangles[collapse.to].push_back(t);
+		}
+		vertex_triangles[collapse.from].clear();
+		versions[collapse.from]++;
+		versions[collapse.to]++;
+		max_cost = std::max(max_cost, collapse.cost);
+
+		// Collapses involving the surviving vertex now use its combined quadric
+		auto& to_triangles = vertex_triangles[collapse.to];
+		to_triangles.erase(std::remove_if(to_triangles.begin(), to_triangles.end(), [&](uint32_t t) { return removed[t]; }), to_triangles.end());
+		for (uint32_t t : to_triangles) {
+			for (uint32_t neighbour : triangles[t]) {
+				if (neighbour == collapse.to) continue;
+				queueCollapse(collapse.to, neighbour);
+				queueCollapse(neighbour, collapse.to);
+			}
+		}
+	}
+
+	// The quadric sums squared distances to several planes, so its square root bounds the distance to any one of them
+	error = static_cast<float>(std::sqrt(max_cost));
+	std::vector<uint32_t> result;
+	result.reserve(static_cast<size_t>(live_triangles) * 3);
+	for (uint32_t t = 0; t < triangles.size(); t++) {
+		if (removed[t]) continue;
+		for (uint32_t corner : triangles[t]) result.push_back(original_ids[corner]);
+	}
+	return result;
+}
+
+LodChain
+LodUtils::buildLodChain(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const DrawRange& range, uint32_t max_level_count, float reduction) {
+	LodChain chain;
+	chain.indices = indices;
+	chain.levels.push_back({ range, 0.0f });
+
+	while (chain.levels.size() < max_level_count) {
+		// Each level is simplified from the previous one, errors accumulate along the chain
+		const LodLevel previous = chain.levels.back();
+		uint32_t target = static_cast<uint32_t>(previous.range.index_count / 3 * reduction) * 3;
+		float level_error;
+		std::vector<uint32_t> level_indices = simplify(vertices, chain.indices, previous.range, target, level_error);
+		if (level_indices.empty() || level_indices.size() > previous.range.index_count * 0.95f) break; // Nothing more to gain
+
+		DrawRange level_range{ static_cast<uint32_t>(chain.indices.size()), static_cast<uint32_t>(level_indices.size()), range.vertex_offset };
+		chain.indices.insert(chain.indices.end(), level_indices.begin(), level_indices.end());
+		chain.levels.push_back({ level_range, previous.error + level_error });
+	}
+	return chain;
+}
+
+uint32_t
+LodUtils::selectLod(const std::vector<LodLevel>& levels, uint32_t current, float pixels_per_unit, float max_error_pixels, float hysteresis) {
+	current = std::min(current, static_cast<uint32_t>(levels.size()) - 1);
+	auto coarsestWithin = [&](float limit) {
+		uint32_t level = 0;
+		while (level + 1 < levels.size() && levels[level + 1].error * pixels_per_unit <= limit) level++;
+		return level;
+	};
+
+	// Too coarse: refine straight away, as visible error matters more than switching cost
+	if (levels[current].error * pixels_per_unit > max_error_pixels) return coarsestWithin(max_error_pixels);
+	return std::max(current, coarsestWithin(max_error_pixels * (1.0f - hysteresis)));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Index buffer of a model with its coarser levels of detail appended after the original indices
+/// </summary>
+struct LodChain {
+	std::vector<uint32_t> indices;
+	/// <summary>
+	/// Ranges of indices, finest (the original range) first
+	/// </summary>
+	std::vector<LodLevel> levels;
+};
+
+class LodUtils {
+public:
+	/// <summary>
+	/// Fraction of a level's triangles kept by the next level of a chain
+	/// </summary>
+	static constexpr float DEFAULT_REDUCTION = 0.5f;
+
+	/// <summary>
+	/// Simplify a range of triangles by collapsing edges into one of their vertices in order of quadric error
+	/// (Garland and Heckbert), so the result only references existing vertices. Mesh and UV seam borders are preserved
+	/// </summary>
+	/// <param name="vertices">Vertex buffer the range indexes into</param>
+	/// <param name="indices">Index buffer holding the range</param>
+	/// <param name="range">Triangles to simplify</param>
+	/// <param name="target_index_count">Number of indices to stop at (fewer may be impossible without flipping triangles)</param>
+	/// <param name="error">Set to an estimate of the largest distance any surface point moved by, in model units</param>
+	/// <returns>Indices of the simplified triangles, relative to range.vertex_offset like the input</returns>
+	static std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const DrawRange& range, uint32_t target_index_count, float& error);
+	/// <summary>
+	/// Build a chain of progressively simplified levels of a range, stopping early once simplification stalls
+	/// </summary>
+	/// <param name="vertices">Vertex buffer shared by every level</param>
+	/// <param name="indices">Index buffer holding the range</param>
+	/// <param name="range">Triangles of the finest level</param>
+	/// <param name="max_level_count">Maximum number of levels, including the finest</param>
+	/// <param name="reduction">Fraction of triangles each level keeps from the previous one</param>
+	static LodChain buildLodChain(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const DrawRange& range, uint32_t max_level_count, float reduction = DEFAULT_REDUCTION);
+	/// <summary>
+	/// Pick the coarsest level whose error covers at most max_error_pixels on screen. Switching to a coarser level
+	/// additionally requires its error to be a hysteresis fraction below the limit, so that objects near a threshold do
+	/// not alternate between levels every frame
+	/// </summary>
+	/// <param name="levels">Levels of detail, errors increasing</param>
+	/// <param name="current">Level drawn last frame</param>
+	/// <param name="pixels_per_unit">Screen pixels covered by one model unit at the object's distance</param>
+	/// <param name="max_error_pixels">Largest acceptable error on screen</param>
+	/// <param name="hysteresis">Fraction of max_error_pixels a coarser level must stay under to be switched to</param>
+	static uint32_t selectLod(const std::vector<LodLevel>& levels, uint32_t current, float pixels_per_unit, float max_error_pixels, float hysteresis = 0.25f);
+};
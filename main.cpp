@@ -1,14 +1,200 @@
+#include "benchmark.hpp"
 #include "core_app.hpp"
+#include "image.hpp"
+#include "regression.hpp"
+#include "self_test.hpp"
 
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
 
-int main() {
-	CoreApp app;
+/// <summary>
+/// Options controlling what the executable does on startup, as parsed from the command line
+/// </summary>
+struct LaunchOptions {
+	AppSettings settings;
+	bool benchmark = false;
+	bool culling_benchmark = false;
+	bool transform_benchmark = false;
+	bool self_test = false;
+	uint32_t seed = 1;
+	std::string output_path; // Empty writes to stdout
+	std::string scene_filter;
+	std::string compare_expected; // Non-empty compares two images instead of rendering
+	std::string compare_actual;
+	std::string diff_path; // Empty writes no diff image
+	double threshold = ImageUtils::DEFAULT_THRESHOLD;
+	std::optional<double> tolerance; // Fraction of pixels allowed to differ, defaulting to none when comparing two images
+	std::string regression_directory; // Non-empty runs the regression suite against the references in this directory
+	bool update_baselines = false;
+	std::optional<double> regression_threshold;
+};
+
+/// <summary>
+/// Fill launch options from command line arguments
+/// (--headless, --frames N, --width N, --height N, --indirect, --gpu-culling, --validate-culling, --cpu-culling,
+/// --texture-budget MB, --texture-demo, --texture PATH, --mesh PATH, --mesh-cache DIR, --mesh-cache-size MB, --lod-error PIXELS, --depth-prepass, --sort-draws, --msaa SAMPLES, --frame-budget MS, --min-render-scale SCALE, --memory-report FRAMES, --capture-every N, --capture-dir DIR, --capture-raw, --device NAME|UUID, --workers N, --pin-threads, --benchmark, --culling-benchmark, --transform-benchmark, --self-test, --seed N, --output PATH, --scene NAME,
+/// --compare EXPECTED ACTUAL, --threshold DELTA, --tolerance FRACTION, --diff PATH, --regression DIR, --update-baselines,
+/// --regression-threshold FRACTION)
+/// </summary>
+/// <returns>Options to start the application with</returns>
+static LaunchOptions parseArguments(int argc, char* argv[]) {
+	LaunchOptions options{};
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+		if (std::strcmp(argv[i], "--headless") == 0) options.settings.headless = true;
+		else if (std::strcmp(argv[i], "--frames") == 0 && has_value) options.settings.frame_limit = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--width") == 0 && has_value) options.settings.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--height") == 0 && has_value) options.settings.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--indirect") == 0) options.settings.indirect_draws = true;
+		else if (std::strcmp(argv[i], "--gpu-culling") == 0) options.settings.gpu_culling = true;
+		else if (std::strcmp(argv[i], "--validate-culling") == 0) options.settings.gpu_culling = options.settings.validate_culling = true;
+		else if (std::strcmp(argv[i], "--cpu-culling") == 0) options.settings.cpu_culling = true;
+		else if (std::strcmp(argv[i], "--texture-budget") == 0 && has_value) options.settings.texture_budget = std::stoull(argv[++i]) * 1024 * 1024;
+		else if (std::strcmp(argv[i], "--texture-demo") == 0) options.settings.texture_demo = true;
+		else if (std::strcmp(argv[i], "--texture") == 0 && has_value) options.settings.texture_path = argv[++i];
+		else if (std::strcmp(argv[i], "--mesh") == 0 && has_value) options.settings.mesh_path = argv[++i];
+		else if (std::strcmp(argv[i], "--mesh-cache") == 0 && has_value) options.settings.mesh_cache_directory = argv[++i];
+		else if (std::strcmp(argv[i], "--mesh-cache-size") == 0 && has_value) options.settings.mesh_cache_size = std::stoull(argv[++i]) * 1024 * 1024;
+		else if (std::strcmp(argv[i], "--lod-error") == 0 && has_value) options.settings.lod_error_pixels = std::stof(argv[++i]);
+		else if (std::strcmp(argv[i], "--depth-prepass") == 0) options.settings.depth_prepass = true;
+		else if (std::strcmp(argv[i], "--sort-draws") == 0) options.settings.sort_draws = true;
+		else if (std::strcmp(argv[i], "--msaa") == 0 && has_value) options.settings.msaa_samples = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--frame-budget") == 0 && has_value) options.settings.frame_budget_ms = std::stod(argv[++i]);
+		else if (std::strcmp(argv[i], "--min-render-scale") == 0 && has_value) options.settings.min_render_scale = std::stof(argv[++i]);
+		else if (std::strcmp(argv[i], "--memory-report") == 0 && has_value) options.settings.memory_report_interval = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--capture-every") == 0 && has_value) options.settings.capture_interval = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--capture-dir") == 0 && has_value) options.settings.capture_directory = argv[++i];
+		else if (std::strcmp(argv[i], "--capture-raw") == 0) options.settings.capture_raw = true;
+		else if (std::strcmp(argv[i], "--device") == 0 && has_value) options.settings.device = argv[++i];
+		else if (std::strcmp(argv[i], "--workers") == 0 && has_value) options.settings.worker_threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--pin-threads") == 0) options.settings.pin_threads = true;
+		else if (std::strcmp(argv[i], "--benchmark") == 0) options.benchmark = true;
+		else if (std::strcmp(argv[i], "--culling-benchmark") == 0) options.culling_benchmark = true;
+		else if (std::strcmp(argv[i], "--transform-benchmark") == 0) options.transform_benchmark = true;
+		else if (std::strcmp(argv[i], "--self-test") == 0) options.self_test = true;
+		else if (std::strcmp(argv[i], "--seed") == 0 && has_value) options.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (std::strcmp(argv[i], "--output") == 0 && has_value) options.output_path = argv[++i];
+		else if (std::strcmp(argv[i], "--scene") == 0 && has_value) options.scene_filter = argv[++i];
+		else if (std::strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+			options.compare_expected = argv[++i];
+			options.compare_actual = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--threshold") == 0 && has_value) options.threshold = std::stod(argv[++i]);
+		else if (std::strcmp(argv[i], "--tolerance") == 0 && has_value) options.tolerance = std::stod(argv[++i]);
+		else if (std::strcmp(argv[i], "--diff") == 0 && has_value) options.diff_path = argv[++i];
+		else if (std::strcmp(argv[i], "--regression") == 0 && has_value) options.regression_directory = argv[++i];
+		else if (std::strcmp(argv[i], "--update-baselines") == 0) options.update_baselines = true;
+		else if (std::strcmp(argv[i], "--regression-threshold") == 0 && has_value) options.regression_threshold = std::stod(argv[++i]);
+		else throw std::runtime_error(std::string("Unrecognised argument ") + argv[i]);
+	}
+	return options;
+}
+
+/// <summary>
+/// Run the benchmark suite (or one of the CPU microbenchmarks), writing its JSON results to the requested output
+/// </summary>
+static int runBenchmark(const LaunchOptions& options) {
+	Benchmark benchmark(options.settings, options.seed);
+	auto runSelected = [&](std::ostream& output) {
+		if (options.culling_benchmark) benchmark.runCulling(output);
+		else if (options.transform_benchmark) benchmark.runTransforms(output);
+		else benchmark.run(output, options.scene_filter);
+	};
+	if (options.output_path.empty()) {
+		runSelected(std::cout);
+	} else {
+		std::ofstream output(options.output_path);
+		if (!output.is_open()) throw std::runtime_error("Failed to open benchmark output " + options.output_path);
+		runSelected(output);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Compare two PNG images perceptually, e.g. a captured frame against a reference, optionally writing where they differ
+/// </summary>
+/// <returns>Success if at most the tolerated fraction of pixels differs</returns>
+static int runComparison(const LaunchOptions& options) {
+	RgbaImage expected = ImageUtils::readPng(options.compare_expected);
+	RgbaImage actual = ImageUtils::readPng(options.compare_actual);
+	RgbaImage diff;
+	ImageComparison comparison = ImageUtils::compare(expected, actual, options.threshold, options.diff_path.empty() ? nullptr : &diff);
+	if (!options.diff_path.empty()) ImageUtils::writePng(options.diff_path, diff);
+
+	bool matches = comparison.differing_fraction <= options.tolerance.value_or(0.0);
+	std::cout << (matches ? "Images match: " : "Images differ: ") << comparison.differing_pixels << " pixels ("
+		<< comparison.differing_fraction * 100.0 << "%) differ, max delta " << comparison.max_delta << ", mean delta " << comparison.mean_delta << std::endl;
+	return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// <summary>
+/// Check the reference scenes against their golden images and performance baselines, or record new ones
+/// </summary>
+/// <returns>Success if every check passed</returns>
+static int runRegression(const LaunchOptions& options) {
+	RegressionSettings regression_settings;
+	regression_settings.pixel_threshold = options.threshold;
+	if (options.tolerance) regression_settings.image_tolerance = *options.tolerance;
+	if (options.regression_threshold) regression_settings.performance_threshold = *options.regression_threshold;
+	regression_settings.update = options.update_baselines;
+	RegressionSuite suite(options.settings, options.regression_directory, regression_settings);
+	return suite.run(std::cout, options.scene_filter) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+	LaunchOptions options = parseArguments(argc, argv);
+
+	if (options.self_test) {
+		try {
+			return SelfTest(std::cout).run() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!options.compare_expected.empty()) {
+		try {
+			return runComparison(options);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!options.regression_directory.empty()) {
+		try {
+			return runRegression(options);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (options.benchmark || options.culling_benchmark || options.transform_benchmark) {
+		try {
+			return runBenchmark(options);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	CoreApp app(options.settings);
 
 	app.printSupportedExtensions();
 
 	try {
 		app.run();
+		if (options.settings.validate_culling) std::cout << "GPU culling matched the CPU reference in " << app.getValidatedCullingFrames() << " frames" << std::endl;
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
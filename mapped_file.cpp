@@ -0,0 +1,63 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+	file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open file " + path);
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file_handle, &file_size);
+	size_ = static_cast<size_t>(file_size.QuadPart);
+	if (size_ == 0) return; // Empty files cannot be mapped
+
+	mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle != nullptr) data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (data_ == nullptr) {
+		if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		throw std::runtime_error("Failed to map file " + path);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (data_ != nullptr) UnmapViewOfFile(data_);
+	if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+	CloseHandle(file_handle);
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) throw std::runtime_error("Failed to open file " + path);
+	struct stat file_status;
+	if (fstat(descriptor, &file_status) != 0) {
+		close(descriptor);
+		throw std::runtime_error("Failed to read size of file " + path);
+	}
+	size_ = static_cast<size_t>(file_status.st_size);
+	if (size_ > 0) {
+		void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (mapping == MAP_FAILED) {
+			close(descriptor);
+			throw std::runtime_error("Failed to map file " + path);
+		}
+		data_ = static_cast<const unsigned char*>(mapping);
+	}
+	close(descriptor); // The mapping stays valid without the descriptor
+}
+
+MappedFile::~MappedFile() {
+	if (data_ != nullptr) munmap(const_cast<unsigned char*>(data_), size_);
+}
+#endif
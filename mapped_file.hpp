@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// <summary>
+/// Read-only memory mapping of a whole file. Pages are loaded by the OS on first access, so only the ranges actually
+/// read cost I/O and nothing is copied into an intermediate buffer
+/// </summary>
+class MappedFile {
+public:
+	/// <summary>
+	/// Map the file at the given path, throwing if it cannot be opened
+	/// </summary>
+	MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const unsigned char* data() const { return data_; }
+	size_t size() const { return size_; }
+
+private:
+	const unsigned char* data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,193 @@
+#include "memory_tracker.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+VkDeviceSize
+MemorySnapshot::allocatedBytes() const {
+	VkDeviceSize total = 0;
+	for (const HeapUsage& heap : heaps) total += heap.allocated_bytes;
+	return total;
+}
+
+VkDeviceSize
+MemorySnapshot::deviceLocalBytes() const {
+	VkDeviceSize total = 0;
+	for (const HeapUsage& heap : heaps) {
+		if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) total += heap.allocated_bytes;
+	}
+	return total;
+}
+
+void
+MemoryTracker::init(VkPhysicalDevice physical_device, bool memory_budget) {
+	std::lock_guard<std::mutex> lock(mutex);
+	this->physical_device = physical_device;
+	this->memory_budget = memory_budget;
+
+	VkPhysicalDeviceMemoryProperties properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &properties);
+	type_heaps.resize(properties.memoryTypeCount);
+	for (uint32_t i = 0; i < properties.memoryTypeCount; i++) type_heaps[i] = properties.memoryTypes[i].heapIndex;
+	heaps.resize(properties.memoryHeapCount);
+	for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+		heaps[i].size = properties.memoryHeaps[i].size;
+		heaps[i].flags = properties.memoryHeaps[i].flags;
+	}
+	heap_warned.assign(heaps.size(), false);
+
+	budget_callback = [](uint32_t heap, const HeapUsage& usage) {
+		std::cerr << "Warning: memory heap " << heap << " is using " << usage.process_usage / (1024 * 1024) << " of its "
+			<< usage.budget / (1024 * 1024) << " MiB budget" << std::endl;
+	};
+}
+
+void
+MemoryTracker::recordAllocation(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type, MemoryCategory category) {
+	std::unique_lock<std::mutex> lock(mutex);
+	uint32_t heap_index = type_heaps[memory_type];
+	allocations[memory] = { size, heap_index, category };
+	total_allocations++;
+
+	HeapUsage& heap = heaps[heap_index];
+	heap.allocated_bytes += size;
+	heap.peak_bytes = std::max(heap.peak_bytes, heap.allocated_bytes);
+	heap.allocation_count++;
+	CategoryUsage& usage = categories[static_cast<size_t>(category)];
+	usage.bytes += size;
+	usage.peak_bytes = std::max(usage.peak_bytes, usage.bytes);
+	usage.allocation_count++;
+
+	// Frees only re-arm the warning, so the budget is only queried when allocating
+	std::vector<HeapUsage> current = heaps;
+	queryBudgets(current);
+	std::vector<uint32_t> exceeded;
+	for (uint32_t i = 0; i < current.size(); i++) {
+		bool near_budget = current[i].budget > 0 && current[i].process_usage > current[i].budget * WARNING_FRACTION;
+		if (near_budget && !heap_warned[i]) exceeded.push_back(i);
+		heap_warned[i] = near_budget;
+	}
+	BudgetCallback callback = budget_callback;
+	lock.unlock();
+
+	if (callback) {
+		for (uint32_t i : exceeded) callback(i, current[i]);
+	}
+}
+
+void
+MemoryTracker::recordFree(VkDeviceMemory memory) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto allocation = allocations.find(memory);
+	if (allocation == allocations.end()) return;
+
+	HeapUsage& heap = heaps[allocation->second.heap];
+	heap.allocated_bytes -= allocation->second.size;
+	heap.allocation_count--;
+	CategoryUsage& usage = categories[static_cast<size_t>(allocation->second.category)];
+	usage.bytes -= allocation->second.size;
+	usage.allocation_count--;
+	allocations.erase(allocation);
+	total_frees++;
+}
+
+MemorySnapshot
+MemoryTracker::snapshot() {
+	std::lock_guard<std::mutex> lock(mutex);
+	MemorySnapshot result;
+	result.heaps = heaps;
+	result.categories = categories;
+	result.budget_queried = queryBudgets(result.heaps);
+	result.total_allocations = total_allocations;
+	result.total_frees = total_frees;
+	return result;
+}
+
+void
+MemoryTracker::setBudgetCallback(BudgetCallback callback) {
+	std::lock_guard<std::mutex> lock(mutex);
+	budget_callback = std::move(callback);
+}
+
+size_t
+MemoryTracker::getLiveAllocationCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return allocations.size();
+}
+
+bool
+MemoryTracker::queryBudgets(std::vector<HeapUsage>& usage) {
+	if (memory_budget) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+		budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budget_properties;
+		vkGetPhysicalDeviceMemoryProperties2(physical_device, &properties);
+		for (uint32_t i = 0; i < usage.size(); i++) {
+			usage[i].budget = budget_properties.heapBudget[i];
+			// The driver may not have accounted for an allocation just made yet
+			usage[i].process_usage = std::max(budget_properties.heapUsage[i], usage[i].allocated_bytes);
+		}
+		return true;
+	}
+
+	for (HeapUsage& heap : usage) {
+		heap.budget = heap.size;
+		heap.process_usage = heap.allocated_bytes;
+	}
+	return false;
+}
+
+const char*
+MemoryTracker::categoryName(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::Vertex: return "vertex";
+	case MemoryCategory::Index: return "index";
+	case MemoryCategory::Indirect: return "indirect";
+	case MemoryCategory::Uniform: return "uniform";
+	case MemoryCategory::Storage: return "storage";
+	case MemoryCategory::Staging: return "staging";
+	case MemoryCategory::Readback: return "readback";
+	case MemoryCategory::Texture: return "texture";
+	case MemoryCategory::Attachment: return "attachment";
+	default: return "unknown";
+	}
+}
+
+MemoryCategory
+MemoryTracker::bufferCategory(VkBufferUsageFlags usage) {
+	if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) return MemoryCategory::Indirect;
+	if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) return MemoryCategory::Index;
+	if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) return MemoryCategory::Vertex;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) return MemoryCategory::Uniform;
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) return MemoryCategory::Storage;
+	if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) return MemoryCategory::Staging;
+	return MemoryCategory::Readback;
+}
+
+void
+MemoryTracker::print(std::ostream& output, const MemorySnapshot& snapshot) {
+	constexpr double MIB = 1024.0 * 1024.0;
+	std::ios_base::fmtflags flags = output.flags();
+	std::streamsize precision = output.precision();
+	output << std::fixed << std::setprecision(2);
+	output << "Device memory (" << snapshot.total_allocations - snapshot.total_frees << " live allocations, "
+		<< (snapshot.budget_queried ? "driver budget" : "budget is heap size") << ")\n";
+	for (uint32_t i = 0; i < snapshot.heaps.size(); i++) {
+		const HeapUsage& heap = snapshot.heaps[i];
+		output << "  heap " << i << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : " (host)")
+			<< ": " << heap.allocated_bytes / MIB << " MiB in " << heap.allocation_count << " allocations, peak "
+			<< heap.peak_bytes / MIB << " MiB, process usage " << heap.process_usage / MIB << " of "
+			<< heap.budget / MIB << " MiB budget\n";
+	}
+	for (size_t i = 0; i < snapshot.categories.size(); i++) {
+		const CategoryUsage& usage = snapshot.categories[i];
+		if (usage.peak_bytes == 0) continue;
+		output << "  " << categoryName(static_cast<MemoryCategory>(i)) << ": " << usage.bytes / MIB << " MiB in "
+			<< usage.allocation_count << " allocations, peak " << usage.peak_bytes / MIB << " MiB\n";
+	}
+	output.flags(flags);
+	output.precision(precision);
+}
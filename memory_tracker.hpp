@@ -0,0 +1,165 @@
+#pragma once
+
+#include "window.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// What a device memory allocation holds, used to break down memory usage
+/// </summary>
+enum class MemoryCategory {
+	Vertex,
+	Index,
+	Indirect,
+	Uniform,
+	Storage,
+	Staging, // Host visible memory only used as a transfer source
+	Readback, // Host visible memory the GPU writes for the CPU to read
+	Texture,
+	Attachment,
+	Count
+};
+
+/// <summary>
+/// Memory usage of a single memory heap
+/// </summary>
+struct HeapUsage {
+	VkDeviceSize size;
+	VkMemoryHeapFlags flags;
+	/// <summary>
+	/// Bytes currently allocated from the heap by this application
+	/// </summary>
+	VkDeviceSize allocated_bytes = 0;
+	/// <summary>
+	/// Most bytes allocated from the heap at any one time
+	/// </summary>
+	VkDeviceSize peak_bytes = 0;
+	uint32_t allocation_count = 0;
+	/// <summary>
+	/// Bytes the process can allocate from the heap before allocations may fail or hurt performance.
+	/// Reported by VK_EXT_memory_budget when available, the heap size otherwise
+	/// </summary>
+	VkDeviceSize budget = 0;
+	/// <summary>
+	/// Bytes of the heap in use by the process as reported by VK_EXT_memory_budget, including memory allocated by the driver.
+	/// Equal to <c>allocated_bytes</c> without the extension
+	/// </summary>
+	VkDeviceSize process_usage = 0;
+};
+
+/// <summary>
+/// Memory usage of a single allocation category
+/// </summary>
+struct CategoryUsage {
+	VkDeviceSize bytes = 0;
+	VkDeviceSize peak_bytes = 0;
+	uint32_t allocation_count = 0;
+};
+
+/// <summary>
+/// Memory usage at a point in time, by heap and by category
+/// </summary>
+struct MemorySnapshot {
+	std::vector<HeapUsage> heaps;
+	std::array<CategoryUsage, static_cast<size_t>(MemoryCategory::Count)> categories;
+	/// <summary>
+	/// Whether heap budgets and usage came from VK_EXT_memory_budget
+	/// </summary>
+	bool budget_queried = false;
+	/// <summary>
+	/// Allocations made and freed since the tracker was initialised
+	/// </summary>
+	uint64_t total_allocations = 0;
+	uint64_t total_frees = 0;
+
+	/// <summary>
+	/// Bytes currently allocated across all heaps
+	/// </summary>
+	VkDeviceSize allocatedBytes() const;
+	/// <summary>
+	/// Bytes currently allocated from device local heaps
+	/// </summary>
+	VkDeviceSize deviceLocalBytes() const;
+};
+
+/// <summary>
+/// Tracks every device memory allocation by heap and category, and warns when the usage of a heap nears its budget.
+/// Thread safe, as allocations are made from both the render thread and the texture streaming thread
+/// </summary>
+class MemoryTracker {
+public:
+	/// <summary>
+	/// Fraction of a heap's budget above which the budget callback is invoked.
+	/// It is invoked once per crossing, being re-armed when usage drops back below
+	/// </summary>
+	static constexpr double WARNING_FRACTION = 0.9;
+
+	using BudgetCallback = std::function<void(uint32_t heap, const HeapUsage& usage)>;
+
+	/// <param name="physical_device">Device whose heaps allocations are made from</param>
+	/// <param name="memory_budget">Whether VK_EXT_memory_budget is enabled, allowing the driver's budget to be queried</param>
+	void init(VkPhysicalDevice physical_device, bool memory_budget);
+
+	/// <summary>
+	/// Account for memory allocated from the given memory type
+	/// </summary>
+	void recordAllocation(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type, MemoryCategory category);
+	/// <summary>
+	/// Account for the freeing of memory passed to <c>recordAllocation</c>, freeing untracked memory is ignored
+	/// </summary>
+	void recordFree(VkDeviceMemory memory);
+
+	/// <summary>
+	/// Current usage, querying the driver's budgets if possible
+	/// </summary>
+	MemorySnapshot snapshot();
+	/// <summary>
+	/// Replace the function invoked when a heap's usage nears its budget (by default a warning is printed).
+	/// The callback is invoked by the allocating thread, outside of the tracker's lock
+	/// </summary>
+	void setBudgetCallback(BudgetCallback callback);
+	/// <summary>
+	/// Number of allocations not yet freed
+	/// </summary>
+	size_t getLiveAllocationCount();
+
+	static const char* categoryName(MemoryCategory category);
+	/// <summary>
+	/// Category of a buffer with the given usage, going by the most specific usage flag
+	/// </summary>
+	static MemoryCategory bufferCategory(VkBufferUsageFlags usage);
+	/// <summary>
+	/// Print a human readable breakdown of the snapshot
+	/// </summary>
+	static void print(std::ostream& output, const MemorySnapshot& snapshot);
+
+private:
+	struct Allocation {
+		VkDeviceSize size;
+		uint32_t heap;
+		MemoryCategory category;
+	};
+
+	std::mutex mutex;
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	bool memory_budget = false;
+	std::vector<uint32_t> type_heaps; // Heap index of each memory type
+	std::vector<HeapUsage> heaps;
+	std::vector<bool> heap_warned;
+	std::array<CategoryUsage, static_cast<size_t>(MemoryCategory::Count)> categories;
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	uint64_t total_allocations = 0;
+	uint64_t total_frees = 0;
+	BudgetCallback budget_callback;
+
+	/// <summary>
+	/// Fill in budgets and process usage of the heaps, returning whether they came from the driver
+	/// </summary>
+	bool queryBudgets(std::vector<HeapUsage>& usage);
+};
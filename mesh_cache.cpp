@@ -0,0 +1,195 @@
+#include "mesh_cache.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+	constexpr char ENTRY_MAGIC[4] = { 'V', 'T', 'M', 'C' };
+
+	/// <summary>
+	/// Start of every entry, followed by the vertices, indices, levels of detail and meshlets it counts
+	/// </summary>
+	struct EntryHeader {
+		char magic[4];
+		uint32_t format_version;
+		uint32_t vertex_size; // Guards against the vertex layout changing without a format version bump
+		uint32_t vertex_count;
+		uint32_t index_count;
+		uint32_t lod_count;
+		uint32_t meshlet_count;
+		uint32_t padding;
+		uint64_t key;
+	};
+
+	/// <summary>
+	/// 64-bit FNV-1a, continuing from the given hash
+	/// </summary>
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	size_t entrySize(const EntryHeader& header) {
+		return sizeof(EntryHeader) + sizeof(Vertex) * static_cast<size_t>(header.vertex_count) + sizeof(uint32_t) * static_cast<size_t>(header.index_count)
+			+ sizeof(LodLevel) * static_cast<size_t>(header.lod_count) + sizeof(Meshlet) * static_cast<size_t>(header.meshlet_count);
+	}
+
+	template<typename T>
+	const unsigned char* readArray(const unsigned char* source, std::vector<T>& destination, uint32_t count) {
+		destination.resize(count);
+		if (count > 0) memcpy(destination.data(), source, sizeof(T) * count);
+		return source + sizeof(T) * count;
+	}
+
+	template<typename T>
+	void writeArray(std::ofstream& output, const std::vector<T>& source) {
+		output.write(reinterpret_cast<const char*>(source.data()), static_cast<std::streamsize>(sizeof(T) * source.size()));
+	}
+}
+
+MeshCache::MeshCache(const std::string& directory, uint64_t size_limit) : directory{ directory }, size_limit{ size_limit } {
+	std::error_code error;
+	std::filesystem::create_directories(this->directory, error);
+	if (error) std::cerr << "Warning: failed to create mesh cache directory " << directory << ": " << error.message() << std::endl;
+}
+
+uint64_t
+MeshCache::computeKey(const unsigned char* source, size_t size, uint32_t importer_version, const ModelImportSettings& import_settings) {
+	uint64_t hash = hashBytes(0xcbf29ce484222325ull, source, size);
+	uint32_t parameters[] = { FORMAT_VERSION, importer_version, import_settings.lod_count, import_settings.build_meshlets ? 1u : 0u };
+	return hashBytes(hash, parameters, sizeof(parameters));
+}
+
+bool
+MeshCache::load(uint64_t key, ImportedMesh& mesh) {
+	std::filesystem::path path = entryPath(key);
+	std::error_code error;
+	if (!std::filesystem::is_regular_file(path, error)) return false;
+
+	bool valid = false;
+	try {
+		MappedFile file(path.string());
+		EntryHeader header;
+		if (file.size() >= sizeof(EntryHeader)) {
+			memcpy(&header, file.data(), sizeof(EntryHeader));
+			valid = memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0 && header.format_version == FORMAT_VERSION
+				&& header.vertex_size == sizeof(Vertex) && header.key == key && file.size() == entrySize(header);
+		}
+		if (valid) {
+			const unsigned char* data = file.data() + sizeof(EntryHeader);
+			data = readArray(data, mesh.vertices, header.vertex_count);
+			data = readArray(data, mesh.mesh.indices, header.index_count);
+			data = readArray(data, mesh.mesh.lods, header.lod_count);
+			readArray(data, mesh.mesh.meshlets, header.meshlet_count);
+		}
+	}
+	catch (const std::exception&) {
+		valid = false;
+	}
+
+	// The file is unmapped by now, which Windows requires before it can be touched or deleted
+	if (!valid) {
+		std::filesystem::remove(path, error);
+		return false;
+	}
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+	return true;
+}
+
+void
+MeshCache::store(uint64_t key, const ImportedMesh& mesh) {
+	EntryHeader header{};
+	memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+	header.format_version = FORMAT_VERSION;
+	header.vertex_size = sizeof(Vertex);
+	header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+	header.index_count = static_cast<uint32_t>(mesh.mesh.indices.size());
+	header.lod_count = static_cast<uint32_t>(mesh.mesh.lods.size());
+	header.meshlet_count = static_cast<uint32_t>(mesh.mesh.meshlets.size());
+	header.key = key;
+	if (entrySize(header) > size_limit) return;
+
+	// Written beside the entry and renamed over it, so that an interrupted write never leaves a truncated entry behind
+	std::filesystem::path path = entryPath(key);
+	std::filesystem::path temporary_path = path;
+	temporary_path += ".tmp";
+	{
+		std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		writeArray(output, mesh.vertices);
+		writeArray(output, mesh.mesh.indices);
+		writeArray(output, mesh.mesh.lods);
+		writeArray(output, mesh.mesh.meshlets);
+		if (!output) {
+			output.close();
+			std::error_code error;
+			std::filesystem::remove(temporary_path, error);
+			std::cerr << "Warning: failed to write mesh cache entry " << path.string() << std::endl;
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary_path, path, error);
+	if (error) {
+		std::filesystem::remove(temporary_path, error);
+		std::cerr << "Warning: failed to write mesh cache entry " << path.string() << std::endl;
+		return;
+	}
+	evict(path);
+}
+
+uint64_t
+MeshCache::computeSize() {
+	uint64_t size = 0;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error)) {
+		if (entry.path().extension() == EXTENSION) size += entry.file_size(error);
+	}
+	return size;
+}
+
+std::filesystem::path
+MeshCache::entryPath(uint64_t key) const {
+	std::ostringstream name;
+	name << std::hex << std::setfill('0') << std::setw(16) << key << EXTENSION;
+	return directory / name.str();
+}
+
+void
+MeshCache::evict(const std::filesystem::path& keep) {
+	struct Entry {
+		std::filesystem::path path;
+		uint64_t size;
+		std::filesystem::file_time_type last_used;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t total_size = 0;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error)) {
+		if (entry.path().extension() != EXTENSION) continue;
+		uint64_t size = entry.file_size(error);
+		if (error) continue;
+		std::filesystem::file_time_type last_used = entry.last_write_time(error);
+		if (error) continue;
+		entries.push_back({ entry.path(), size, last_used });
+		total_size += size;
+	}
+	if (total_size <= size_limit) return;
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+	for (const Entry& entry : entries) {
+		if (total_size <= size_limit) break;
+		if (entry.path == keep) continue;
+		if (std::filesystem::remove(entry.path, error)) total_size -= entry.size;
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Vertices and processed triangles of an imported mesh, laid out exactly as they are uploaded
+/// </summary>
+struct ImportedMesh {
+	std::vector<Vertex> vertices;
+	ProcessedMesh mesh;
+};
+
+/// <summary>
+/// On-disk cache of processed meshes, so that importing an unchanged file with unchanged settings skips parsing and
+/// processing. Entries are addressed by a hash of the source file's bytes, the importer's version and the import settings,
+/// and hold the vertex and index buffers as uploaded followed by the levels of detail and meshlets. Reading an entry marks
+/// it as most recently used, and the least recently used entries are deleted once the cache grows beyond its size limit.
+/// Failing to write the cache is reported but never fatal
+/// </summary>
+class MeshCache {
+public:
+	/// <summary>
+	/// Version of the entry layout and of the processing stored in it, bumped whenever either changes
+	/// </summary>
+	static constexpr uint32_t FORMAT_VERSION = 1;
+	static constexpr const char* EXTENSION = ".mesh";
+
+	/// <summary>
+	/// Creates a MeshCache object, creating its directory if needed
+	/// </summary>
+	/// <param name="directory">Directory holding the entries (and nothing else the cache should delete)</param>
+	/// <param name="size_limit">Bytes the entries may occupy together</param>
+	MeshCache(const std::string& directory, uint64_t size_limit);
+
+	/// <summary>
+	/// Key of the entry holding a source file imported with the given importer and settings
+	/// </summary>
+	/// <param name="source">Bytes of the source file</param>
+	/// <param name="size">Size of the source file</param>
+	/// <param name="importer_version">Version of the importer's output (e.g. ObjUtils::IMPORTER_VERSION)</param>
+	/// <param name="import_settings">Processing applied after importing</param>
+	static uint64_t computeKey(const unsigned char* source, size_t size, uint32_t importer_version, const ModelImportSettings& import_settings);
+
+	/// <summary>
+	/// Read the entry with the given key, returning false if it does not exist. Invalid entries are deleted
+	/// </summary>
+	bool load(uint64_t key, ImportedMesh& mesh);
+	/// <summary>
+	/// Write an entry, replacing any with the same key, then evict least recently used entries beyond the size limit.
+	/// Meshes larger than the whole cache are not stored
+	/// </summary>
+	void store(uint64_t key, const ImportedMesh& mesh);
+	/// <summary>
+	/// Bytes currently occupied by the entries
+	/// </summary>
+	uint64_t computeSize();
+
+private:
+	std::filesystem::path directory;
+	uint64_t size_limit;
+
+	std::filesystem::path entryPath(uint64_t key) const;
+	/// <summary>
+	/// Delete the least recently used entries until the rest fit in the size limit, never deleting the given one
+	/// </summary>
+	void evict(const std::filesystem::path& keep);
+};
@@ -0,0 +1,368 @@
+#include "mesh_streamer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+MeshStreamer::MeshStreamer(LogicalDevice& device, JobSystem& jobs, uint32_t frame_count)
+	: device{ device }, jobs{ jobs }, frame_count{ frame_count } {}
+
+MeshStreamer::~MeshStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		for (const QueuedMesh& queued : queue) {
+			meshes[queued.slot].state = MeshState::Cancelled;
+			meshes[queued.slot].loader = nullptr;
+			meshes[queued.slot].processed_loader = nullptr;
+		}
+		queue.clear();
+	}
+	jobs.wait(load_counter);
+
+	for (UploadBatch& batch : uploads) {
+		vkWaitForFences(device.getDevice(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), 1, &batch.command_buffer);
+		vkDestroyFence(device.getDevice(), batch.fence, nullptr);
+	}
+	for (StreamedMesh& mesh : meshes) destroyStaging(mesh);
+}
+
+MeshStreamer::MeshHandle
+MeshStreamer::load(MeshLoader loader, const ModelImportSettings& import_settings, float priority) {
+	return enqueue(std::move(loader), nullptr, import_settings, priority);
+}
+
+MeshStreamer::MeshHandle
+MeshStreamer::loadProcessed(ProcessedLoader loader, float priority) {
+	return enqueue(nullptr, std::move(loader), {}, priority);
+}
+
+void
+MeshStreamer::setPriority(MeshHandle handle, float priority) {
+	std::lock_guard<std::mutex> lock(mutex);
+	StreamedMesh* mesh = find(handle);
+	if (!mesh) return;
+	uint32_t slot = handle & ((1u << SLOT_BITS) - 1);
+	if (mesh->state == MeshState::Queued) {
+		queue.erase({ mesh->priority, mesh->sequence, slot });
+		queue.insert({ priority, mesh->sequence, slot });
+	}
+	mesh->priority = priority;
+}
+
+void
+MeshStreamer::cancel(MeshHandle handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	StreamedMesh* mesh = find(handle);
+	if (!mesh) return;
+	uint32_t slot = handle & ((1u << SLOT_BITS) - 1);
+	switch (mesh->state) {
+	case MeshState::Queued:
+		queue.erase({ mesh->priority, mesh->sequence, slot });
+		pending_count--;
+		release(slot);
+		break;
+	case MeshState::Loading:
+		mesh->cancel_requested = true; // Discarded by the loading job
+		break;
+	case MeshState::Uploading:
+		if (mesh->submitted) mesh->cancel_requested = true; // Discarded once its copies have completed
+		else {
+			destroyStaging(*mesh);
+			staged_slots.erase(std::find(staged_slots.begin(), staged_slots.end(), slot));
+			pending_count--;
+			release(slot);
+		}
+		break;
+	case MeshState::Ready:
+		retired_models.push_back({ std::move(mesh->model), frame_counter });
+		release(slot);
+		break;
+	case MeshState::Failed:
+		release(slot);
+		break;
+	default:
+		break;
+	}
+}
+
+void
+MeshStreamer::update() {
+	frame_counter++;
+	retired_models.erase(
+		std::remove_if(retired_models.begin(), retired_models.end(), [this](const RetiredModel& retired) { return retired.frame + frame_count <= frame_counter; }),
+		retired_models.end());
+
+	if (jobs.getThreadCount() == 1) loadNext(); // No workers to run background jobs
+
+	std::lock_guard<std::mutex> lock(mutex);
+	collectUploads();
+	submitUploads();
+}
+
+MeshState
+MeshStreamer::getState(MeshHandle handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	StreamedMesh* mesh = find(handle);
+	return mesh ? mesh->state : MeshState::Cancelled;
+}
+
+Model*
+MeshStreamer::getModel(MeshHandle handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	StreamedMesh* mesh = find(handle);
+	return mesh && mesh->state == MeshState::Ready ? mesh->model.get() : nullptr;
+}
+
+std::unique_ptr<Model>
+MeshStreamer::take(MeshHandle handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	StreamedMesh* mesh = find(handle);
+	if (!mesh || mesh->state != MeshState::Ready) return nullptr;
+	std::unique_ptr<Model> model = std::move(mesh->model);
+	release(handle & ((1u << SLOT_BITS) - 1));
+	return model;
+}
+
+std::string
+MeshStreamer::getError(MeshHandle handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	StreamedMesh* mesh = find(handle);
+	return mesh ? mesh->error : std::string();
+}
+
+uint32_t
+MeshStreamer::getPendingCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending_count;
+}
+
+MeshStreamer::MeshHandle
+MeshStreamer::enqueue(MeshLoader loader, ProcessedLoader processed_loader, const ModelImportSettings& import_settings, float priority) {
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t slot;
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else {
+		if (meshes.size() >= (1u << SLOT_BITS) - 1) throw std::runtime_error("Too many meshes streamed at once"); // The last slot would make NO_MESH a valid handle
+		slot = static_cast<uint32_t>(meshes.size());
+		meshes.emplace_back();
+	}
+
+	StreamedMesh& mesh = meshes[slot];
+	mesh.loader = std::move(loader);
+	mesh.processed_loader = std::move(processed_loader);
+	mesh.import_settings = import_settings;
+	mesh.priority = priority;
+	mesh.sequence = next_sequence++;
+	mesh.state = MeshState::Queued;
+	queue.insert({ priority, mesh.sequence, slot });
+	pending_count++;
+	dispatchLoads();
+	return mesh.generation << SLOT_BITS | slot;
+}
+
+MeshStreamer::StreamedMesh*
+MeshStreamer::find(MeshHandle handle) {
+	uint32_t slot = handle & ((1u << SLOT_BITS) - 1);
+	if (slot >= meshes.size() || meshes[slot].generation != handle >> SLOT_BITS) return nullptr;
+	return &meshes[slot];
+}
+
+void
+MeshStreamer::release(uint32_t slot) {
+	StreamedMesh& mesh = meshes[slot];
+	uint32_t generation = (mesh.generation + 1) & ((1u << (32 - SLOT_BITS)) - 1);
+	mesh = StreamedMesh{};
+	mesh.generation = generation;
+	free_slots.push_back(slot);
+}
+
+void
+MeshStreamer::dispatchLoads() {
+	if (stopping || jobs.getThreadCount() == 1) return;
+	// A job finding nothing left to claim simply ends, so dispatching one per free slot is fine
+	while (active_loads < MAX_CONCURRENT_LOADS && !queue.empty()) {
+		active_loads++;
+		jobs.runInBackground([this]() {
+			loadNext();
+			std::lock_guard<std::mutex> lock(mutex);
+			active_loads--;
+			dispatchLoads();
+		}, load_counter);
+	}
+}
+
+void
+MeshStreamer::loadNext() {
+	uint32_t slot;
+	MeshLoader loader;
+	ProcessedLoader processed_loader;
+	ModelImportSettings import_settings;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queue.empty()) return;
+		slot = queue.begin()->slot;
+		queue.erase(queue.begin());
+		StreamedMesh& mesh = meshes[slot];
+		mesh.state = MeshState::Loading;
+		loader = std::move(mesh.loader);
+		mesh.loader = nullptr;
+		processed_loader = std::move(mesh.processed_loader);
+		mesh.processed_loader = nullptr;
+		import_settings = mesh.import_settings;
+	}
+	// A loading slot is only released by this job, so it keeps its index even though entries may move
+	auto cancelled = [this, slot]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return meshes[slot].cancel_requested;
+	};
+
+	// Entries may move while the mutex is not held, so results are gathered here and moved in at the end
+	StreamedMesh staged;
+	std::string error;
+	try {
+		MeshData data;
+		ProcessedMesh processed;
+		if (processed_loader) {
+			ImportedMesh imported = processed_loader();
+			data.vertices = std::move(imported.vertices);
+			processed = std::move(imported.mesh);
+		}
+		else data = loader();
+		if (data.vertices.size() < 3) throw std::runtime_error("Mesh has fewer than 3 vertices");
+		if (!cancelled()) {
+			if (!processed_loader && !data.indices.empty()) processed = Model::process(data.vertices, data.indices, import_settings);
+
+			if (!cancelled()) {
+				VkDeviceSize vertex_bytes = sizeof(Vertex) * data.vertices.size();
+				VkDeviceSize index_bytes = sizeof(uint32_t) * processed.indices.size();
+				device.createBuffer(
+					vertex_bytes + index_bytes,
+					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					MemoryCategory::Staging,
+					staged.staging_buffer,
+					staged.staging_memory);
+				void* mapped;
+				vkMapMemory(device.getDevice(), staged.staging_memory, 0, vertex_bytes + index_bytes, 0, &mapped);
+				memcpy(mapped, data.vertices.data(), static_cast<size_t>(vertex_bytes));
+				if (index_bytes > 0) memcpy(static_cast<char*>(mapped) + vertex_bytes, processed.indices.data(), static_cast<size_t>(index_bytes));
+				vkUnmapMemory(device.getDevice(), staged.staging_memory);
+
+				staged.vertex_count = static_cast<uint32_t>(data.vertices.size());
+				staged.index_count = static_cast<uint32_t>(processed.indices.size());
+				staged.lods = std::move(processed.lods);
+				staged.meshlets = std::move(processed.meshlets);
+			}
+		}
+	} catch (const std::exception& exception) {
+		destroyStaging(staged);
+		error = exception.what();
+		if (error.empty()) error = "Unknown error";
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	StreamedMesh& mesh = meshes[slot];
+	if (mesh.cancel_requested) {
+		destroyStaging(staged);
+		pending_count--;
+		release(slot);
+	} else if (!error.empty()) {
+		mesh.error = std::move(error);
+		mesh.state = MeshState::Failed;
+		pending_count--;
+	} else {
+		mesh.staging_buffer = staged.staging_buffer;
+		mesh.staging_memory = staged.staging_memory;
+		mesh.vertex_count = staged.vertex_count;
+		mesh.index_count = staged.index_count;
+		mesh.lods = std::move(staged.lods);
+		mesh.meshlets = std::move(staged.meshlets);
+		mesh.state = MeshState::Uploading;
+		staged_slots.push_back(slot);
+	}
+}
+
+void
+MeshStreamer::destroyStaging(StreamedMesh& mesh) {
+	if (mesh.staging_buffer != VK_NULL_HANDLE) vkDestroyBuffer(device.getDevice(), mesh.staging_buffer, nullptr);
+	device.freeMemory(mesh.staging_memory);
+	mesh.staging_buffer = VK_NULL_HANDLE;
+	mesh.staging_memory = VK_NULL_HANDLE;
+}
+
+void
+MeshStreamer::submitUploads() {
+	if (staged_slots.empty()) return;
+	std::stable_sort(staged_slots.begin(), staged_slots.end(), [this](uint32_t a, uint32_t b) { return meshes[a].priority > meshes[b].priority; });
+
+	VkCommandBufferAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocate_info.commandPool = device.getCommandPool();
+	allocate_info.commandBufferCount = 1;
+	UploadBatch batch{};
+	if (vkAllocateCommandBuffers(device.getDevice(), &allocate_info, &batch.command_buffer) != VK_SUCCESS) throw std::runtime_error("Failed to allocate mesh upload command buffer");
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.command_buffer, &begin_info);
+
+	VkDeviceSize batch_bytes = 0;
+	for (uint32_t slot : staged_slots) {
+		StreamedMesh& mesh = meshes[slot];
+		VkDeviceSize mesh_bytes = sizeof(Vertex) * mesh.vertex_count + sizeof(uint32_t) * mesh.index_count;
+		if (!batch.slots.empty() && batch_bytes + mesh_bytes > UPLOAD_BYTES_PER_FRAME) break;
+		mesh.model = std::make_unique<Model>(device, batch.command_buffer, mesh.staging_buffer, mesh.vertex_count, mesh.index_count,
+			std::move(mesh.lods), std::move(mesh.meshlets));
+		mesh.submitted = true;
+		batch.slots.push_back(slot);
+		batch_bytes += mesh_bytes;
+	}
+	staged_slots.erase(staged_slots.begin(), staged_slots.begin() + batch.slots.size()); // Submitted highest priority first
+
+	// Frames submitted after this batch may draw the models as soon as they are published
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	vkEndCommandBuffer(batch.command_buffer);
+
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(device.getDevice(), &fence_info, nullptr, &batch.fence) != VK_SUCCESS) throw std::runtime_error("Failed to create mesh upload fence");
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &batch.command_buffer;
+	if (vkQueueSubmit(device.getGraphicsQueue(), 1, &submit_info, batch.fence) != VK_SUCCESS) throw std::runtime_error("Failed to submit mesh uploads");
+	uploads.push_back(std::move(batch));
+}
+
+void
+MeshStreamer::collectUploads() {
+	for (auto batch = uploads.begin(); batch != uploads.end();) {
+		if (vkGetFenceStatus(device.getDevice(), batch->fence) != VK_SUCCESS) {
+			batch++;
+			continue;
+		}
+
+		for (uint32_t slot : batch->slots) {
+			StreamedMesh& mesh = meshes[slot];
+			destroyStaging(mesh);
+			pending_count--;
+			if (mesh.cancel_requested) release(slot); // Never published, so no frame can have drawn its model
+			else mesh.state = MeshState::Ready;
+		}
+		vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), 1, &batch->command_buffer);
+		vkDestroyFence(device.getDevice(), batch->fence, nullptr);
+		batch = uploads.erase(batch);
+	}
+}
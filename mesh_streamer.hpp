@@ -0,0 +1,230 @@
+#pragma once
+
+#include "device.hpp"
+#include "job_system.hpp"
+#include "mesh_cache.hpp"
+#include "model.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Lifecycle of a mesh requested from a MeshStreamer
+/// </summary>
+enum class MeshState {
+	Queued,    // Waiting for a background thread
+	Loading,   // Being read and processed into staging memory
+	Uploading, // Staged, or being copied to device local buffers
+	Ready,     // Copies have completed, the model may be drawn
+	Failed,    // The loader or processing threw, see getError
+	Cancelled  // Cancelled or taken before or after becoming ready, or an unknown handle
+};
+
+/// <summary>
+/// Loads meshes without stalling the frame. Reading, decoding and processing (levels of detail, meshlets) run as background
+/// jobs on the job system's workers, which write the results straight into a staging buffer of their own (without workers,
+/// one mesh is loaded per update instead). Once per frame the render thread records the copies of staged meshes into device
+/// local buffers in a command buffer of their own, submits it with a fence and publishes the models whose fence has
+/// signalled. Queued meshes are picked up highest priority first, so priorities can follow the camera until a mesh starts
+/// loading. A mesh's slot is reused once it is taken, or cancelled (failed meshes keep theirs until then, for getError),
+/// and handles carry a generation so that stale ones read as cancelled instead of aliasing the slot's next mesh
+/// </summary>
+class MeshStreamer {
+public:
+	using MeshHandle = uint32_t;
+	/// <summary>
+	/// Reads a mesh from its source, called on a background thread
+	/// </summary>
+	using MeshLoader = std::function<MeshData()>;
+	/// <summary>
+	/// Reads a mesh whose processing is already done (e.g. from a MeshCache), called on a background thread
+	/// </summary>
+	using ProcessedLoader = std::function<ImportedMesh()>;
+
+	static constexpr MeshHandle NO_MESH = UINT32_MAX;
+	/// <summary>
+	/// Low bits of a handle selecting its slot, the rest holding the slot's generation
+	/// </summary>
+	static constexpr uint32_t SLOT_BITS = 20;
+	/// <summary>
+	/// Meshes loaded at once, leaving the remaining job threads free for the frame's own work
+	/// </summary>
+	static constexpr uint32_t MAX_CONCURRENT_LOADS = 2;
+	/// <summary>
+	/// Bytes of copies submitted per frame (at least one mesh is submitted regardless), bounding the transfer work a
+	/// single frame competes with
+	/// </summary>
+	static constexpr VkDeviceSize UPLOAD_BYTES_PER_FRAME = 32ull * 1024 * 1024;
+
+	/// <summary>
+	/// Creates a MeshStreamer object
+	/// </summary>
+	/// <param name="device">Device to create buffers on and submit copies to</param>
+	/// <param name="jobs">Job system loading the meshes</param>
+	/// <param name="frame_count">Number of frames that can be in flight</param>
+	MeshStreamer(LogicalDevice& device, JobSystem& jobs, uint32_t frame_count);
+	/// <summary>
+	/// Waits for every load and upload in progress
+	/// </summary>
+	~MeshStreamer();
+
+	MeshStreamer(const MeshStreamer&) = delete;
+	MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+	/// <summary>
+	/// Queue a mesh to be loaded, returning immediately
+	/// </summary>
+	/// <param name="loader">Function reading the mesh, called once on a background thread</param>
+	/// <param name="import_settings">Processing applied to the mesh's triangles after loading</param>
+	/// <param name="priority">Order in which queued meshes are loaded, highest first</param>
+	/// <returns>Handle of the mesh</returns>
+	MeshHandle load(MeshLoader loader, const ModelImportSettings& import_settings = {}, float priority = 0.0f);
+	/// <summary>
+	/// Queue a mesh that needs no processing to be loaded, returning immediately
+	/// </summary>
+	/// <param name="loader">Function reading the mesh, called once on a background thread</param>
+	/// <param name="priority">Order in which queued meshes are loaded, highest first</param>
+	/// <returns>Handle of the mesh</returns>
+	MeshHandle loadProcessed(ProcessedLoader loader, float priority = 0.0f);
+	/// <summary>
+	/// Change the priority of a mesh that has not started loading yet
+	/// </summary>
+	void setPriority(MeshHandle mesh, float priority);
+	/// <summary>
+	/// Stop loading a mesh, or unload it once frames in flight are done with it if it is ready, or forget why it failed.
+	/// Work already under way is finished and discarded
+	/// </summary>
+	void cancel(MeshHandle mesh);
+	/// <summary>
+	/// Submit the copies of staged meshes and publish those whose copies have completed. Must be called from the thread
+	/// submitting frames, once per frame
+	/// </summary>
+	void update();
+
+	MeshState getState(MeshHandle mesh);
+	/// <summary>
+	/// Model of a mesh that is ready, null otherwise
+	/// </summary>
+	Model* getModel(MeshHandle mesh);
+	/// <summary>
+	/// Hand over the model of a ready mesh, e.g. to the scene, after which the streamer considers it cancelled
+	/// </summary>
+	std::unique_ptr<Model> take(MeshHandle mesh);
+	/// <summary>
+	/// What the loader or processing of a failed mesh threw
+	/// </summary>
+	std::string getError(MeshHandle mesh);
+	/// <summary>
+	/// Meshes queued, loading or uploading
+	/// </summary>
+	uint32_t getPendingCount();
+
+private:
+	struct StreamedMesh {
+		MeshLoader loader; // Released once called
+		ProcessedLoader processed_loader; // Used instead of loader when set
+		ModelImportSettings import_settings;
+		float priority = 0.0f;
+		uint64_t sequence = 0; // Order of the load request, breaking ties between equal priorities
+		uint32_t generation = 0; // Bumped whenever the slot is released, invalidating its handles
+		MeshState state = MeshState::Cancelled; // Free slots read as cancelled
+		bool cancel_requested = false; // Discard the results of the work under way
+
+		// Written by the loading job
+		VkBuffer staging_buffer = VK_NULL_HANDLE;
+		VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		std::vector<LodLevel> lods;
+		std::vector<Meshlet> meshlets;
+		bool submitted = false;
+
+		std::unique_ptr<Model> model; // Owned from submission, published once ready
+		std::string error;
+	};
+
+	/// <summary>
+	/// Entry of the load queue, ordered highest priority first and then oldest first
+	/// </summary>
+	struct QueuedMesh {
+		float priority;
+		uint64_t sequence;
+		uint32_t slot;
+
+		bool operator<(const QueuedMesh& other) const {
+			if (priority != other.priority) return priority > other.priority;
+			return sequence < other.sequence;
+		}
+	};
+
+	/// <summary>
+	/// Copies of one or more staged meshes submitted together
+	/// </summary>
+	struct UploadBatch {
+		VkCommandBuffer command_buffer;
+		VkFence fence;
+		std::vector<uint32_t> slots;
+	};
+
+	/// <summary>
+	/// Model that frames in flight may still draw, destroyed once they have completed
+	/// </summary>
+	struct RetiredModel {
+		std::unique_ptr<Model> model;
+		uint64_t frame;
+	};
+
+	LogicalDevice& device;
+	JobSystem& jobs;
+	uint32_t frame_count;
+	uint64_t frame_counter = 0;
+	std::vector<UploadBatch> uploads;
+	std::vector<RetiredModel> retired_models;
+
+	// Shared with the loading jobs
+	std::mutex mutex;
+	std::vector<StreamedMesh> meshes; // Indexed by slot
+	std::vector<uint32_t> free_slots;
+	std::set<QueuedMesh> queue; // Slots of queued meshes
+	std::vector<uint32_t> staged_slots; // Slots of staged meshes whose copies are not submitted yet
+	uint32_t pending_count = 0; // Meshes queued, loading or uploading
+	uint64_t next_sequence = 0;
+	uint32_t active_loads = 0;
+	bool stopping = false;
+	JobCounter load_counter; // Counts the loading jobs, which the destructor waits for
+
+	/// <summary>
+	/// Queue a mesh in a free slot, returning its handle
+	/// </summary>
+	MeshHandle enqueue(MeshLoader loader, ProcessedLoader processed_loader, const ModelImportSettings& import_settings, float priority);
+	/// <summary>
+	/// Mesh a handle refers to, null if the handle is out of range or its slot has been reused (caller holds the mutex)
+	/// </summary>
+	StreamedMesh* find(MeshHandle handle);
+	/// <summary>
+	/// Mark a slot cancelled and free for reuse, invalidating its handles (caller holds the mutex)
+	/// </summary>
+	void release(uint32_t slot);
+	/// <summary>
+	/// Start loading jobs while fewer than MAX_CONCURRENT_LOADS are running (caller holds the mutex)
+	/// </summary>
+	void dispatchLoads();
+	/// <summary>
+	/// Load the highest priority queued mesh into a staging buffer of its own
+	/// </summary>
+	void loadNext();
+	void destroyStaging(StreamedMesh& mesh);
+	/// <summary>
+	/// Record the copies of staged meshes, up to UPLOAD_BYTES_PER_FRAME, and submit them with a fence
+	/// </summary>
+	void submitUploads();
+	/// <summary>
+	/// Publish or discard the meshes of batches whose fence has signalled
+	/// </summary>
+	void collectUploads();
+};
@@ -0,0 +1,130 @@
+#include "meshlet.hpp"
+#include "culling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+std::vector<Meshlet>
+MeshletUtils::buildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const DrawRange& range, uint32_t max_vertices, uint32_t max_triangles) {
+	// Renumber the range's vertices densely so per-vertex state can live in plain arrays
+	std::unordered_map<uint32_t, uint32_t> local_ids;
+	std::vector<glm::vec2> positions;
+	uint32_t triangle_count = range.index_count / 3;
+	std::vector<std::array<uint32_t, 3>> triangles(triangle_count);
+	for (uint32_t i = 0; i < triangle_count * 3; i++) {
+		uint32_t index = indices[range.first_index + i];
+		auto [entry, inserted] = local_ids.try_emplace(index, static_cast<uint32_t>(positions.size()));
+		if (inserted) positions.push_back(vertices[index + range.vertex_offset].pos);
+		triangles[i / 3][i % 3] = entry->second;
+	}
+	std::vector<std::vector<uint32_t>> vertex_triangles(positions.size());
+	for (uint32_t t = 0; t < triangle_count; t++) {
+		for (uint32_t corner : triangles[t]) vertex_triangles[corner].push_back(t);
+	}
+
+	std::vector<uint32_t> reordered(indices.begin() + range.first_index, indices.begin() + range.first_index + triangle_count * 3);
+	std::vector<bool> used(triangle_count, false);
+	std::vector<uint32_t> vertex_meshlet(positions.size(), UINT32_MAX); // Last meshlet each vertex was added to
+	std::vector<Meshlet> meshlets;
+	uint32_t written = 0; // Triangles already placed in the reordered range
+	uint32_t seed = 0;
+
+	while (written < triangle_count) {
+		while (used[seed]) seed++;
+		uint32_t meshlet_index = static_cast<uint32_t>(meshlets.size());
+		Meshlet meshlet{};
+		meshlet.range = { range.first_index + written * 3, 0, range.vertex_offset };
+		std::vector<uint32_t> meshlet_vertices;
+		glm::vec2 centroid_sum{ 0.0f };
+
+		auto newVertices = [&](uint32_t t) {
+			uint32_t count = 0;
+			for (uint32_t corner : triangles[t]) count += vertex_meshlet[corner] != meshlet_index ? 1 : 0;
+			return count;
+		};
+		auto addTriangle = [&](uint32_t t) {
+			used[t] = true;
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				uint32_t vertex = triangles[t][corner];
+				if (vertex_meshlet[vertex] != meshlet_index) {
+					vertex_meshlet[vertex] = meshlet_index;
+					meshlet_vertices.push_back(vertex);
+					centroid_sum += positions[vertex];
+				}
+				reordered[written * 3 + corner] = indices[range.first_index + t * 3 + corner];
+			}
+			written++;
+			meshlet.range.index_count += 3;
+		};
+
+		addTriangle(seed);
+		while (meshlet.range.index_count / 3 < max_triangles) {
+			// Candidates share at least one vertex with the meshlet, so only the meshlet's vertices need to be searched
+			glm::vec2 centroid = centroid_sum * (1.0f / meshlet_vertices.size());
+			uint32_t best = UINT32_MAX;
+			uint32_t best_new = 4;
+			float best_distance = std::numeric_limits<float>::max();
+			for (uint32_t vertex : meshlet_vertices) {
+				for (uint32_t t : vertex_triangles[vertex]) {
+					if (used[t]) continue;
+					uint32_t new_vertices = newVertices(t);
+					if (new_vertices > best_new) continue;
+					glm::vec2 offset = (positions[triangles[t][0]] + positions[triangles[t][1]] + positions[triangles[t][2]]) * (1.0f / 3.0f) - centroid;
+					float distance = glm::dot(offset, offset);
+					if (new_vertices < best_new || distance < best_distance) {
+						best = t;
+						best_new = new_vertices;
+						best_distance = distance;
+					}
+				}
+			}
+			if (best == UINT32_MAX || meshlet_vertices.size() + best_new > max_vertices) break;
+			addTriangle(best);
+		}
+
+		meshlet.vertex_count = static_cast<uint32_t>(meshlet_vertices.size());
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(reordered.begin(), reordered.end(), indices.begin() + range.first_index);
+	for (Meshlet& meshlet : meshlets) computeBounds(vertices, indices, meshlet);
+	return meshlets;
+}
+
+void
+MeshletUtils::computeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Meshlet& meshlet) {
+	meshlet.sphere = CullingUtils::computeBoundingSphere(vertices, indices, meshlet.range);
+
+	// Front faces are clockwise on screen, so their facing normal is the negated cross(p1 - p0, p2 - p0) of model space
+	std::vector<glm::vec3> normals;
+	glm::vec3 axis{ 0.0f };
+	for (uint32_t i = 0; i < meshlet.range.index_count; i += 3) {
+		glm::vec3 p[3];
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			const glm::vec2& pos = vertices[indices[meshlet.range.first_index + i + corner] + meshlet.range.vertex_offset].pos;
+			p[corner] = glm::vec3(pos.x, pos.y, 0.0f);
+		}
+		glm::vec3 normal = -glm::cross(p[1] - p[0], p[2] - p[0]);
+		float length = glm::length(normal);
+		if (length == 0.0f) continue; // Degenerate triangles are never rasterised
+		normal /= length;
+		normals.push_back(normal);
+		axis += normal;
+	}
+
+	float axis_length = glm::length(axis);
+	if (axis_length == 0.0f) {
+		meshlet.cone = { 0.0f, 0.0f, 0.0f, NO_CONE_CUTOFF };
+		return;
+	}
+	axis /= axis_length;
+	float min_dot = 1.0f;
+	for (const glm::vec3& normal : normals) min_dot = std::min(min_dot, glm::dot(normal, axis));
+
+	// Normals spreading past (nearly) 90 degrees can always show a front face
+	float cutoff = min_dot <= 0.1f ? NO_CONE_CUTOFF : std::sqrt(1.0f - min_dot * min_dot);
+	meshlet.cone = { axis, cutoff };
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class MeshletUtils {
+public:
+	static constexpr uint32_t MAX_VERTICES = 64;
+	static constexpr uint32_t MAX_TRIANGLES = 124;
+	/// <summary>
+	/// Cone cutoff given to clusters whose normals spread too far for any view to see only their back faces
+	/// </summary>
+	static constexpr float NO_CONE_CUTOFF = 1.0f;
+
+	/// <summary>
+	/// Split a range of triangles into meshlets, growing each from a seed triangle by adding the neighbouring triangle
+	/// that brings in the fewest new vertices (the closest one on ties). The range's indices are reordered so that
+	/// each meshlet's triangles are contiguous, which leaves drawing the whole range unaffected
+	/// </summary>
+	/// <param name="vertices">Vertex buffer the range indexes into</param>
+	/// <param name="indices">Index buffer holding the range, reordered in place</param>
+	/// <param name="range">Triangles to split</param>
+	/// <param name="max_vertices">Largest number of unique vertices per meshlet</param>
+	/// <param name="max_triangles">Largest number of triangles per meshlet</param>
+	/// <returns>Meshlets covering the range, in index buffer order</returns>
+	static std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const DrawRange& range, uint32_t max_vertices = MAX_VERTICES, uint32_t max_triangles = MAX_TRIANGLES);
+	/// <summary>
+	/// Compute the bounding sphere and normal cone of a meshlet's triangles
+	/// </summary>
+	static void computeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Meshlet& meshlet);
+};
@@ -1,4 +1,10 @@
 #include "model.hpp"
+#include "lod.hpp"
+#include "meshlet.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <utility>
 
 VkVertexInputBindingDescription
 Vertex::getBindingDescription() {
@@ -9,9 +15,9 @@ Vertex::getBindingDescription() {
 	return binding_desc;
 }
 
-std::array<VkVertexInputAttributeDescription, 2>
+std::array<VkVertexInputAttributeDescription, 3>
 Vertex::getAttributeDescriptions() {
-	std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions{};
+	std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
 
 	// Position attribute
 	attribute_descriptions[0].binding = 0;
@@ -25,6 +31,42 @@ Vertex::getAttributeDescriptions() {
 	attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT; // 3 32-bit signed float components for position
 	attribute_descriptions[1].offset = offsetof(Vertex, color); // Offset of color into vertex data block
 
+	// Texture coordinate attribute, after the instance attributes so their locations stay unchanged
+	attribute_descriptions[2].binding = 0;
+	attribute_descriptions[2].location = 7; // Texture coordinates are in location 7 (check vertex shader)
+	attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+	attribute_descriptions[2].offset = offsetof(Vertex, uv);
+
+	return attribute_descriptions;
+}
+
+VkVertexInputBindingDescription
+InstanceData::getBindingDescription() {
+	VkVertexInputBindingDescription binding_desc{};
+	binding_desc.binding = 1;
+	binding_desc.stride = sizeof(InstanceData);
+	binding_desc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE; // Advance through the buffer once per instance instead of once per vertex
+	return binding_desc;
+}
+
+std::array<VkVertexInputAttributeDescription, 5>
+InstanceData::getAttributeDescriptions() {
+	std::array<VkVertexInputAttributeDescription, 5> attribute_descriptions{};
+
+	// Transform attribute, a mat4 occupies 4 consecutive locations (one per column)
+	for (uint32_t column = 0; column < 4; column++) {
+		attribute_descriptions[column].binding = 1;
+		attribute_descriptions[column].location = 2 + column; // Transform columns are in locations 2-5 (check vertex shader)
+		attribute_descriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attribute_descriptions[column].offset = static_cast<uint32_t>(offsetof(InstanceData, transform) + sizeof(glm::vec4) * column);
+	}
+
+	// Color attribute
+	attribute_descriptions[4].binding = 1;
+	attribute_descriptions[4].location = 6; // Instance color is in location 6 (check vertex shader)
+	attribute_descriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attribute_descriptions[4].offset = offsetof(InstanceData, color);
+
 	return attribute_descriptions;
 }
 
@@ -35,15 +77,71 @@ Model::Model(LogicalDevice& device, const std::vector<Vertex>& vertices): logica
 Model::Model(LogicalDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t> indices) : logical_device{ device } {
 	createVertexBuffers(vertices);
 	createIndexBuffers(indices);
+	if (has_index_buffer) lods.push_back({ { 0, index_count, 0 }, 0.0f });
+}
+
+Model::Model(LogicalDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const ModelImportSettings& import_settings)
+	: Model(device, vertices, process(vertices, indices, import_settings)) {}
+
+Model::Model(LogicalDevice& device, const std::vector<Vertex>& vertices, ProcessedMesh mesh) : logical_device{ device } {
+	createVertexBuffers(vertices);
+	createIndexBuffers(mesh.indices);
+	lods = std::move(mesh.lods);
+	meshlets = std::move(mesh.meshlets);
+}
+
+Model::Model(LogicalDevice& device, VkCommandBuffer command_buffer, VkBuffer staging_buffer, uint32_t vertex_count, uint32_t index_count,
+	std::vector<LodLevel> lods, std::vector<Meshlet> meshlets)
+	: logical_device{ device }, vertex_count{ vertex_count }, index_count{ index_count }, lods{ std::move(lods) }, meshlets{ std::move(meshlets) } {
+	assert(vertex_count >= 3 && "Number of vertices in a model must be at least 3");
+	VkDeviceSize vertex_bytes = sizeof(Vertex) * vertex_count;
+	device.createBuffer(
+		vertex_bytes,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		MemoryCategory::Vertex,
+		vertex_buffer,
+		vertex_buffer_memory);
+	VkBufferCopy vertex_copy{ 0, 0, vertex_bytes };
+	vkCmdCopyBuffer(command_buffer, staging_buffer, vertex_buffer, 1, &vertex_copy);
+
+	has_index_buffer = index_count > 0;
+	if (has_index_buffer) {
+		VkDeviceSize index_bytes = sizeof(uint32_t) * index_count;
+		device.createBuffer(
+			index_bytes,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			MemoryCategory::Index,
+			index_buffer,
+			index_buffer_memory);
+		VkBufferCopy index_copy{ vertex_bytes, 0, index_bytes };
+		vkCmdCopyBuffer(command_buffer, staging_buffer, index_buffer, 1, &index_copy);
+	}
+}
+
+ProcessedMesh
+Model::process(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const ModelImportSettings& import_settings) {
+	ProcessedMesh mesh;
+
+	// Meshlets reorder the full range, so they are built before the levels of detail copy it
+	DrawRange full_range{ 0, static_cast<uint32_t>(indices.size()), 0 };
+	std::vector<uint32_t> ordered_indices = indices;
+	if (import_settings.build_meshlets) mesh.meshlets = MeshletUtils::buildMeshlets(vertices, ordered_indices, full_range);
+
+	LodChain chain = LodUtils::buildLodChain(vertices, ordered_indices, full_range, import_settings.lod_count);
+	mesh.indices = std::move(chain.indices);
+	mesh.lods = std::move(chain.levels);
+	return mesh;
 }
 
 Model::~Model() {
 	vkDestroyBuffer(logical_device.getDevice(), vertex_buffer, nullptr);
-	vkFreeMemory(logical_device.getDevice(), vertex_buffer_memory, nullptr);
+	logical_device.freeMemory(vertex_buffer_memory);
 
 	if (has_index_buffer) {
 		vkDestroyBuffer(logical_device.getDevice(), index_buffer, nullptr);
-		vkFreeMemory(logical_device.getDevice(), index_buffer_memory, nullptr);
+		logical_device.freeMemory(index_buffer_memory);
 	}
 }
 
@@ -58,10 +156,22 @@ Model::bind(VkCommandBuffer command_buffer) {
 
 void
 Model::draw(VkCommandBuffer command_buffer) {
-	if (has_index_buffer) vkCmdDrawIndexed(command_buffer, index_count, 1, 0, 0, 0);
+	if (has_index_buffer) vkCmdDrawIndexed(command_buffer, fullRange().index_count, 1, 0, 0, 0); // Levels of detail follow the full range
 	else vkCmdDraw(command_buffer, vertex_count, 1, 0, 0);
 }
 
+void
+Model::drawRange(VkCommandBuffer command_buffer, const DrawRange& range, uint32_t instance_count, uint32_t first_instance) {
+	assert(has_index_buffer && "Drawing an index range requires an index buffer");
+	vkCmdDrawIndexed(command_buffer, range.index_count, instance_count, range.first_index, range.vertex_offset, first_instance);
+}
+
+void
+Model::drawInstanced(VkCommandBuffer command_buffer, uint32_t instance_count, uint32_t first_instance) {
+	if (has_index_buffer) vkCmdDrawIndexed(command_buffer, fullRange().index_count, instance_count, 0, 0, first_instance);
+	else vkCmdDraw(command_buffer, vertex_count, instance_count, 0, first_instance);
+}
+
 void
 Model::createVertexBuffers(const std::vector<Vertex> vertices) {
 	// Determine how big the buffer needs to be
@@ -76,6 +186,7 @@ Model::createVertexBuffers(const std::vector<Vertex> vertices) {
 		buffer_size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // Buffer will be used for copying to vertex buffer from
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // Underlying memory should be visible to the host device (i.e: CPU)
+		MemoryCategory::Staging,
 		staging_buffer,
 		staging_buffer_memory
 	);
@@ -91,13 +202,14 @@ Model::createVertexBuffers(const std::vector<Vertex> vertices) {
 		buffer_size,
 		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, // Buffer will be used as a vertex buffer and will be transferred to from the staging buffer
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // Underlying memory is the most efficient for access by the Vulkan device
+		MemoryCategory::Vertex,
 		vertex_buffer,
 		vertex_buffer_memory);
 	logical_device.copyBuffer(staging_buffer, vertex_buffer, buffer_size);
 
 	// Clean up staging buffer resources
 	vkDestroyBuffer(logical_device.getDevice(), staging_buffer, nullptr);
-	vkFreeMemory(logical_device.getDevice(), staging_buffer_memory, nullptr);
+	logical_device.freeMemory(staging_buffer_memory);
 }
 
 void
@@ -115,6 +227,7 @@ Model::createIndexBuffers(const std::vector<uint32_t> indices) {
 		buffer_size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // Buffer will be used for copying to vertex buffer from
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // Underlying memory should be visible to the host device (i.e: CPU)
+		MemoryCategory::Staging,
 		staging_buffer,
 		staging_buffer_memory
 	);
@@ -130,11 +243,12 @@ Model::createIndexBuffers(const std::vector<uint32_t> indices) {
 		buffer_size,
 		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, // Buffer will be used as an index buffer and will be transferred to from the staging buffer
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // Underlying memory is the most efficient for access by the Vulkan device
+		MemoryCategory::Index,
 		index_buffer,
 		index_buffer_memory);
 	logical_device.copyBuffer(staging_buffer, index_buffer, buffer_size);
 
 	// Clean up staging buffer resources
 	vkDestroyBuffer(logical_device.getDevice(), staging_buffer, nullptr);
-	vkFreeMemory(logical_device.getDevice(), staging_buffer_memory, nullptr);
+	logical_device.freeMemory(staging_buffer_memory);
 }
@@ -19,6 +19,10 @@ struct Vertex {
     /// Color of the vertex
     /// </summary>
     glm::vec3 color;
+    /// <summary>
+    /// Texture coordinates of the vertex (only sampled by objects with a texture)
+    /// </summary>
+    glm::vec2 uv{ 0.0f };
 
     /// <summary>
     /// Creates a description of how to interpret vertex data stored in memory as will be used by the vertex shader
@@ -28,16 +32,140 @@ struct Vertex {
     /// <summary>
     /// Defines how to extract specific vertex attributes from the raw data of a single vertex
     /// </summary>
-    /// <returns>A 2 element array defining how position and color should be extracted</returns>
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+    /// <returns>A 3 element array defining how position, color and texture coordinates should be extracted</returns>
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
+};
+
+/// <summary>
+/// Per-instance data elements, streamed through a second vertex binding advanced once per instance
+/// </summary>
+struct InstanceData {
+    /// <summary>
+    /// Transform applied to every vertex of the instance
+    /// </summary>
+    glm::mat4 transform{ 1.0f };
+    /// <summary>
+    /// Colour multiplied with the vertex colours of the instance (alpha is unused)
+    /// </summary>
+    glm::vec4 color{ 1.0f };
+
+    /// <summary>
+    /// Creates a description of how to interpret instance data stored in memory, advanced per instance rather than per vertex
+    /// </summary>
+    /// <returns>A Vulkan-usable struct defining layout of instance data in memory</returns>
+    static VkVertexInputBindingDescription getBindingDescription();
+    /// <summary>
+    /// Defines how to extract specific attributes from the raw data of a single instance
+    /// </summary>
+    /// <returns>A 5 element array defining how the 4 transform columns and the color should be extracted</returns>
+    static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions();
+};
+
+/// <summary>
+/// Contiguous range of a model's index buffer drawn by a single draw call
+/// </summary>
+struct DrawRange {
+    uint32_t first_index;
+    uint32_t index_count;
+    int32_t vertex_offset = 0;
+};
+
+/// <summary>
+/// One level of detail of a model: an index range over the model's shared vertices, and how far (in model units) its
+/// surface may deviate from the full resolution mesh
+/// </summary>
+struct LodLevel {
+    DrawRange range;
+    float error = 0.0f;
+};
+
+/// <summary>
+/// Small cluster of a model's triangles, stored contiguously in the model's index buffer and culled as a unit
+/// </summary>
+struct Meshlet {
+    /// <summary>
+    /// Triangles of the cluster
+    /// </summary>
+    DrawRange range;
+    uint32_t vertex_count;
+    /// <summary>
+    /// Model space bounding sphere, centre in xyz and radius in w
+    /// </summary>
+    glm::vec4 sphere;
+    /// <summary>
+    /// Cone containing the facing normals of every triangle (normals pointing towards viewers that see the front face):
+    /// model space axis in xyz, sine of the cone's spread in w. A cutoff of 1 or more means the cluster is never backfacing
+    /// </summary>
+    glm::vec4 cone;
+};
+
+/// <summary>
+/// Optional processing applied to an indexed model's triangles when it is created
+/// </summary>
+struct ModelImportSettings {
+    /// <summary>
+    /// Largest number of levels of detail, including the full resolution one
+    /// </summary>
+    uint32_t lod_count = 1;
+    /// <summary>
+    /// Whether to split the full resolution triangles into meshlets (reordering them within the index buffer)
+    /// </summary>
+    bool build_meshlets = false;
+};
+
+/// <summary>
+/// Vertices and triangle indices of a mesh, as read from a source
+/// </summary>
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+/// <summary>
+/// Result of the CPU side processing of an indexed mesh (see ModelImportSettings), ready to be uploaded.
+/// Processing never touches the device, so meshes can be processed on any thread
+/// </summary>
+struct ProcessedMesh {
+    /// <summary>
+    /// Index buffer holding the (possibly reordered) full resolution triangles followed by every simplified level
+    /// </summary>
+    std::vector<uint32_t> indices;
+    std::vector<LodLevel> lods;
+    std::vector<Meshlet> meshlets;
 };
 
 class Model {
 public:
     Model(LogicalDevice& device, const std::vector<Vertex>& vertices);
     Model(LogicalDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t> indices);
+    /// <summary>
+    /// Creates an indexed model along with up to lod_count - 1 simplified levels of detail, whose indices are appended
+    /// to the index buffer so that every level shares the vertex buffer, and optionally its meshlets
+    /// </summary>
+    Model(LogicalDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const ModelImportSettings& import_settings);
+    /// <summary>
+    /// Creates an indexed model from triangles processed beforehand with <c>process</c>
+    /// </summary>
+    Model(LogicalDevice& device, const std::vector<Vertex>& vertices, ProcessedMesh mesh);
+    /// <summary>
+    /// Creates an indexed model whose buffers are filled by copies recorded into the given command buffer, without waiting
+    /// for them. The model must not be drawn before the command buffer has completed
+    /// </summary>
+    /// <param name="command_buffer">Command buffer to record the copies into</param>
+    /// <param name="staging_buffer">Buffer holding the vertices, immediately followed by the indices</param>
+    /// <param name="vertex_count">Number of vertices at the start of the staging buffer</param>
+    /// <param name="index_count">Number of indices following them</param>
+    /// <param name="lods">Levels of detail of the indices</param>
+    /// <param name="meshlets">Meshlets of the full resolution range</param>
+    Model(LogicalDevice& device, VkCommandBuffer command_buffer, VkBuffer staging_buffer, uint32_t vertex_count, uint32_t index_count,
+        std::vector<LodLevel> lods, std::vector<Meshlet> meshlets);
     ~Model();
 
+    /// <summary>
+    /// Build the levels of detail and meshlets requested by the import settings
+    /// </summary>
+    static ProcessedMesh process(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const ModelImportSettings& import_settings);
+
     /// <summary>
     /// Binds the vertex buffer of this model to the given command buffer
     /// </summary>
@@ -48,6 +176,37 @@ public:
     /// </summary>
     /// <param name="command_buffer">Command buffer to add draw command to</param>
     void draw(VkCommandBuffer command_buffer);
+    /// <summary>
+    /// Adds a draw command for a sub-range of the indices of this model to the given command buffer
+    /// </summary>
+    /// <param name="command_buffer">Command buffer to add draw command to</param>
+    /// <param name="range">Index range to draw (the model must have an index buffer)</param>
+    /// <param name="instance_count">Number of instances to draw</param>
+    /// <param name="first_instance">Index of the first instance's data in the instance buffer</param>
+    void drawRange(VkCommandBuffer command_buffer, const DrawRange& range, uint32_t instance_count = 1, uint32_t first_instance = 0);
+    /// <summary>
+    /// Adds a single draw command for several instances of all of the vertices of this model to the given command buffer.
+    /// Per-instance data is read from the buffer bound to the instance binding
+    /// </summary>
+    /// <param name="command_buffer">Command buffer to add draw command to</param>
+    /// <param name="instance_count">Number of instances to draw</param>
+    /// <param name="first_instance">Index of the first instance's data in the instance buffer</param>
+    void drawInstanced(VkCommandBuffer command_buffer, uint32_t instance_count, uint32_t first_instance = 0);
+
+    uint32_t getVertexCount() { return vertex_count; }
+    uint32_t getIndexCount() { return has_index_buffer ? index_count : 0; }
+    /// <summary>
+    /// Range covering every index of this model at full resolution
+    /// </summary>
+    DrawRange fullRange() { return lods.empty() ? DrawRange{ 0, getIndexCount(), 0 } : lods[0].range; }
+    /// <summary>
+    /// Levels of detail of the full range, finest first (only the full range unless created with a level count)
+    /// </summary>
+    const std::vector<LodLevel>& getLods() { return lods; }
+    /// <summary>
+    /// Meshlets partitioning the full range (empty unless created with build_meshlets)
+    /// </summary>
+    const std::vector<Meshlet>& getMeshlets() { return meshlets; }
 
 private:
     LogicalDevice& logical_device;
@@ -60,6 +219,8 @@ private:
     VkDeviceMemory index_buffer_memory;
     uint32_t index_count;
     bool has_index_buffer = false;
+    std::vector<LodLevel> lods;
+    std::vector<Meshlet> meshlets;
 
     /// <summary>
     /// Creates a buffer on the Vulkan device to store vertex data
@@ -0,0 +1,129 @@
+#include "obj.hpp"
+
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+	/// <summary>
+	/// Cursor over the remainder of a line
+	/// </summary>
+	struct LineReader {
+		const char* current;
+		const char* end;
+
+		void skipSpaces() {
+			while (current < end && (*current == ' ' || *current == '\t')) current++;
+		}
+
+		bool readFloat(float& value) {
+			skipSpaces();
+			if (current < end && *current == '+') current++; // Accepted by strtof, not by from_chars
+			auto [next, error] = std::from_chars(current, end, value);
+			if (error != std::errc()) return false;
+			current = next;
+			return true;
+		}
+
+		bool readInt(int64_t& value) {
+			auto [next, error] = std::from_chars(current, end, value);
+			if (error != std::errc()) return false;
+			current = next;
+			return true;
+		}
+	};
+
+	/// <summary>
+	/// Resolve a 1-based (or negative, relative to the end) OBJ index into a 0-based one, throwing if out of range
+	/// </summary>
+	uint32_t resolveIndex(int64_t index, size_t count, size_t line) {
+		int64_t resolved = index < 0 ? static_cast<int64_t>(count) + index : index - 1;
+		if (index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(count)) {
+			throw std::runtime_error("OBJ line " + std::to_string(line) + " references a missing vertex");
+		}
+		return static_cast<uint32_t>(resolved);
+	}
+}
+
+MeshData
+ObjUtils::parse(const unsigned char* data, size_t size) {
+	std::vector<glm::vec2> positions;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec2> uvs;
+	std::unordered_map<uint64_t, uint32_t> corner_vertices; // Position and texture coordinate indices (both + 1) to vertex
+	std::vector<uint32_t> polygon;
+	MeshData mesh;
+
+	const char* text = reinterpret_cast<const char*>(data);
+	const char* text_end = text + size;
+	size_t line_number = 0;
+	while (text < text_end) {
+		const char* line_end = text;
+		while (line_end < text_end && *line_end != '\n') line_end++;
+		LineReader line{ text, line_end > text && line_end[-1] == '\r' ? line_end - 1 : line_end };
+		text = line_end < text_end ? line_end + 1 : text_end;
+		line_number++;
+
+		line.skipSpaces();
+		const char* keyword = line.current;
+		while (line.current < line.end && *line.current != ' ' && *line.current != '\t') line.current++;
+		std::string_view type(keyword, line.current - keyword);
+
+		if (type == "v") {
+			glm::vec3 position;
+			glm::vec3 color{ 1.0f };
+			if (!line.readFloat(position.x) || !line.readFloat(position.y) || !line.readFloat(position.z)) {
+				throw std::runtime_error("OBJ line " + std::to_string(line_number) + " has a malformed position");
+			}
+			glm::vec3 rgb;
+			if (line.readFloat(rgb.x) && line.readFloat(rgb.y) && line.readFloat(rgb.z)) color = rgb; // Vertex colours are a common extension
+			positions.push_back({ position.x, position.y });
+			colors.push_back(color);
+		}
+		else if (type == "vt") {
+			glm::vec2 uv{ 0.0f };
+			if (!line.readFloat(uv.x)) throw std::runtime_error("OBJ line " + std::to_string(line_number) + " has malformed texture coordinates");
+			line.readFloat(uv.y);
+			uvs.push_back({ uv.x, 1.0f - uv.y }); // OBJ's origin is the bottom left, Vulkan's the top left
+		}
+		else if (type == "f") {
+			polygon.clear();
+			while (true) {
+				line.skipSpaces();
+				if (line.current >= line.end) break;
+				int64_t position_index;
+				int64_t uv_index = 0;
+				if (!line.readInt(position_index)) throw std::runtime_error("OBJ line " + std::to_string(line_number) + " has a malformed face");
+				uint32_t position = resolveIndex(position_index, positions.size(), line_number);
+				uint32_t uv = UINT32_MAX;
+				if (line.current < line.end && *line.current == '/') {
+					line.current++;
+					if (line.current < line.end && *line.current != '/') {
+						if (!line.readInt(uv_index)) throw std::runtime_error("OBJ line " + std::to_string(line_number) + " has a malformed face");
+						uv = resolveIndex(uv_index, uvs.size(), line_number);
+					}
+					// Normals are not part of the vertex format
+					if (line.current < line.end && *line.current == '/') {
+						line.current++;
+						int64_t normal_index;
+						line.readInt(normal_index);
+					}
+				}
+
+				// A missing texture coordinate keys as 0, which must not carry into the position half
+				uint64_t uv_key = uv == UINT32_MAX ? 0 : static_cast<uint64_t>(uv) + 1;
+				uint64_t corner = (static_cast<uint64_t>(position) + 1) << 32 | uv_key;
+				auto [existing, inserted] = corner_vertices.try_emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+				if (inserted) mesh.vertices.push_back({ positions[position], colors[position], uv == UINT32_MAX ? glm::vec2(0.0f) : uvs[uv] });
+				polygon.push_back(existing->second);
+			}
+			if (polygon.size() < 3) throw std::runtime_error("OBJ line " + std::to_string(line_number) + " has a face with fewer than 3 corners");
+			for (size_t corner = 1; corner + 1 < polygon.size(); corner++) {
+				mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[corner], polygon[corner + 1] });
+			}
+		}
+	}
+	return mesh;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Utility class containing static methods for importing Wavefront OBJ meshes
+/// </summary>
+class ObjUtils {
+public:
+	/// <summary>
+	/// Version of the parser's output, bumped whenever a change makes the same file import differently so that cached
+	/// imports of it are invalidated
+	/// </summary>
+	static constexpr uint32_t IMPORTER_VERSION = 2;
+
+	/// <summary>
+	/// Parse the positions ("v x y z [r g b]"), texture coordinates ("vt u v") and faces ("f") of an OBJ file into an indexed
+	/// mesh, throwing on malformed faces. Vertices are 2D, so positions are projected onto the XY plane. Polygons are
+	/// triangulated as fans, and corners sharing both a position and texture coordinates share a vertex. Everything else
+	/// (normals, groups, materials) is ignored
+	/// </summary>
+	/// <param name="data">Contents of the file</param>
+	/// <param name="size">Size of the file in bytes</param>
+	static MeshData parse(const unsigned char* data, size_t size);
+};
@@ -28,9 +28,12 @@ void GraphicsPipeline::createGraphicsPipeline(
 
 	// START OF PROGRAMMABLE STAGES CREATION
 	std::vector<char> vert_shader_code = FileUtils::readFile(vert_file_path);
-	std::vector<char> frag_shader_code = FileUtils::readFile(frag_file_path);
 	VkShaderModule vert_shader_module = ShaderUtils::createShaderModule(device.getDevice(), vert_shader_code);
-	VkShaderModule frag_shader_module = ShaderUtils::createShaderModule(device.getDevice(), frag_shader_code);
+	VkShaderModule frag_shader_module = VK_NULL_HANDLE; // Depth-only pipelines have no fragment stage
+	if (!frag_file_path.empty()) {
+		std::vector<char> frag_shader_code = FileUtils::readFile(frag_file_path);
+		frag_shader_module = ShaderUtils::createShaderModule(device.getDevice(), frag_shader_code);
+	}
 
 	VkPipelineShaderStageCreateInfo vert_shader_stage_create_info{};
 	vert_shader_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -47,20 +50,18 @@ void GraphicsPipeline::createGraphicsPipeline(
 
 	// First stage of fixed function stages set
 	VkPipelineVertexInputStateCreateInfo vertex_input_info{};
-	auto binding_description = Vertex::getBindingDescription();
-	auto attribute_descriptions = Vertex::getAttributeDescriptions();
 	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_info.vertexBindingDescriptionCount = 1;
-	vertex_input_info.pVertexBindingDescriptions = &binding_description;
-	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-	vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
+	vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(config_info.binding_descriptions.size());
+	vertex_input_info.pVertexBindingDescriptions = config_info.binding_descriptions.data();
+	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(config_info.attribute_descriptions.size());
+	vertex_input_info.pVertexAttributeDescriptions = config_info.attribute_descriptions.data();
 	
 	// START OF PIPELINE CREATION
 	VkGraphicsPipelineCreateInfo pipeline_info{};
 	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
 	// Shader/programmable stages data
-	pipeline_info.stageCount = 2;
+	pipeline_info.stageCount = frag_shader_module == VK_NULL_HANDLE ? 1 : 2;
 	pipeline_info.pStages = shader_stages;
 
 	// Fixed function stages data
@@ -71,13 +72,17 @@ void GraphicsPipeline::createGraphicsPipeline(
 	pipeline_info.pMultisampleState = &config_info.multisample_info;
 	pipeline_info.pDepthStencilState = &config_info.depth_stencil_info;
 	pipeline_info.pColorBlendState = &config_info.color_blend_info;
-	pipeline_info.pDynamicState = nullptr; // Optional
+	VkPipelineDynamicStateCreateInfo dynamic_state_info{};
+	dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state_info.dynamicStateCount = static_cast<uint32_t>(config_info.dynamic_states.size());
+	dynamic_state_info.pDynamicStates = config_info.dynamic_states.data();
+	pipeline_info.pDynamicState = config_info.dynamic_states.empty() ? nullptr : &dynamic_state_info;
 
 	pipeline_info.layout = config_info.pipeline_layout;
 
 	// Defines which render pass this pipeline will belong to and which subpass it constitutes
 	pipeline_info.renderPass = config_info.render_pass;
-	pipeline_info.subpass = 0;
+	pipeline_info.subpass = config_info.subpass;
 
 	// No parent pipeline to derive from (would also require a VK_PIPELINE_CREATE_DERIVATIVE_BIT flag)
 	pipeline_info.basePipelineHandle = VK_NULL_HANDLE; // Optional
@@ -89,7 +94,7 @@ void GraphicsPipeline::createGraphicsPipeline(
 	// END OF PIPELINE CREATION
 
 	vkDestroyShaderModule(device.getDevice(), vert_shader_module, nullptr);
-	vkDestroyShaderModule(device.getDevice(), frag_shader_module, nullptr);
+	if (frag_shader_module != VK_NULL_HANDLE) vkDestroyShaderModule(device.getDevice(), frag_shader_module, nullptr);
 }
 
 void
@@ -97,8 +102,50 @@ GraphicsPipeline::bind(VkCommandBuffer command_buffer) {
 	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, internal_pipeline);
 }
 
+ComputePipeline::ComputePipeline(
+	LogicalDevice& device,
+	const std::string& comp_file_path,
+	VkPipelineLayout pipeline_layout)
+	: device{ device } {
+
+	if (pipeline_layout == VK_NULL_HANDLE) {
+		throw std::runtime_error("Compute pipeline creation requires a pipeline layout");
+	}
+
+	std::vector<char> comp_shader_code = FileUtils::readFile(comp_file_path);
+	VkShaderModule comp_shader_module = ShaderUtils::createShaderModule(device.getDevice(), comp_shader_code);
+
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT; // A compute pipeline consists of this single programmable stage
+	pipeline_info.stage.module = comp_shader_module;
+	pipeline_info.stage.pName = "main";
+	pipeline_info.layout = pipeline_layout;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_info.basePipelineIndex = -1;
+
+	if (vkCreateComputePipelines(device.getDevice(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &internal_pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+
+	vkDestroyShaderModule(device.getDevice(), comp_shader_module, nullptr);
+}
+
+void
+ComputePipeline::bind(VkCommandBuffer command_buffer) {
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, internal_pipeline);
+}
+
 void
 GraphicsPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& config_info, uint32_t width, uint32_t height) {
+	// Per-vertex data in binding 0, per-instance data in binding 1
+	auto vertex_attributes = Vertex::getAttributeDescriptions();
+	auto instance_attributes = InstanceData::getAttributeDescriptions();
+	config_info.binding_descriptions = { Vertex::getBindingDescription(), InstanceData::getBindingDescription() };
+	config_info.attribute_descriptions.assign(vertex_attributes.begin(), vertex_attributes.end());
+	config_info.attribute_descriptions.insert(config_info.attribute_descriptions.end(), instance_attributes.begin(), instance_attributes.end());
+
 	config_info.input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 	config_info.input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; // Specifies that each 3 vertices describe a triangle with no reuse, see (https://vulkan-tutorial.com/en/Drawing_a_triangle/Graphics_pipeline_basics/Fixed_functions)
 	config_info.input_assembly_info.primitiveRestartEnable = VK_FALSE; // Specifies whether or not a MAX value specifices the restart of assembly, see (https://vulkan-tutorial.com/en/Drawing_a_triangle/Graphics_pipeline_basics/Fixed_functions)
@@ -145,10 +192,21 @@ GraphicsPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& config_info, uin
 	config_info.color_blend_info.attachmentCount = 1;
 	config_info.color_blend_info.pAttachments = &config_info.color_blend_attachment;
 
-	// config_info.depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	// config_info.depth_stencil_info.depthTestEnable = VK_TRUE;
-	// config_info.depth_stencil_info.depthWriteEnable = VK_TRUE;
-	// config_info.depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
-	// config_info.depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
-	// config_info.depth_stencil_info.stencilTestEnable = VK_FALSE;
+	config_info.depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	config_info.depth_stencil_info.depthTestEnable = VK_TRUE;
+	config_info.depth_stencil_info.depthWriteEnable = VK_TRUE;
+	config_info.depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL; // Later draws at equal depth still win, so coplanar geometry keeps its draw order (unless draws are sorted by state)
+	config_info.depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
+	config_info.depth_stencil_info.stencilTestEnable = VK_FALSE;
+}
+
+void
+GraphicsPipeline::depthPrepassConfigInfo(PipelineConfigInfo& depth_config_info, PipelineConfigInfo& colour_config_info) {
+	// The pre-pass lays down the nearest depth of every pixel without shading it
+	depth_config_info.color_blend_attachment.colorWriteMask = 0;
+	depth_config_info.depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	// Only the nearest fragment of each pixel then passes the colour pass' depth test
+	colour_config_info.depth_stencil_info.depthWriteEnable = VK_FALSE;
+	colour_config_info.depth_stencil_info.depthCompareOp = VK_COMPARE_OP_EQUAL;
 }
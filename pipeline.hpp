@@ -6,6 +6,8 @@
 #include <vector>
 
 struct PipelineConfigInfo {
+	std::vector<VkVertexInputBindingDescription> binding_descriptions;
+	std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
 	VkViewport viewport;
 	VkRect2D scissor;
 	VkPipelineViewportStateCreateInfo viewport_info;
@@ -15,6 +17,7 @@ struct PipelineConfigInfo {
 	VkPipelineColorBlendAttachmentState color_blend_attachment;
 	VkPipelineColorBlendStateCreateInfo color_blend_info;
 	VkPipelineDepthStencilStateCreateInfo depth_stencil_info;
+	std::vector<VkDynamicState> dynamic_states; // State set while recording instead, e.g. the viewport and scissor
 	VkPipelineLayout pipeline_layout = nullptr;
 	VkRenderPass render_pass = nullptr;
 	uint32_t subpass = 0;
@@ -30,7 +33,7 @@ public:
 	/// </summary>
 	/// <param name="device">Device from which to derive the pipeline</param>
 	/// <param name="vert_file_path">Path to a SPIR-V vertex shader file</param>
-	/// <param name="frag_file_path">Path to a SPIR-V fragment shader file</param>
+	/// <param name="frag_file_path">Path to a SPIR-V fragment shader file (empty for a depth-only pipeline)</param>
 	/// <param name="config_info">Configuration information to be utilised in pipeline construction</param>
 	GraphicsPipeline(
 		LogicalDevice& device,
@@ -52,6 +55,13 @@ public:
 	/// <param name="width">Width of images to be rendered by the pipeline</param>
 	/// <param name="height">Hiehgt of images to be rendered by the pipeline</param>
 	static void defaultPipelineConfigInfo(PipelineConfigInfo& config_info, uint32_t width, uint32_t height);
+	/// <summary>
+	/// Adjusts two default configs for a depth pre-pass: the first writes depth only, the second then shades only the
+	/// fragments whose depth equals the stored one, so each pixel is shaded once however much geometry overlaps it
+	/// </summary>
+	/// <param name="depth_config_info">Default config turned into the depth-only pre-pass config</param>
+	/// <param name="colour_config_info">Default config turned into the equal-test colour pass config</param>
+	static void depthPrepassConfigInfo(PipelineConfigInfo& depth_config_info, PipelineConfigInfo& colour_config_info);
 
 private:
 	/// <summary>
@@ -68,3 +78,31 @@ private:
 	LogicalDevice& device;
 	VkPipeline internal_pipeline;
 };
+
+/// <summary>
+/// Class for creating and managing a Vulkan compute pipeline
+/// </summary>
+class ComputePipeline {
+public:
+	/// <summary>
+	/// Creates a ComputePipeline object
+	/// </summary>
+	/// <param name="device">Device from which to derive the pipeline</param>
+	/// <param name="comp_file_path">Path to a SPIR-V compute shader file</param>
+	/// <param name="pipeline_layout">Layout describing the descriptor sets and push constants used by the shader</param>
+	ComputePipeline(
+		LogicalDevice& device,
+		const std::string& comp_file_path,
+		VkPipelineLayout pipeline_layout);
+	~ComputePipeline() { vkDestroyPipeline(device.getDevice(), internal_pipeline, nullptr); }
+
+	/// <summary>
+	/// Bind this pipeline to the compute bind point of the given command buffer
+	/// </summary>
+	/// <param name="command_buffer">Command buffer to bind this pipeline to</param>
+	void bind(VkCommandBuffer command_buffer);
+
+private:
+	LogicalDevice& device;
+	VkPipeline internal_pipeline;
+};
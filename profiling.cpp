@@ -0,0 +1,170 @@
+#include "profiling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <string>
+#endif
+
+FrameTimeSummary
+ProfilingUtils::summarise(std::vector<double> samples) {
+	FrameTimeSummary summary{};
+	summary.sample_count = samples.size();
+	if (samples.empty()) return summary;
+
+	std::sort(samples.begin(), samples.end());
+	// Nearest-rank percentile: smallest sample such that at least p% of samples are less than or equal to it
+	auto percentile = [&samples](double p) {
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+		return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+	};
+
+	summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+	summary.p50 = percentile(50.0);
+	summary.p99 = percentile(99.0);
+	summary.max = samples.back();
+	return summary;
+}
+
+HostMemoryUsage
+ProfilingUtils::queryHostMemoryUsage() {
+	HostMemoryUsage usage{};
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		usage.current_bytes = counters.WorkingSetSize;
+		usage.peak_bytes = counters.PeakWorkingSetSize;
+	}
+#elif defined(__linux__)
+	// VmRSS and VmHWM are reported in kB
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.rfind("VmRSS:", 0) == 0) usage.current_bytes = std::stoull(line.substr(6)) * 1024;
+		else if (line.rfind("VmHWM:", 0) == 0) usage.peak_bytes = std::stoull(line.substr(6)) * 1024;
+	}
+#endif
+	return usage;
+}
+
+GpuTimer::GpuTimer(LogicalDevice& device, uint32_t slot_count) : device{ device }, pending(slot_count, false) {
+	// Timestamps are only meaningful if the graphics queue family has valid timestamp bits
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queue_family_count, queue_families.data());
+	uint32_t valid_bits = queue_families[device.findPhysicalQueueFamilies().graphics_family.value()].timestampValidBits;
+
+	timestamp_period_ns = device.physical_device_properties.limits.timestampPeriod;
+	supported = valid_bits > 0 && timestamp_period_ns > 0.0;
+	if (!supported) return;
+	timestamp_mask = valid_bits >= 64 ? UINT64_MAX : ((uint64_t{ 1 } << valid_bits) - 1);
+
+	VkQueryPoolCreateInfo query_pool_info{};
+	query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	query_pool_info.queryCount = slot_count * 2; // A start and an end timestamp per slot
+	if (vkCreateQueryPool(device.getDevice(), &query_pool_info, nullptr, &query_pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp query pool");
+	}
+}
+
+GpuTimer::~GpuTimer() {
+	if (query_pool != VK_NULL_HANDLE) vkDestroyQueryPool(device.getDevice(), query_pool, nullptr);
+}
+
+void
+GpuTimer::begin(VkCommandBuffer command_buffer, uint32_t slot) {
+	if (!supported) return;
+	vkCmdResetQueryPool(command_buffer, query_pool, slot * 2, 2); // Queries must be reset before every reuse
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, slot * 2);
+}
+
+void
+GpuTimer::end(VkCommandBuffer command_buffer, uint32_t slot) {
+	if (!supported) return;
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, slot * 2 + 1);
+	pending[slot] = true;
+}
+
+std::optional<double>
+GpuTimer::collect(uint32_t slot) {
+	if (!supported || !pending[slot]) return std::nullopt;
+	pending[slot] = false;
+
+	uint64_t timestamps[2];
+	if (vkGetQueryPoolResults(
+		device.getDevice(),
+		query_pool,
+		slot * 2,
+		2,
+		sizeof(timestamps),
+		timestamps,
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+		return std::nullopt;
+	}
+
+	uint64_t elapsed_ticks = ((timestamps[1] & timestamp_mask) - (timestamps[0] & timestamp_mask)) & timestamp_mask; // Masking again handles counter wrap-around
+	return static_cast<double>(elapsed_ticks) * timestamp_period_ns / 1.0e6;
+}
+
+FragmentCounter::FragmentCounter(LogicalDevice& device, uint32_t slot_count) : device{ device }, pending(slot_count, false) {
+	supported = device.getEnabledFeatures().pipeline_statistics_query;
+	if (!supported) return;
+
+	VkQueryPoolCreateInfo query_pool_info{};
+	query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	query_pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	query_pool_info.queryCount = slot_count;
+	query_pool_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT; // The only statistic, so each result is a single value
+	if (vkCreateQueryPool(device.getDevice(), &query_pool_info, nullptr, &query_pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline statistics query pool");
+	}
+}
+
+FragmentCounter::~FragmentCounter() {
+	if (query_pool != VK_NULL_HANDLE) vkDestroyQueryPool(device.getDevice(), query_pool, nullptr);
+}
+
+void
+FragmentCounter::begin(VkCommandBuffer command_buffer, uint32_t slot) {
+	if (!supported) return;
+	vkCmdResetQueryPool(command_buffer, query_pool, slot, 1); // Queries must be reset before every reuse
+	vkCmdBeginQuery(command_buffer, query_pool, slot, 0);
+}
+
+void
+FragmentCounter::end(VkCommandBuffer command_buffer, uint32_t slot) {
+	if (!supported) return;
+	vkCmdEndQuery(command_buffer, query_pool, slot);
+	pending[slot] = true;
+}
+
+std::optional<uint64_t>
+FragmentCounter::collect(uint32_t slot) {
+	if (!supported || !pending[slot]) return std::nullopt;
+	pending[slot] = false;
+
+	uint64_t invocations = 0;
+	if (vkGetQueryPoolResults(
+		device.getDevice(),
+		query_pool,
+		slot,
+		1,
+		sizeof(invocations),
+		&invocations,
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+		return std::nullopt;
+	}
+	return invocations;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/// <summary>
+/// Per-frame timings gathered by the application while running
+/// </summary>
+struct FrameTimings {
+	/// <summary>
+	/// Wall-clock time spent on the CPU for each drawn frame, in milliseconds
+	/// </summary>
+	std::vector<double> cpu_ms;
+	/// <summary>
+	/// GPU execution time of each frame's command buffer, in milliseconds (empty if timestamps are unsupported)
+	/// </summary>
+	std::vector<double> gpu_ms;
+	/// <summary>
+	/// Fragment shader invocations of each frame's command buffer (empty if pipeline statistics queries are unsupported)
+	/// </summary>
+	std::vector<uint64_t> fragment_invocations;
+	/// <summary>
+	/// Fraction of the swapchain's resolution, per axis, each frame was rendered at
+	/// </summary>
+	std::vector<double> render_scale;
+	/// <summary>
+	/// Pipeline, vertex buffer and push constant binds recorded for each frame's scene draws
+	/// </summary>
+	std::vector<uint32_t> binds_issued;
+	/// <summary>
+	/// Binds each frame's scene draws requested that were skipped because the state was already bound
+	/// </summary>
+	std::vector<uint32_t> binds_skipped;
+};
+
+/// <summary>
+/// Summary statistics of a set of frame time samples
+/// </summary>
+struct FrameTimeSummary {
+	size_t sample_count = 0;
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+/// <summary>
+/// Memory used by the current process on the host
+/// </summary>
+struct HostMemoryUsage {
+	uint64_t current_bytes = 0;
+	uint64_t peak_bytes = 0;
+};
+
+/// <summary>
+/// Utility class containing static methods for summarising profiling data
+/// </summary>
+class ProfilingUtils {
+public:
+	/// <summary>
+	/// Compute mean and nearest-rank percentiles of the given samples
+	/// </summary>
+	/// <param name="samples">Frame times to summarise (order does not matter)</param>
+	/// <returns>Summary of the samples, all zero if there are none</returns>
+	static FrameTimeSummary summarise(std::vector<double> samples);
+	/// <summary>
+	/// Query the resident set size of this process (current and peak)
+	/// </summary>
+	/// <returns>Memory usage, all zero on platforms where it cannot be queried</returns>
+	static HostMemoryUsage queryHostMemoryUsage();
+};
+
+/// <summary>
+/// Measures GPU execution time of command buffers through timestamp queries.
+/// Each slot owns a pair of queries, so one slot should be used per command buffer that can be in flight at once
+/// </summary>
+class GpuTimer {
+public:
+	/// <summary>
+	/// Creates a GpuTimer object
+	/// </summary>
+	/// <param name="device">Device whose graphics queue executes the timed command buffers</param>
+	/// <param name="slot_count">Number of command buffers that can be timed simultaneously</param>
+	GpuTimer(LogicalDevice& device, uint32_t slot_count);
+	~GpuTimer();
+
+	/// <summary>
+	/// Whether the graphics queue supports timestamps. All other calls are no-ops if it does not
+	/// </summary>
+	bool isSupported() { return supported; }
+
+	/// <summary>
+	/// Record the start timestamp for a slot. Must be recorded outside of a render pass
+	/// </summary>
+	/// <param name="command_buffer">Command buffer being timed</param>
+	/// <param name="slot">Slot to record into</param>
+	void begin(VkCommandBuffer command_buffer, uint32_t slot);
+	/// <summary>
+	/// Record the end timestamp for a slot. Must be recorded outside of a render pass
+	/// </summary>
+	/// <param name="command_buffer">Command buffer being timed</param>
+	/// <param name="slot">Slot to record into</param>
+	void end(VkCommandBuffer command_buffer, uint32_t slot);
+	/// <summary>
+	/// Fetch the elapsed time of the last submission recorded in a slot.
+	/// The caller must ensure that submission has completed (e.g. by waiting on its fence)
+	/// </summary>
+	/// <param name="slot">Slot to read from</param>
+	/// <returns>Elapsed GPU time in milliseconds, or nothing if no timing was pending for the slot</returns>
+	std::optional<double> collect(uint32_t slot);
+
+private:
+	LogicalDevice& device;
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	bool supported = false;
+	double timestamp_period_ns = 0.0;
+	uint64_t timestamp_mask = 0;
+	std::vector<bool> pending;
+};
+
+/// <summary>
+/// Counts fragment shader invocations of command buffers through pipeline statistics queries, to measure overdraw.
+/// Each slot owns a single query, so one slot should be used per command buffer that can be in flight at once
+/// </summary>
+class FragmentCounter {
+public:
+	/// <summary>
+	/// Creates a FragmentCounter object
+	/// </summary>
+	/// <param name="device">Device whose graphics queue executes the counted command buffers</param>
+	/// <param name="slot_count">Number of command buffers that can be counted simultaneously</param>
+	FragmentCounter(LogicalDevice& device, uint32_t slot_count);
+	~FragmentCounter();
+
+	/// <summary>
+	/// Whether the device supports pipeline statistics queries. All other calls are no-ops if it does not
+	/// </summary>
+	bool isSupported() { return supported; }
+
+	/// <summary>
+	/// Start counting for a slot. Must be recorded outside of a render pass
+	/// </summary>
+	/// <param name="command_buffer">Command buffer being counted</param>
+	/// <param name="slot">Slot to count into</param>
+	void begin(VkCommandBuffer command_buffer, uint32_t slot);
+	/// <summary>
+	/// Stop counting for a slot. Must be recorded outside of a render pass
+	/// </summary>
+	/// <param name="command_buffer">Command buffer being counted</param>
+	/// <param name="slot">Slot to count into</param>
+	void end(VkCommandBuffer command_buffer, uint32_t slot);
+	/// <summary>
+	/// Fetch the count of the last submission recorded in a slot.
+	/// The caller must ensure that submission has completed (e.g. by waiting on its fence)
+	/// </summary>
+	/// <param name="slot">Slot to read from</param>
+	/// <returns>Number of fragment shader invocations, or nothing if no count was pending for the slot</returns>
+	std::optional<uint64_t> collect(uint32_t slot);
+
+private:
+	LogicalDevice& device;
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	bool supported = false;
+	std::vector<bool> pending;
+};
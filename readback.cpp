@@ -0,0 +1,83 @@
+#include "readback.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+FrameReadback::FrameReadback(LogicalDevice& device, uint32_t slot_count, VkExtent2D extent, VkFormat format)
+	: device{ device }, extent{ extent }, slots(slot_count) {
+	if (!isFormatSupported(format)) throw std::runtime_error("Images of this format cannot be read back");
+	swizzle = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+	for (Slot& slot : slots) {
+		device.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			MemoryCategory::Readback,
+			slot.buffer,
+			slot.memory);
+		void* mapped;
+		vkMapMemory(device.getDevice(), slot.memory, 0, size, 0, &mapped);
+		slot.mapped = static_cast<const uint8_t*>(mapped);
+	}
+}
+
+FrameReadback::~FrameReadback() {
+	for (Slot& slot : slots) {
+		vkUnmapMemory(device.getDevice(), slot.memory);
+		vkDestroyBuffer(device.getDevice(), slot.buffer, nullptr);
+		device.freeMemory(slot.memory);
+	}
+}
+
+bool
+FrameReadback::isFormatSupported(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void
+FrameReadback::record(VkCommandBuffer command_buffer, uint32_t slot, VkImage image, uint64_t frame) {
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { extent.width, extent.height, 1 }; // Rows tightly packed, as bufferRowLength is 0
+	vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slots[slot].buffer, 1, &region);
+
+	// Signalling the frame's fence does not by itself make device writes visible to the host
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = slots[slot].buffer;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	slots[slot].pending = true;
+	slots[slot].frame = frame;
+}
+
+std::optional<CapturedFrame>
+FrameReadback::collect(uint32_t slot) {
+	if (!slots[slot].pending) return std::nullopt;
+	slots[slot].pending = false;
+
+	CapturedFrame captured;
+	captured.frame = slots[slot].frame;
+	captured.image.width = extent.width;
+	captured.image.height = extent.height;
+	captured.image.pixels.resize(static_cast<size_t>(extent.width) * extent.height * 4);
+	memcpy(captured.image.pixels.data(), slots[slot].mapped, captured.image.pixels.size());
+	if (swizzle) {
+		for (size_t i = 0; i < captured.image.pixels.size(); i += 4) std::swap(captured.image.pixels[i], captured.image.pixels[i + 2]);
+	}
+	return captured;
+}
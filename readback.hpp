@@ -0,0 +1,76 @@
+#pragma once
+
+#include "device.hpp"
+#include "image.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/// <summary>
+/// Rendered image copied back to the CPU
+/// </summary>
+struct CapturedFrame {
+	/// <summary>
+	/// Index of the frame the image was rendered in, counted from the application's start
+	/// </summary>
+	uint64_t frame = 0;
+	RgbaImage image;
+};
+
+/// <summary>
+/// Copies rendered images into a ring of persistently mapped host-visible buffers, one per command buffer, without ever
+/// waiting for the copies. A copy is read once the submission that recorded it is known to have completed, i.e. frames
+/// later when the same command buffer is about to be reused, so capturing never stalls rendering
+/// </summary>
+class FrameReadback {
+public:
+	/// <summary>
+	/// Creates a FrameReadback object
+	/// </summary>
+	/// <param name="device">Device whose graphics queue executes the copies</param>
+	/// <param name="slot_count">Number of command buffers that can hold a copy simultaneously</param>
+	/// <param name="extent">Size of the images copied</param>
+	/// <param name="format">Format of the images copied (see isFormatSupported)</param>
+	FrameReadback(LogicalDevice& device, uint32_t slot_count, VkExtent2D extent, VkFormat format);
+	~FrameReadback();
+
+	FrameReadback(const FrameReadback&) = delete;
+	FrameReadback& operator=(const FrameReadback&) = delete;
+
+	/// <summary>
+	/// Whether images of the given format can be read back (8-bit RGBA or BGRA, which are converted to RGBA)
+	/// </summary>
+	static bool isFormatSupported(VkFormat format);
+
+	/// <summary>
+	/// Record a copy of an image into a slot's buffer, made visible to the host once the command buffer completes.
+	/// Must be recorded outside of a render pass, with the image in the transfer source layout
+	/// </summary>
+	/// <param name="command_buffer">Command buffer to record into</param>
+	/// <param name="slot">Slot to copy into</param>
+	/// <param name="image">Image to copy</param>
+	/// <param name="frame">Index of the frame being recorded</param>
+	void record(VkCommandBuffer command_buffer, uint32_t slot, VkImage image, uint64_t frame);
+	/// <summary>
+	/// Fetch the image copied by the last submission recorded in a slot.
+	/// The caller must ensure that submission has completed (e.g. by waiting on its fence)
+	/// </summary>
+	/// <param name="slot">Slot to read from</param>
+	/// <returns>The copied image, or nothing if no copy was pending for the slot</returns>
+	std::optional<CapturedFrame> collect(uint32_t slot);
+
+private:
+	struct Slot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		const uint8_t* mapped = nullptr;
+		bool pending = false;
+		uint64_t frame = 0;
+	};
+
+	LogicalDevice& device;
+	VkExtent2D extent;
+	bool swizzle; // Images are BGRA
+	std::vector<Slot> slots;
+};
@@ -0,0 +1,226 @@
+#include "regression.hpp"
+#include "profiling.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+	/// <summary>
+	/// Median of a frame time series, leaving out the warmup frames
+	/// </summary>
+	double measuredMedian(const std::vector<double>& samples) {
+		size_t skip = std::min<size_t>(Benchmark::WARMUP_FRAMES, samples.size());
+		return ProfilingUtils::summarise(std::vector<double>(samples.begin() + skip, samples.end())).p50;
+	}
+}
+
+RegressionSuite::RegressionSuite(const AppSettings& settings, const std::string& directory, const RegressionSettings& regression_settings)
+	: settings{ settings }, directory{ directory }, regression_settings{ regression_settings } {}
+
+const std::vector<RegressionScene>&
+RegressionSuite::referenceScenes() {
+	static const std::vector<RegressionScene> scenes = {
+		{ { "triangle", 1, 1 } },
+		{ { "tris_10k_draws_100", 10000, 100 } },
+		{ { "tris_10k_draws_100_indirect", 10000, 100 }, 1, false, true },
+		{ { "copies_1k_instanced", 10000, 1000, true } },
+		{ { "overdraw_layers_8", 16, 8, false, true } },
+		{ { "overdraw_layers_8_prepass", 16, 8, false, true }, 1, true },
+		{ { "tris_10k_draws_100_msaa_4", 10000, 100 }, 4 },
+		// Zoomed in so that roughly half the objects fall outside the frustum and some straddle its side planes
+		{ { "tris_10k_draws_100_gpu_culled", 10000, 100 }, 1, false, true, true, glm::scale(glm::mat4{ 1.0f }, glm::vec3{ 2.0f, 2.0f, 1.0f }) }
+	};
+	return scenes;
+}
+
+bool
+RegressionSuite::run(std::ostream& report, const std::string& scene_filter) {
+	std::filesystem::create_directories(directory);
+	Baselines baselines = readBaselines();
+	bool passed = true;
+	bool device_warned = false;
+
+	report << std::fixed << std::setprecision(4);
+	for (const RegressionScene& scene : referenceScenes()) {
+		const std::string& name = scene.config.name;
+		if (!scene_filter.empty() && name.find(scene_filter) == std::string::npos) continue;
+		std::cerr << "Running regression scene " << name << std::endl;
+
+		Metrics metrics;
+		std::string device_name;
+		RgbaImage image;
+		try {
+			image = renderScene(scene, metrics, device_name);
+		}
+		catch (const std::runtime_error& e) {
+			// GPU culling disagreeing with the CPU reference ends up here too
+			report << "[FAIL] " << name << ": " << e.what() << std::endl;
+			passed = false;
+			continue;
+		}
+
+		if (regression_settings.update) {
+			ImageUtils::writePng((std::filesystem::path(directory) / (name + ".png")).string(), image);
+			if (baselines.device != device_name) baselines.scenes.clear(); // Measurements of another device are not comparable
+			baselines.device = device_name;
+			baselines.scenes[name] = metrics;
+			report << "[UPDATED] " << name << std::endl;
+			continue;
+		}
+
+		bool scene_passed = checkImage(report, name, image);
+		auto baseline = baselines.scenes.find(name);
+		if (baseline == baselines.scenes.end()) {
+			report << "[FAIL] " << name << ": no baselines recorded, run with --update-baselines" << std::endl;
+			scene_passed = false;
+		} else if (baselines.device != device_name) {
+			if (!device_warned) std::cerr << "Baselines were recorded on " << baselines.device << ", not " << device_name << ", performance is not checked" << std::endl;
+			device_warned = true;
+		} else {
+			scene_passed = checkMetrics(report, name, metrics, baseline->second) && scene_passed;
+		}
+		passed = passed && scene_passed;
+	}
+
+	if (regression_settings.update) writeBaselines(baselines);
+	else report << (passed ? "All regression checks passed" : "Regression checks failed") << std::endl;
+	return passed;
+}
+
+RgbaImage
+RegressionSuite::renderScene(const RegressionScene& scene, Metrics& metrics, std::string& device_name) {
+	// Only the scene decides what is rendered, so references stay valid whatever else the command line asks for
+	AppSettings scene_settings;
+	scene_settings.headless = true;
+	scene_settings.width = WIDTH;
+	scene_settings.height = HEIGHT;
+	scene_settings.frame_limit = Benchmark::WARMUP_FRAMES + MEASURED_FRAMES;
+	scene_settings.capture_interval = scene_settings.frame_limit; // Only the last frame
+	scene_settings.msaa_samples = scene.msaa_samples;
+	scene_settings.depth_prepass = scene.depth_prepass;
+	scene_settings.indirect_draws = scene.indirect_draws;
+	scene_settings.gpu_culling = scene.gpu_culling;
+	scene_settings.validate_culling = scene.gpu_culling;
+	scene_settings.device = settings.device;
+	scene_settings.worker_threads = settings.worker_threads;
+	scene_settings.pin_threads = settings.pin_threads;
+	CoreApp app(scene_settings);
+	device_name = app.getDevice().physical_device_properties.deviceName;
+
+	RgbaImage image;
+	app.setCaptureCallback([&image](CapturedFrame captured) { image = std::move(captured.image); });
+	BenchmarkScene generated = Benchmark::generateScene(scene.config, SEED);
+	std::vector<std::unique_ptr<Model>> models;
+	models.push_back(std::make_unique<Model>(app.getDevice(), generated.vertices, generated.indices));
+	app.setScene(std::move(models), std::move(generated.objects), generated.instances);
+	app.setViewProjection(scene.view_projection);
+	app.run();
+	if (image.pixels.empty()) throw std::runtime_error("Scene " + scene.config.name + " rendered no image, the device cannot capture frames");
+	if (scene.gpu_culling && app.getValidatedCullingFrames() == 0) {
+		throw std::runtime_error("Scene " + scene.config.name + " was not culled on the GPU, the device lacks indirect draws");
+	}
+
+	const FrameTimings& timings = app.getFrameTimings();
+	metrics["cpu_frame_ms_p50"] = measuredMedian(timings.cpu_ms);
+	if (!timings.gpu_ms.empty()) metrics["gpu_frame_ms_p50"] = measuredMedian(timings.gpu_ms);
+	MemorySnapshot memory = app.getDevice().getMemoryTracker().snapshot();
+	metrics["device_allocated_bytes"] = static_cast<double>(memory.allocatedBytes());
+	metrics["device_peak_bytes"] = static_cast<double>(std::accumulate(memory.categories.begin(), memory.categories.end(), VkDeviceSize{ 0 },
+		[](VkDeviceSize total, const CategoryUsage& usage) { return total + usage.peak_bytes; }));
+	return image;
+}
+
+bool
+RegressionSuite::checkImage(std::ostream& report, const std::string& scene, const RgbaImage& image) {
+	std::filesystem::path golden_path = std::filesystem::path(directory) / (scene + ".png");
+	std::filesystem::path failure_directory = std::filesystem::path(directory) / "failures";
+	if (!std::filesystem::exists(golden_path)) {
+		std::filesystem::create_directories(failure_directory);
+		ImageUtils::writePng((failure_directory / (scene + ".png")).string(), image);
+		report << "[FAIL] " << scene << ": no golden image " << golden_path.string() << ", run with --update-baselines" << std::endl;
+		return false;
+	}
+
+	RgbaImage golden = ImageUtils::readPng(golden_path.string());
+	if (golden.width != image.width || golden.height != image.height) {
+		report << "[FAIL] " << scene << ": golden image is " << golden.width << "x" << golden.height << ", rendered " << image.width << "x" << image.height << std::endl;
+		return false;
+	}
+	RgbaImage diff;
+	ImageComparison comparison = ImageUtils::compare(golden, image, regression_settings.pixel_threshold, &diff);
+	bool passed = comparison.differing_fraction <= regression_settings.image_tolerance;
+	report << (passed ? "[PASS] " : "[FAIL] ") << scene << " image: " << comparison.differing_pixels << " pixels ("
+		<< comparison.differing_fraction * 100.0 << "%) differ, max delta " << comparison.max_delta << std::endl;
+	if (!passed) {
+		std::filesystem::create_directories(failure_directory);
+		ImageUtils::writePng((failure_directory / (scene + ".png")).string(), image);
+		ImageUtils::writePng((failure_directory / (scene + ".diff.png")).string(), diff);
+	}
+	return passed;
+}
+
+bool
+RegressionSuite::checkMetrics(std::ostream& report, const std::string& scene, const Metrics& metrics, const Metrics& baselines) {
+	bool passed = true;
+	for (const auto& [metric, value] : metrics) {
+		auto baseline = baselines.find(metric);
+		if (baseline == baselines.end()) continue; // Not measurable when the baselines were recorded
+		bool is_time = metric.find("_ms") != std::string::npos;
+		double limit = baseline->second * (1.0 + regression_settings.performance_threshold) + (is_time ? TIME_SLACK_MS : 0.0);
+		double change = baseline->second > 0.0 ? (value / baseline->second - 1.0) * 100.0 : 0.0;
+		bool metric_passed = value <= limit;
+		passed = passed && metric_passed;
+		report << (metric_passed ? "[PASS] " : "[FAIL] ") << scene << " " << metric << ": " << value << " (baseline " << baseline->second
+			<< ", " << std::showpos << change << std::noshowpos << "%)" << std::endl;
+	}
+	return passed;
+}
+
+RegressionSuite::Baselines
+RegressionSuite::readBaselines() {
+	Baselines baselines;
+	std::ifstream file(baselinePath());
+	if (!file.is_open()) return baselines;
+
+	// One "SCENE METRIC VALUE" per line, after a "device NAME" line
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		if (line.rfind("device ", 0) == 0) {
+			baselines.device = line.substr(7);
+			continue;
+		}
+		std::istringstream fields(line);
+		std::string scene, metric;
+		double value;
+		if (!(fields >> scene >> metric >> value)) throw std::runtime_error("Malformed baseline in " + baselinePath() + ": " + line);
+		baselines.scenes[scene][metric] = value;
+	}
+	return baselines;
+}
+
+void
+RegressionSuite::writeBaselines(const Baselines& baselines) {
+	std::ofstream file(baselinePath());
+	if (!file.is_open()) throw std::runtime_error("Failed to open baselines " + baselinePath());
+	file << "# Performance baselines of the regression suite, rewritten by --update-baselines\n";
+	file << "device " << baselines.device << "\n";
+	file << std::setprecision(10);
+	for (const auto& [scene, metrics] : baselines.scenes) {
+		for (const auto& [metric, value] : metrics) file << scene << " " << metric << " " << value << "\n";
+	}
+}
+
+std::string
+RegressionSuite::baselinePath() {
+	return (std::filesystem::path(directory) / "baselines.txt").string();
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "core_app.hpp"
+#include "image.hpp"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Reference scene of the regression suite and the rendering features it exercises
+/// </summary>
+struct RegressionScene {
+	BenchmarkSceneConfig config;
+	uint32_t msaa_samples = 1;
+	bool depth_prepass = false;
+	bool indirect_draws = false;
+	/// <summary>
+	/// Cull the draws in the compute pass and check every frame's result against the CPU reference
+	/// </summary>
+	bool gpu_culling = false;
+	/// <summary>
+	/// Camera of the scene; the identity shows exactly the generated geometry
+	/// </summary>
+	glm::mat4 view_projection{ 1.0f };
+};
+
+/// <summary>
+/// Options of a regression suite run
+/// </summary>
+struct RegressionSettings {
+	/// <summary>
+	/// Perceptual difference (0 to 1) above which a pixel differs from the golden image
+	/// </summary>
+	double pixel_threshold = ImageUtils::DEFAULT_THRESHOLD;
+	/// <summary>
+	/// Fraction of pixels that may differ from the golden image, absorbing rasterisation differences between driver versions
+	/// </summary>
+	double image_tolerance = 0.001;
+	/// <summary>
+	/// Fraction by which a metric may exceed its baseline before it counts as a regression
+	/// </summary>
+	double performance_threshold = 0.15;
+	/// <summary>
+	/// Record the rendered images and measured metrics as the new golden images and baselines instead of checking them
+	/// </summary>
+	bool update = false;
+};
+
+/// <summary>
+/// Renders a fixed set of deterministic scenes headlessly and checks each against a golden image, and its frame times and
+/// memory usage against stored baselines. Meant to run on machines without a GPU through a software driver such as
+/// lavapipe (e.g. VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json --regression DIR --device llvmpipe), whose
+/// output is the same wherever it runs. Baselines are only comparable on the device they were recorded on, so they are
+/// skipped with a warning on any other. regression.py runs the suite after the self-test and fails on any regression
+/// </summary>
+class RegressionSuite {
+public:
+	static constexpr uint32_t WIDTH = 256;
+	static constexpr uint32_t HEIGHT = 256;
+	static constexpr uint32_t MEASURED_FRAMES = 100;
+	static constexpr uint32_t SEED = 1;
+	/// <summary>
+	/// Frame time increase tolerated on top of the relative threshold, so that scenes taking fractions of a millisecond
+	/// do not fail on timer noise
+	/// </summary>
+	static constexpr double TIME_SLACK_MS = 0.05;
+
+	/// <summary>
+	/// Creates a RegressionSuite object
+	/// </summary>
+	/// <param name="settings">Application settings selecting the device and job threads (other options are ignored, as each
+	/// scene defines what it renders)</param>
+	/// <param name="directory">Directory holding the golden images (SCENE.png) and baselines (baselines.txt). Images of
+	/// failing scenes and their diffs are written to its failures subdirectory</param>
+	/// <param name="regression_settings">Tolerances of the checks, or whether to record new references</param>
+	RegressionSuite(const AppSettings& settings, const std::string& directory, const RegressionSettings& regression_settings = {});
+
+	/// <summary>
+	/// Run every reference scene, writing a line per check to the report
+	/// </summary>
+	/// <param name="report">Stream to write results to</param>
+	/// <param name="scene_filter">Only scenes whose name contains this string are run (empty runs all)</param>
+	/// <returns>Whether every check passed (when updating references, whether every scene rendered)</returns>
+	bool run(std::ostream& report, const std::string& scene_filter = "");
+
+	/// <summary>
+	/// Small scenes covering direct, instanced and indirect draws, overdraw with and without a depth pre-pass, and
+	/// multisampling
+	/// </summary>
+	static const std::vector<RegressionScene>& referenceScenes();
+
+private:
+	/// <summary>
+	/// Metrics of one scene, keyed by name. All are lower-is-better
+	/// </summary>
+	using Metrics = std::map<std::string, double>;
+
+	/// <summary>
+	/// Stored baselines, per scene and metric
+	/// </summary>
+	struct Baselines {
+		std::string device; // Device the baselines were measured on
+		std::map<std::string, Metrics> scenes;
+	};
+
+	AppSettings settings;
+	std::string directory;
+	RegressionSettings regression_settings;
+
+	/// <summary>
+	/// Render a scene, returning its last frame and filling its metrics
+	/// </summary>
+	RgbaImage renderScene(const RegressionScene& scene, Metrics& metrics, std::string& device_name);
+	/// <summary>
+	/// Compare a rendered image against the scene's golden image, saving it and a diff on failure
+	/// </summary>
+	bool checkImage(std::ostream& report, const std::string& scene, const RgbaImage& image);
+	/// <summary>
+	/// Compare metrics against a scene's baselines, failing on increases above the performance threshold
+	/// </summary>
+	bool checkMetrics(std::ostream& report, const std::string& scene, const Metrics& metrics, const Metrics& baselines);
+
+	Baselines readBaselines();
+	void writeBaselines(const Baselines& baselines);
+	std::string baselinePath();
+};
@@ -0,0 +1,57 @@
+"""
+Runs the self-test and the regression suite headlessly on a software Vulkan driver and exits non-zero if either fails,
+so that a CI job can gate on it. The golden images and baselines in the reference directory have to be recorded once
+on the same driver with --update, and committed; a reference directory without them fails rather than passing.
+
+Example (lavapipe):
+    python regression.py --executable "x64/Release/vulkan-tutorial Follow-Along.exe" --icd path/to/lvp_icd.x86_64.json
+"""
+import argparse
+import os
+import subprocess
+import sys
+from os import chdir, path
+
+DEFAULT_EXECUTABLE = path.join("x64", "Release", "vulkan-tutorial Follow-Along.exe")
+DEFAULT_REFERENCES = "regression"
+DEFAULT_DEVICE = "llvmpipe"
+
+
+def run(command, environment):
+    print(" ".join(f'"{argument}"' if " " in argument else argument for argument in command), flush=True)
+    return subprocess.run(command, env=environment).returncode
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Run the self-test and regression suite, failing on any regression")
+    parser.add_argument("--executable", default=DEFAULT_EXECUTABLE, help="Built application, relative to the repository")
+    parser.add_argument("--references", default=DEFAULT_REFERENCES, help="Directory of golden images and baselines")
+    parser.add_argument("--icd", help="Vulkan driver manifest to load instead of the installed drivers (e.g. lavapipe)")
+    parser.add_argument("--device", default=DEFAULT_DEVICE, help="Name or UUID of the device to render on")
+    parser.add_argument("--scene", default="", help="Only run scenes whose name contains this string")
+    parser.add_argument("--update", action="store_true", help="Record new golden images and baselines instead")
+    arguments = parser.parse_args()
+
+    # The application loads its shaders relative to the working directory
+    chdir(path.dirname(path.realpath(__file__)))
+    if not path.isfile(arguments.executable):
+        sys.exit(f"{arguments.executable} does not exist, build the project first")
+
+    environment = dict(os.environ)
+    if arguments.icd:
+        environment["VK_ICD_FILENAMES"] = path.abspath(arguments.icd)
+
+    if not arguments.update:
+        if not path.isdir(arguments.references) or not any(name.endswith(".png") for name in os.listdir(arguments.references)):
+            sys.exit(f"{arguments.references} holds no golden images, record them with --update on the CI driver first")
+        if run([arguments.executable, "--self-test"], environment) != 0:
+            sys.exit("Self-test failed")
+
+    command = [arguments.executable, "--regression", arguments.references, "--device", arguments.device]
+    if arguments.scene:
+        command += ["--scene", arguments.scene]
+    if arguments.update:
+        os.makedirs(arguments.references, exist_ok=True)
+        command.append("--update-baselines")
+    if run(command, environment) != 0:
+        sys.exit(f"Regression suite failed, see {path.join(arguments.references, 'failures')} for the differing images")
@@ -0,0 +1,751 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+	/// <summary>
+	/// Accesses that modify memory, which later accesses have to wait on
+	/// </summary>
+	constexpr VkAccessFlags WRITE_ACCESS_MASK =
+		VK_ACCESS_SHADER_WRITE_BIT |
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT |
+		VK_ACCESS_HOST_WRITE_BIT |
+		VK_ACCESS_MEMORY_WRITE_BIT;
+}
+
+RenderGraph::RenderGraph(LogicalDevice& device) : device{ device } {}
+
+RenderGraph::~RenderGraph() {
+	for (Pass& pass : passes) {
+		for (auto& [views, framebuffer] : pass.framebuffers) vkDestroyFramebuffer(device.getDevice(), framebuffer, nullptr);
+		if (pass.render_pass != VK_NULL_HANDLE) vkDestroyRenderPass(device.getDevice(), pass.render_pass, nullptr);
+	}
+	for (Image& image : images) {
+		if (image.imported) continue;
+		if (image.view != VK_NULL_HANDLE) vkDestroyImageView(device.getDevice(), image.view, nullptr);
+		if (image.image != VK_NULL_HANDLE) vkDestroyImage(device.getDevice(), image.image, nullptr);
+	}
+	for (MemoryBlock& block : memory_blocks) {
+		device.freeMemory(block.memory);
+	}
+}
+
+uint32_t
+RenderGraph::createImage(const std::string& name, const RenderGraphImageInfo& info) {
+	checkMutable();
+	Image image{};
+	image.name = name;
+	image.info = info;
+	images.push_back(image);
+	return static_cast<uint32_t>(images.size()) - 1;
+}
+
+uint32_t
+RenderGraph::importImage(const std::string& name, const RenderGraphImageInfo& info, VkImageLayout initial_layout, VkImageLayout final_layout) {
+	checkMutable();
+	Image image{};
+	image.name = name;
+	image.info = info;
+	image.imported = true;
+	image.initial_layout = initial_layout;
+	image.final_layout = final_layout;
+	images.push_back(image);
+	return static_cast<uint32_t>(images.size()) - 1;
+}
+
+uint32_t
+RenderGraph::importBuffer(const std::string& name) {
+	checkMutable();
+	buffers.push_back(name);
+	return static_cast<uint32_t>(buffers.size()) - 1;
+}
+
+uint32_t
+RenderGraph::addPass(const std::string& name, std::function<void(VkCommandBuffer)> record) {
+	checkMutable();
+	Pass pass{};
+	pass.name = name;
+	pass.record = std::move(record);
+	passes.push_back(std::move(pass));
+	return static_cast<uint32_t>(passes.size()) - 1;
+}
+
+void
+RenderGraph::readImage(uint32_t pass, uint32_t image, ImageUsage usage) {
+	if (usage == ImageUsage::ColorAttachment || usage == ImageUsage::ResolveAttachment || usage == ImageUsage::DepthAttachment || usage == ImageUsage::TransferDst) {
+		throw std::runtime_error("Pass " + passes[pass].name + " cannot read " + images[image].name + " through a writing usage");
+	}
+	addImageAccess(pass, image, usage, false, std::nullopt);
+}
+
+void
+RenderGraph::writeImage(uint32_t pass, uint32_t image, ImageUsage usage) {
+	if (usage == ImageUsage::DepthRead || usage == ImageUsage::Sampled || usage == ImageUsage::TransferSrc) {
+		throw std::runtime_error("Pass " + passes[pass].name + " cannot write " + images[image].name + " through a read-only usage");
+	}
+	if (usage == ImageUsage::ResolveAttachment) throw std::runtime_error("Pass " + passes[pass].name + " must declare resolves into " + images[image].name + " with resolveImage");
+	addImageAccess(pass, image, usage, true, std::nullopt);
+}
+
+void
+RenderGraph::clearImage(uint32_t pass, uint32_t image, ImageUsage usage, VkClearValue clear_value) {
+	if (usage != ImageUsage::ColorAttachment && usage != ImageUsage::DepthAttachment) {
+		throw std::runtime_error("Pass " + passes[pass].name + " can only clear " + images[image].name + " as an attachment");
+	}
+	addImageAccess(pass, image, usage, true, clear_value);
+}
+
+void
+RenderGraph::resolveImage(uint32_t pass, uint32_t source, uint32_t destination) {
+	const std::vector<ImageAccess>& accesses = passes[pass].images;
+	auto is_source = [&](const ImageAccess& access) { return access.image == source && access.usage == ImageUsage::ColorAttachment; };
+	if (std::none_of(accesses.begin(), accesses.end(), is_source)) {
+		throw std::runtime_error("Pass " + passes[pass].name + " can only resolve " + images[source].name + " after declaring it as a colour attachment");
+	}
+	if (images[source].info.samples == VK_SAMPLE_COUNT_1_BIT || images[destination].info.samples != VK_SAMPLE_COUNT_1_BIT) {
+		throw std::runtime_error("Pass " + passes[pass].name + " can only resolve multisampled images into single-sampled ones");
+	}
+	addImageAccess(pass, destination, ImageUsage::ResolveAttachment, true, std::nullopt);
+	for (ImageAccess& access : passes[pass].images) {
+		if (access.image == destination) access.resolve_source = source;
+	}
+}
+
+void
+RenderGraph::readBuffer(uint32_t pass, uint32_t buffer, BufferUsage usage) {
+	checkMutable();
+	if (usage == BufferUsage::TransferDst) throw std::runtime_error("Pass " + passes[pass].name + " cannot read " + buffers[buffer] + " as a transfer destination");
+	passes[pass].buffers.push_back({ buffer, usage, false });
+}
+
+void
+RenderGraph::writeBuffer(uint32_t pass, uint32_t buffer, BufferUsage usage) {
+	checkMutable();
+	if (usage != BufferUsage::Storage && usage != BufferUsage::TransferDst) {
+		throw std::runtime_error("Pass " + passes[pass].name + " cannot write " + buffers[buffer] + " through a read-only usage");
+	}
+	passes[pass].buffers.push_back({ buffer, usage, true });
+}
+
+void
+RenderGraph::addImageAccess(uint32_t pass, uint32_t image, ImageUsage usage, bool write, std::optional<VkClearValue> clear) {
+	checkMutable();
+	// A pass uses each image in a single layout, repeated declarations of the same usage are merged
+	for (ImageAccess& access : passes[pass].images) {
+		if (access.image != image) continue;
+		if (access.usage != usage) throw std::runtime_error("Pass " + passes[pass].name + " uses " + images[image].name + " in two different ways");
+		access.write = access.write || write;
+		if (clear) access.clear = clear;
+		return;
+	}
+	passes[pass].images.push_back({ image, usage, write, clear });
+}
+
+void
+RenderGraph::checkMutable() {
+	if (compiled) throw std::runtime_error("Render graph cannot change after it has been compiled");
+}
+
+void
+RenderGraph::compile() {
+	checkMutable();
+	buildDependencies();
+	cullPasses();
+	orderPasses();
+	createTransientImages();
+	planBarriers();
+	createRenderPasses();
+	compiled = true;
+}
+
+void
+RenderGraph::setImportedImage(uint32_t image, VkImage handle, VkImageView view) {
+	if (!images[image].imported) throw std::runtime_error("Image " + images[image].name + " is owned by the render graph");
+	images[image].image = handle;
+	images[image].view = view;
+}
+
+void
+RenderGraph::execute(VkCommandBuffer command_buffer) {
+	if (!compiled) throw std::runtime_error("Render graph must be compiled before it is executed");
+
+	for (uint32_t index : order) {
+		Pass& pass = passes[index];
+		recordBarriers(command_buffer, pass.barriers);
+		if (pass.render_pass == VK_NULL_HANDLE) {
+			pass.record(command_buffer);
+			continue;
+		}
+
+		VkRenderPassBeginInfo begin_info{};
+		begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		begin_info.renderPass = pass.render_pass;
+		begin_info.framebuffer = getFramebuffer(pass);
+		begin_info.renderArea.offset = { 0, 0 };
+		begin_info.renderArea.extent = pass.render_area.value_or(pass.extent);
+		begin_info.clearValueCount = static_cast<uint32_t>(pass.clear_values.size());
+		begin_info.pClearValues = pass.clear_values.data();
+		vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		pass.record(command_buffer);
+		vkCmdEndRenderPass(command_buffer);
+	}
+	recordBarriers(command_buffer, final_barriers);
+}
+
+RenderGraph::UsageInfo
+RenderGraph::imageUsageInfo(ImageUsage usage, bool write) {
+	UsageInfo info{};
+	switch (usage) {
+	case ImageUsage::ColorAttachment:
+		info.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		info.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+		if (write) info.access |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		info.image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		break;
+	case ImageUsage::ResolveAttachment:
+		info.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // Resolves count as colour attachment writes
+		info.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		info.image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		break;
+	case ImageUsage::DepthAttachment:
+	case ImageUsage::DepthRead:
+		info.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		if (write) info.access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		info.layout = usage == ImageUsage::DepthRead ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		info.image_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		break;
+	case ImageUsage::Sampled:
+		info.stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.access = VK_ACCESS_SHADER_READ_BIT;
+		info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.image_usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+		break;
+	case ImageUsage::Storage:
+		info.stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.access = VK_ACCESS_SHADER_READ_BIT;
+		if (write) info.access |= VK_ACCESS_SHADER_WRITE_BIT;
+		info.layout = VK_IMAGE_LAYOUT_GENERAL;
+		info.image_usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		break;
+	case ImageUsage::TransferSrc:
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_READ_BIT;
+		info.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		info.image_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		break;
+	case ImageUsage::TransferDst:
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		info.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		info.image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		break;
+	}
+	return info;
+}
+
+RenderGraph::UsageInfo
+RenderGraph::bufferUsageInfo(BufferUsage usage, bool write) {
+	UsageInfo info{};
+	switch (usage) {
+	case BufferUsage::Indirect:
+		info.stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+		info.access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		break;
+	case BufferUsage::Vertex:
+		info.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		info.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		break;
+	case BufferUsage::Index:
+		info.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		info.access = VK_ACCESS_INDEX_READ_BIT;
+		break;
+	case BufferUsage::Uniform:
+		info.stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.access = VK_ACCESS_UNIFORM_READ_BIT;
+		break;
+	case BufferUsage::Storage:
+		info.stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.access = VK_ACCESS_SHADER_READ_BIT;
+		if (write) info.access |= VK_ACCESS_SHADER_WRITE_BIT;
+		break;
+	case BufferUsage::TransferSrc:
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case BufferUsage::TransferDst:
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		break;
+	}
+	return info;
+}
+
+VkImageAspectFlags
+RenderGraph::aspectsOf(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	case VK_FORMAT_S8_UINT:
+		return VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+void
+RenderGraph::buildDependencies() {
+	auto addUnique = [](std::vector<uint32_t>& list, uint32_t pass) {
+		if (std::find(list.begin(), list.end(), pass) == list.end()) list.push_back(pass);
+	};
+	struct ResourceAccess {
+		size_t resource; // Images first, then buffers
+		bool write;
+		bool needs_contents; // Everything but clears and resolves sees what was there before
+	};
+
+	std::vector<uint32_t> last_writer(images.size() + buffers.size(), NO_PASS);
+	std::vector<std::vector<uint32_t>> readers(images.size() + buffers.size()); // Passes reading each resource since its last write
+	for (uint32_t index = 0; index < passes.size(); index++) {
+		Pass& pass = passes[index];
+		std::vector<ResourceAccess> accesses;
+		for (const ImageAccess& access : pass.images) accesses.push_back({ access.image, access.write, !access.clear.has_value() && access.usage != ImageUsage::ResolveAttachment });
+		for (const BufferAccess& access : pass.buffers) accesses.push_back({ images.size() + access.buffer, access.write, true });
+
+		for (const ResourceAccess& access : accesses) {
+			uint32_t writer = last_writer[access.resource];
+			if (writer != NO_PASS) {
+				addUnique(pass.dependencies, writer);
+				if (access.needs_contents) addUnique(pass.data_dependencies, writer);
+			}
+			if (access.write) { // Earlier readers must be done before the resource is overwritten
+				for (uint32_t reader : readers[access.resource]) addUnique(pass.dependencies, reader);
+			}
+		}
+
+		// Updated once the whole pass is known, so a pass reading and writing a resource does not depend on itself
+		for (const ResourceAccess& access : accesses) {
+			if (access.write) {
+				last_writer[access.resource] = index;
+				readers[access.resource].clear();
+			} else {
+				readers[access.resource].push_back(index);
+			}
+		}
+	}
+}
+
+void
+RenderGraph::cullPasses() {
+	// Dependencies always point to earlier passes, so walking backwards sees every user of a pass before the pass itself
+	std::vector<bool> keep(passes.size(), false);
+	for (uint32_t index = static_cast<uint32_t>(passes.size()); index-- > 0;) {
+		Pass& pass = passes[index];
+		if (pass.side_effects) keep[index] = true;
+		for (const ImageAccess& access : pass.images) {
+			if (access.write && images[access.image].imported) keep[index] = true;
+		}
+		for (const BufferAccess& access : pass.buffers) {
+			if (access.write) keep[index] = true;
+		}
+
+		pass.culled = !keep[index];
+		if (pass.culled) continue;
+		for (uint32_t dependency : pass.data_dependencies) keep[dependency] = true;
+	}
+}
+
+void
+RenderGraph::orderPasses() {
+	order.clear();
+	std::vector<uint32_t> position(passes.size(), NO_PASS);
+	std::vector<uint32_t> unscheduled(passes.size(), 0); // Kept dependencies not yet placed
+	size_t kept_count = 0;
+	for (uint32_t index = 0; index < passes.size(); index++) {
+		if (passes[index].culled) continue;
+		kept_count++;
+		for (uint32_t dependency : passes[index].dependencies) {
+			if (!passes[dependency].culled) unscheduled[index]++;
+		}
+	}
+
+	while (order.size() < kept_count) {
+		uint32_t best = NO_PASS;
+		uint32_t best_ready_at = 0;
+		for (uint32_t index = 0; index < passes.size(); index++) {
+			if (passes[index].culled || position[index] != NO_PASS || unscheduled[index] > 0) continue;
+			uint32_t ready_at = 0; // Position right after the last of its dependencies
+			for (uint32_t dependency : passes[index].dependencies) {
+				if (!passes[dependency].culled) ready_at = std::max(ready_at, position[dependency] + 1);
+			}
+			if (best == NO_PASS || ready_at < best_ready_at) {
+				best = index;
+				best_ready_at = ready_at;
+			}
+		}
+		if (best == NO_PASS) throw std::runtime_error("Render graph passes have a dependency cycle");
+
+		position[best] = static_cast<uint32_t>(order.size());
+		order.push_back(best);
+		for (uint32_t index = 0; index < passes.size(); index++) {
+			if (passes[index].culled || position[index] != NO_PASS) continue;
+			const std::vector<uint32_t>& dependencies = passes[index].dependencies;
+			if (std::find(dependencies.begin(), dependencies.end(), best) != dependencies.end()) unscheduled[index]--;
+		}
+	}
+}
+
+void
+RenderGraph::createTransientImages() {
+	// Lifetimes and usage flags over the kept passes
+	for (uint32_t position = 0; position < order.size(); position++) {
+		for (const ImageAccess& access : passes[order[position]].images) {
+			Image& image = images[access.image];
+			if (image.first_use == NO_PASS) image.first_use = position;
+			image.last_use = position;
+			image.usage |= imageUsageInfo(access.usage, access.write).image_usage;
+		}
+	}
+
+	// Attachments that are only used within one pass are never loaded or stored, so they need no backing memory on tilers
+	const VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+	std::vector<uint32_t> transients;
+	for (uint32_t index = 0; index < images.size(); index++) {
+		Image& image = images[index];
+		if (image.imported || image.first_use == NO_PASS) continue;
+		if (image.first_use == image.last_use && (image.usage & ~attachment_usage) == 0) image.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		transients.push_back(index);
+	}
+	std::sort(transients.begin(), transients.end(), [&](uint32_t a, uint32_t b) { return images[a].first_use < images[b].first_use; });
+
+	for (uint32_t index : transients) {
+		Image& image = images[index];
+		VkImageCreateInfo image_info{};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.format = image.info.format;
+		image_info.extent = { image.info.extent.width, image.info.extent.height, 1 };
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.samples = image.info.samples;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.usage = image.usage;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(device.getDevice(), &image_info, nullptr, &image.image) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create transient image " + image.name);
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(device.getDevice(), image.image, &requirements);
+		unaliased_memory_size += requirements.size;
+		bool lazy = (image.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && device.hasMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+		// Share the block closest in size among those whose images are all done by the time this one is first used
+		auto sizeDistance = [&](const MemoryBlock& block) { return block.size > requirements.size ? block.size - requirements.size : requirements.size - block.size; };
+		uint32_t best = NO_BLOCK;
+		for (uint32_t block = 0; block < memory_blocks.size(); block++) {
+			if (memory_blocks[block].last_use >= image.first_use || memory_blocks[block].lazy != lazy || (memory_blocks[block].memory_type_bits & requirements.memoryTypeBits) == 0) continue;
+			if (best == NO_BLOCK || sizeDistance(memory_blocks[block]) < sizeDistance(memory_blocks[best])) best = block;
+		}
+		if (best == NO_BLOCK) {
+			best = static_cast<uint32_t>(memory_blocks.size());
+			memory_blocks.push_back({});
+			memory_blocks[best].memory_type_bits = requirements.memoryTypeBits;
+			memory_blocks[best].lazy = lazy;
+		}
+
+		// Images are bound at offset 0, which satisfies any alignment
+		MemoryBlock& block = memory_blocks[best];
+		block.size = std::max(block.size, requirements.size);
+		block.memory_type_bits &= requirements.memoryTypeBits;
+		block.last_use = image.last_use;
+		image.memory_block = best;
+	}
+
+	// Every use of a block, which the first use of any of its images waits on (the memory may hold another image then)
+	for (uint32_t index : order) {
+		for (const ImageAccess& access : passes[index].images) {
+			if (images[access.image].memory_block == NO_BLOCK) continue;
+			UsageInfo use = imageUsageInfo(access.usage, access.write);
+			memory_blocks[images[access.image].memory_block].stages |= use.stages;
+			memory_blocks[images[access.image].memory_block].write_access |= use.access & WRITE_ACCESS_MASK;
+		}
+	}
+
+	for (MemoryBlock& block : memory_blocks) {
+		uint32_t memory_type = device.findMemoryType(block.memory_type_bits, block.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		block.memory = device.allocateMemory(block.size, memory_type, MemoryCategory::Attachment);
+		if (block.lazy) lazy_memory_size += block.size;
+		else transient_memory_size += block.size;
+	}
+
+	for (uint32_t index : transients) {
+		Image& image = images[index];
+		if (vkBindImageMemory(device.getDevice(), image.image, memory_blocks[image.memory_block].memory, 0) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to bind memory of transient image " + image.name);
+		}
+
+		VkImageViewCreateInfo view_info{};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = image.image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = image.info.format;
+		view_info.subresourceRange.aspectMask = aspectsOf(image.info.format);
+		if (image.usage & VK_IMAGE_USAGE_SAMPLED_BIT) view_info.subresourceRange.aspectMask &= ~VK_IMAGE_ASPECT_STENCIL_BIT; // Sampled views may only have one aspect
+		view_info.subresourceRange.baseMipLevel = 0;
+		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(device.getDevice(), &view_info, nullptr, &image.view) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create view of transient image " + image.name);
+		}
+	}
+}
+
+void
+RenderGraph::planBarriers() {
+	std::vector<ResourceState> image_states(images.size());
+	for (uint32_t index = 0; index < images.size(); index++) {
+		if (images[index].imported) {
+			image_states[index].layout = images[index].initial_layout;
+		} else if (images[index].memory_block != NO_BLOCK) {
+			// Whatever last used the memory (earlier this frame or in the previous one) is treated as a write to wait on
+			image_states[index].write_stages = memory_blocks[images[index].memory_block].stages;
+			image_states[index].write_access = memory_blocks[images[index].memory_block].write_access;
+		}
+	}
+	std::vector<ResourceState> buffer_states(buffers.size());
+
+	for (uint32_t index : order) {
+		Pass& pass = passes[index];
+		pass.barriers = {};
+		for (const ImageAccess& access : pass.images) {
+			planAccess(image_states[access.image], imageUsageInfo(access.usage, access.write), access.write, access.image, pass.barriers);
+		}
+		for (const BufferAccess& access : pass.buffers) {
+			planAccess(buffer_states[access.buffer], bufferUsageInfo(access.usage, access.write), access.write, std::nullopt, pass.barriers);
+		}
+	}
+
+	// Hand imported images over in the layout their owner expects
+	final_barriers = {};
+	for (uint32_t index = 0; index < images.size(); index++) {
+		const Image& image = images[index];
+		if (!image.imported || image.first_use == NO_PASS || image.final_layout == VK_IMAGE_LAYOUT_UNDEFINED) continue;
+		UsageInfo release{};
+		release.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		release.layout = image.final_layout;
+		planAccess(image_states[index], release, false, index, final_barriers);
+	}
+}
+
+void
+RenderGraph::planAccess(ResourceState& state, const UsageInfo& use, bool write, std::optional<uint32_t> image, Barriers& barriers) {
+	bool transition = image.has_value() && state.layout != use.layout;
+	if (write || transition) {
+		// Writes and layout transitions wait on every earlier access, and make the last write visible if they need it
+		VkPipelineStageFlags src_stages = state.write_stages | state.read_stages;
+		if (src_stages != 0 || transition) {
+			barriers.src_stages |= src_stages != 0 ? src_stages : use.stages; // Nothing in the graph to wait on, chain with whatever made the image available (e.g. a semaphore wait at the same stage)
+			barriers.dst_stages |= use.stages;
+			if (transition) {
+				barriers.transitions.push_back({ *image, state.layout, use.layout, state.write_access, use.access });
+			} else {
+				barriers.src_access |= state.write_access;
+				barriers.dst_access |= use.access;
+			}
+		}
+
+		// A layout transition counts as a write that only its own stages have waited on
+		state.write_stages = use.stages;
+		state.write_access = write ? use.access & WRITE_ACCESS_MASK : 0;
+		state.read_stages = write ? 0 : use.stages;
+		state.synced_stages = use.stages;
+		state.visible_access = use.access;
+		state.layout = use.layout;
+		return;
+	}
+
+	// Reads wait on the last write once per stage and access, reads after reads need nothing
+	if (state.write_stages != 0 && ((use.stages & ~state.synced_stages) != 0 || (use.access & ~state.visible_access) != 0)) {
+		barriers.src_stages |= state.write_stages;
+		barriers.dst_stages |= use.stages;
+		barriers.src_access |= state.write_access;
+		barriers.dst_access |= use.access;
+		state.synced_stages |= use.stages;
+		state.visible_access |= use.access;
+	}
+	state.read_stages |= use.stages;
+}
+
+void
+RenderGraph::createRenderPasses() {
+	// Whether an image's contents are used after a position of the order, deciding its store op there
+	auto neededAfter = [&](uint32_t image, uint32_t position) {
+		if (images[image].imported) return true;
+		for (uint32_t later = position + 1; later < order.size(); later++) {
+			for (const ImageAccess& access : passes[order[later]].images) {
+				if (access.image == image) return !access.clear.has_value();
+			}
+		}
+		return false;
+	};
+
+	std::vector<bool> has_contents(images.size(), false);
+	for (uint32_t index = 0; index < images.size(); index++) {
+		has_contents[index] = images[index].imported && images[index].initial_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	for (uint32_t position = 0; position < order.size(); position++) {
+		Pass& pass = passes[order[position]];
+		std::vector<VkAttachmentDescription> descriptions;
+		std::vector<VkAttachmentReference> colour_references;
+		std::vector<uint32_t> colour_images; // Image of each colour reference, matching resolves to their sources
+		std::vector<std::pair<uint32_t, VkAttachmentReference>> resolves; // Source image and reference of each resolve attachment
+		std::optional<VkAttachmentReference> depth_reference;
+		for (const ImageAccess& access : pass.images) {
+			if (!isAttachment(access.usage)) continue;
+			const Image& image = images[access.image];
+			UsageInfo use = imageUsageInfo(access.usage, access.write);
+
+			// Layouts stay unchanged within the pass, transitions are recorded by the graph before it begins
+			VkAttachmentDescription description{};
+			description.format = image.info.format;
+			description.samples = image.info.samples;
+			if (access.clear) description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			else if (access.usage == ImageUsage::ResolveAttachment) description.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // Fully overwritten by the resolve
+			else description.loadOp = has_contents[access.image] ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			description.storeOp = neededAfter(access.image, position) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE; // Transient depth never leaves tile memory on tiled GPUs
+			description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.initialLayout = use.layout;
+			description.finalLayout = use.layout;
+
+			VkAttachmentReference reference{ static_cast<uint32_t>(descriptions.size()), use.layout };
+			if (access.usage == ImageUsage::ColorAttachment) {
+				colour_references.push_back(reference);
+				colour_images.push_back(access.image);
+			} else if (access.usage == ImageUsage::ResolveAttachment) {
+				resolves.push_back({ access.resolve_source, reference });
+			} else {
+				if (depth_reference) throw std::runtime_error("Pass " + pass.name + " has more than one depth attachment");
+				depth_reference = reference;
+			}
+			descriptions.push_back(description);
+			pass.attachments.push_back(access.image);
+			pass.clear_values.push_back(access.clear.value_or(VkClearValue{}));
+			pass.extent = image.info.extent;
+		}
+		for (const ImageAccess& access : pass.images) {
+			if (access.write) has_contents[access.image] = true;
+		}
+		if (descriptions.empty()) continue;
+
+		// Resolve references parallel the colour references, unused for colour attachments that are not resolved
+		std::vector<VkAttachmentReference> resolve_references;
+		if (!resolves.empty()) resolve_references.resize(colour_references.size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+		for (const auto& [source, reference] : resolves) {
+			size_t colour = std::find(colour_images.begin(), colour_images.end(), source) - colour_images.begin();
+			resolve_references[colour] = reference;
+		}
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colour_references.size());
+		subpass.pColorAttachments = colour_references.data();
+		subpass.pResolveAttachments = resolve_references.empty() ? nullptr : resolve_references.data();
+		subpass.pDepthStencilAttachment = depth_reference ? &*depth_reference : nullptr;
+
+		// No subpass dependencies, the barriers recorded before the pass already order it against everything else
+		VkRenderPassCreateInfo render_pass_info{};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		render_pass_info.attachmentCount = static_cast<uint32_t>(descriptions.size());
+		render_pass_info.pAttachments = descriptions.data();
+		render_pass_info.subpassCount = 1;
+		render_pass_info.pSubpasses = &subpass;
+		if (vkCreateRenderPass(device.getDevice(), &render_pass_info, nullptr, &pass.render_pass) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render pass for " + pass.name);
+		}
+	}
+}
+
+void
+RenderGraph::recordBarriers(VkCommandBuffer command_buffer, const Barriers& barriers) {
+	if (barriers.src_stages == 0) return;
+
+	std::vector<VkImageMemoryBarrier> image_barriers;
+	image_barriers.reserve(barriers.transitions.size());
+	for (const ImageTransition& transition : barriers.transitions) {
+		const Image& image = images[transition.image];
+		if (image.image == VK_NULL_HANDLE) throw std::runtime_error("Imported image " + image.name + " has no handle");
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = transition.src_access;
+		barrier.dstAccessMask = transition.dst_access;
+		barrier.oldLayout = transition.old_layout;
+		barrier.newLayout = transition.new_layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image.image;
+		barrier.subresourceRange = { aspectsOf(image.info.format), 0, 1, 0, 1 };
+		image_barriers.push_back(barrier);
+	}
+
+	// A single global memory barrier covers every buffer, and every image keeping its layout
+	VkMemoryBarrier memory_barrier{};
+	memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memory_barrier.srcAccessMask = barriers.src_access;
+	memory_barrier.dstAccessMask = barriers.dst_access;
+	bool has_memory_barrier = barriers.src_access != 0; // Without writes to make visible, the execution dependency suffices
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		barriers.src_stages,
+		barriers.dst_stages,
+		0,
+		has_memory_barrier ? 1 : 0, has_memory_barrier ? &memory_barrier : nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
+
+VkFramebuffer
+RenderGraph::getFramebuffer(Pass& pass) {
+	std::vector<VkImageView> views;
+	for (uint32_t image : pass.attachments) {
+		if (images[image].view == VK_NULL_HANDLE) throw std::runtime_error("Attachment " + images[image].name + " of pass " + pass.name + " has no view");
+		views.push_back(images[image].view);
+	}
+
+	// One framebuffer per combination of imported views seen, e.g. one per swapchain image
+	auto found = pass.framebuffers.find(views);
+	if (found != pass.framebuffers.end()) return found->second;
+
+	VkFramebufferCreateInfo framebuffer_info{};
+	framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebuffer_info.renderPass = pass.render_pass;
+	framebuffer_info.attachmentCount = static_cast<uint32_t>(views.size());
+	framebuffer_info.pAttachments = views.data();
+	framebuffer_info.width = pass.extent.width;
+	framebuffer_info.height = pass.extent.height;
+	framebuffer_info.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(device.getDevice(), &framebuffer_info, nullptr, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create framebuffer for " + pass.name);
+	}
+	pass.framebuffers.emplace(views, framebuffer);
+	return framebuffer;
+}
@@ -0,0 +1,323 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Ways a render graph pass can use an image, each implying the pipeline stages, accesses and layout of the use
+/// </summary>
+enum class ImageUsage {
+	ColorAttachment,
+	ResolveAttachment, // Receives the resolve of a multisampled colour attachment at the end of the pass, see resolveImage
+	DepthAttachment,
+	DepthRead, // Depth attachment tested against without being written
+	Sampled, // Read through a sampler from fragment or compute shaders
+	Storage, // Storage image accessed from compute shaders
+	TransferSrc,
+	TransferDst
+};
+
+/// <summary>
+/// Ways a render graph pass can use a buffer
+/// </summary>
+enum class BufferUsage {
+	Indirect,
+	Vertex,
+	Index,
+	Uniform,
+	Storage, // Storage buffer accessed from vertex, fragment or compute shaders
+	TransferSrc,
+	TransferDst
+};
+
+/// <summary>
+/// Description of an image managed or imported by a render graph
+/// </summary>
+struct RenderGraphImageInfo {
+	VkFormat format;
+	VkExtent2D extent;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+/// <summary>
+/// Frame described as passes declaring which images and buffers they read and write. Compiling the graph culls passes
+/// whose results are never used, orders the rest, plans the pipeline barriers and layout transitions between them,
+/// creates a render pass for each pass with attachments, and places transient images whose lifetimes do not overlap in
+/// the same memory. Executing it records every pass with its barriers into a command buffer.
+/// Declaration order defines which write a read sees; passes only move relative to passes they share no resource with
+/// </summary>
+class RenderGraph {
+public:
+	static constexpr uint32_t NO_PASS = UINT32_MAX;
+	static constexpr uint32_t NO_IMAGE = UINT32_MAX;
+
+	RenderGraph(LogicalDevice& device);
+	~RenderGraph();
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	/// <summary>
+	/// Declare an image created and owned by the graph. Its contents only live between the passes using it in a frame,
+	/// so its memory may be shared with other transient images
+	/// </summary>
+	/// <returns>Handle of the image</returns>
+	uint32_t createImage(const std::string& name, const RenderGraphImageInfo& info);
+	/// <summary>
+	/// Declare an image owned outside the graph, whose handle is supplied every frame through setImportedImage.
+	/// Passes writing imported images are never culled
+	/// </summary>
+	/// <param name="initial_layout">Layout of the image when the graph starts executing (undefined discards its contents)</param>
+	/// <param name="final_layout">Layout the image is transitioned to after its last use (undefined leaves it as is)</param>
+	/// <returns>Handle of the image</returns>
+	uint32_t importImage(const std::string& name, const RenderGraphImageInfo& info, VkImageLayout initial_layout, VkImageLayout final_layout);
+	/// <summary>
+	/// Declare a buffer owned outside the graph. Buffers are synchronised with global memory barriers, so the graph
+	/// never needs their handles. Passes writing buffers are never culled
+	/// </summary>
+	/// <returns>Handle of the buffer</returns>
+	uint32_t importBuffer(const std::string& name);
+
+	/// <summary>
+	/// Add a pass. Passes with colour or depth attachments are recorded inside a render pass created by the graph
+	/// </summary>
+	/// <param name="record">Records the pass' commands, called on every execution unless the pass was culled</param>
+	/// <returns>Handle of the pass</returns>
+	uint32_t addPass(const std::string& name, std::function<void(VkCommandBuffer)> record);
+	/// <summary>
+	/// Declare that a pass reads an image written by an earlier pass (or imported with contents)
+	/// </summary>
+	void readImage(uint32_t pass, uint32_t image, ImageUsage usage);
+	/// <summary>
+	/// Declare that a pass writes an image, keeping its previous contents where not overwritten
+	/// </summary>
+	void writeImage(uint32_t pass, uint32_t image, ImageUsage usage);
+	/// <summary>
+	/// Declare that a pass clears an attachment before writing it, so its previous contents are never needed
+	/// </summary>
+	void clearImage(uint32_t pass, uint32_t image, ImageUsage usage, VkClearValue clear_value);
+	/// <summary>
+	/// Declare that a pass resolves one of its multisampled colour attachments into a single-sampled image as the render
+	/// pass ends, overwriting the image. The samples never leave the pass, so if nothing else uses the source it can live
+	/// in lazily allocated memory and never be written out on tile-based GPUs
+	/// </summary>
+	/// <param name="source">Multisampled image already declared as a colour attachment of the pass</param>
+	/// <param name="destination">Single-sampled image receiving the resolved colours</param>
+	void resolveImage(uint32_t pass, uint32_t source, uint32_t destination);
+	void readBuffer(uint32_t pass, uint32_t buffer, BufferUsage usage);
+	void writeBuffer(uint32_t pass, uint32_t buffer, BufferUsage usage);
+	/// <summary>
+	/// Keep a pass even if nothing uses what it writes (e.g. it only writes host-visible memory)
+	/// </summary>
+	void setSideEffects(uint32_t pass) { passes[pass].side_effects = true; }
+
+	/// <summary>
+	/// Cull, order and plan the passes, then create the transient images and render passes. No passes or resources can be
+	/// added afterwards
+	/// </summary>
+	void compile();
+	/// <summary>
+	/// Supply the handle of an imported image for the next executions
+	/// </summary>
+	/// <param name="view">View used when the image is an attachment (may be null otherwise)</param>
+	void setImportedImage(uint32_t image, VkImage handle, VkImageView view);
+	/// <summary>
+	/// Restrict the area a pass with attachments renders to for the next executions, e.g. for dynamic resolution. Clears
+	/// only cover the area and contents outside it are undefined afterwards
+	/// </summary>
+	/// <param name="extent">Size of the area from the origin, within the pass' attachments</param>
+	void setRenderArea(uint32_t pass, VkExtent2D extent) { passes[pass].render_area = extent; }
+	/// <summary>
+	/// Record every pass that was not culled, in compiled order, with the barriers planned between them
+	/// </summary>
+	void execute(VkCommandBuffer command_buffer);
+
+	/// <summary>
+	/// Render pass a pass is recorded in, for creating compatible pipelines (null for passes without attachments)
+	/// </summary>
+	VkRenderPass getRenderPass(uint32_t pass) { return passes[pass].render_pass; }
+	/// <summary>
+	/// Handle of an image, for passes recording transfers. Valid after compiling for transient images (unless unused) and
+	/// after setImportedImage for imported ones
+	/// </summary>
+	VkImage getImage(uint32_t image) { return images[image].image; }
+	bool isCulled(uint32_t pass) { return passes[pass].culled; }
+	/// <summary>
+	/// Passes in the order they are executed, culled passes excluded
+	/// </summary>
+	const std::vector<uint32_t>& getOrder() { return order; }
+	/// <summary>
+	/// Bytes of device memory allocated for transient images, lazily allocated memory excluded
+	/// </summary>
+	VkDeviceSize getTransientMemorySize() { return transient_memory_size; }
+	/// <summary>
+	/// Bytes of lazily allocated memory reserved for attachments living within a single pass, which tile-based GPUs may never commit
+	/// </summary>
+	VkDeviceSize getLazyMemorySize() { return lazy_memory_size; }
+	/// <summary>
+	/// Bytes transient images would need if each had its own memory, lazily allocated or not
+	/// </summary>
+	VkDeviceSize getUnaliasedMemorySize() { return unaliased_memory_size; }
+
+private:
+	static constexpr uint32_t NO_BLOCK = UINT32_MAX;
+
+	/// <summary>
+	/// Pipeline stages, accesses and layout of one use of a resource
+	/// </summary>
+	struct UsageInfo {
+		VkPipelineStageFlags stages = 0;
+		VkAccessFlags access = 0;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageUsageFlags image_usage = 0;
+	};
+
+	/// <summary>
+	/// Synchronisation state of a resource while planning barriers
+	/// </summary>
+	struct ResourceState {
+		VkPipelineStageFlags write_stages = 0; // Stages of the last write (or layout transition)
+		VkAccessFlags write_access = 0;
+		VkPipelineStageFlags read_stages = 0; // Stages reading since the last write, which the next write must wait on
+		VkPipelineStageFlags synced_stages = 0; // Stages that have waited on the last write
+		VkAccessFlags visible_access = 0; // Accesses the last write has been made visible to
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	struct ImageTransition {
+		uint32_t image;
+		VkImageLayout old_layout;
+		VkImageLayout new_layout;
+		VkAccessFlags src_access;
+		VkAccessFlags dst_access;
+	};
+
+	/// <summary>
+	/// Barriers recorded as a single vkCmdPipelineBarrier. Image handles are resolved at execution, since imported
+	/// images change between frames
+	/// </summary>
+	struct Barriers {
+		VkPipelineStageFlags src_stages = 0;
+		VkPipelineStageFlags dst_stages = 0;
+		VkAccessFlags src_access = 0; // Global memory barrier, covering buffers and images keeping their layout
+		VkAccessFlags dst_access = 0;
+		std::vector<ImageTransition> transitions;
+	};
+
+	struct ImageAccess {
+		uint32_t image;
+		ImageUsage usage;
+		bool write;
+		std::optional<VkClearValue> clear;
+		uint32_t resolve_source = NO_IMAGE; // Colour attachment resolved into the image (resolve attachments only)
+	};
+
+	struct BufferAccess {
+		uint32_t buffer;
+		BufferUsage usage;
+		bool write;
+	};
+
+	struct Pass {
+		std::string name;
+		std::function<void(VkCommandBuffer)> record;
+		std::vector<ImageAccess> images;
+		std::vector<BufferAccess> buffers;
+		bool side_effects = false;
+
+		// Filled in by compile()
+		bool culled = false;
+		std::vector<uint32_t> dependencies; // Passes that must run earlier
+		std::vector<uint32_t> data_dependencies; // Subset of dependencies whose results this pass uses
+		Barriers barriers; // Recorded before the pass
+		VkRenderPass render_pass = VK_NULL_HANDLE;
+		std::vector<uint32_t> attachments; // Images in attachment order
+		std::vector<VkClearValue> clear_values;
+		VkExtent2D extent{};
+		std::optional<VkExtent2D> render_area; // Whole extent if unset
+		std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers; // Imported views change between frames
+	};
+
+	struct Image {
+		std::string name;
+		RenderGraphImageInfo info;
+		bool imported = false;
+		VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkImageUsageFlags usage = 0;
+		uint32_t first_use = NO_PASS; // Positions in the compiled order
+		uint32_t last_use = NO_PASS;
+		uint32_t memory_block = NO_BLOCK;
+	};
+
+	/// <summary>
+	/// Allocation shared by transient images whose lifetimes do not overlap
+	/// </summary>
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memory_type_bits = 0;
+		uint32_t last_use = 0;
+		bool lazy = false; // Lazily allocated, only holding attachments that never leave their pass
+		VkPipelineStageFlags stages = 0; // Every stage its images are used in
+		VkAccessFlags write_access = 0; // Every write its images receive
+	};
+
+	LogicalDevice& device;
+	std::vector<Pass> passes;
+	std::vector<Image> images;
+	std::vector<std::string> buffers;
+	std::vector<uint32_t> order;
+	std::vector<MemoryBlock> memory_blocks;
+	Barriers final_barriers; // Transitions of imported images to their final layouts
+	VkDeviceSize transient_memory_size = 0;
+	VkDeviceSize lazy_memory_size = 0;
+	VkDeviceSize unaliased_memory_size = 0;
+	bool compiled = false;
+
+	static UsageInfo imageUsageInfo(ImageUsage usage, bool write);
+	static UsageInfo bufferUsageInfo(BufferUsage usage, bool write);
+	static bool isAttachment(ImageUsage usage) { return usage == ImageUsage::ColorAttachment || usage == ImageUsage::ResolveAttachment || usage == ImageUsage::DepthAttachment || usage == ImageUsage::DepthRead; }
+	static VkImageAspectFlags aspectsOf(VkFormat format);
+
+	void addImageAccess(uint32_t pass, uint32_t image, ImageUsage usage, bool write, std::optional<VkClearValue> clear);
+	void checkMutable();
+	/// <summary>
+	/// Derive the dependencies of every pass from the order their accesses were declared in
+	/// </summary>
+	void buildDependencies();
+	/// <summary>
+	/// Cull passes that neither have side effects nor contribute to an imported resource
+	/// </summary>
+	void cullPasses();
+	/// <summary>
+	/// Topologically sort the kept passes, preferring the ready pass whose inputs were produced longest ago so that
+	/// barriers have unrelated work to overlap with
+	/// </summary>
+	void orderPasses();
+	/// <summary>
+	/// Create the transient images used by kept passes and assign them to memory blocks by lifetime. Attachments used by a
+	/// single pass are made transient attachments in lazily allocated memory where the device has it
+	/// </summary>
+	void createTransientImages();
+	/// <summary>
+	/// Simulate the frame's resource states to find the barriers each pass needs
+	/// </summary>
+	void planBarriers();
+	/// <summary>
+	/// Add the barrier needed before a use of a resource to a set of barriers, and update the resource's state
+	/// </summary>
+	/// <param name="image">Image the state belongs to, or nothing for buffers</param>
+	void planAccess(ResourceState& state, const UsageInfo& use, bool write, std::optional<uint32_t> image, Barriers& barriers);
+	void createRenderPasses();
+	void recordBarriers(VkCommandBuffer command_buffer, const Barriers& barriers);
+	VkFramebuffer getFramebuffer(Pass& pass);
+};
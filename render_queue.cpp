@@ -0,0 +1,35 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+
+uint64_t
+RenderQueue::makeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+	constexpr uint32_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+	uint64_t quantised_depth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * DEPTH_MAX);
+	return (static_cast<uint64_t>(pipeline & ((1u << PIPELINE_BITS) - 1)) << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS))
+		| (static_cast<uint64_t>(material & ((1u << MATERIAL_BITS) - 1)) << (MESH_BITS + DEPTH_BITS))
+		| (static_cast<uint64_t>(mesh & ((1u << MESH_BITS) - 1)) << DEPTH_BITS)
+		| quantised_depth;
+}
+
+void
+RenderQueue::sort() {
+	if (entries.size() < 2) return;
+	scratch.resize(entries.size());
+
+	// One counting sort pass per byte, least significant first, each stable so earlier passes order ties of later ones
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		size_t offsets[256] = {};
+		for (const Entry& entry : entries) offsets[(entry.key >> shift) & 0xFF]++;
+		if (offsets[(entries[0].key >> shift) & 0xFF] == entries.size()) continue; // Every key has the same byte here
+
+		size_t offset = 0;
+		for (size_t& bucket : offsets) {
+			size_t count = bucket;
+			bucket = offset;
+			offset += count;
+		}
+		for (const Entry& entry : entries) scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+		entries.swap(scratch);
+	}
+}
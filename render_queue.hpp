@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// State changes requested while recording a frame's draws: those issued to the command buffer, and those skipped
+/// because the state was already bound
+/// </summary>
+struct BindCounts {
+	uint32_t issued = 0;
+	uint32_t skipped = 0;
+};
+
+/// <summary>
+/// Draws of a frame ordered by a 64-bit key packing (most significant first) pipeline, material, mesh and depth, so that
+/// recording them in order changes each kind of state as rarely as possible: every pipeline once, every material once per
+/// pipeline, and so on, with draws sharing all state ordered front to back. Sorting is a stable LSD radix sort, linear in
+/// the number of draws, that skips the bytes every key shares
+/// </summary>
+class RenderQueue {
+public:
+	static constexpr uint32_t PIPELINE_BITS = 4;
+	static constexpr uint32_t MATERIAL_BITS = 20;
+	static constexpr uint32_t MESH_BITS = 16;
+	static constexpr uint32_t DEPTH_BITS = 24;
+
+	struct Entry {
+		uint64_t key;
+		uint32_t item; // Caller's identifier of the draw
+	};
+
+	/// <summary>
+	/// Pack draw state into a sort key. Identifiers are truncated to their field's width, which at worst splits batches
+	/// </summary>
+	/// <param name="pipeline">Index of the pipeline drawing</param>
+	/// <param name="material">Identifier of the textures and other resources the draw binds</param>
+	/// <param name="mesh">Identifier of the vertex and index buffers the draw binds</param>
+	/// <param name="depth">Normalised depth of the draw, from 0 (near) to 1 (far), clamped</param>
+	static uint64_t makeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+	static uint32_t getPipeline(uint64_t key) { return static_cast<uint32_t>(key >> (64 - PIPELINE_BITS)); }
+
+	void clear() { entries.clear(); }
+	void push(uint64_t key, uint32_t item) { entries.push_back({ key, item }); }
+	/// <summary>
+	/// Order the entries by key, draws with equal keys keeping the order they were pushed in
+	/// </summary>
+	void sort();
+	const std::vector<Entry>& getEntries() const { return entries; }
+
+private:
+	std::vector<Entry> entries;
+	std::vector<Entry> scratch; // Kept between frames, like entries, so sorting does not allocate
+};
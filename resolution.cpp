@@ -0,0 +1,30 @@
+#include "resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+ResolutionController::ResolutionController(double budget_ms, float min_scale, float max_scale)
+	: budget_ms{ budget_ms }, min_scale{ min_scale }, max_scale{ max_scale }, scale{ max_scale } {
+	if (budget_ms <= 0.0 || min_scale <= 0.0f || min_scale > max_scale) throw std::runtime_error("Invalid dynamic resolution parameters");
+}
+
+float
+ResolutionController::update(double gpu_ms) {
+	average_ms = frame_count == 0 ? gpu_ms : average_ms + SMOOTHING * (gpu_ms - average_ms);
+	frame_count++;
+	if (frame_count - last_change_frame < COOLDOWN_FRAMES || average_ms <= 0.0) return scale;
+
+	// Pixel count scales with the square of the scale
+	float target = scale * static_cast<float>(std::sqrt(budget_ms * HEADROOM / average_ms));
+	target = std::clamp(target, std::max(scale - MAX_STEP, min_scale), std::min(scale + MAX_STEP, max_scale));
+	if (std::abs(target - scale) < DEADBAND * scale) return scale;
+
+	changes.push_back({ frame_count, average_ms, target });
+
+	// Predict the time at the new scale so the average does not keep pushing in the same direction during the cooldown
+	average_ms *= (target * target) / (scale * scale);
+	scale = target;
+	last_change_frame = frame_count;
+	return scale;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Change of render scale made by a ResolutionController
+/// </summary>
+struct ResolutionChange {
+	uint32_t frame; // Number of GPU times fed to the controller when the change was made
+	double average_gpu_ms; // Smoothed GPU time that prompted the change
+	float scale;
+};
+
+/// <summary>
+/// Picks the fraction of the output resolution (per axis) to render at so that GPU frame time stays within a budget.
+/// GPU cost is assumed proportional to pixel count, so the scale moves by the square root of the ratio between the
+/// budget and the smoothed frame time, in bounded steps. Changes smaller than a deadband are ignored and every change is
+/// followed by a cooldown, as frame times reported to the controller lag behind the frames in flight
+/// </summary>
+class ResolutionController {
+public:
+	/// <summary>
+	/// Fraction of the budget aimed at, leaving room for frame to frame variation
+	/// </summary>
+	static constexpr double HEADROOM = 0.9;
+	/// <summary>
+	/// Weight of the newest frame time in the moving average
+	/// </summary>
+	static constexpr double SMOOTHING = 0.2;
+	/// <summary>
+	/// Smallest relative change of scale worth making, below which the scale is kept to avoid oscillating
+	/// </summary>
+	static constexpr float DEADBAND = 0.05f;
+	/// <summary>
+	/// Largest change of scale made at once
+	/// </summary>
+	static constexpr float MAX_STEP = 0.15f;
+	/// <summary>
+	/// Frame times ignored after a change, until frames rendered at the new scale are being reported
+	/// </summary>
+	static constexpr uint32_t COOLDOWN_FRAMES = 8;
+
+	/// <param name="budget_ms">GPU time each frame should take</param>
+	/// <param name="min_scale">Lowest fraction of the output resolution to render at</param>
+	/// <param name="max_scale">Highest fraction of the output resolution to render at</param>
+	ResolutionController(double budget_ms, float min_scale, float max_scale = 1.0f);
+
+	/// <summary>
+	/// Account for the GPU time of a finished frame
+	/// </summary>
+	/// <returns>Scale to render the next frame at</returns>
+	float update(double gpu_ms);
+	float getScale() const { return scale; }
+	double getBudget() const { return budget_ms; }
+	/// <summary>
+	/// Every change of scale made so far, in order
+	/// </summary>
+	const std::vector<ResolutionChange>& getChanges() const { return changes; }
+
+private:
+	double budget_ms;
+	float min_scale;
+	float max_scale;
+	float scale;
+	double average_ms = 0.0;
+	uint32_t frame_count = 0;
+	uint32_t last_change_frame = 0;
+	std::vector<ResolutionChange> changes;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "culling.hpp"
+#include "model.hpp"
+#include "texture.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/// <summary>
+/// A single drawable entry of the scene, referencing an index range of one of the loaded models
+/// </summary>
+struct SceneObject {
+	/// <summary>
+	/// Index of the model (in the application's model list) whose buffers are drawn
+	/// </summary>
+	uint32_t model;
+	/// <summary>
+	/// Indices of the model drawn for this object
+	/// </summary>
+	DrawRange range;
+	/// <summary>
+	/// Index of the first InstanceData entry used by this object in the application's instance buffer
+	/// </summary>
+	uint32_t first_instance = 0;
+	/// <summary>
+	/// Number of copies drawn with a single instanced draw call
+	/// </summary>
+	uint32_t instance_count = 1;
+	/// <summary>
+	/// Model space bounding sphere of the range (centre in xyz, radius in w), moved by each instance's transform for culling.
+	/// Unbounded objects are never culled
+	/// </summary>
+	glm::vec4 bounds{ 0.0f, 0.0f, 0.0f, CullingUtils::UNBOUNDED_RADIUS };
+	/// <summary>
+	/// Colour multiplied into every fragment of the object, passed per draw through push constants
+	/// </summary>
+	glm::vec4 tint{ 1.0f };
+	/// <summary>
+	/// Texture of the application's TextureStreamer multiplied into the object's colour, streamed at the level its size on screen needs
+	/// </summary>
+	uint32_t texture = TextureStreamer::NO_TEXTURE;
+	/// <summary>
+	/// Draw the model's level of detail matching the object's size on screen instead of range (which should then be the
+	/// model's full range)
+	/// </summary>
+	bool use_lods = false;
+	/// <summary>
+	/// Draw each instance of the model's full range as one indirect command per meshlet, so that the GPU culler drops
+	/// clusters outside the frustum or facing away from the camera (only with GPU culling and a model built with meshlets)
+	/// </summary>
+	bool use_meshlets = false;
+};
+
+/// <summary>
+/// Data shared by every draw of a frame, written to the frame's region of the uniform ring buffer (std140 layout of shader.vert)
+/// </summary>
+struct FrameUniforms {
+	glm::mat4 view_projection{ 1.0f };
+	float time = 0.0f; // Seconds since the application started
+	uint32_t frame_index = 0;
+	uint32_t padding[2] = {};
+};
+
+/// <summary>
+/// Small per-draw parameters pushed straight into the command buffer (push_constant block of shader.vert and textured.frag)
+/// </summary>
+struct DrawPushConstants {
+	glm::vec4 tint{ 1.0f };
+	uint32_t texture = TextureStreamer::NO_TEXTURE; // Bindless image index, not the streamer's texture identifier
+};
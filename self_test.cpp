@@ -0,0 +1,296 @@
+#include "self_test.hpp"
+#include "culling.hpp"
+#include "device_selection.hpp"
+#include "mesh_cache.hpp"
+#include "obj.hpp"
+#include "render_queue.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+namespace {
+	/// <summary>
+	/// Suitable candidate of the given type with a single device local heap, whose UUID bytes count up from uuid_seed
+	/// </summary>
+	DeviceCandidate makeCandidate(const char* name, VkPhysicalDeviceType type, VkDeviceSize device_local_bytes, uint8_t uuid_seed = 0) {
+		DeviceCandidate candidate{};
+		std::strncpy(candidate.properties.deviceName, name, VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+		candidate.properties.deviceType = type;
+		candidate.memory_properties.memoryHeapCount = 1;
+		candidate.memory_properties.memoryHeaps[0] = { device_local_bytes, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++) candidate.uuid[i] = static_cast<uint8_t>(uuid_seed + i);
+		candidate.has_uuid = true;
+		candidate.suitable = true;
+		return candidate;
+	}
+
+	MeshData parseObj(std::string_view text) {
+		return ObjUtils::parse(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+	}
+
+	/// <summary>
+	/// Mesh of the given number of vertices, with one degenerate triangle per vertex
+	/// </summary>
+	ImportedMesh makeImportedMesh(uint32_t vertex_count) {
+		ImportedMesh mesh;
+		for (uint32_t i = 0; i < vertex_count; i++) {
+			mesh.vertices.push_back({ { static_cast<float>(i), 0.0f }, glm::vec3(1.0f), glm::vec2(0.0f) });
+			mesh.mesh.indices.insert(mesh.mesh.indices.end(), { i, i, i });
+		}
+		return mesh;
+	}
+}
+
+SelfTest::SelfTest(std::ostream& report) : report{ report } {}
+
+bool
+SelfTest::run() {
+	checkDeviceSelection();
+	checkObjImport();
+	checkMeshCache();
+	checkRenderQueue();
+	checkCulling();
+	report << (failures == 0 ? "All self-test checks passed" : std::to_string(failures) + " self-test checks failed") << std::endl;
+	return failures == 0;
+}
+
+void
+SelfTest::check(bool condition, const std::string& description) {
+	report << (condition ? "[PASS] " : "[FAIL] ") << description << std::endl;
+	if (!condition) failures++;
+}
+
+void
+SelfTest::checkDeviceSelection() {
+	constexpr VkDeviceSize GIB = 1024ull * 1024 * 1024;
+	std::ostringstream log;
+	auto choose = [&log](const std::vector<DeviceCandidate>& candidates, const std::string& device_override = "") {
+		log.str("");
+		return DeviceSelectionUtils::choose(candidates, device_override, log);
+	};
+
+	// Type outweighs memory, even when the preferred type has the least of it
+	std::vector<DeviceCandidate> mixed = {
+		makeCandidate("llvmpipe", VK_PHYSICAL_DEVICE_TYPE_CPU, 64 * GIB, 0x10),
+		makeCandidate("Intel UHD Graphics", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 32 * GIB, 0x20),
+		makeCandidate("NVIDIA GeForce GTX 1050", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 2 * GIB, 0x30)
+	};
+	check(choose(mixed) == 2u, "Device selection prefers a discrete GPU over integrated and CPU devices with more memory");
+	check(choose({ mixed[0], mixed[1] }) == 1u, "Device selection prefers an integrated GPU over a CPU device with more memory");
+
+	// Within a type, more device local memory wins
+	std::vector<DeviceCandidate> discrete = {
+		makeCandidate("AMD Radeon RX 6500", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4 * GIB, 0x40),
+		makeCandidate("AMD Radeon RX 6800", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 16 * GIB, 0x50)
+	};
+	check(choose(discrete) == 1u, "Device selection prefers more device local memory within a device type");
+
+	// Unsuitable devices are never chosen, however they score
+	std::vector<DeviceCandidate> unsuitable = discrete;
+	unsuitable[1].suitable = false;
+	check(choose(unsuitable) == 0u, "Device selection skips unsuitable devices");
+
+	// Overrides pick a lower scoring device by name substring or UUID
+	check(choose(mixed, "uhd") == 1u, "Device override matches a case insensitive substring of the name");
+	check(choose(mixed, "LLVMPIPE") == 0u, "Device override matches names regardless of case");
+	std::string uuid = DeviceSelectionUtils::formatUuid(mixed[1].uuid);
+	check(choose(mixed, uuid) == 1u, "Device override matches a UUID with dashes");
+	std::string undashed = uuid;
+	undashed.erase(std::remove(undashed.begin(), undashed.end(), '-'), undashed.end());
+	std::transform(undashed.begin(), undashed.end(), undashed.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+	check(choose(mixed, undashed) == 1u, "Device override matches an uppercase UUID without dashes");
+
+	// A mistyped override must not silently render on another device
+	check(!choose(mixed, "radeon") && log.str().find("does not match override") != std::string::npos, "Unmatched device override chooses nothing and logs why");
+	check(!choose(unsuitable, "6800"), "Device override matching only unsuitable devices chooses nothing");
+	check(!choose({}), "Device selection without candidates chooses nothing");
+
+	// Equal scores keep the device enumerated first
+	std::vector<DeviceCandidate> tied = {
+		makeCandidate("NVIDIA RTX A4000", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 16 * GIB, 0x60),
+		makeCandidate("NVIDIA RTX A4000", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 16 * GIB, 0x70)
+	};
+	check(choose(tied) == 0u, "Device selection keeps enumeration order between equal scores");
+	check(choose(tied, "a4000") == 0u, "Device override matching several devices keeps enumeration order between equal scores");
+	check(choose(tied, DeviceSelectionUtils::formatUuid(tied[1].uuid)) == 1u, "Device override by UUID tells identical devices apart");
+}
+
+void
+SelfTest::checkObjImport() {
+	// Two triangles sharing an edge, without texture coordinates
+	MeshData quad = parseObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3\nf 2 3 4\n");
+	check(quad.vertices.size() == 4, "OBJ faces without texture coordinates keep one vertex per position");
+	check(quad.indices == std::vector<uint32_t>{ 0, 1, 2, 1, 2, 3 }, "OBJ faces without texture coordinates index the positions they name");
+	bool positions_match = quad.vertices.size() == 4;
+	const float expected[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+	for (size_t i = 0; positions_match && i < 4; i++) positions_match = quad.vertices[i].pos.x == expected[i][0] && quad.vertices[i].pos.y == expected[i][1];
+	check(positions_match, "OBJ vertices keep the position of their corner");
+
+	// The same position with two texture coordinates is two vertices, the same pair is one
+	MeshData textured = parseObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nvt 0 0\nvt 1 1\nf 1/1 2/1 3/1\nf 1/2 2/1 3/1\n");
+	check(textured.vertices.size() == 4, "OBJ corners are welded only when position and texture coordinates match");
+}
+
+void
+SelfTest::checkMeshCache() {
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "vulkan_tutorial_self_test_mesh_cache";
+	std::filesystem::remove_all(directory);
+	std::filesystem::path source_path = directory / "source.obj";
+	std::filesystem::path entries = directory / "entries";
+	std::filesystem::create_directories(directory);
+	auto writeSource = [&source_path](const std::string& text) {
+		std::ofstream(source_path, std::ios::binary | std::ios::trunc) << text;
+	};
+	auto keyOf = [&source_path](uint32_t importer_version, const ModelImportSettings& settings) {
+		std::ifstream file(source_path, std::ios::binary);
+		std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		return MeshCache::computeKey(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size(), importer_version, settings);
+	};
+
+	// Invalidation: the key covers the source's bytes, the importer's version and the import settings
+	{
+		MeshCache cache(entries.string(), 64ull * 1024 * 1024);
+		ModelImportSettings settings{ 4, true };
+		writeSource("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\n");
+		ImportedMesh stored = makeImportedMesh(3);
+		cache.store(keyOf(ObjUtils::IMPORTER_VERSION, settings), stored);
+		ImportedMesh loaded;
+		check(cache.load(keyOf(ObjUtils::IMPORTER_VERSION, settings), loaded) && loaded.mesh.indices == stored.mesh.indices, "Mesh cache hits an unchanged source");
+
+		// Rewriting the source with identical bytes only changes its modification time, which content keys ignore
+		writeSource("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\n");
+		check(cache.load(keyOf(ObjUtils::IMPORTER_VERSION, settings), loaded), "Mesh cache hits a source rewritten with the same contents");
+		check(!cache.load(keyOf(ObjUtils::IMPORTER_VERSION + 1, settings), loaded), "Mesh cache misses once the importer version changes");
+		check(!cache.load(keyOf(ObjUtils::IMPORTER_VERSION, { 2, true }), loaded), "Mesh cache misses once the import settings change");
+		writeSource("v 0 0 0\nv 2 0 0\nv 1 1 0\nf 1 2 3\n");
+		check(!cache.load(keyOf(ObjUtils::IMPORTER_VERSION, settings), loaded), "Mesh cache misses once the source is modified");
+	}
+
+	// Eviction: room for two entries, the third evicts whichever was used least recently
+	{
+		std::filesystem::remove_all(entries);
+		ImportedMesh mesh = makeImportedMesh(64);
+		MeshCache probe(entries.string(), UINT64_MAX);
+		probe.store(1, mesh);
+		uint64_t entry_size = probe.computeSize();
+		std::filesystem::remove_all(entries);
+
+		MeshCache cache(entries.string(), entry_size * 5 / 2);
+		cache.store(1, mesh);
+		cache.store(2, mesh);
+		// Explicit times, as file systems may not tell apart writes this close together
+		auto now = std::filesystem::file_time_type::clock::now();
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(entries)) {
+			bool first = entry.path().filename().string().rfind("0000000000000001", 0) == 0;
+			std::filesystem::last_write_time(entry.path(), now - std::chrono::hours(first ? 3 : 2));
+		}
+		ImportedMesh loaded;
+		cache.load(1, loaded); // Entry 1 becomes the most recently used
+		cache.store(3, mesh);
+		check(!cache.load(2, loaded) && cache.load(1, loaded) && cache.load(3, loaded), "Mesh cache evicts the least recently used entry beyond its size limit");
+		check(cache.computeSize() <= entry_size * 5 / 2, "Mesh cache stays within its size limit");
+
+		MeshCache small(entries.string(), entry_size / 2);
+		small.store(4, mesh);
+		check(!small.load(4, loaded), "Mesh cache does not store meshes larger than its size limit");
+	}
+	std::filesystem::remove_all(directory);
+}
+
+void
+SelfTest::checkRenderQueue() {
+	std::mt19937_64 rng(48);
+	auto sortsStably = [](const std::vector<uint64_t>& keys) {
+		RenderQueue queue;
+		std::vector<RenderQueue::Entry> expected;
+		for (uint32_t i = 0; i < keys.size(); i++) {
+			queue.push(keys[i], i);
+			expected.push_back({ keys[i], i });
+		}
+		queue.sort();
+		std::stable_sort(expected.begin(), expected.end(), [](const RenderQueue::Entry& a, const RenderQueue::Entry& b) { return a.key < b.key; });
+		const std::vector<RenderQueue::Entry>& entries = queue.getEntries();
+		return std::equal(entries.begin(), entries.end(), expected.begin(), expected.end(),
+			[](const RenderQueue::Entry& a, const RenderQueue::Entry& b) { return a.key == b.key && a.item == b.item; });
+	};
+
+	std::vector<uint64_t> keys(10000);
+	for (uint64_t& key : keys) key = rng();
+	check(sortsStably(keys), "Render queue sorts random keys like a stable sort");
+
+	// Few distinct keys, so most draws tie and must keep the order they were pushed in
+	for (uint64_t& key : keys) key = rng() % 8 << 40 | rng() % 4;
+	check(sortsStably(keys), "Render queue keeps the push order of draws with equal keys");
+
+	// Keys as recorded: bytes every key shares are skipped, and scene order keys only differ in their pass
+	std::uniform_real_distribution<float> depth(-0.5f, 1.5f);
+	for (uint64_t& key : keys) key = RenderQueue::makeKey(static_cast<uint32_t>(rng() % 2), static_cast<uint32_t>(rng() % 16), static_cast<uint32_t>(rng() % 64), depth(rng));
+	check(sortsStably(keys), "Render queue sorts state keys like a stable sort");
+	for (uint64_t& key : keys) key = RenderQueue::makeKey(static_cast<uint32_t>(rng() % 2), 0, 0, 0.0f);
+	check(sortsStably(keys), "Render queue keeps scene order within each pass of unsorted draws");
+	check(sortsStably({}) && sortsStably({ 7 }), "Render queue sorts empty and single draw queues");
+}
+
+void
+SelfTest::checkCulling() {
+	constexpr uint32_t SPHERE_COUNT = 100003; // Not a multiple of the block size, so padding is culled too
+	constexpr float TOLERANCE = 1e-5f;        // Distance to a plane within which paths may disagree, relative to the sphere's magnitude
+	std::mt19937_64 rng(31);
+	std::uniform_real_distribution<float> coordinate(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> radius(0.05f, 2.0f);
+	std::uniform_int_distribution<size_t> plane_index(0, 5);
+
+	// Spheres scattered around a camera looking down -z, every fourth moved to exactly touch one of the planes
+	Frustum frustum = Frustum::fromMatrix(glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f));
+	std::vector<glm::vec4> spheres(SPHERE_COUNT);
+	BoundingSphereArray sphere_array;
+	sphere_array.resize(SPHERE_COUNT);
+	for (uint32_t i = 0; i < SPHERE_COUNT; i++) {
+		glm::vec3 centre{ coordinate(rng), coordinate(rng), coordinate(rng) };
+		float sphere_radius = radius(rng);
+		if (i % 4 == 0) {
+			const glm::vec4& plane = frustum.planes[plane_index(rng)];
+			glm::vec3 normal(plane);
+			centre = centre - normal * (glm::dot(normal, centre) + plane.w + sphere_radius);
+		}
+		spheres[i] = glm::vec4{ centre, sphere_radius };
+		sphere_array.set(i, spheres[i]);
+	}
+
+	std::vector<uint32_t> expected;
+	CullingUtils::cullSpheres(frustum, sphere_array, expected, SimdLevel::Scalar);
+	check(!expected.empty() && expected.size() < SPHERE_COUNT / 2, "Culling scene keeps some spheres and culls most");
+
+	auto agrees = [&](const std::vector<uint32_t>& visible) {
+		if (!std::is_sorted(visible.begin(), visible.end())) return false;
+		std::vector<uint32_t> differing;
+		std::set_symmetric_difference(expected.begin(), expected.end(), visible.begin(), visible.end(), std::back_inserter(differing));
+		return std::all_of(differing.begin(), differing.end(), [&](uint32_t i) {
+			if (i >= SPHERE_COUNT) return false; // Padding is never visible
+			float tolerance = TOLERANCE * std::max(1.0f, glm::length(glm::vec3(spheres[i])) + spheres[i].w);
+			return std::abs(CullingUtils::visibilityMargin(frustum, spheres[i])) <= tolerance;
+		});
+	};
+	std::vector<uint32_t> visible;
+	for (SimdLevel level : { SimdLevel::Sse, SimdLevel::Avx2, SimdLevel::Neon }) {
+		if (!CullingUtils::isSimdLevelSupported(level)) continue;
+		CullingUtils::cullSpheres(frustum, sphere_array, visible, level);
+		check(agrees(visible), std::string(CullingUtils::simdLevelName(level)) + " culling matches the scalar path");
+	}
+	JobSystem jobs(4);
+	CullingUtils::cullSpheres(frustum, sphere_array, visible, jobs);
+	check(agrees(visible), "Multithreaded culling matches the scalar path");
+	CullingUtils::cullSpheresReference(frustum, spheres, visible);
+	check(agrees(visible), "Per-sphere reference culling matches the scalar path");
+}
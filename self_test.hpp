@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/// <summary>
+/// Checks of engine logic that needs no GPU (device selection, importers, caches, culling), so they run on any machine
+/// </summary>
+class SelfTest {
+public:
+	/// <summary>
+	/// Creates a SelfTest object
+	/// </summary>
+	/// <param name="report">Stream a line per check is written to</param>
+	SelfTest(std::ostream& report);
+
+	/// <summary>
+	/// Run every check
+	/// </summary>
+	/// <returns>Whether every check passed</returns>
+	bool run();
+
+private:
+	std::ostream& report;
+	uint32_t failures = 0;
+
+	/// <summary>
+	/// Report a check, counting it as a failure unless its condition holds
+	/// </summary>
+	void check(bool condition, const std::string& description);
+	/// <summary>
+	/// Device selection over made-up candidates: type before memory, memory within a type, overrides by name or UUID,
+	/// unmatched overrides choosing nothing and ties keeping enumeration order
+	/// </summary>
+	void checkDeviceSelection();
+	/// <summary>
+	/// Corners of OBJ faces are welded only when both their position and texture coordinates match
+	/// </summary>
+	void checkObjImport();
+	/// <summary>
+	/// Mesh cache entries miss once the source, importer or settings change, and the least recently used are evicted first
+	/// </summary>
+	void checkMeshCache();
+	/// <summary>
+	/// The render queue's radix sort orders draws exactly as a stable comparison sort of their keys would
+	/// </summary>
+	void checkRenderQueue();
+	/// <summary>
+	/// Every SIMD and multithreaded culling path keeps the same spheres as the scalar path, except ones touching a plane
+	/// within float tolerance, where contracting multiplies and adds into fused ones may round either way
+	/// </summary>
+	void checkCulling();
+};
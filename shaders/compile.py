@@ -5,3 +5,5 @@ if __name__ == "__main__":
     chdir(path.dirname(path.realpath(__file__)))
     subprocess.run("C:/VulkanSDK/1.2.182.0/Bin/glslc.exe shader.vert -o vert.spv".split())
     subprocess.run("C:/VulkanSDK/1.2.182.0/Bin/glslc.exe shader.frag -o frag.spv".split())
+    subprocess.run("C:/VulkanSDK/1.2.182.0/Bin/glslc.exe textured.frag -o textured.spv".split())
+    subprocess.run("C:/VulkanSDK/1.2.182.0/Bin/glslc.exe cull.comp -o cull.spv".split())
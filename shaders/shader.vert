@@ -3,9 +3,33 @@
 layout(location = 0) in vec2 in_position;
 layout(location = 1) in vec3 in_color;
 
+// Per-instance attributes (binding 1)
+layout(location = 2) in mat4 instance_transform; // Occupies locations 2-5
+layout(location = 6) in vec4 instance_color;
+
+layout(location = 7) in vec2 in_uv;
+
+// Per-frame data, bound once per frame from the uniform ring buffer
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 view_projection;
+    float time;
+    uint frame_index;
+} frame;
+
+// Per-draw data
+layout(push_constant) uniform DrawConstants {
+    vec4 tint;
+    uint texture; // Bindless image index, read by textured.frag
+} draw;
+
+// Depth must match bit for bit between the depth pre-pass and the equal-test colour pass
+invariant gl_Position;
+
 layout(location = 0) out vec3 frag_color; 
+layout(location = 1) out vec2 frag_uv;
 
 void main() {
-    gl_Position = vec4(in_position, 0.0, 1.0);
-    frag_color = in_color;
+    gl_Position = frame.view_projection * instance_transform * vec4(in_position, 0.0, 1.0);
+    frag_color = in_color * instance_color.rgb * draw.tint.rgb;
+    frag_uv = in_uv;
 }
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 frag_colour;
+layout(location = 1) in vec2 frag_uv;
+
+// Every texture of the application, indexed by the draw (set 1 is the bindless set)
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+layout(push_constant) uniform DrawConstants {
+    vec4 tint;
+    uint texture;
+} draw;
+
+layout(location = 0) out vec4 out_colour;
+
+const uint NO_TEXTURE = 0xFFFFFFFFu;
+
+void main() {
+    vec3 texture_colour = vec3(1.0);
+    if (draw.texture != NO_TEXTURE) texture_colour = texture(textures[nonuniformEXT(draw.texture)], frag_uv).rgb;
+    out_colour = vec4(frag_colour * texture_colour, 1.0);
+}
@@ -21,10 +21,6 @@ SwapChain::~SwapChain() {
 		vkDestroyFence(device.getDevice(), in_flight_fences[i], nullptr);
 	}
 
-	for (auto framebuffer : swap_chain_framebuffers) { vkDestroyFramebuffer(device.getDevice(), framebuffer, nullptr); }
-
-	vkDestroyRenderPass(device.getDevice(), render_pass, nullptr);
-	
 	for (auto& image_view : swap_chain_image_views) { vkDestroyImageView(device.getDevice(), image_view, nullptr); }
 	swap_chain_image_views.clear();
 
@@ -32,14 +28,20 @@ SwapChain::~SwapChain() {
 		vkDestroySwapchainKHR(device.getDevice(), swap_chain, nullptr);
 		swap_chain = nullptr;
 	}
+
+	// Offscreen images are owned by us rather than by a swapchain
+	for (size_t i = 0; i < offscreen_image_memories.size(); i++) {
+		vkDestroyImage(device.getDevice(), swap_chain_images[i], nullptr);
+		device.freeMemory(offscreen_image_memories[i]);
+	}
 }
 
 void
 SwapChain::init() {
-	createSwapChain();
+	if (device.isHeadless()) createOffscreenImages();
+	else createSwapChain();
 	createImageViews();
-	createRenderPass();
-	createFramebuffers();
+	chooseDepthFormat();
 	createSynchronisationObjects();
 }
 
@@ -47,13 +49,19 @@ VkResult
 SwapChain::acquireNextImage(uint32_t* image_index) {
 	vkWaitForFences(device.getDevice(), 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
 
-	auto result = vkAcquireNextImageKHR(
-		device.getDevice(),
-		swap_chain,
-		UINT64_MAX, // Disables image availability timeout
-		image_available_semaphores[current_frame], // Signal semaphore for current frame once the image has been retrieved and is available
-		VK_NULL_HANDLE, // No fences are used
-		image_index);
+	VkResult result = VK_SUCCESS;
+	if (device.isHeadless()) { // Offscreen images are simply handed out round-robin
+		*image_index = next_offscreen_image;
+		next_offscreen_image = (next_offscreen_image + 1) % static_cast<uint32_t>(swap_chain_images.size());
+	} else {
+		result = vkAcquireNextImageKHR(
+			device.getDevice(),
+			swap_chain,
+			UINT64_MAX, // Disables image availability timeout
+			image_available_semaphores[current_frame], // Signal semaphore for current frame once the image has been retrieved and is available
+			VK_NULL_HANDLE, // No fences are used
+			image_index);
+	}
 
 	// Check if a previous frame is using this image (i.e. there is its fence to wait on)
 	if (images_in_flight[*image_index] != VK_NULL_HANDLE) { vkWaitForFences(device.getDevice(), 1, &images_in_flight[*image_index], VK_TRUE, UINT64_MAX); }
@@ -66,6 +74,20 @@ VkResult
 SwapChain::submitCommandBuffers(const VkCommandBuffer* command_buffer, uint32_t* image_index) {
 	VkSubmitInfo submit_info{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+	// Offscreen images need no acquire/present synchronisation, the in-flight fences alone guard their reuse
+	if (device.isHeadless()) {
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = command_buffer;
+
+		vkResetFences(device.getDevice(), 1, &in_flight_fences[current_frame]);
+		if (vkQueueSubmit(device.getGraphicsQueue(), 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit draw command buffer");
+		}
+
+		current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+		return VK_SUCCESS;
+	}
 	
 	// Wait on color writing step until an image has been retrieved from the swapchain
 	VkSemaphore wait_semaphores[] = { image_available_semaphores[current_frame] };
@@ -127,7 +149,10 @@ SwapChain::createSwapChain() {
 	create_info.imageColorSpace = surface_format.colorSpace;
 	create_info.imageExtent = extent;
 	create_info.imageArrayLayers = 1;
-	create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // Images will be used for direct colour attachment (i.e: presented as is with no further processing)
+	image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // Images will be used for direct colour attachment
+	image_usage |= swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT; // Or blitted to from a lower resolution render target, where supported
+	image_usage |= swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // Or copied out of when capturing frames, where supported
+	create_info.imageUsage = image_usage;
 	create_info.preTransform = swap_chain_support.capabilities.currentTransform; // No transformation desired
 	create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // Ignore alpha channel, no blending needed
 	create_info.presentMode = present_mode;
@@ -164,45 +189,29 @@ SwapChain::createSwapChain() {
 }
 
 void
-SwapChain::createRenderPass() {
-	VkAttachmentDescription colour_attachment{};
-	colour_attachment.format = swap_chain_image_format;
-	colour_attachment.samples = VK_SAMPLE_COUNT_1_BIT; // Should match multi-sampling sample count
-	colour_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // Clear colour and depth data before drawing new frame
-	colour_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Save rendered data in memory (so we can actually display the goddamn thing)
-	colour_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // Not doing anything with stencil buffer data, so we don't care
-	colour_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colour_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // We don't care about previous image data
-	colour_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Newly rendered data should be stored in a format suitable for presentation to the swapchain
-
-	VkAttachmentReference color_attachment_ref{};
-	color_attachment_ref.attachment = 0;
-	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass{};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // Specify that this is a graphics subpass (because compute shaders are a thing, apparently)
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &color_attachment_ref;
-
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL; // The built-in pre-pass dependency should wait
-	dependency.dstSubpass = 0; // And it waits on the subpass with index 0 (the only one in our case)
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // Wait on the colour attachment output specifically, which occurs only after an image has been retrieved (see submitCommandBuffers)
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // The operation that should wait is in the color attachment stage
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; // The exact operation that should wait is the final writing of the colors
-
-	VkRenderPassCreateInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colour_attachment;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(device.getDevice(), &renderPassInfo, nullptr, &render_pass) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create render pass");
+SwapChain::createOffscreenImages() {
+	swap_chain_image_format = VK_FORMAT_B8G8R8A8_SRGB; // Same format preferred by chooseSwapSurfaceFormat so output matches windowed rendering
+	swap_chain_extent = window_extent;
+
+	image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	swap_chain_images.resize(OFFSCREEN_IMAGE_COUNT);
+	offscreen_image_memories.resize(OFFSCREEN_IMAGE_COUNT);
+	for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; i++) {
+		VkImageCreateInfo image_info{};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.format = swap_chain_image_format;
+		image_info.extent = { swap_chain_extent.width, swap_chain_extent.height, 1 };
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.usage = image_usage; // Rendered or blitted to, and copyable so results can be inspected
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // Only the graphics queue ever touches these
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		device.createImageWithInfo(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Attachment, swap_chain_images[i], offscreen_image_memories[i]);
 	}
 }
 
@@ -237,25 +246,12 @@ SwapChain::createImageViews() {
 }
 
 void
-SwapChain::createFramebuffers() {
-	swap_chain_framebuffers.resize(swap_chain_image_views.size());
-
-	for (size_t i = 0; i < swap_chain_image_views.size(); i++) {
-		VkImageView attachments[] = { swap_chain_image_views[i] };
-
-		VkFramebufferCreateInfo framebuffer_create_info{};
-		framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebuffer_create_info.renderPass = render_pass;
-		framebuffer_create_info.attachmentCount = 1;
-		framebuffer_create_info.pAttachments = attachments;
-		framebuffer_create_info.width = swap_chain_extent.width;
-		framebuffer_create_info.height = swap_chain_extent.height;
-		framebuffer_create_info.layers = 1;
-
-		if (vkCreateFramebuffer(device.getDevice(), &framebuffer_create_info, nullptr, &swap_chain_framebuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create framebuffer");
-		}
-	}
+SwapChain::chooseDepthFormat() {
+	// Stencil is unused, so plain 32-bit depth is preferred and combined formats are fallbacks
+	depth_format = device.findSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
 void
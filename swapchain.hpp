@@ -6,22 +6,35 @@
 #include <vector>
 
 
+/// <summary>
+/// Ring of images rendered to by the application. When the device has a window these are presentable swapchain images,
+/// when the device is headless they are plain offscreen images owned by this class (no surface or VK_KHR_swapchain involved)
+/// </summary>
 class SwapChain {
 public:
 	static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+	static constexpr uint32_t OFFSCREEN_IMAGE_COUNT = 3;
 
 	SwapChain(LogicalDevice& device, VkExtent2D window_extent);
 	SwapChain(LogicalDevice& device, VkExtent2D window_extent, std::shared_ptr<SwapChain> previous);
 	~SwapChain();
 
-	VkFramebuffer getFramebuffer(int index) { return swap_chain_framebuffers[index]; }
+	VkImage getImage(int index) { return swap_chain_images[index]; }
 	VkImageView getImageView(int index) { return swap_chain_image_views[index]; }
 	size_t imageCount() { return swap_chain_images.size(); }
 	VkFormat getSwapChainImageFormat() { return swap_chain_image_format; }
+	/// <summary>
+	/// Usage the images were created with (always includes colour attachment)
+	/// </summary>
+	VkImageUsageFlags getImageUsage() { return image_usage; }
+	VkFormat getDepthFormat() { return depth_format; }
 	VkExtent2D getSwapChainExtent() { return swap_chain_extent; }
 	uint32_t getWidth() { return swap_chain_extent.width; }
 	uint32_t getHeight() { return swap_chain_extent.height; }
-	VkRenderPass getRenderPass() { return render_pass; }
+	/// <summary>
+	/// Index (below MAX_FRAMES_IN_FLIGHT) of the frame being recorded, valid between acquireNextImage and submitCommandBuffers
+	/// </summary>
+	size_t getCurrentFrame() { return current_frame; }
 
 	/// <summary>
 	/// Acquire the next available image to be rendered to
@@ -29,17 +42,24 @@ public:
 	/// <param name="image_index">Location to store the index of the image</param>
 	/// <returns></returns>
 	VkResult acquireNextImage(uint32_t* image_index);
+	/// <summary>
+	/// Submit the given command buffer for rendering to the acquired image and present it (presentation is skipped when headless)
+	/// </summary>
+	/// <param name="command_buffer">Command buffer rendering to the image</param>
+	/// <param name="image_index">Index of the image as returned by acquireNextImage</param>
+	/// <returns>Result of presentation, always VK_SUCCESS when headless</returns>
 	VkResult submitCommandBuffers(const VkCommandBuffer* command_buffer, uint32_t* image_index);
 
 private:
 	VkFormat swap_chain_image_format;
+	VkImageUsageFlags image_usage;
 	VkExtent2D swap_chain_extent;
 
 	std::vector<VkImage> swap_chain_images;
+	std::vector<VkDeviceMemory> offscreen_image_memories; // Only populated when headless, swapchain images are owned by the swapchain
 	std::vector<VkImageView> swap_chain_image_views;
-	std::vector<VkFramebuffer> swap_chain_framebuffers;
 
-	VkRenderPass render_pass;
+	VkFormat depth_format; // Depth images themselves are transient images of the render graph
 
 	LogicalDevice& device;
 	VkExtent2D window_extent;
@@ -52,12 +72,19 @@ private:
 	std::vector<VkFence> in_flight_fences;
 	std::vector<VkFence> images_in_flight; // Keeps track of which images are in flight by their fences so they're not accidentally used before work being done on them has concluded
 	size_t current_frame = 0;
+	uint32_t next_offscreen_image = 0;
 
 	void init();
 	void createSwapChain();
+	/// <summary>
+	/// Headless counterpart of createSwapChain, creating a ring of device-local images to render to
+	/// </summary>
+	void createOffscreenImages();
 	void createImageViews();
-	void createRenderPass();
-	void createFramebuffers();
+	/// <summary>
+	/// Choose the first depth format usable as a depth attachment
+	/// </summary>
+	void chooseDepthFormat();
 	void createSynchronisationObjects();
 
 	/// <summary>
@@ -0,0 +1,440 @@
+#include "texture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	constexpr VkDeviceSize STAGING_ALIGNMENT = 16; // Satisfies copy offset alignment of every uncompressed and block compressed format
+
+	VkImageMemoryBarrier
+	imageBarrier(VkImage image, uint32_t level_count, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = src_access;
+		barrier.dstAccessMask = dst_access;
+		barrier.oldLayout = old_layout;
+		barrier.newLayout = new_layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1 };
+		return barrier;
+	}
+}
+
+RgbaTextureSource::RgbaTextureSource(uint32_t width, uint32_t height, std::vector<uint8_t> pixels, bool srgb) : srgb{ srgb } {
+	if (pixels.size() != static_cast<size_t>(width) * height * 4) throw std::runtime_error("RGBA texture data does not match its extent");
+	mips.push_back({ { width, height }, std::move(pixels) });
+
+	// Each level averages 2x2 texels of the previous one (clamping at odd edges)
+	while (width > 1 || height > 1) {
+		const Mip& previous = mips.back();
+		uint32_t mip_width = std::max(width / 2, 1u);
+		uint32_t mip_height = std::max(height / 2, 1u);
+		Mip mip{ { mip_width, mip_height }, std::vector<uint8_t>(static_cast<size_t>(mip_width) * mip_height * 4) };
+		for (uint32_t y = 0; y < mip_height; y++) {
+			for (uint32_t x = 0; x < mip_width; x++) {
+				uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+				for (uint32_t channel = 0; channel < 4; channel++) {
+					uint32_t sum = previous.pixels[(static_cast<size_t>(y0) * width + x0) * 4 + channel]
+						+ previous.pixels[(static_cast<size_t>(y0) * width + x1) * 4 + channel]
+						+ previous.pixels[(static_cast<size_t>(y1) * width + x0) * 4 + channel]
+						+ previous.pixels[(static_cast<size_t>(y1) * width + x1) * 4 + channel];
+					mip.pixels[(static_cast<size_t>(y) * mip_width + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+		mips.push_back(std::move(mip));
+		width = mip_width;
+		height = mip_height;
+	}
+}
+
+std::unique_ptr<RgbaTextureSource>
+RgbaTextureSource::checkerboard(uint32_t size, uint32_t cell_size) {
+	std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint8_t value = ((x / cell_size + y / cell_size) % 2 == 0) ? 255 : 0;
+			uint8_t* pixel = &pixels[(static_cast<size_t>(y) * size + x) * 4];
+			pixel[0] = pixel[1] = pixel[2] = value;
+			pixel[3] = 255;
+		}
+	}
+	return std::make_unique<RgbaTextureSource>(size, size, std::move(pixels));
+}
+
+void
+RgbaTextureSource::readMip(uint32_t level, void* destination) const {
+	std::memcpy(destination, mips[level].pixels.data(), mips[level].pixels.size());
+}
+
+TextureStreamer::TextureStreamer(LogicalDevice& device, BindlessDescriptors& bindless, uint32_t frame_count, VkDeviceSize memory_budget)
+	: device{ device }, bindless{ bindless }, frame_count{ frame_count }, memory_budget{ memory_budget } {
+	createSampler();
+
+	// Mips are read straight into mapped memory, so the streaming thread never waits on the render thread
+	device.createBuffer(
+		STAGING_CAPACITY,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		MemoryCategory::Staging,
+		staging_buffer,
+		staging_memory);
+	void* mapped;
+	vkMapMemory(device.getDevice(), staging_memory, 0, STAGING_CAPACITY, 0, &mapped);
+	staging_mapped = static_cast<char*>(mapped);
+
+	worker = std::thread(&TextureStreamer::workerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		stopping = true;
+	}
+	queue_condition.notify_all();
+	worker.join();
+
+	for (StreamedTexture& texture : textures) {
+		vkDestroyImageView(device.getDevice(), texture.view, nullptr);
+		vkDestroyImage(device.getDevice(), texture.image, nullptr);
+		device.freeMemory(texture.memory);
+	}
+	for (RetiredImage& retired : retired_images) {
+		vkDestroyImageView(device.getDevice(), retired.view, nullptr);
+		vkDestroyImage(device.getDevice(), retired.image, nullptr);
+		device.freeMemory(retired.memory);
+	}
+	vkDestroySampler(device.getDevice(), sampler, nullptr);
+	vkUnmapMemory(device.getDevice(), staging_memory);
+	vkDestroyBuffer(device.getDevice(), staging_buffer, nullptr);
+	device.freeMemory(staging_memory);
+}
+
+uint32_t
+TextureStreamer::addTexture(std::unique_ptr<TextureSource> source) {
+	StreamedTexture texture{};
+	uint32_t mip_count = source->getMipCount();
+	if (mip_count == 0) throw std::runtime_error("Texture has no mip levels");
+	if (!device.supportsTextureFormat(source->getFormat())) throw std::runtime_error("Texture format is not supported by the device");
+	texture.tail_level = mip_count - 1;
+	while (texture.tail_level > 0) {
+		VkExtent2D extent = source->getMipExtent(texture.tail_level - 1);
+		if (std::max(extent.width, extent.height) > RESIDENT_TAIL_EXTENT) break;
+		texture.tail_level--;
+	}
+	texture.finest_level = texture.tail_level;
+	while (texture.finest_level > 0 && source->getMipSize(texture.finest_level - 1) <= STAGING_CAPACITY) texture.finest_level--;
+	texture.resident_level = texture.tail_level;
+	texture.requested_level = texture.tail_level;
+	texture.source = std::move(source);
+	createResidentImage(texture, texture.tail_level, texture.image, texture.memory, texture.view, texture.memory_size);
+
+	// The tail is small, so a blocking upload through its own staging buffer is acceptable
+	VkDeviceSize tail_size = 0;
+	for (uint32_t level = texture.tail_level; level < mip_count; level++) tail_size = (tail_size + texture.source->getMipSize(level) + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	VkBuffer upload_buffer;
+	VkDeviceMemory upload_memory;
+	device.createBuffer(
+		tail_size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		MemoryCategory::Staging,
+		upload_buffer,
+		upload_memory);
+	void* mapped;
+	vkMapMemory(device.getDevice(), upload_memory, 0, tail_size, 0, &mapped);
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize offset = 0;
+	for (uint32_t level = texture.tail_level; level < mip_count; level++) {
+		texture.source->readMip(level, static_cast<char*>(mapped) + offset);
+		VkBufferImageCopy region{};
+		region.bufferOffset = offset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.tail_level, 0, 1 };
+		VkExtent2D extent = texture.source->getMipExtent(level);
+		region.imageExtent = { extent.width, extent.height, 1 };
+		regions.push_back(region);
+		offset = (offset + texture.source->getMipSize(level) + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	}
+	vkUnmapMemory(device.getDevice(), upload_memory);
+
+	uint32_t level_count = mip_count - texture.tail_level;
+	VkCommandBuffer command_buffer = device.beginSingleTimeCommands();
+	VkImageMemoryBarrier to_transfer = imageBarrier(texture.image, level_count, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+	vkCmdCopyBufferToImage(command_buffer, upload_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	VkImageMemoryBarrier to_shader = imageBarrier(texture.image, level_count, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_shader);
+	device.endSingleTimeCommands(command_buffer);
+	vkDestroyBuffer(device.getDevice(), upload_buffer, nullptr);
+	device.freeMemory(upload_memory);
+
+	texture.descriptor_index = bindless.addImage(texture.view, sampler);
+	resident_bytes += texture.memory_size;
+	textures.push_back(std::move(texture));
+	return static_cast<uint32_t>(textures.size() - 1);
+}
+
+void
+TextureStreamer::requestLevel(uint32_t texture, uint32_t level) {
+	StreamedTexture& streamed = textures[texture];
+	level = std::clamp(level, streamed.finest_level, streamed.tail_level);
+	// Several objects may share a texture, the finest level any of them asks for this frame wins
+	if (streamed.last_request_frame != frame_counter) streamed.requested_level = level;
+	else streamed.requested_level = std::min(streamed.requested_level, level);
+	streamed.last_request_frame = frame_counter;
+}
+
+uint32_t
+TextureStreamer::levelForScreenSize(uint32_t texture, float screen_pixels) {
+	const TextureSource& source = *textures[texture].source;
+	VkExtent2D extent = source.getMipExtent(0);
+	float texels = static_cast<float>(std::max(extent.width, extent.height));
+	if (screen_pixels >= texels) return 0;
+	if (screen_pixels < 1.0f) return source.getMipCount() - 1;
+	// One texel per pixel: each level halves the extent
+	uint32_t level = static_cast<uint32_t>(std::floor(std::log2(texels / screen_pixels)));
+	return std::min(level, source.getMipCount() - 1);
+}
+
+void
+TextureStreamer::update(VkCommandBuffer command_buffer) {
+	// Frames up to frame_counter - frame_count have completed, so have their copies and draws
+	while (!retired_images.empty() && retired_images.front().frame + frame_count <= frame_counter) {
+		RetiredImage& retired = retired_images.front();
+		vkDestroyImageView(device.getDevice(), retired.view, nullptr);
+		vkDestroyImage(device.getDevice(), retired.image, nullptr);
+		device.freeMemory(retired.memory);
+		retired_images.erase(retired_images.begin());
+	}
+	while (!staging_spans.empty() && staging_spans.front().release_frame != UINT64_MAX && staging_spans.front().release_frame + frame_count <= frame_counter) {
+		staging_spans.pop_front();
+	}
+
+	// Copy levels the streaming thread has finished reading into their textures
+	std::vector<ReadRequest> finished;
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		finished.swap(completed_reads);
+	}
+	for (const ReadRequest& read : finished) {
+		StreamedTexture& texture = textures[read.texture];
+		texture.loading = false;
+		// The texture may have been demoted while the level was being read
+		bool still_next = texture.resident_level == read.level + 1 && desiredLevel(texture) <= read.level;
+		if (still_next && makeRoom(command_buffer, texture.source->getMipSize(read.level), read.texture)) {
+			changeResidency(command_buffer, read.texture, read.level, read.staging_offset);
+		} else if (still_next) {
+			// Nothing can be evicted for it, so back off rather than reading the level again every frame
+			texture.blocked_until_frame = frame_counter + REQUEST_LIFETIME_FRAMES;
+		}
+		releaseStaging(read.staging_offset, frame_counter);
+	}
+
+	// The budget may have shrunk, or requests expired
+	if (resident_bytes > memory_budget) makeRoom(command_buffer, 0, NO_TEXTURE);
+
+	// Read the next level of the textures furthest from their requested level first
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < textures.size(); i++) {
+		const StreamedTexture& texture = textures[i];
+		if (!texture.loading && texture.blocked_until_frame <= frame_counter && desiredLevel(texture) < texture.resident_level) candidates.push_back(i);
+	}
+	std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+		return textures[a].resident_level - desiredLevel(textures[a]) > textures[b].resident_level - desiredLevel(textures[b]);
+	});
+	std::vector<ReadRequest> reads;
+	for (uint32_t i : candidates) {
+		StreamedTexture& texture = textures[i];
+		uint32_t level = texture.resident_level - 1;
+		VkDeviceSize staging_offset;
+		if (!allocateStaging(texture.source->getMipSize(level), staging_offset)) break; // Ring is full until earlier copies complete
+		reads.push_back({ texture.source.get(), i, level, staging_offset });
+		texture.loading = true;
+	}
+	if (!reads.empty()) {
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			pending_reads.insert(pending_reads.end(), reads.begin(), reads.end());
+		}
+		queue_condition.notify_one();
+	}
+
+	frame_counter++;
+}
+
+void
+TextureStreamer::createSampler() {
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_LINEAR;
+	sampler_info.minFilter = VK_FILTER_LINEAR;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_info.maxLod = VK_LOD_CLAMP_NONE; // Level 0 of each view is the finest resident level
+	if (vkCreateSampler(device.getDevice(), &sampler_info, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture sampler");
+	}
+}
+
+void
+TextureStreamer::workerLoop() {
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	while (true) {
+		queue_condition.wait(lock, [&]() { return stopping || !pending_reads.empty(); });
+		if (stopping) return;
+		ReadRequest read = pending_reads.front();
+		pending_reads.pop_front();
+
+		// Reading may block on I/O, so the render thread must be free to take the lock meanwhile
+		lock.unlock();
+		read.source->readMip(read.level, staging_mapped + read.staging_offset);
+		lock.lock();
+		completed_reads.push_back(read);
+	}
+}
+
+bool
+TextureStreamer::allocateStaging(VkDeviceSize size, VkDeviceSize& offset) {
+	size = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	if (staging_spans.empty()) staging_head = 0;
+
+	// Spans are released in allocation order, so free space is after the head and (once wrapped) before the oldest span
+	if (staging_spans.empty() || staging_head > staging_spans.front().offset) {
+		if (STAGING_CAPACITY - staging_head >= size) offset = staging_head;
+		else if (!staging_spans.empty() && staging_spans.front().offset >= size) offset = 0;
+		else return false;
+	} else if (staging_spans.front().offset - staging_head >= size) {
+		offset = staging_head;
+	} else {
+		return false;
+	}
+
+	staging_spans.push_back({ offset, size, UINT64_MAX });
+	staging_head = offset + size;
+	return true;
+}
+
+void
+TextureStreamer::releaseStaging(VkDeviceSize offset, uint64_t frame) {
+	for (StagingSpan& span : staging_spans) {
+		if (span.offset == offset && span.release_frame == UINT64_MAX) {
+			span.release_frame = frame;
+			return;
+		}
+	}
+}
+
+uint32_t
+TextureStreamer::desiredLevel(const StreamedTexture& texture) {
+	if (texture.last_request_frame + REQUEST_LIFETIME_FRAMES < frame_counter) return texture.tail_level;
+	return texture.requested_level;
+}
+
+void
+TextureStreamer::createResidentImage(const StreamedTexture& texture, uint32_t first_level, VkImage& image, VkDeviceMemory& memory, VkImageView& view, VkDeviceSize& memory_size) {
+	VkExtent2D extent = texture.source->getMipExtent(first_level);
+	uint32_t level_count = texture.source->getMipCount() - first_level;
+
+	VkImageCreateInfo image_info{};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.format = texture.source->getFormat();
+	image_info.extent = { extent.width, extent.height, 1 };
+	image_info.mipLevels = level_count;
+	image_info.arrayLayers = 1;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	device.createImageWithInfo(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Texture, image, memory);
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device.getDevice(), image, &requirements);
+	memory_size = requirements.size;
+
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = image_info.format;
+	view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1 };
+	if (vkCreateImageView(device.getDevice(), &view_info, nullptr, &view) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture image view");
+	}
+}
+
+void
+TextureStreamer::changeResidency(VkCommandBuffer command_buffer, uint32_t texture_index, uint32_t first_level, VkDeviceSize staging_offset) {
+	StreamedTexture& texture = textures[texture_index];
+	uint32_t mip_count = texture.source->getMipCount();
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView view;
+	VkDeviceSize memory_size;
+	createResidentImage(texture, first_level, image, memory, view, memory_size);
+
+	// Earlier frames in submission order may still sample the old image, the barrier waits for their fragment shaders
+	VkImageMemoryBarrier to_transfer[] = {
+		imageBarrier(texture.image, mip_count - texture.resident_level, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+		imageBarrier(image, mip_count - first_level, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT)
+	};
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, to_transfer);
+
+	// Levels held by both images move over on the GPU, only a newly added level comes from staging
+	std::vector<VkImageCopy> copies;
+	for (uint32_t level = std::max(first_level, texture.resident_level); level < mip_count; level++) {
+		VkExtent2D extent = texture.source->getMipExtent(level);
+		VkImageCopy copy{};
+		copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.resident_level, 0, 1 };
+		copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - first_level, 0, 1 };
+		copy.extent = { extent.width, extent.height, 1 };
+		copies.push_back(copy);
+	}
+	vkCmdCopyImage(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+	if (first_level < texture.resident_level) {
+		VkExtent2D extent = texture.source->getMipExtent(first_level);
+		VkBufferImageCopy region{};
+		region.bufferOffset = staging_offset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyBufferToImage(command_buffer, staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	VkImageMemoryBarrier to_shader = imageBarrier(image, mip_count - first_level, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_shader);
+
+	// Pending frames still use the old slot, so the new image gets its own and the old one is released once they complete
+	bindless.removeImage(texture.descriptor_index);
+	texture.descriptor_index = bindless.addImage(view, sampler);
+	retired_images.push_back({ texture.image, texture.memory, texture.view, frame_counter });
+	resident_bytes = resident_bytes - texture.memory_size + memory_size;
+	texture.image = image;
+	texture.memory = memory;
+	texture.view = view;
+	texture.memory_size = memory_size;
+	texture.resident_level = first_level;
+}
+
+bool
+TextureStreamer::makeRoom(VkCommandBuffer command_buffer, VkDeviceSize bytes, uint32_t protected_texture) {
+	while (resident_bytes + bytes > memory_budget) {
+		// Evict from the texture whose request is oldest, among those holding finer levels than they currently need
+		uint32_t victim = NO_TEXTURE;
+		for (uint32_t i = 0; i < textures.size(); i++) {
+			const StreamedTexture& texture = textures[i];
+			if (i == protected_texture || texture.resident_level >= desiredLevel(texture) || texture.resident_level == texture.tail_level) continue;
+			if (victim == NO_TEXTURE || texture.last_request_frame < textures[victim].last_request_frame) victim = i;
+		}
+		if (victim == NO_TEXTURE) return false;
+		changeResidency(command_buffer, victim, textures[victim].resident_level + 1, 0);
+	}
+	return true;
+}
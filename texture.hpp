@@ -0,0 +1,227 @@
+#pragma once
+
+#include "descriptors.hpp"
+#include "device.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Provides the mip levels of a texture in the exact layout they are uploaded in (tightly packed rows, or blocks for
+/// compressed formats). Level 0 is the finest
+/// </summary>
+class TextureSource {
+public:
+	virtual ~TextureSource() = default;
+
+	virtual VkFormat getFormat() const = 0;
+	virtual uint32_t getMipCount() const = 0;
+	virtual VkExtent2D getMipExtent(uint32_t level) const = 0;
+	virtual VkDeviceSize getMipSize(uint32_t level) const = 0;
+	/// <summary>
+	/// Copy the data of a mip level to the given memory. Called from the streaming thread, so it may block on I/O,
+	/// but must not touch state shared with other sources without synchronisation
+	/// </summary>
+	/// <param name="level">Mip level to read</param>
+	/// <param name="destination">Memory with room for getMipSize(level) bytes (usually mapped staging memory)</param>
+	virtual void readMip(uint32_t level, void* destination) const = 0;
+};
+
+/// <summary>
+/// Uncompressed RGBA8 texture held in host memory, with its mip chain generated by box filtering
+/// </summary>
+class RgbaTextureSource : public TextureSource {
+public:
+	/// <summary>
+	/// Creates a RgbaTextureSource object
+	/// </summary>
+	/// <param name="width">Width of level 0 in pixels</param>
+	/// <param name="height">Height of level 0 in pixels</param>
+	/// <param name="pixels">width * height RGBA8 pixels, row by row</param>
+	/// <param name="srgb">Whether the colours are sRGB encoded</param>
+	RgbaTextureSource(uint32_t width, uint32_t height, std::vector<uint8_t> pixels, bool srgb = true);
+
+	/// <summary>
+	/// Black and white checkerboard, mostly useful to see which mip level is sampled
+	/// </summary>
+	static std::unique_ptr<RgbaTextureSource> checkerboard(uint32_t size, uint32_t cell_size);
+
+	VkFormat getFormat() const override { return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM; }
+	uint32_t getMipCount() const override { return static_cast<uint32_t>(mips.size()); }
+	VkExtent2D getMipExtent(uint32_t level) const override { return mips[level].extent; }
+	VkDeviceSize getMipSize(uint32_t level) const override { return mips[level].pixels.size(); }
+	void readMip(uint32_t level, void* destination) const override;
+
+private:
+	struct Mip {
+		VkExtent2D extent;
+		std::vector<uint8_t> pixels;
+	};
+
+	std::vector<Mip> mips;
+	bool srgb;
+};
+
+/// <summary>
+/// Streams texture mip levels into device memory on demand. The coarse tail of every texture (levels of at most
+/// RESIDENT_TAIL_EXTENT texels) is uploaded when it is added, finer levels are read by a background thread straight into
+/// a staging ring and copied in during the frame, one level per texture per frame. Textures stay within a memory budget by
+/// dropping their finest levels when they are no longer requested. Changing the resident levels of a texture recreates its
+/// image with the new level range in a new bindless slot (frames in flight keep sampling the old one), so the slot of a
+/// texture must be looked up every frame
+/// </summary>
+class TextureStreamer {
+public:
+	static constexpr uint32_t NO_TEXTURE = UINT32_MAX;
+	static constexpr uint32_t RESIDENT_TAIL_EXTENT = 64;
+	static constexpr VkDeviceSize STAGING_CAPACITY = 64ull * 1024 * 1024;
+	/// <summary>
+	/// Frames a texture keeps its requested levels after it was last requested, before they may be evicted
+	/// </summary>
+	static constexpr uint64_t REQUEST_LIFETIME_FRAMES = 120;
+
+	/// <summary>
+	/// Creates a TextureStreamer object
+	/// </summary>
+	/// <param name="device">Device to create images on</param>
+	/// <param name="bindless">Bindless set holding a slot per texture</param>
+	/// <param name="frame_count">Number of frames that can be in flight</param>
+	/// <param name="memory_budget">Bytes of device memory all textures may occupy together</param>
+	TextureStreamer(LogicalDevice& device, BindlessDescriptors& bindless, uint32_t frame_count, VkDeviceSize memory_budget);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	/// <summary>
+	/// Add a texture and upload its coarse tail, blocking until it is resident
+	/// </summary>
+	/// <returns>Identifier of the texture</returns>
+	uint32_t addTexture(std::unique_ptr<TextureSource> source);
+	/// <summary>
+	/// Ask for a texture to be resident down to the given level, e.g. as computed by levelForScreenSize
+	/// </summary>
+	void requestLevel(uint32_t texture, uint32_t level);
+	/// <summary>
+	/// Finest level worth having resident for a texture covering the given number of pixels on screen
+	/// </summary>
+	uint32_t levelForScreenSize(uint32_t texture, float screen_pixels);
+	/// <summary>
+	/// Record this frame's uploads and residency changes. Must be recorded outside of a render pass, before any draw
+	/// sampling the textures, once per frame after the frame's previous submission has completed
+	/// </summary>
+	void update(VkCommandBuffer command_buffer);
+
+	/// <summary>
+	/// Index of the texture in the bindless image array for the frame being recorded
+	/// </summary>
+	uint32_t getDescriptorIndex(uint32_t texture) { return textures[texture].descriptor_index; }
+	/// <summary>
+	/// Finest mip level currently resident
+	/// </summary>
+	uint32_t getResidentLevel(uint32_t texture) { return textures[texture].resident_level; }
+	VkDeviceSize getResidentBytes() { return resident_bytes; }
+	void setMemoryBudget(VkDeviceSize budget) { memory_budget = budget; }
+
+private:
+	struct StreamedTexture {
+		std::unique_ptr<TextureSource> source;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkDeviceSize memory_size = 0;
+		uint32_t tail_level = 0;     // Finest level that is never evicted
+		uint32_t finest_level = 0;   // Finest level small enough to pass through the staging ring
+		uint32_t resident_level = 0; // Finest level in the image, which holds every level from here to the last
+		uint32_t requested_level = 0;
+		uint64_t last_request_frame = 0;
+		uint64_t blocked_until_frame = 0; // Set when a streamed level did not fit in the budget, to stop reading it again every frame
+		bool loading = false; // Level resident_level - 1 is being read
+		uint32_t descriptor_index = 0;
+	};
+
+	/// <summary>
+	/// Mip level read by the streaming thread into staging memory
+	/// </summary>
+	struct ReadRequest {
+		const TextureSource* source; // Stable while textures grows, unlike the StreamedTexture entries
+		uint32_t texture;
+		uint32_t level;
+		VkDeviceSize staging_offset;
+	};
+
+	/// <summary>
+	/// Image with a view, kept alive until frames that may still sample it have completed
+	/// </summary>
+	struct RetiredImage {
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		uint64_t frame;
+	};
+
+	/// <summary>
+	/// Reserved range of the staging ring, released in allocation order once the frame that copied from it has completed
+	/// </summary>
+	struct StagingSpan {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint64_t release_frame; // UINT64_MAX while its copy has not been recorded
+	};
+
+	LogicalDevice& device;
+	BindlessDescriptors& bindless;
+	uint32_t frame_count;
+	VkDeviceSize memory_budget;
+	VkDeviceSize resident_bytes = 0;
+	uint64_t frame_counter = 0;
+	VkSampler sampler = VK_NULL_HANDLE;
+	std::vector<StreamedTexture> textures;
+	std::vector<RetiredImage> retired_images;
+
+	// Staging ring, written by the streaming thread and read by copy commands
+	VkBuffer staging_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+	char* staging_mapped = nullptr;
+	VkDeviceSize staging_head = 0; // Next free byte
+	std::deque<StagingSpan> staging_spans;
+
+	// Streaming thread and its queues
+	std::thread worker;
+	std::mutex queue_mutex;
+	std::condition_variable queue_condition;
+	std::deque<ReadRequest> pending_reads;
+	std::vector<ReadRequest> completed_reads;
+	bool stopping = false;
+
+	void createSampler();
+	void workerLoop();
+	/// <summary>
+	/// Reserve contiguous staging memory, returning false if the ring has no room this frame
+	/// </summary>
+	bool allocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+	void releaseStaging(VkDeviceSize offset, uint64_t frame);
+	/// <summary>
+	/// Finest level a texture should have resident, falling back to its tail once its request has expired
+	/// </summary>
+	uint32_t desiredLevel(const StreamedTexture& texture);
+	/// <summary>
+	/// Create an image (with view) holding the levels of a texture from first_level to the last
+	/// </summary>
+	void createResidentImage(const StreamedTexture& texture, uint32_t first_level, VkImage& image, VkDeviceMemory& memory, VkImageView& view, VkDeviceSize& memory_size);
+	/// <summary>
+	/// Replace a texture's image with one holding levels from first_level, copying the levels both images share.
+	/// When a finer level is added, its data is copied from the given staging offset
+	/// </summary>
+	void changeResidency(VkCommandBuffer command_buffer, uint32_t texture_index, uint32_t first_level, VkDeviceSize staging_offset);
+	/// <summary>
+	/// Drop the finest level of the least recently requested textures holding more than they were asked for, until
+	/// the given number of bytes fits in the budget. Returns whether it does
+	/// </summary>
+	bool makeRoom(VkCommandBuffer command_buffer, VkDeviceSize bytes, uint32_t protected_texture);
+};
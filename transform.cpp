@@ -0,0 +1,153 @@
+#include "transform.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+uint32_t
+TransformHierarchy::addNode(const glm::mat4& local, uint32_t parent) {
+	uint32_t node = size();
+	if (parent != NO_PARENT && parent >= node) throw std::runtime_error("Transform parent must be added before its children");
+	parents.push_back(parent);
+	staged_locals.push_back(local);
+	return node;
+}
+
+void
+TransformHierarchy::setLocal(uint32_t node, const glm::mat4& local) {
+	if (node >= node_slots.size()) {
+		staged_locals[node - node_slots.size()] = local; // Not placed yet, the whole hierarchy is recomputed once it is
+		return;
+	}
+	uint32_t slot = node_slots[node];
+	local_transforms[slot] = local;
+	markDirty(slot);
+}
+
+const glm::mat4&
+TransformHierarchy::getLocal(uint32_t node) const {
+	if (node >= node_slots.size()) return staged_locals[node - node_slots.size()];
+	return local_transforms[node_slots[node]];
+}
+
+void
+TransformHierarchy::update(std::vector<uint32_t>& updated_nodes) {
+	if (!staged_locals.empty()) rebuildLayout();
+
+	updated_nodes.clear();
+	for (uint32_t level = 0; level < getDepthCount(); level++) {
+		if (dirty_levels[level].empty()) continue; // Untouched levels cost nothing, only dirty subtrees are visited
+		updateLevel(level);
+		for (uint32_t slot : dirty_levels[level]) {
+			dirty[slot] = 0;
+			updated_nodes.push_back(slot_nodes[slot]);
+		}
+		dirty_levels[level].clear();
+	}
+}
+
+void
+TransformHierarchy::rebuildLayout() {
+	uint32_t node_count = size();
+	uint32_t placed_count = static_cast<uint32_t>(node_slots.size());
+
+	// Local transforms by node, taken from the sorted arrays or from the nodes added since
+	std::vector<glm::mat4> locals(node_count);
+	for (uint32_t node = 0; node < placed_count; node++) locals[node] = local_transforms[node_slots[node]];
+	for (uint32_t node = placed_count; node < node_count; node++) locals[node] = staged_locals[node - placed_count];
+	staged_locals.clear();
+
+	// Children of every node, in order of their identifiers
+	std::vector<uint32_t> child_offsets(static_cast<size_t>(node_count) + 1, 0);
+	for (uint32_t node = 0; node < node_count; node++) {
+		if (parents[node] != NO_PARENT) child_offsets[parents[node] + 1]++;
+	}
+	for (uint32_t node = 0; node < node_count; node++) child_offsets[node + 1] += child_offsets[node];
+	std::vector<uint32_t> children(child_offsets.back());
+	std::vector<uint32_t> child_cursors(child_offsets.begin(), child_offsets.end() - 1);
+	for (uint32_t node = 0; node < node_count; node++) {
+		if (parents[node] != NO_PARENT) children[child_cursors[parents[node]]++] = node;
+	}
+
+	// Breadth-first order places each level after the previous one, with siblings next to each other
+	slot_nodes.clear();
+	slot_nodes.reserve(node_count);
+	first_child_slots.assign(node_count, 0);
+	child_counts.assign(node_count, 0);
+	for (uint32_t node = 0; node < node_count; node++) {
+		if (parents[node] == NO_PARENT) slot_nodes.push_back(node);
+	}
+	level_offsets = { 0 };
+	uint32_t level_begin = 0;
+	while (level_begin < slot_nodes.size()) {
+		uint32_t level_end = static_cast<uint32_t>(slot_nodes.size());
+		level_offsets.push_back(level_end);
+		for (uint32_t slot = level_begin; slot < level_end; slot++) {
+			uint32_t node = slot_nodes[slot];
+			first_child_slots[slot] = static_cast<uint32_t>(slot_nodes.size());
+			child_counts[slot] = child_offsets[node + 1] - child_offsets[node];
+			slot_nodes.insert(slot_nodes.end(), children.begin() + child_offsets[node], children.begin() + child_offsets[node + 1]);
+		}
+		level_begin = level_end;
+	}
+	assert(slot_nodes.size() == node_count && "Every node must be reachable from a root");
+
+	node_slots.resize(node_count);
+	parent_slots.resize(node_count);
+	local_transforms.resize(node_count);
+	world_transforms.resize(node_count);
+	for (uint32_t slot = 0; slot < node_count; slot++) node_slots[slot_nodes[slot]] = slot;
+	for (uint32_t slot = 0; slot < node_count; slot++) {
+		uint32_t node = slot_nodes[slot];
+		parent_slots[slot] = parents[node] == NO_PARENT ? NO_PARENT : node_slots[parents[node]];
+		local_transforms[slot] = locals[node];
+	}
+
+	// Slots changed for (potentially) every node, so everything is recomputed once
+	dirty.assign(node_count, 1);
+	dirty_levels.assign(getDepthCount() + 1, {}); // Extra empty level receives the (non-existent) children of the deepest one
+	for (uint32_t level = 0; level < getDepthCount(); level++) {
+		for (uint32_t slot = level_offsets[level]; slot < level_offsets[level + 1]; slot++) dirty_levels[level].push_back(slot);
+	}
+}
+
+void
+TransformHierarchy::markDirty(uint32_t slot) {
+	if (dirty[slot]) return;
+	dirty[slot] = 1;
+	uint32_t level = static_cast<uint32_t>(std::upper_bound(level_offsets.begin(), level_offsets.end(), slot) - level_offsets.begin()) - 1;
+	dirty_levels[level].push_back(slot);
+}
+
+void
+TransformHierarchy::updateLevel(uint32_t level) {
+	const std::vector<uint32_t>& queue = dirty_levels[level];
+
+	// Slots of one level only read their parents' (already final) world transforms, so any split of the queue is safe.
+	// Each child has a single parent, so its dirty flag is only ever touched by the thread handling that parent
+	auto process = [this, &queue](size_t begin, size_t end, std::vector<uint32_t>& queued_children) {
+		for (size_t i = begin; i < end; i++) {
+			uint32_t slot = queue[i];
+			world_transforms[slot] = parent_slots[slot] == NO_PARENT
+				? local_transforms[slot]
+				: world_transforms[parent_slots[slot]] * local_transforms[slot];
+			for (uint32_t child = first_child_slots[slot]; child < first_child_slots[slot] + child_counts[slot]; child++) {
+				if (dirty[child]) continue; // Already queued by its own change
+				dirty[child] = 1;
+				queued_children.push_back(child);
+			}
+		}
+	};
+
+	std::vector<uint32_t>& next_queue = dirty_levels[level + 1];
+	if (queue.size() < PARALLEL_THRESHOLD || jobs == nullptr || jobs->getThreadCount() == 1) {
+		process(0, queue.size(), next_queue);
+		return;
+	}
+
+	// Split into contiguous ranges, concatenating the queued children in range order keeps the result deterministic
+	constexpr size_t GRAIN = PARALLEL_THRESHOLD / 4;
+	std::vector<std::vector<uint32_t>> range_children(jobs->rangeCount(queue.size(), GRAIN));
+	jobs->parallelForRanges(queue.size(), GRAIN, [&](size_t range, size_t begin, size_t end) { process(begin, end, range_children[range]); });
+	for (const std::vector<uint32_t>& queued : range_children) next_queue.insert(next_queue.end(), queued.begin(), queued.end());
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Scene graph of transforms stored as flat arrays sorted by depth, with the children of a node stored contiguously in the
+/// next level. Changing a local transform marks the node dirty; update() only recomputes the world transforms of dirty
+/// subtrees, one depth level at a time with the nodes of a level split across jobs
+/// </summary>
+class TransformHierarchy {
+public:
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+	/// <summary>
+	/// Dirty nodes in a level below which the level is updated on the calling thread only
+	/// </summary>
+	static constexpr uint32_t PARALLEL_THRESHOLD = 4096;
+
+	/// <param name="jobs">Scheduler large levels are split across, or nullptr to update on the calling thread only</param>
+	explicit TransformHierarchy(JobSystem* jobs = nullptr) : jobs{ jobs } {}
+
+	/// <summary>
+	/// Add a node, which is placed in the hierarchy on the next update
+	/// </summary>
+	/// <param name="local">Transform relative to the parent (or to world space for roots)</param>
+	/// <param name="parent">Node to attach to, which must already exist, or NO_PARENT for a root</param>
+	/// <returns>Identifier of the node, stable for the lifetime of the hierarchy</returns>
+	uint32_t addNode(const glm::mat4& local, uint32_t parent = NO_PARENT);
+	/// <summary>
+	/// Change the local transform of a node, its subtree's world transforms are recomputed on the next update
+	/// </summary>
+	void setLocal(uint32_t node, const glm::mat4& local);
+	const glm::mat4& getLocal(uint32_t node) const;
+	/// <summary>
+	/// World transform of a node as of the last update, which must have happened after the node was added
+	/// </summary>
+	const glm::mat4& getWorld(uint32_t node) const { return world_transforms[node_slots[node]]; }
+	uint32_t getParent(uint32_t node) const { return parents[node]; }
+	uint32_t size() const { return static_cast<uint32_t>(parents.size()); }
+	uint32_t getDepthCount() const { return static_cast<uint32_t>(level_offsets.empty() ? 0 : level_offsets.size() - 1); }
+
+	/// <summary>
+	/// Recompute the world transforms of all dirty nodes and their descendants
+	/// </summary>
+	/// <param name="updated_nodes">Filled with the identifiers of every node whose world transform was recomputed</param>
+	void update(std::vector<uint32_t>& updated_nodes);
+
+private:
+	JobSystem* jobs;
+
+	// Per node identifier
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> node_slots;     // Position of each node in the depth-sorted arrays (nodes added since the last sort have none)
+	std::vector<glm::mat4> staged_locals; // Local transforms of the nodes added since the last sort
+
+	// Per slot, sorted by depth, children of a node contiguous in the next level
+	std::vector<uint32_t> slot_nodes;
+	std::vector<uint32_t> parent_slots;
+	std::vector<uint32_t> first_child_slots;
+	std::vector<uint32_t> child_counts;
+	std::vector<glm::mat4> local_transforms;
+	std::vector<glm::mat4> world_transforms;
+	std::vector<uint8_t> dirty; // Slot already queued for recomputation
+	std::vector<uint32_t> level_offsets; // First slot of each level, followed by the slot count
+
+	std::vector<std::vector<uint32_t>> dirty_levels; // Queued slots of each level
+
+	/// <summary>
+	/// Sort the nodes by depth so that every level only depends on the previous one, then mark everything dirty
+	/// </summary>
+	void rebuildLayout();
+	void markDirty(uint32_t slot);
+	/// <summary>
+	/// Recompute the queued slots of a level and queue their children in the next one
+	/// </summary>
+	void updateLevel(uint32_t level);
+};